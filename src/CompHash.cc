@@ -52,6 +52,18 @@ CompositeHash::CompositeHash(TypeListPtr composite_type)
 		singleton_tag = type->GetTypes()[0]->InternalType();
 		size = 0;
 		key = nullptr;
+
+		switch ( singleton_tag ) {
+		case TYPE_INTERNAL_INT:
+		case TYPE_INTERNAL_UNSIGNED:
+		case TYPE_INTERNAL_DOUBLE:
+		case TYPE_INTERNAL_ADDR:
+			has_atomic_keys = true;
+			break;
+
+		default:
+			break;
+		}
 		}
 
 	else
@@ -184,7 +196,7 @@ char* CompositeHash::SingleValHash(bool type_check, char* kp0,
 
 			for ( int i = 0; i < num_fields; ++i )
 				{
-				auto rv_i = rv->GetField(i).get();
+				auto rv_i = rv->GetField(i);
 
 				Attributes* a = rt->FieldDecl(i)->attrs.get();
 				bool optional_attr = (a && a->Find(ATTR_OPTIONAL));
@@ -194,7 +206,7 @@ char* CompositeHash::SingleValHash(bool type_check, char* kp0,
 
 				if ( ! (kp = SingleValHash(type_check, kp,
 							   rt->GetFieldType(i).get(),
-							   rv_i, optional_attr)) )
+							   rv_i.get(), optional_attr)) )
 					return nullptr;
 				}
 
@@ -385,6 +397,55 @@ std::unique_ptr<HashKey> CompositeHash::MakeHashKey(const Val& argv, bool type_c
 	return std::make_unique<HashKey>((k == key), (void*) k, kp - k);
 	}
 
+bool CompositeHash::MakeAtomicKey(const Val& argv, AtomicKey* k, bool type_check) const
+	{
+	auto v = &argv;
+
+	if ( v->GetType()->Tag() == TYPE_LIST )
+		{
+		auto lv = v->AsListVal();
+
+		if ( type_check && lv->Length() != 1 )
+			return false;
+
+		v = lv->Idx(0).get();
+		}
+
+	if ( type_check && v->GetType()->InternalType() != singleton_tag )
+		return false;
+
+	// Mirrors the HashKey constructors that ComputeSingletonHash()
+	// uses for these types.
+	switch ( singleton_tag ) {
+	case TYPE_INTERNAL_INT:
+		k->data.i = v->AsInt();
+		k->size = sizeof(k->data.i);
+		break;
+
+	case TYPE_INTERNAL_UNSIGNED:
+		k->data.i = bro_int_t(v->AsCount());
+		k->size = sizeof(k->data.u);
+		break;
+
+	case TYPE_INTERNAL_DOUBLE:
+		k->data.d = v->InternalDouble();
+		k->size = sizeof(k->data.d);
+		break;
+
+	case TYPE_INTERNAL_ADDR:
+		v->AsAddr().CopyIPv6(k->data.addr);
+		k->size = sizeof(k->data.addr);
+		break;
+
+	default:
+		reporter->InternalError("bad internal type in CompositeHash::MakeAtomicKey");
+		return false;
+	}
+
+	k->hash = HashKey::HashBytes(&k->data, k->size);
+	return true;
+	}
+
 std::unique_ptr<HashKey> CompositeHash::ComputeSingletonHash(const Val* v, bool type_check) const
 	{
 	if ( v->GetType()->Tag() == TYPE_LIST )
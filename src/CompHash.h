@@ -5,6 +5,7 @@
 #include <memory>
 
 #include "zeek/Type.h"
+#include "zeek/Hash.h"
 #include "zeek/IntrusivePtr.h"
 
 namespace zeek {
@@ -16,7 +17,29 @@ using ListValPtr = zeek::IntrusivePtr<ListVal>;
 
 namespace zeek::detail {
 
-class HashKey;
+// The key of an index consisting of a single atomic value, built in place
+// rather than on the heap.  Its bytes and hash are the same as those of
+// the key that CompositeHash::MakeHashKey() returns for the value, so the
+// two can be used interchangeably for looking up entries.
+class AtomicKey {
+public:
+	const void* Key() const	{ return &data; }
+	int Size() const	{ return size; }
+	hash_t Hash() const	{ return hash; }
+
+private:
+	friend class CompositeHash;
+
+	union {
+		bro_int_t i;
+		bro_uint_t u;
+		double d;
+		uint32_t addr[4];
+	} data;
+
+	int size = 0;
+	hash_t hash = 0;
+};
 
 class CompositeHash {
 public:
@@ -27,6 +50,14 @@ public:
 	// or nullptr if it fails to typecheck.
 	std::unique_ptr<HashKey> MakeHashKey(const Val& v, bool type_check) const;
 
+	// True if the index consists of a single value of an atomic type,
+	// i.e., one whose keys MakeAtomicKey() can build.
+	bool HasAtomicKeys() const	{ return has_atomic_keys; }
+
+	// Builds the key for the given index val in *k, returning false
+	// if it fails to typecheck.  Only valid if HasAtomicKeys().
+	bool MakeAtomicKey(const Val& v, AtomicKey* k, bool type_check) const;
+
 	// Given a hash key, recover the values used to create it.
 	ListValPtr RecoverVals(const HashKey& k) const;
 
@@ -98,6 +129,8 @@ protected:
 	bool is_complex_type;
 
 	InternalTypeTag singleton_tag;
+
+	bool has_atomic_keys = false;
 };
 
 } // namespace zeek::detail
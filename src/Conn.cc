@@ -109,6 +109,7 @@ Connection::Connection(NetSessions* s, const detail::ConnIDKey& k, double t,
 
 	hist_seen = 0;
 	history = "";
+	conn_val_history_len = 0;
 
 	root_analyzer = nullptr;
 	primary_PIA = nullptr;
@@ -127,7 +128,10 @@ Connection::~Connection()
 	CancelTimers();
 
 	if ( conn_val )
+		{
+		conn_val->ResolveDeferredFields();
 		conn_val->SetOrigin(nullptr);
+		}
 
 	delete root_analyzer;
 
@@ -337,15 +341,15 @@ const RecordValPtr& Connection::ConnVal()
 		TransportProto prot_type = ConnTransport();
 
 		auto id_val = make_intrusive<RecordVal>(id::conn_id);
-		id_val->Assign(0, make_intrusive<AddrVal>(orig_addr));
+		id_val->AssignAddr(0, orig_addr);
 		id_val->Assign(1, val_mgr->Port(ntohs(orig_port), prot_type));
-		id_val->Assign(2, make_intrusive<AddrVal>(resp_addr));
+		id_val->AssignAddr(2, resp_addr);
 		id_val->Assign(3, val_mgr->Port(ntohs(resp_port), prot_type));
 
 		auto orig_endp = make_intrusive<RecordVal>(id::endpoint);
-		orig_endp->Assign(0, val_mgr->Count(0));
-		orig_endp->Assign(1, val_mgr->Count(0));
-		orig_endp->Assign(4, val_mgr->Count(orig_flow_label));
+		orig_endp->AssignCount(0, 0);
+		orig_endp->AssignCount(1, 0);
+		orig_endp->AssignCount(4, orig_flow_label);
 
 		const int l2_len = sizeof(orig_l2_addr);
 		char null[l2_len]{};
@@ -354,9 +358,9 @@ const RecordValPtr& Connection::ConnVal()
 			orig_endp->Assign(5, make_intrusive<StringVal>(fmt_mac(orig_l2_addr, l2_len)));
 
 		auto resp_endp = make_intrusive<RecordVal>(id::endpoint);
-		resp_endp->Assign(0, val_mgr->Count(0));
-		resp_endp->Assign(1, val_mgr->Count(0));
-		resp_endp->Assign(4, val_mgr->Count(resp_flow_label));
+		resp_endp->AssignCount(0, 0);
+		resp_endp->AssignCount(1, 0);
+		resp_endp->AssignCount(4, resp_flow_label);
 
 		if ( memcmp(&resp_l2_addr, &null, l2_len) != 0 )
 			resp_endp->Assign(5, make_intrusive<StringVal>(fmt_mac(resp_l2_addr, l2_len)));
@@ -364,9 +368,9 @@ const RecordValPtr& Connection::ConnVal()
 		conn_val->Assign(0, std::move(id_val));
 		conn_val->Assign(1, std::move(orig_endp));
 		conn_val->Assign(2, std::move(resp_endp));
-		// 3 and 4 are set below.
-		conn_val->Assign(5, make_intrusive<TableVal>(id::string_set));	// service
-		conn_val->Assign(6, val_mgr->EmptyString());	// history
+		// 3 and 4 are set below, 5 (service) and 6 (history) are
+		// left to ProvideField().
+		conn_val->DeferFields(this, 1 << 5);
 
 		if ( ! uid )
 			uid.Set(zeek::detail::bits_per_uid);
@@ -387,15 +391,47 @@ const RecordValPtr& Connection::ConnVal()
 	if ( root_analyzer )
 		root_analyzer->UpdateConnVal(conn_val.get());
 
-	conn_val->Assign(3, make_intrusive<TimeVal>(start_time));	// ###
-	conn_val->Assign(4, make_intrusive<IntervalVal>(last_time - start_time));
-	conn_val->Assign(6, make_intrusive<StringVal>(history.c_str()));
+	conn_val->AssignDouble(3, start_time);	// ###
+	conn_val->AssignDouble(4, last_time - start_time);
+
+	// The history only ever grows, so its current prefix is what it
+	// was at the time of this call, whenever the field gets accessed.
+	// Deferring it anew also replaces anything a script assigned, as
+	// assigning the history right here would.
+	conn_val_history_len = history.size();
+	conn_val->DeferFields(this, 1 << 6);
 
 	conn_val->SetOrigin(this);
 
 	return conn_val;
 	}
 
+ValPtr Connection::ProvideField(const RecordVal* rv, int field)
+	{
+	switch ( field ) {
+	case 5:
+		return make_intrusive<TableVal>(id::string_set);
+
+	case 6:
+		// Unless the history has grown since, the string from last
+		// time still does.
+		if ( ! conn_val_history || conn_val_history->Len() != int(conn_val_history_len) )
+			{
+			if ( conn_val_history_len == 0 )
+				conn_val_history = val_mgr->EmptyString();
+			else
+				conn_val_history = make_intrusive<StringVal>(conn_val_history_len,
+				                                             history.data());
+			}
+
+		return conn_val_history;
+
+	default:
+		reporter->InternalError("bad deferred connection record field %d", field);
+		return nullptr;
+	}
+	}
+
 analyzer::Analyzer* Connection::FindAnalyzer(analyzer::ID id)
 	{
 	return root_analyzer ? root_analyzer->FindChild(id) : nullptr;
@@ -533,6 +569,9 @@ void Connection::FlipRoles()
 	resp_flow_label = orig_flow_label;
 	orig_flow_label = tmp_flow;
 
+	if ( conn_val )
+		conn_val->ResolveDeferredFields();
+
 	conn_val = nullptr;
 
 	if ( root_analyzer )
@@ -632,7 +671,7 @@ void Connection::CheckFlowLabel(bool is_orig, uint32_t flow_label)
 		if ( conn_val )
 			{
 			RecordVal* endp = conn_val->GetField(is_orig ? 1 : 2)->AsRecordVal();
-			endp->Assign(4, val_mgr->Count(flow_label));
+			endp->AssignCount(4, flow_label);
 			}
 
 		if ( connection_flow_label_changed &&
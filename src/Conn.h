@@ -13,6 +13,7 @@
 #include "zeek/Rule.h"
 #include "zeek/IPAddr.h"
 #include "zeek/UID.h"
+#include "zeek/Val.h"
 #include "zeek/WeirdState.h"
 #include "zeek/ZeekArgs.h"
 #include "zeek/IntrusivePtr.h"
@@ -71,7 +72,7 @@ static inline int addr_port_canon_lt(const IPAddr& addr1, uint32_t p1,
 	return addr1 < addr2 || (addr1 == addr2 && p1 < p2);
 	}
 
-class Connection final : public Obj {
+class Connection final : public Obj, public detail::RecordFieldProvider {
 public:
 
 	Connection(NetSessions* s, const detail::ConnIDKey& k, double t, const ConnID* id,
@@ -174,10 +175,15 @@ public:
 	void EnableStatusUpdateTimer();
 
 	/**
-	 * Returns the associated "connection" record.
+	 * Returns the associated "connection" record.  Its service set and
+	 * history get filled in only once accessed, still reflecting the
+	 * state as of this call.
 	 */
 	const RecordValPtr& ConnVal();
 
+	// Supplies the connection record's deferred fields.
+	ValPtr ProvideField(const RecordVal* rv, int field) override;
+
 	void AppendAddl(const char* str);
 
 	void Match(detail::Rule::PatternType type, const u_char* data, int len,
@@ -208,7 +214,11 @@ public:
 		std::is_convertible_v<
 			std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	EnqueueEvent(EventHandlerPtr h, analyzer::Analyzer* analyzer, Args&&... args)
-		{ return EnqueueEvent(h, analyzer, zeek::Args{std::forward<Args>(args)...}); }
+		{
+		auto vl = acquire_args(sizeof...(args));
+		(vl.push_back(std::forward<Args>(args)), ...);
+		return EnqueueEvent(h, analyzer, std::move(vl));
+		}
 
 	void Weird(const char* name, const char* addl = "", const char* source = "");
 	bool DidWeird() const	{ return weird != 0; }
@@ -347,6 +357,12 @@ protected:
 	std::string history;
 	uint32_t hist_seen;
 
+	// The length of the history as of the latest ConnVal() call, which
+	// the connection record's history field reflects, and the string
+	// last supplied for it.
+	size_t conn_val_history_len;
+	StringValPtr conn_val_history;
+
 	analyzer::TransportLayerAnalyzer* root_analyzer;
 	analyzer::pia::PIA* primary_PIA;
 
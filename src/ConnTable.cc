@@ -0,0 +1,385 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/ConnTable.h"
+
+#include <set>
+
+#include "zeek/3rdparty/doctest.h"
+
+#include "zeek/Hash.h"
+#include "zeek/util.h"
+
+namespace zeek::detail {
+
+// Size of the first slot array. Must be a power of two.
+static constexpr size_t INITIAL_SLOTS = 256;
+
+// Number of old slots moved into the current array per modification while
+// a migration is pending. The current array has twice the capacity of the
+// old one and is at most 3/8 full after a resize, so moving more than
+// 4/3 slots per insert guarantees that the migration completes before the
+// next resize becomes necessary.
+static constexpr size_t MIGRATE_STEP = 4;
+
+ConnectionTable::hash_t ConnectionTable::Hash(const ConnIDKey& key)
+	{
+	return static_cast<hash_t>(KeyedHash::Hash64(&key, sizeof(key)));
+	}
+
+Connection* ConnectionTable::Lookup(const ConnIDKey& key, hash_t h) const
+	{
+	auto idx = Find(slots, num_slots, key, h);
+	if ( idx >= 0 )
+		return slots[idx].conn;
+
+	if ( Migrating() )
+		{
+		idx = Find(old_slots, num_old_slots, key, h);
+		if ( idx >= 0 )
+			return old_slots[idx].conn;
+		}
+
+	return nullptr;
+	}
+
+Connection* ConnectionTable::Insert(const ConnIDKey& key, hash_t h, Connection* conn)
+	{
+	Migrate(MIGRATE_STEP);
+
+	Connection* prev = nullptr;
+
+	// New entries only ever go into the current array, so drop a
+	// not-yet-migrated version of the key first.
+	if ( Migrating() )
+		{
+		auto idx = Find(old_slots, num_old_slots, key, h);
+		if ( idx >= 0 )
+			{
+			prev = old_slots[idx].conn;
+			EraseAt(old_slots, num_old_slots, idx);
+			--num_entries;
+			}
+		}
+
+	if ( num_entries + 1 > num_slots / 4 * 3 )
+		Grow();
+
+	if ( Connection* replaced = Place(key, h, conn) )
+		return replaced;
+
+	++num_entries;
+	return prev;
+	}
+
+Connection* ConnectionTable::Remove(const ConnIDKey& key, hash_t h)
+	{
+	Migrate(MIGRATE_STEP);
+
+	auto idx = Find(slots, num_slots, key, h);
+	if ( idx >= 0 )
+		{
+		Connection* c = slots[idx].conn;
+		EraseAt(slots, num_slots, idx);
+		--num_entries;
+		return c;
+		}
+
+	if ( Migrating() )
+		{
+		idx = Find(old_slots, num_old_slots, key, h);
+		if ( idx >= 0 )
+			{
+			Connection* c = old_slots[idx].conn;
+			EraseAt(old_slots, num_old_slots, idx);
+			--num_entries;
+			return c;
+			}
+		}
+
+	return nullptr;
+	}
+
+void ConnectionTable::Clear()
+	{
+	free(slots);
+	free(old_slots);
+	slots = old_slots = nullptr;
+	num_slots = num_old_slots = 0;
+	num_entries = 0;
+	migrate_pos = migrate_left = 0;
+	}
+
+size_t ConnectionTable::MemoryAllocation() const
+	{
+	return padded_sizeof(*this) + (num_slots + num_old_slots) * sizeof(Slot);
+	}
+
+ptrdiff_t ConnectionTable::Find(const Slot* s, size_t n, const ConnIDKey& key, hash_t h)
+	{
+	if ( n == 0 )
+		return -1;
+
+	size_t mask = n - 1;
+	size_t idx = Home(h, mask);
+
+	for ( size_t dist = 0; ; ++dist )
+		{
+		const Slot& slot = s[idx];
+
+		if ( ! slot.conn )
+			return -1;
+
+		if ( slot.Matches(key, h) )
+			return idx;
+
+		// Robin Hood invariant: had the key been inserted, it would
+		// have displaced any entry closer to its home than we are.
+		if ( Distance(idx, slot.hash, mask) < dist )
+			return -1;
+
+		idx = (idx + 1) & mask;
+		}
+	}
+
+Connection* ConnectionTable::Place(const ConnIDKey& key, hash_t h, Connection* conn)
+	{
+	size_t mask = num_slots - 1;
+	size_t idx = Home(h, mask);
+	size_t dist = 0;
+
+	// First walk the key's probe sequence looking for an existing entry.
+	for ( ; ; ++dist, idx = (idx + 1) & mask )
+		{
+		Slot& slot = slots[idx];
+
+		if ( ! slot.conn )
+			{
+			memcpy(slot.key, &key, sizeof(slot.key));
+			slot.hash = h;
+			slot.conn = conn;
+			return nullptr;
+			}
+
+		if ( slot.Matches(key, h) )
+			{
+			Connection* prev = slot.conn;
+			slot.conn = conn;
+			return prev;
+			}
+
+		if ( Distance(idx, slot.hash, mask) < dist )
+			break;
+		}
+
+	// The key isn't present; take over this slot and carry the displaced
+	// entry forward until it finds a free slot of its own.
+	Slot carry;
+	memcpy(carry.key, &key, sizeof(carry.key));
+	carry.hash = h;
+	carry.conn = conn;
+
+	for ( ; ; ++dist, idx = (idx + 1) & mask )
+		{
+		Slot& slot = slots[idx];
+
+		if ( ! slot.conn )
+			{
+			slot = carry;
+			return nullptr;
+			}
+
+		size_t slot_dist = Distance(idx, slot.hash, mask);
+		if ( slot_dist < dist )
+			{
+			std::swap(slot, carry);
+			dist = slot_dist;
+			}
+		}
+	}
+
+void ConnectionTable::EraseAt(Slot* s, size_t n, size_t idx)
+	{
+	size_t mask = n - 1;
+	size_t next = (idx + 1) & mask;
+
+	while ( s[next].conn && Distance(next, s[next].hash, mask) > 0 )
+		{
+		s[idx] = s[next];
+		idx = next;
+		next = (next + 1) & mask;
+		}
+
+	s[idx].conn = nullptr;
+	}
+
+void ConnectionTable::Grow()
+	{
+	if ( ! slots )
+		{
+		slots = static_cast<Slot*>(util::safe_calloc(INITIAL_SLOTS, sizeof(Slot)));
+		num_slots = INITIAL_SLOTS;
+		return;
+		}
+
+	// Only one migration at a time. With MIGRATE_STEP chosen as above
+	// this shouldn't trigger, but finish any leftovers to be safe.
+	if ( Migrating() )
+		Migrate(migrate_left);
+
+	old_slots = slots;
+	num_old_slots = num_slots;
+	num_slots *= 2;
+	slots = static_cast<Slot*>(util::safe_calloc(num_slots, sizeof(Slot)));
+
+	// Start migrating right after an empty slot, so that we always move
+	// complete probe clusters. The load factor guarantees there's one.
+	size_t mask = num_old_slots - 1;
+	size_t empty = 0;
+	while ( old_slots[empty].conn )
+		++empty;
+
+	migrate_pos = (empty + 1) & mask;
+	migrate_left = num_old_slots;
+	}
+
+void ConnectionTable::Migrate(size_t min_slots)
+	{
+	if ( ! Migrating() )
+		return;
+
+	size_t mask = num_old_slots - 1;
+
+	while ( migrate_left > 0 )
+		{
+		Slot& slot = old_slots[migrate_pos];
+
+		if ( slot.conn )
+			{
+			Place(*reinterpret_cast<const ConnIDKey*>(slot.key), slot.hash, slot.conn);
+			slot.conn = nullptr;
+			}
+
+		else if ( min_slots == 0 )
+			// At a cluster boundary and done with our quota.
+			break;
+
+		migrate_pos = (migrate_pos + 1) & mask;
+		--migrate_left;
+
+		if ( min_slots > 0 )
+			--min_slots;
+		}
+
+	if ( migrate_left == 0 )
+		{
+		free(old_slots);
+		old_slots = nullptr;
+		num_old_slots = 0;
+		migrate_pos = 0;
+		}
+	}
+
+TEST_SUITE_BEGIN("ConnTable");
+
+static ConnIDKey make_test_key(uint32_t i)
+	{
+	ConnIDKey key;
+	memcpy(&key.ip1.s6_addr[12], &i, sizeof(i));
+	key.ip2.s6_addr[15] = 1;
+	key.port1 = static_cast<uint16_t>(i);
+	key.port2 = 80;
+	return key;
+	}
+
+static Connection* make_test_conn(uint32_t i)
+	{
+	// The table never dereferences its values, so any distinct non-null
+	// pointer will do.
+	return reinterpret_cast<Connection*>(static_cast<uintptr_t>(i + 1) * 8);
+	}
+
+TEST_CASE("conntable operation")
+	{
+	ConnectionTable t;
+	CHECK(t.Size() == 0);
+	CHECK(t.Lookup(make_test_key(1)) == nullptr);
+	CHECK(t.Remove(make_test_key(1)) == nullptr);
+
+	CHECK(t.Insert(make_test_key(1), make_test_conn(1)) == nullptr);
+	CHECK(t.Insert(make_test_key(2), make_test_conn(2)) == nullptr);
+	CHECK(t.Size() == 2);
+	CHECK(t.Lookup(make_test_key(1)) == make_test_conn(1));
+	CHECK(t.Lookup(make_test_key(2)) == make_test_conn(2));
+
+	// Replacing returns the previous value and doesn't change the size.
+	CHECK(t.Insert(make_test_key(1), make_test_conn(3)) == make_test_conn(1));
+	CHECK(t.Size() == 2);
+	CHECK(t.Lookup(make_test_key(1)) == make_test_conn(3));
+
+	CHECK(t.Remove(make_test_key(1)) == make_test_conn(3));
+	CHECK(t.Lookup(make_test_key(1)) == nullptr);
+	CHECK(t.Size() == 1);
+
+	t.Clear();
+	CHECK(t.Size() == 0);
+	CHECK(t.Lookup(make_test_key(2)) == nullptr);
+	}
+
+TEST_CASE("conntable incremental growth")
+	{
+	ConnectionTable t;
+	const uint32_t n = 100000;
+	bool saw_migration = false;
+
+	for ( uint32_t i = 0; i < n; ++i )
+		{
+		CHECK(t.Insert(make_test_key(i), make_test_conn(i)) == nullptr);
+		saw_migration = saw_migration || t.Migrating();
+
+		// Remove every third entry again right away, so that removals
+		// hit both slot arrays during migrations.
+		if ( i % 3 == 0 )
+			CHECK(t.Remove(make_test_key(i / 3)) == make_test_conn(i / 3));
+		}
+
+	CHECK(saw_migration);
+
+	size_t expected = 0;
+	for ( uint32_t i = 0; i < n; ++i )
+		{
+		bool removed = i <= (n - 1) / 3;
+		Connection* c = t.Lookup(make_test_key(i));
+
+		if ( removed )
+			CHECK(c == nullptr);
+		else
+			{
+			CHECK(c == make_test_conn(i));
+			++expected;
+			}
+		}
+
+	CHECK(t.Size() == expected);
+	}
+
+TEST_CASE("conntable iteration")
+	{
+	ConnectionTable t;
+	std::set<Connection*> inserted;
+
+	for ( uint32_t i = 0; i < 1000; ++i )
+		{
+		t.Insert(make_test_key(i), make_test_conn(i));
+		inserted.insert(make_test_conn(i));
+		}
+
+	std::set<Connection*> seen;
+	for ( Connection* c : t )
+		CHECK(seen.insert(c).second);
+
+	CHECK(seen == inserted);
+	}
+
+TEST_SUITE_END();
+
+} // namespace zeek::detail
@@ -0,0 +1,194 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include "zeek/IPAddr.h"
+
+namespace zeek {
+
+class Connection;
+
+namespace detail {
+
+/**
+ * A flat, open-addressing hash table mapping ConnIDKeys to connections.
+ *
+ * Entries live inline in a single slot array (no per-connection node
+ * allocation) and are placed with Robin Hood linear probing, keyed by a
+ * 32-bit keyed hash of the ConnIDKey.  Callers on the packet path compute
+ * that hash once via Hash() and pass it to Lookup()/Insert() so that it
+ * isn't recomputed for every table operation.
+ *
+ * Growing the table never rehashes everything at once: the previous slot
+ * array is kept around and drained a few slots at a time during subsequent
+ * inserts and removals, so the cost of a resize is spread across many
+ * packets.  Lookups consult both arrays while such a migration is pending.
+ */
+class ConnectionTable {
+public:
+	using hash_t = uint32_t;
+
+	ConnectionTable() = default;
+	~ConnectionTable()	{ Clear(); }
+
+	ConnectionTable(const ConnectionTable&) = delete;
+	ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+	/**
+	 * Returns the hash value that identifies a given key in all tables.
+	 * It's seeded like Zeek's other internal hashes, so an attacker can't
+	 * predict collisions.
+	 */
+	static hash_t Hash(const ConnIDKey& key);
+
+	/**
+	 * Looks up the connection stored for a key.
+	 *
+	 * @param key The key to look up.
+	 * @param h The key's hash as returned by Hash().
+	 * @return The connection, or nullptr if there's no entry for the key.
+	 */
+	Connection* Lookup(const ConnIDKey& key, hash_t h) const;
+	Connection* Lookup(const ConnIDKey& key) const
+		{ return Lookup(key, Hash(key)); }
+
+	/**
+	 * Stores a connection for a key, replacing any existing entry.
+	 *
+	 * @param key The key to store the connection under.
+	 * @param h The key's hash as returned by Hash().
+	 * @param conn The connection. Must not be nullptr.
+	 * @return The connection previously stored for the key, or nullptr
+	 * if there wasn't one.
+	 */
+	Connection* Insert(const ConnIDKey& key, hash_t h, Connection* conn);
+	Connection* Insert(const ConnIDKey& key, Connection* conn)
+		{ return Insert(key, Hash(key), conn); }
+
+	/**
+	 * Removes the entry for a key.
+	 *
+	 * @param key The key to remove.
+	 * @param h The key's hash as returned by Hash().
+	 * @return The connection that was stored for the key, or nullptr if
+	 * there wasn't one.
+	 */
+	Connection* Remove(const ConnIDKey& key, hash_t h);
+	Connection* Remove(const ConnIDKey& key)
+		{ return Remove(key, Hash(key)); }
+
+	/**
+	 * Removes all entries and releases the slot storage. Doesn't touch the
+	 * connections themselves.
+	 */
+	void Clear();
+
+	size_t Size() const	{ return num_entries; }
+	size_t Capacity() const	{ return num_slots + num_old_slots; }
+
+	/**
+	 * Returns true while slots of a previous, smaller array are still
+	 * waiting to be moved into the current one.
+	 */
+	bool Migrating() const	{ return old_slots != nullptr; }
+
+	size_t MemoryAllocation() const;
+
+	// Iteration over all stored connections in unspecified order.  The
+	// table must not be modified while iterating.
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Connection*;
+		using difference_type = std::ptrdiff_t;
+		using pointer = Connection**;
+		using reference = Connection*;
+
+		Connection* operator*() const	{ return table->ConnAt(pos); }
+
+		const_iterator& operator++()	{ ++pos; SkipEmpty(); return *this; }
+		const_iterator operator++(int)	{ auto t = *this; ++(*this); return t; }
+
+		bool operator==(const const_iterator& o) const	{ return pos == o.pos; }
+		bool operator!=(const const_iterator& o) const	{ return pos != o.pos; }
+
+	private:
+		friend class ConnectionTable;
+
+		const_iterator(const ConnectionTable* t, size_t p) : table(t), pos(p)
+			{ SkipEmpty(); }
+
+		void SkipEmpty()
+			{
+			while ( pos < table->Capacity() && ! table->ConnAt(pos) )
+				++pos;
+			}
+
+		const ConnectionTable* table;
+		size_t pos;
+	};
+
+	const_iterator begin() const	{ return {this, 0}; }
+	const_iterator end() const	{ return {this, Capacity()}; }
+
+private:
+	// Slots are plain data, so that arrays of them can come straight
+	// from calloc(): large zeroed allocations are backed by fresh pages
+	// that the kernel maps on demand, which keeps resizing cheap.  The
+	// key is stored as raw bytes and compared like ConnIDKey does.
+	struct Slot {
+		unsigned char key[sizeof(ConnIDKey)];
+		hash_t hash;
+		Connection* conn;	// nullptr marks an empty slot
+
+		bool Matches(const ConnIDKey& k, hash_t h) const
+			{ return hash == h && memcmp(key, &k, sizeof(key)) == 0; }
+	};
+
+	// Returns the connection at a position in the concatenation of the
+	// current and the old slot array, or nullptr for an empty slot.
+	Connection* ConnAt(size_t pos) const
+		{
+		return pos < num_slots ? slots[pos].conn : old_slots[pos - num_slots].conn;
+		}
+
+	static size_t Home(hash_t h, size_t mask)	{ return h & mask; }
+	static size_t Distance(size_t idx, hash_t h, size_t mask)
+		{ return (idx - Home(h, mask)) & mask; }
+
+	// Returns the index of the key's slot in the given array, or -1.
+	static ptrdiff_t Find(const Slot* s, size_t n, const ConnIDKey& key, hash_t h);
+
+	// Robin Hood insertion into the current array. Returns the replaced
+	// connection if the key was present already.
+	Connection* Place(const ConnIDKey& key, hash_t h, Connection* conn);
+
+	// Removes the slot at idx from the given array, shifting the
+	// following entries of its probe sequence back by one.
+	static void EraseAt(Slot* s, size_t n, size_t idx);
+
+	void Grow();
+
+	// Moves at least the given number of slots from the old array into
+	// the current one, continuing until the end of a probe cluster so
+	// that the old array remains consistent for lookups.
+	void Migrate(size_t min_slots);
+
+	Slot* slots = nullptr;
+	size_t num_slots = 0;
+	Slot* old_slots = nullptr;
+	size_t num_old_slots = 0;
+	size_t num_entries = 0;
+
+	// Position of the next old slot to migrate and the number of old
+	// slots that still need to be visited.
+	size_t migrate_pos = 0;
+	size_t migrate_left = 0;
+};
+
+} // namespace detail
+} // namespace zeek
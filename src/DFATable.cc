@@ -0,0 +1,374 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+#include "zeek/DFATable.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+#include "zeek/DFA.h"
+#include "zeek/EquivClass.h"
+#include "zeek/NFA.h"
+#include "zeek/util.h"
+
+namespace zeek::detail {
+
+namespace {
+
+constexpr char CACHE_MAGIC[8] = "ZEEKDFA";
+constexpr uint32_t CACHE_VERSION = 1;
+
+// Layout of a cache file: this header, the key padded to a multiple of
+// four bytes, and then the table's arrays.
+struct CacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t key_len;
+	int32_t num_states;
+	int32_t num_ecs;
+	int32_t num_accepts;
+	uint32_t data_len;	// # of int32s after the key
+};
+
+size_t padded_key_len(size_t key_len)
+	{
+	return (key_len + 3) & ~size_t(3);
+	}
+
+size_t data_len(int num_states, int num_ecs, int num_accepts)
+	{
+	return NUM_SYM + size_t(num_states) * num_ecs + num_states + 1 + num_accepts;
+	}
+
+void fill_storage(std::vector<int32_t>* storage, const std::vector<int32_t>& ecs,
+                  const std::vector<int32_t>& xtions,
+                  const std::vector<std::vector<int32_t>>& accepts)
+	{
+	storage->clear();
+	storage->insert(storage->end(), ecs.begin(), ecs.end());
+	storage->insert(storage->end(), xtions.begin(), xtions.end());
+
+	int32_t offset = 0;
+
+	for ( const auto& a : accepts )
+		{
+		storage->push_back(offset);
+		offset += a.size();
+		}
+
+	storage->push_back(offset);
+
+	for ( const auto& a : accepts )
+		storage->insert(storage->end(), a.begin(), a.end());
+	}
+
+} // namespace
+
+DFA_Table::~DFA_Table()
+	{
+	if ( mapping )
+		munmap(mapping, mapping_size);
+	}
+
+DFA_Table* DFA_Table::Build(DFA_Machine* dfa, const EquivClass* ec, int max_states)
+	{
+	DFA_State* start = dfa->StartState();
+
+	if ( ! start || max_states <= 0 )
+		return nullptr;
+
+	const int k = ec->NumClasses();
+
+	std::vector<DFA_State*> states{start};
+	std::unordered_map<DFA_State*, int> index{{start, 0}};
+	std::vector<int32_t> xtions;
+
+	// Breadth-first, so that the start state becomes state 0.
+	for ( size_t i = 0; i < states.size(); ++i )
+		{
+		for ( int c = 0; c < k; ++c )
+			{
+			DFA_State* next = states[i]->Xtion(c, dfa);
+
+			if ( ! next )
+				{
+				xtions.push_back(JAM);
+				continue;
+				}
+
+			auto it = index.find(next);
+
+			if ( it == index.end() )
+				{
+				if ( static_cast<int>(states.size()) >= max_states )
+					return nullptr;
+
+				it = index.emplace(next, states.size()).first;
+				states.push_back(next);
+				}
+
+			xtions.push_back(it->second);
+			}
+		}
+
+	std::vector<std::vector<int32_t>> accepts;
+
+	for ( auto s : states )
+		{
+		accepts.emplace_back();
+
+		if ( s->Accept() )
+			accepts.back().assign(s->Accept()->begin(), s->Accept()->end());
+		}
+
+	const int* ecs = ec->EquivClasses();
+
+	auto* t = new DFA_Table();
+	t->num_states = states.size();
+	t->num_ecs = k;
+	fill_storage(&t->storage, std::vector<int32_t>(ecs, ecs + NUM_SYM), xtions, accepts);
+	t->num_accepts = t->storage.size() - data_len(t->num_states, k, 0);
+	t->SetArrays(t->storage.data());
+
+	return t;
+	}
+
+void DFA_Table::Minimize()
+	{
+	assert(! mapping);
+
+	// Moore's algorithm: start with the states split by what they
+	// accept, then keep splitting blocks whose states transition into
+	// different blocks until that doesn't change anything anymore.
+	std::vector<int> block(num_states);
+	size_t num_blocks;
+
+		{
+		std::map<std::vector<int32_t>, int> ids;
+
+		for ( int s = 0; s < num_states; ++s )
+			{
+			std::vector<int32_t> a(AcceptBegin(s), AcceptEnd(s));
+			block[s] = ids.emplace(std::move(a), ids.size()).first->second;
+			}
+
+		num_blocks = ids.size();
+		}
+
+	std::vector<int> next_block(num_states);
+	std::vector<int> signature(num_ecs + 1);
+
+	for ( ; ; )
+		{
+		std::map<std::vector<int>, int> ids;
+
+		for ( int s = 0; s < num_states; ++s )
+			{
+			signature[0] = block[s];
+
+			for ( int c = 0; c < num_ecs; ++c )
+				{
+				int t = Xtion(s, c);
+				signature[c + 1] = t == JAM ? -1 : block[t];
+				}
+
+			next_block[s] = ids.emplace(signature, ids.size()).first->second;
+			}
+
+		block.swap(next_block);
+
+		if ( ids.size() == num_blocks )
+			break;
+
+		num_blocks = ids.size();
+		}
+
+	if ( num_blocks == static_cast<size_t>(num_states) )
+		return;
+
+	// Number the blocks in order of their first states, which keeps the
+	// start state at 0.
+	std::vector<int> renumber(num_blocks, -1);
+	std::vector<int> reps;
+
+	for ( int s = 0; s < num_states; ++s )
+		if ( renumber[block[s]] < 0 )
+			{
+			renumber[block[s]] = reps.size();
+			reps.push_back(s);
+			}
+
+	std::vector<int32_t> new_xtions;
+	std::vector<std::vector<int32_t>> new_accepts;
+
+	for ( int r : reps )
+		{
+		for ( int c = 0; c < num_ecs; ++c )
+			{
+			int t = Xtion(r, c);
+			new_xtions.push_back(t == JAM ? JAM : renumber[block[t]]);
+			}
+
+		new_accepts.emplace_back(AcceptBegin(r), AcceptEnd(r));
+		}
+
+	std::vector<int32_t> new_ecs(ecs, ecs + NUM_SYM);
+	fill_storage(&storage, new_ecs, new_xtions, new_accepts);
+	storage.shrink_to_fit();
+
+	num_states = reps.size();
+	num_accepts = storage.size() - data_len(num_states, num_ecs, 0);
+	SetArrays(storage.data());
+	}
+
+DFA_Table* DFA_Table::Load(const std::string& dir, const std::string& key)
+	{
+	std::string path = CacheFile(dir, key);
+	int fd = open(path.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		return nullptr;
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(CacheHeader) )
+		{
+		close(fd);
+		return nullptr;
+		}
+
+	size_t size = st.st_size;
+	void* m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if ( m == MAP_FAILED )
+		return nullptr;
+
+	auto* t = new DFA_Table();
+	t->mapping = m;
+	t->mapping_size = size;
+
+	const auto* hdr = static_cast<const CacheHeader*>(m);
+	const char* key_start = static_cast<const char*>(m) + sizeof(CacheHeader);
+	size_t header_len = sizeof(CacheHeader) + padded_key_len(hdr->key_len);
+
+	if ( memcmp(hdr->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+	     hdr->version != CACHE_VERSION ||
+	     hdr->key_len != key.size() || size < header_len ||
+	     memcmp(key_start, key.data(), key.size()) != 0 ||
+	     hdr->num_states <= 0 || hdr->num_ecs <= 0 || hdr->num_accepts < 0 ||
+	     hdr->data_len != data_len(hdr->num_states, hdr->num_ecs, hdr->num_accepts) ||
+	     size != header_len + hdr->data_len * sizeof(int32_t) )
+		{
+		delete t;
+		return nullptr;
+		}
+
+	t->num_states = hdr->num_states;
+	t->num_ecs = hdr->num_ecs;
+	t->num_accepts = hdr->num_accepts;
+	t->SetArrays(reinterpret_cast<const int32_t*>(static_cast<const char*>(m) + header_len));
+
+	// Don't trust the file with indexing anything out of bounds.
+	bool valid = t->accept_offsets[0] == 0 &&
+		t->accept_offsets[t->num_states] == t->num_accepts;
+
+	for ( int i = 0; valid && i < NUM_SYM; ++i )
+		valid = t->ecs[i] >= 0 && t->ecs[i] < t->num_ecs;
+
+	for ( int s = 0; valid && s < t->num_states; ++s )
+		valid = t->accept_offsets[s] <= t->accept_offsets[s + 1];
+
+	for ( size_t i = 0; valid && i < size_t(t->num_states) * t->num_ecs; ++i )
+		valid = t->xtions[i] >= JAM && t->xtions[i] < t->num_states;
+
+	if ( ! valid )
+		{
+		delete t;
+		return nullptr;
+		}
+
+	return t;
+	}
+
+bool DFA_Table::Save(const std::string& dir, const std::string& key) const
+	{
+	CacheHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	hdr.version = CACHE_VERSION;
+	hdr.key_len = key.size();
+	hdr.num_states = num_states;
+	hdr.num_ecs = num_ecs;
+	hdr.num_accepts = num_accepts;
+	hdr.data_len = data_len(num_states, num_ecs, num_accepts);
+
+	// Write to a file of our own first, so that concurrent readers
+	// never see a partial one.
+	std::string path = CacheFile(dir, key);
+	std::string tmp = path + ".tmp." + std::to_string(getpid());
+
+	FILE* f = fopen(tmp.c_str(), "wb");
+
+	if ( ! f )
+		return false;
+
+	static const char pad[4] = { 0 };
+
+	bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+		fwrite(key.data(), 1, key.size(), f) == key.size() &&
+		fwrite(pad, 1, padded_key_len(key.size()) - key.size(), f) ==
+			padded_key_len(key.size()) - key.size() &&
+		fwrite(ecs, sizeof(int32_t), hdr.data_len, f) == hdr.data_len;
+
+	if ( fclose(f) != 0 )
+		ok = false;
+
+	if ( ok && rename(tmp.c_str(), path.c_str()) == 0 )
+		return true;
+
+	unlink(tmp.c_str());
+	return false;
+	}
+
+unsigned int DFA_Table::MemoryAllocation() const
+	{
+	return padded_sizeof(*this)
+		+ util::pad_size(storage.capacity() * sizeof(int32_t))
+		+ mapping_size;
+	}
+
+void DFA_Table::SetArrays(const int32_t* buf)
+	{
+	ecs = buf;
+	xtions = ecs + NUM_SYM;
+	accept_offsets = xtions + num_states * num_ecs;
+	accepts = accept_offsets + num_states + 1;
+	}
+
+std::string DFA_Table::CacheFile(const std::string& dir, const std::string& key)
+	{
+	// FNV-1a; it needs to stay the same across runs, and the file
+	// repeats the key anyway.
+	uint64_t h = 14695981039346656037ULL;
+
+	for ( u_char c : key )
+		{
+		h ^= c;
+		h *= 1099511628211ULL;
+		}
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016" PRIx64 ".dfa", h);
+
+	return dir + "/" + name;
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,103 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zeek::detail {
+
+class DFA_Machine;
+class EquivClass;
+
+/**
+ * A completely computed DFA, in one flat transition table indexed by
+ * state and equivalence class.  Unlike DFA_Machine, which computes states
+ * as input reaches them, a table is built once up front and then never
+ * changes, which also lets it be written to disk and mapped back in on
+ * later runs.
+ */
+class DFA_Table {
+public:
+	// Transition target for input the DFA can't match.
+	static constexpr int JAM = -1;
+
+	~DFA_Table();
+
+	/**
+	 * Computes all states of a DFA.
+	 * @param dfa  the DFA; computing its states adds them to its cache
+	 * @param ec  the equivalence classes the DFA's input maps to
+	 * @param max_states  the maximum number of states to compute
+	 * @return the table, or nullptr if the DFA has more states than
+	 * allowed or can't match anything at all
+	 */
+	static DFA_Table* Build(DFA_Machine* dfa, const EquivClass* ec, int max_states);
+
+	/**
+	 * Merges states that accept the same input.
+	 */
+	void Minimize();
+
+	/**
+	 * Maps in a table that Save() has written for the same key.
+	 * @param dir  the cache directory
+	 * @param key  identifies the expressions the table is for
+	 * @return the table, or nullptr if there's no valid one
+	 */
+	static DFA_Table* Load(const std::string& dir, const std::string& key);
+
+	/**
+	 * Writes the table to a cache file.
+	 * @return false if the file couldn't be written
+	 */
+	bool Save(const std::string& dir, const std::string& key) const;
+
+	int StartState() const	{ return 0; }
+
+	int Xtion(int state, int ec) const	{ return xtions[state * num_ecs + ec]; }
+
+	bool Accepts(int state) const
+		{ return accept_offsets[state] != accept_offsets[state + 1]; }
+
+	// The accept indices of a state.
+	const int32_t* AcceptBegin(int state) const
+		{ return accepts + accept_offsets[state]; }
+	const int32_t* AcceptEnd(int state) const
+		{ return accepts + accept_offsets[state + 1]; }
+
+	// Maps input symbols to equivalence classes.
+	const int32_t* EquivClasses() const	{ return ecs; }
+
+	int NumStates() const	{ return num_states; }
+	int NumClasses() const	{ return num_ecs; }
+
+	unsigned int MemoryAllocation() const;
+
+private:
+	DFA_Table() = default;
+
+	// Points the arrays into the given buffer.
+	void SetArrays(const int32_t* buf);
+
+	static std::string CacheFile(const std::string& dir, const std::string& key);
+
+	int num_states = 0;
+	int num_ecs = 0;
+	int num_accepts = 0;
+
+	// In order: ecs, xtions, accept_offsets, accepts.
+	const int32_t* ecs = nullptr;
+	const int32_t* xtions = nullptr;
+	const int32_t* accept_offsets = nullptr;	// num_states + 1 of them
+	const int32_t* accepts = nullptr;
+
+	// Holds the arrays unless they're in a cache file mapped in.
+	std::vector<int32_t> storage;
+	void* mapping = nullptr;
+	size_t mapping_size = 0;
+};
+
+} // namespace zeek::detail
@@ -44,6 +44,7 @@ ODesc::ODesc(DescType t, File* arg_f)
 	include_stats = false;
 	indent_with_spaces = 0;
 	escape = false;
+	escape_starts = "\\";
 	utf8 = false;
 	}
 
@@ -267,6 +268,24 @@ size_t ODesc::StartsWithEscapeSequence(const char* start, const char* end)
 	return 0;
 	}
 
+void ODesc::UpdateEscapeStarts()
+	{
+	// Backslashes always get escaped.
+	escape_starts = "\\";
+
+	for ( const auto& esc : escape_sequences )
+		{
+		if ( esc.empty() )
+			continue;
+
+		char c = esc[0];
+
+		// Non-printable characters get looked at anyway.
+		if ( isprint(c) && escape_starts.find(c) == std::string::npos )
+			escape_starts += c;
+		}
+	}
+
 std::pair<const char*, size_t> ODesc::FirstEscapeLoc(const char* bytes, size_t n)
 	{
 	typedef std::pair<const char*, size_t> escape_pos;
@@ -276,6 +295,13 @@ std::pair<const char*, size_t> ODesc::FirstEscapeLoc(const char* bytes, size_t n
 
 	for ( size_t i = 0; i < n; ++i )
 		{
+		// Skip ahead over everything that can't need escaping, which
+		// is usually most of it.
+		i += util::printable_prefix_len(bytes + i, n - i, escape_starts);
+
+		if ( i == n )
+			break;
+
 		auto printable = isprint(bytes[i]);
 
 		if ( ! printable && ! utf8 )
@@ -59,16 +59,18 @@ public:
 
 	void EnableEscaping();
 	void EnableUTF8();
-	void AddEscapeSequence(const char* s) { escape_sequences.insert(s); }
+	void AddEscapeSequence(const char* s)
+	    { escape_sequences.insert(s); UpdateEscapeStarts(); }
 	void AddEscapeSequence(const char* s, size_t n)
-	    { escape_sequences.insert(std::string(s, n)); }
+	    { escape_sequences.insert(std::string(s, n)); UpdateEscapeStarts(); }
 	void AddEscapeSequence(const std::string & s)
-	    { escape_sequences.insert(s); }
-	void RemoveEscapeSequence(const char* s) { escape_sequences.erase(s); }
+	    { escape_sequences.insert(s); UpdateEscapeStarts(); }
+	void RemoveEscapeSequence(const char* s)
+	    { escape_sequences.erase(s); UpdateEscapeStarts(); }
 	void RemoveEscapeSequence(const char* s, size_t n)
-	    { escape_sequences.erase(std::string(s, n)); }
+	    { escape_sequences.erase(std::string(s, n)); UpdateEscapeStarts(); }
 	void RemoveEscapeSequence(const std::string & s)
-	    { escape_sequences.erase(s); }
+	    { escape_sequences.erase(s); UpdateEscapeStarts(); }
 
 	void PushIndent();
 	void PopIndent();
@@ -183,6 +185,9 @@ protected:
 	 */
 	size_t StartsWithEscapeSequence(const char* start, const char* end);
 
+	// Recomputes escape_starts after a change to the escape sequences.
+	void UpdateEscapeStarts();
+
 	DescType type;
 	DescStyle style;
 
@@ -199,6 +204,7 @@ protected:
 
 	using escape_set = std::set<std::string>;
 	escape_set escape_sequences; // additional sequences of chars to escape
+	std::string escape_starts; // printable chars that may start an escape
 
 	File* f;	// or the file we're using.
 
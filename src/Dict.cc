@@ -11,6 +11,10 @@
 #include <climits>
 #include <fstream>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "zeek/3rdparty/doctest.h"
 
 #include "zeek/Reporter.h"
@@ -530,6 +534,47 @@ TEST_CASE("dict iterator invalidation")
 	delete key3;
 	}
 
+TEST_CASE("dict lookup while growing and removing")
+	{
+	PDict<uint32_t> dict;
+	std::vector<uint32_t> vals(2000);
+
+	for ( bro_uint_t i = 0; i < vals.size(); i++ )
+		{
+		vals[i] = i;
+		detail::HashKey key(i);
+		dict.Insert(&key, &vals[i]);
+		}
+
+	for ( bro_uint_t i = 0; i < vals.size(); i += 2 )
+		{
+		detail::HashKey key(i);
+		dict.Remove(&key);
+		}
+
+	CHECK(dict.Length() == 1000);
+
+	// Half of these were never inserted, half got removed.
+	int found = 0;
+	int wrong = 0;
+
+	for ( bro_uint_t i = 0; i < 2 * vals.size(); i++ )
+		{
+		detail::HashKey key(i);
+
+		if ( auto v = dict.Lookup(&key) )
+			{
+			++found;
+
+			if ( *v != i || i % 2 == 0 )
+				++wrong;
+			}
+		}
+
+	CHECK(found == 1000);
+	CHECK(wrong == 0);
+	}
+
 TEST_SUITE_END();
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -730,7 +775,7 @@ size_t Dictionary::MemoryAllocation() const
 	size_t size = padded_sizeof(*this);
 	if ( table )
 		{
-		size += zeek::util::pad_size(Capacity() * sizeof(detail::DictEntry));
+		size += zeek::util::pad_size(TableBytes(Capacity()));
 		for ( int i = Capacity()-1; i>=0; i-- )
 			if ( ! table[i].Empty() && table[i].key_size > 8 )
 				size += zeek::util::pad_size(table[i].key_size);
@@ -919,9 +964,11 @@ void Dictionary::Clear()
 void Dictionary::Init()
 	{
 	ASSERT(! table);
-	table = (detail::DictEntry*)malloc(sizeof(detail::DictEntry) * Capacity(true));
+	table = (detail::DictEntry*)malloc(TableBytes(Capacity(true)));
 	for ( int i = Capacity() - 1; i >= 0; i-- )
 		table[i].SetEmpty();
+
+	memset(Ctrl(), detail::DICT_CTRL_EMPTY, Capacity() + detail::DICT_GROUP_WIDTH);
 	}
 
 // private
@@ -948,6 +995,12 @@ void* Dictionary::Lookup(const void* key, int key_size, detail::hash_t h) const
 	return position >= 0 ? table[position].value : nullptr;
 	}
 
+int Dictionary::Position(const detail::HashKey* key) const
+	{
+	Dictionary* d = const_cast<Dictionary*>(this);
+	return d->LookupIndex(key->Key(), key->Size(), key->Hash());
+	}
+
 //for verification purposes
 int Dictionary::LinearLookupIndex(const void* key, int key_size, detail::hash_t hash) const
 	{
@@ -1017,12 +1070,16 @@ int Dictionary::LookupIndex(const void* key, int key_size, detail::hash_t hash,
                             int* insert_position/*output*/, int* insert_distance/*output*/)
 	{
 	ASSERT(bucket>=0 && bucket < Buckets());
+	int position = ProbeIndex(key, key_size, hash, bucket, end);
+
+	if ( position >= 0 || ! (insert_position || insert_distance) )
+		return position;
+
+	//no such cluster, or not found in the cluster. Find where it ends.
 	int i = bucket;
-	for ( ; i < end && ! table[i].Empty() && BucketByPosition(i) <= bucket; i++ )
-		if ( BucketByPosition(i) == bucket && table[i].Equal((char*)key, key_size, hash) )
-			return i;
+	while ( i < end && ! table[i].Empty() && BucketByPosition(i) <= bucket )
+		i++;
 
-	//no such cluster, or not found in the cluster.
 	if ( insert_position )
 		*insert_position = i;
 
@@ -1032,6 +1089,58 @@ int Dictionary::LookupIndex(const void* key, int key_size, detail::hash_t hash,
 	return -1;
 	}
 
+// Sets bit i of *matches if the i'th control byte of the group starting at
+// ctrl holds the given tag, and bit i of *empties if it's empty.
+static inline void match_group(const uint8_t* ctrl, uint8_t tag, uint32_t* matches, uint32_t* empties)
+	{
+#ifdef __SSE2__
+	__m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+	*matches = _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+	*empties = _mm_movemask_epi8(group);
+#else
+	*matches = *empties = 0;
+
+	for ( int i = 0; i < detail::DICT_GROUP_WIDTH; i++ )
+		{
+		*matches |= uint32_t(ctrl[i] == tag) << i;
+		*empties |= uint32_t(ctrl[i] >> 7) << i;
+		}
+#endif
+	}
+
+int Dictionary::ProbeIndex(const void* key, int key_size, detail::hash_t hash, int bucket, int end) const
+	{
+	const uint8_t* ctrl = Ctrl();
+	uint8_t tag = CtrlTag(hash);
+
+	for ( int group = bucket; group < end; group += detail::DICT_GROUP_WIDTH )
+		{
+		uint32_t matches, empties;
+		match_group(ctrl + group, tag, &matches, &empties);
+
+		// The bucket's cluster ends before the first empty position,
+		// so only tags up to there can be of interest.
+		if ( empties )
+			matches &= (empties & (~empties + 1)) - 1;
+
+		for ( ; matches; matches &= matches - 1 )
+			{
+			int i = group + __builtin_ctz(matches);
+
+			if ( i >= end )
+				return -1;
+
+			if ( BucketByPosition(i) == bucket && table[i].Equal((const char*)key, key_size, hash) )
+				return i;
+			}
+
+		if ( empties )
+			return -1;
+		}
+
+	return -1;
+	}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Insert
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1153,14 +1262,14 @@ void Dictionary::InsertAndRelocate(detail::DictEntry& entry, int insert_position
 			{
 			ASSERT(insert_position == Capacity());
 			SizeUp(); //copied all the items to new table. as it's just copying without remapping, insert_position is now empty.
-			table[insert_position] = entry;
+			SetEntry(insert_position, entry);
 			if ( last_affected_position )
 				*last_affected_position = insert_position;
 			return;
 			}
 		if ( table[insert_position].Empty() )
 			{   //the condition to end the loop.
-			table[insert_position] = entry;
+			SetEntry(insert_position, entry);
 			if ( last_affected_position )
 				*last_affected_position = insert_position;
 			return;
@@ -1172,7 +1281,7 @@ void Dictionary::InsertAndRelocate(detail::DictEntry& entry, int insert_position
 		t.distance += next - insert_position;
 
 		//swap
-		table[insert_position] = entry;
+		SetEntry(insert_position, entry);
 		entry = t;
 		insert_position = next; //append to the end of the current cluster.
 		}
@@ -1216,7 +1325,13 @@ void Dictionary::SizeUp()
 	int prev_capacity = Capacity();
 	log2_buckets++;
 	int capacity = Capacity();
-	table = (detail::DictEntry*)realloc(table, capacity * sizeof(detail::DictEntry));
+	table = (detail::DictEntry*)realloc(table, TableBytes(capacity));
+
+	// The control bytes move up behind the added entries, which
+	// overlap where they were.
+	memmove(Ctrl(), reinterpret_cast<char*>(table + prev_capacity), prev_capacity);
+	memset(Ctrl() + prev_capacity, detail::DICT_CTRL_EMPTY, capacity - prev_capacity + detail::DICT_GROUP_WIDTH);
+
 	for ( int i = prev_capacity; i < capacity; i++ )
 		table[i].SetEmpty();
 
@@ -1302,13 +1417,13 @@ detail::DictEntry Dictionary::RemoveAndRelocate(int position, int* last_affected
 		if ( position == Capacity() - 1 || table[position+1].Empty() || table[position+1].distance == 0 )
 			{
 			//no next cluster to fill, or next position is empty or next position is already in perfect bucket.
-			table[position].SetEmpty();
+			SetEmpty(position);
 			if ( last_affected_position )
 				*last_affected_position = position;
 			return entry;
 			}
 		int next = TailOfClusterByPosition(position+1);
-		table[position] = table[next];
+		SetEntry(position, table[next]);
 		table[position].distance -= next - position; //distance improved for the item.
 		position = next;
 		}
@@ -51,6 +51,17 @@ constexpr uint8_t DICT_THRESHOLD_BITS = 3;
 // bucket at which to start looking for the next value to return.
 constexpr uint16_t TOO_FAR_TO_REACH = 0xFFFF;
 
+// Alongside the entries, the table keeps one control byte per position,
+// Swiss-table style: DICT_CTRL_EMPTY for empty positions, otherwise a 7-bit
+// tag taken from the entry's hash. Lookups compare the tags of a whole
+// group of positions at once (using SSE2 where available) and only look
+// at the entries whose tags match, rather than at every entry in the way.
+constexpr uint8_t DICT_CTRL_EMPTY = 0x80;
+
+// Number of control bytes compared at once. The control bytes are padded
+// by this many empty ones so that a group can start at any position.
+constexpr int DICT_GROUP_WIDTH = 16;
+
 /**
  * An entry stored in the dictionary.
  */
@@ -246,6 +257,11 @@ public:
 	void* Lookup(const detail::HashKey* key) const;
 	void* Lookup(const void* key, int key_size, detail::hash_t h) const;
 
+	// Returns the position of the key's entry in the table, or -1 if
+	// there's none.  Iterating over an unordered dictionary visits its
+	// entries in the order of their positions.
+	int Position(const detail::HashKey* key) const;
+
 	// Returns previous value, or 0 if none.
 	// If iterators_invalidated is supplied, its value is set to true
 	// if the removal may have invalidated any existing iterators.
@@ -419,8 +435,34 @@ private:
 	[[deprecated("Remove in v5.1. Use begin() and the standard-library-compatible version of iteration.")]]
 	void StopIterationNonConst(IterCookie* cookie);
 
+	// Control bytes. They follow the entries in the same allocation.
+	uint8_t* Ctrl() const	{ return reinterpret_cast<uint8_t*>(table + Capacity()); }
+	static uint8_t CtrlTag(detail::hash_t h)	{ return (uint32_t(h) >> 25) & 0x7f; }
+
+	// Size of the allocation holding a table of the given capacity.
+	static size_t TableBytes(int capacity)
+		{ return capacity * (sizeof(detail::DictEntry) + 1) + detail::DICT_GROUP_WIDTH; }
+
+	// Stores an entry at the given position, or empties it, keeping its
+	// control byte in sync.
+	void SetEntry(int position, const detail::DictEntry& entry)
+		{
+		table[position] = entry;
+		Ctrl()[position] = CtrlTag(entry.hash);
+		}
+
+	void SetEmpty(int position)
+		{
+		table[position].SetEmpty();
+		Ctrl()[position] = detail::DICT_CTRL_EMPTY;
+		}
+
 	//Lookup
 	int LinearLookupIndex(const void* key, int key_size, detail::hash_t hash) const;
+
+	// Finds the position of the key if it's within [bucket, end) and
+	// belongs to the bucket, or returns -1, probing the control bytes.
+	int ProbeIndex(const void* key, int key_size, detail::hash_t hash, int bucket, int end) const;
 	int LookupIndex(const void* key, int key_size, detail::hash_t hash, int* insert_position = nullptr,
 		int* insert_distance = nullptr);
 	int LookupIndex(const void* key, int key_size, detail::hash_t hash, int begin, int end,
@@ -18,6 +18,13 @@ zeek::EventMgr& mgr = zeek::event_mgr;
 
 namespace zeek {
 
+// Bounds the number of freed Event blocks kept for reuse.
+static constexpr size_t MAX_SPARE_EVENTS = 4096;
+
+// Freed Event blocks.  Never destroyed, as events may get freed during the
+// destruction of other static objects, the event manager's included.
+static std::vector<void*>* spare_events = new std::vector<void*>;
+
 	Event::Event(EventHandlerPtr arg_handler, zeek::Args arg_args,
              util::detail::SourceID arg_src, analyzer::ID arg_aid,
              Obj* arg_obj)
@@ -32,6 +39,31 @@ namespace zeek {
 		Ref(obj);
 	}
 
+Event::~Event()
+	{
+	release_args(std::move(args));
+	}
+
+void* Event::operator new(size_t size)
+	{
+	assert(size == sizeof(Event));
+
+	if ( spare_events->empty() )
+		return ::operator new(size);
+
+	void* ptr = spare_events->back();
+	spare_events->pop_back();
+	return ptr;
+	}
+
+void Event::operator delete(void* ptr)
+	{
+	if ( spare_events->size() < MAX_SPARE_EVENTS )
+		spare_events->push_back(ptr);
+	else
+		::operator delete(ptr);
+	}
+
 void Event::Describe(ODesc* d) const
 	{
 	if ( d->IsReadable() )
@@ -49,12 +81,20 @@ void Event::Describe(ODesc* d) const
 
 void Event::Dispatch(bool no_remote)
 	{
-	if ( src == util::detail::SOURCE_BROKER )
-		no_remote = true;
-
 	if ( handler->ErrorHandler() )
 		reporter->BeginErrorHandler();
 
+	Call(no_remote);
+
+	if ( handler->ErrorHandler() )
+		reporter->EndErrorHandler();
+	}
+
+void Event::Call(bool no_remote)
+	{
+	if ( src == util::detail::SOURCE_BROKER )
+		no_remote = true;
+
 	try
 		{
 		handler->Call(&args, no_remote);
@@ -68,9 +108,6 @@ void Event::Dispatch(bool no_remote)
 	if ( obj )
 		// obj->EventDone();
 		Unref(obj);
-
-	if ( handler->ErrorHandler() )
-		reporter->EndErrorHandler();
 	}
 
 EventMgr::EventMgr()
@@ -155,15 +192,32 @@ void EventMgr::Drain()
 
 		while ( current )
 			{
-			Event* next = current->NextEvent();
-
-			current_src = current->Source();
-			current_aid = current->Analyzer();
-			current->Dispatch();
-			Unref(current);
-
-			++event_mgr.num_events_dispatched;
-			current = next;
+			// Dispatch the run of events that share the current
+			// one's handler back-to-back, with the handler's setup
+			// done once for all of them.  Events still execute in
+			// the order they got queued.
+			EventHandler* h = current->handler.Ptr();
+			bool error_handler = h->ErrorHandler();
+
+			if ( error_handler )
+				reporter->BeginErrorHandler();
+
+			do
+				{
+				Event* next = current->NextEvent();
+
+				current_src = current->Source();
+				current_aid = current->Analyzer();
+				current->Call(false);
+				Unref(current);
+
+				++event_mgr.num_events_dispatched;
+				current = next;
+				}
+			while ( current && current->handler.Ptr() == h );
+
+			if ( error_handler )
+				reporter->EndErrorHandler();
 			}
 		}
 
@@ -21,6 +21,12 @@ public:
 	Event(EventHandlerPtr handler, zeek::Args args,
 	      util::detail::SourceID src = util::detail::SOURCE_LOCAL, analyzer::ID aid = 0,
 	      Obj* obj = nullptr);
+	~Event() override;
+
+	// Events get allocated from, and freed into, a pool of recycled
+	// blocks, as the event queue creates and destroys them at high rates.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
 
 	void SetNext(Event* n)		{ next_event = n; }
 	Event* NextEvent() const	{ return next_event; }
@@ -39,6 +45,10 @@ protected:
 	// EventMgr::Dispatch().
 	void Dispatch(bool no_remote = false);
 
+	// Calls the handler, leaving the setup for error handler events
+	// that Dispatch() does to the caller.
+	void Call(bool no_remote);
+
 	EventHandlerPtr handler;
 	zeek::Args args;
 	util::detail::SourceID src;
@@ -76,7 +86,11 @@ public:
 		std::is_convertible_v<
 			std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	Enqueue(const EventHandlerPtr& h, Args&&... args)
-		{ return Enqueue(h, zeek::Args{std::forward<Args>(args)...}); }
+		{
+		auto vl = acquire_args(sizeof...(args));
+		(vl.push_back(std::forward<Args>(args)), ...);
+		return Enqueue(h, std::move(vl));
+		}
 
 	void Dispatch(Event* event, bool no_remote = false);
 
@@ -20,11 +20,12 @@ EventHandler::EventHandler(std::string arg_name)
 	error_handler = false;
 	enabled = true;
 	generate_always = false;
+	live = false;
 	}
 
-EventHandler::operator bool() const
+void EventHandler::UpdateLiveness()
 	{
-	return enabled && ((local && local->HasBodies())
+	live = enabled && ((local && local->HasBodies())
 			   || generate_always
 			   || ! auto_publish.empty());
 	}
@@ -48,7 +49,10 @@ const FuncTypePtr& EventHandler::GetType(bool check_export)
 	}
 
 void EventHandler::SetFunc(FuncPtr f)
-	{ local = std::move(f); }
+	{
+	local = std::move(f);
+	UpdateLiveness();
+	}
 
 void EventHandler::Call(Args* vl, bool no_remote)
 	{
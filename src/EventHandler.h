@@ -30,17 +30,25 @@ public:
 	void AutoPublish(std::string topic)
 		{
 		auto_publish.insert(std::move(topic));
+		UpdateLiveness();
 		}
 
 	void AutoUnpublish(const std::string& topic)
 		{
 		auto_publish.erase(topic);
+		UpdateLiveness();
 		}
 
 	void Call(zeek::Args* vl, bool no_remote = false);
 
 	// Returns true if there is at least one local or remote handler.
-	explicit operator  bool() const;
+	// This is cheap enough to test before building an event's arguments,
+	// which analyzers should do.
+	explicit operator bool() const	{ return live; }
+
+	// Recomputes the result of the bool operator. Needs calling when
+	// the local function gains bodies.
+	void UpdateLiveness();
 
 	void SetUsed()	{ used = true; }
 	bool Used()	{ return used; }
@@ -50,11 +58,19 @@ public:
 	void SetErrorHandler()	{ error_handler = true; }
 	bool ErrorHandler()	{ return error_handler; }
 
-	void SetEnable(bool arg_enable)	{ enabled = arg_enable; }
+	void SetEnable(bool arg_enable)
+		{
+		enabled = arg_enable;
+		UpdateLiveness();
+		}
 
 	// Flags the event as interesting even if there is no body defined. In
 	// particular, this will then still pass the event on to plugins.
-	void SetGenerateAlways()	{ generate_always = true; }
+	void SetGenerateAlways()
+		{
+		generate_always = true;
+		UpdateLiveness();
+		}
 	bool GenerateAlways()	{ return generate_always; }
 
 private:
@@ -67,6 +83,7 @@ private:
 	bool enabled;
 	bool error_handler;	// this handler reports error messages.
 	bool generate_always;
+	bool live;		// whether there's a local or remote handler
 
 	std::unordered_set<std::string> auto_publish;
 };
@@ -2881,6 +2881,35 @@ ExprPtr IndexExpr::MakeLvalue()
 	return make_intrusive<RefExpr>(IntrusivePtr{NewRef{}, this});
 	}
 
+// If indexing "aggr" with the index list "index" is a lookup in a table
+// indexed by a single atomic value, returns the expression for that value.
+// Such lookups can then evaluate it directly, rather than creating a
+// ListVal just to hold it.
+static const Expr* atomic_table_index(const Expr* aggr, const Expr* index)
+	{
+	const auto& t = aggr->GetType();
+
+	if ( t->Tag() != TYPE_TABLE || index->Tag() != EXPR_LIST )
+		return nullptr;
+
+	const auto& exprs = index->AsListExpr()->Exprs();
+	const auto& itypes = t->AsTableType()->GetIndexTypes();
+
+	if ( exprs.length() != 1 || itypes.size() != 1 )
+		return nullptr;
+
+	switch ( itypes[0]->InternalType() ) {
+	case TYPE_INTERNAL_INT:
+	case TYPE_INTERNAL_UNSIGNED:
+	case TYPE_INTERNAL_DOUBLE:
+	case TYPE_INTERNAL_ADDR:
+		return exprs[0];
+
+	default:
+		return nullptr;
+	}
+	}
+
 ValPtr IndexExpr::Eval(Frame* f) const
 	{
 	auto v1 = op1->Eval(f);
@@ -2888,6 +2917,12 @@ ValPtr IndexExpr::Eval(Frame* f) const
 	if ( ! v1 )
 		return nullptr;
 
+	if ( auto index = atomic_table_index(op1.get(), op2.get()) )
+		{
+		auto v2 = index->Eval(f);
+		return v2 ? Fold(v1.get(), v2.get()) : nullptr;
+		}
+
 	auto v2 = op2->Eval(f);
 
 	if ( ! v2 )
@@ -3176,7 +3211,7 @@ HasFieldExpr::~HasFieldExpr()
 ValPtr HasFieldExpr::Fold(Val* v) const
 	{
 	auto rv = v->AsRecordVal();
-	return val_mgr->Bool(rv->GetField(field) != nullptr);
+	return val_mgr->Bool(rv->HasField(field));
 	}
 
 void HasFieldExpr::ExprDescribe(ODesc* d) const
@@ -4195,6 +4230,29 @@ InExpr::InExpr(ExprPtr arg_op1, ExprPtr arg_op2)
 		}
 	}
 
+ValPtr InExpr::Eval(Frame* f) const
+	{
+	if ( IsError() )
+		return nullptr;
+
+	auto index = atomic_table_index(op2.get(), op1.get());
+
+	if ( ! index )
+		return BinaryExpr::Eval(f);
+
+	auto v1 = index->Eval(f);
+
+	if ( ! v1 )
+		return nullptr;
+
+	auto v2 = op2->Eval(f);
+
+	if ( ! v2 )
+		return nullptr;
+
+	return Fold(v1.get(), v2.get());
+	}
+
 ValPtr InExpr::Fold(Val* v1, Val* v2) const
 	{
 	if ( v1->GetType()->Tag() == TYPE_PATTERN )
@@ -1250,6 +1250,8 @@ class InExpr final : public BinaryExpr {
 public:
 	InExpr(ExprPtr op1, ExprPtr op2);
 
+	ValPtr Eval(Frame* f) const override;
+
 	// Optimization-related:
 	ExprPtr Duplicate() override;
 
@@ -0,0 +1,652 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+#include "zeek/FlowShards.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <tuple>
+
+#include "zeek/3rdparty/doctest.h"
+
+#include "zeek/Options.h"
+#include "zeek/util.h"
+
+namespace zeek::detail {
+
+namespace {
+
+// Rows of all logs to sort in memory at once before spilling a run.
+constexpr size_t MERGE_MEM_LIMIT = size_t(256) << 20;
+
+std::vector<pid_t> workers;
+
+void forward_signal(int sig)
+	{
+	for ( pid_t pid : workers )
+		kill(pid, sig);
+	}
+
+std::string shard_marker(int shard)
+	{
+	return ".shard-" + std::to_string(shard);
+	}
+
+// Where a row goes in the merged log: rows with a numerical timestamp
+// first, then ones with a textual one (ISO 8601 in JSON logs), then the
+// ones without.
+struct SortKey {
+	int cls = 2;
+	double num = 0;
+	std::string str;
+
+	bool operator<(const SortKey& other) const
+		{ return std::tie(cls, num, str) < std::tie(other.cls, other.num, other.str); }
+};
+
+// How to find a row's timestamp.
+struct LogFormat {
+	std::string separator = "\t";
+	int ts_field = -1;	// for TSV logs
+
+	SortKey Key(const std::string& row) const;
+};
+
+SortKey LogFormat::Key(const std::string& row) const
+	{
+	SortKey key;
+
+	if ( row[0] == '{' )
+		{
+		auto pos = row.find("\"ts\":");
+
+		if ( pos == std::string::npos )
+			return key;
+
+		const char* val = row.c_str() + pos + 5;
+
+		if ( *val == '"' )
+			{
+			const char* end = strchr(val + 1, '"');
+
+			if ( end )
+				{
+				key.cls = 1;
+				key.str.assign(val + 1, end);
+				}
+
+			return key;
+			}
+
+		char* end;
+		key.num = strtod(val, &end);
+
+		if ( end != val )
+			key.cls = 0;
+
+		return key;
+		}
+
+	if ( ts_field < 0 )
+		return key;
+
+	size_t start = 0;
+
+	for ( int i = 0; i < ts_field; ++i )
+		{
+		start = row.find(separator, start);
+
+		if ( start == std::string::npos )
+			return key;
+
+		start += separator.size();
+		}
+
+	auto end = row.find(separator, start);
+	std::string field = row.substr(start, end == std::string::npos ? end : end - start);
+	char* num_end;
+	key.num = strtod(field.c_str(), &num_end);
+
+	if ( ! field.empty() && *num_end == '\0' )
+		key.cls = 0;
+
+	return key;
+	}
+
+// Reads lines, without their newlines, from a file that's either plain
+// or gzip-compressed.
+class LineReader {
+public:
+	explicit LineReader(const std::string& name)
+		{ file = gzopen(name.c_str(), "rb"); }
+
+	~LineReader()
+		{
+		if ( file )
+			gzclose(file);
+		}
+
+	bool IsOpen() const	{ return file; }
+	bool IsCompressed() const	{ return ! gzdirect(file); }
+
+	bool Next(std::string* line)
+		{
+		line->clear();
+		char buf[8192];
+
+		while ( gzgets(file, buf, sizeof(buf)) )
+			{
+			line->append(buf);
+
+			if ( line->back() == '\n' )
+				{
+				line->pop_back();
+				return true;
+				}
+			}
+
+		return ! line->empty();
+		}
+
+private:
+	gzFile file = nullptr;
+};
+
+struct Row {
+	SortKey key;
+	std::string line;
+};
+
+// Decodes the escapes in a "#separator" header line.
+std::string decode_separator(const std::string& s)
+	{
+	std::string result;
+
+	for ( size_t i = 0; i < s.size(); ++i )
+		{
+		if ( s[i] == '\\' && i + 3 < s.size() && s[i + 1] == 'x' )
+			{
+			result += static_cast<char>(strtol(s.substr(i + 2, 2).c_str(), nullptr, 16));
+			i += 3;
+			}
+		else
+			result += s[i];
+		}
+
+	return result;
+	}
+
+// Sorted rows in a temporary file.
+struct Run {
+	FILE* file;
+	Row head;
+};
+
+bool spill_run(std::vector<Row>* rows, std::vector<Run>* runs)
+	{
+	FILE* f = tmpfile();
+
+	if ( ! f )
+		{
+		fprintf(stderr, "failed to create temporary file for merging logs: %s\n", strerror(errno));
+		return false;
+		}
+
+	for ( const auto& r : *rows )
+		fprintf(f, "%s\n", r.line.c_str());
+
+	if ( ferror(f) || fflush(f) != 0 )
+		{
+		fprintf(stderr, "failed to write temporary file for merging logs: %s\n", strerror(errno));
+		fclose(f);
+		return false;
+		}
+
+	rewind(f);
+	runs->push_back({f, {}});
+	rows->clear();
+	return true;
+	}
+
+bool read_run_row(Run* run, const LogFormat& format)
+	{
+	char* line = nullptr;
+	size_t n = 0;
+	ssize_t len = getline(&line, &n, run->file);
+
+	if ( len <= 0 )
+		{
+		free(line);
+		return false;
+		}
+
+	run->head.line.assign(line, len - 1);
+	run->head.key = format.Key(run->head.line);
+	free(line);
+	return true;
+	}
+
+// Concatenates files byte by byte, for formats we can't read.
+bool concat_files(const std::vector<std::string>& files, const std::string& out)
+	{
+	FILE* dst = fopen(out.c_str(), "wb");
+
+	if ( ! dst )
+		{
+		fprintf(stderr, "failed to open %s: %s\n", out.c_str(), strerror(errno));
+		return false;
+		}
+
+	bool ok = true;
+
+	for ( const auto& f : files )
+		{
+		FILE* src = fopen(f.c_str(), "rb");
+
+		if ( ! src )
+			continue;
+
+		char buf[65536];
+		size_t n;
+
+		while ( (n = fread(buf, 1, sizeof(buf), src)) > 0 )
+			if ( fwrite(buf, 1, n, dst) != n )
+				ok = false;
+
+		fclose(src);
+		}
+
+	if ( fclose(dst) != 0 || ! ok )
+		{
+		fprintf(stderr, "failed to write %s: %s\n", out.c_str(), strerror(errno));
+		return false;
+		}
+
+	return true;
+	}
+
+bool is_zstd(const std::string& file)
+	{
+	static const u_char magic[4] = { 0x28, 0xb5, 0x2f, 0xfd };
+	u_char buf[4];
+	FILE* f = fopen(file.c_str(), "rb");
+
+	if ( ! f )
+		return false;
+
+	bool result = fread(buf, 1, sizeof(buf), f) == sizeof(buf) && memcmp(buf, magic, sizeof(magic)) == 0;
+	fclose(f);
+	return result;
+	}
+
+} // namespace
+
+bool merge_log_shards(const std::vector<std::string>& shards, const std::string& merged,
+                      size_t mem_limit)
+	{
+	std::vector<std::string> existing;
+
+	for ( const auto& s : shards )
+		if ( access(s.c_str(), F_OK) == 0 )
+			existing.push_back(s);
+
+	if ( existing.empty() )
+		return true;
+
+	// We can't read zstd, but its streams may be concatenated.
+	if ( is_zstd(existing[0]) )
+		return concat_files(existing, merged);
+
+	std::vector<std::string> header;
+	std::string close_line;
+	LogFormat format;
+	bool compressed = false;
+
+	std::vector<Row> rows;
+	size_t rows_size = 0;
+	std::vector<Run> runs;
+
+	auto cleanup = [&runs]()
+		{
+		for ( auto& r : runs )
+			fclose(r.file);
+		};
+
+	for ( const auto& s : existing )
+		{
+		LineReader in(s);
+
+		if ( ! in.IsOpen() )
+			{
+			fprintf(stderr, "failed to open %s: %s\n", s.c_str(), strerror(errno));
+			cleanup();
+			return false;
+			}
+
+		compressed = compressed || in.IsCompressed();
+
+		// All shards come with the same header, except for the
+		// time it was opened. Keep the first shard's.
+		bool keep_header = header.empty();
+		std::string line;
+
+		while ( in.Next(&line) )
+			{
+			if ( line.empty() )
+				continue;
+
+			if ( line[0] == '#' )
+				{
+				if ( line.compare(0, 6, "#close") == 0 )
+					close_line = std::max(close_line, line);
+
+				else if ( keep_header )
+					{
+					header.push_back(line);
+
+					if ( line.compare(0, 11, "#separator ") == 0 )
+						format.separator = decode_separator(line.substr(11));
+
+					else if ( line.compare(0, 7, "#fields") == 0 )
+						{
+						std::vector<std::string> fields;
+						util::tokenize_string(line, format.separator, &fields);
+						auto it = std::find(fields.begin(), fields.end(), "ts");
+
+						if ( it != fields.end() )
+							// Minus one for the "#fields" itself.
+							format.ts_field = it - fields.begin() - 1;
+						}
+					}
+
+				continue;
+				}
+
+			keep_header = false;
+			rows_size += line.size();
+			rows.push_back({format.Key(line), std::move(line)});
+
+			if ( rows_size > mem_limit )
+				{
+				std::stable_sort(rows.begin(), rows.end(),
+				                 [](const Row& a, const Row& b) { return a.key < b.key; });
+
+				if ( ! spill_run(&rows, &runs) )
+					{
+					cleanup();
+					return false;
+					}
+
+				rows_size = 0;
+				}
+			}
+		}
+
+	std::stable_sort(rows.begin(), rows.end(),
+	                 [](const Row& a, const Row& b) { return a.key < b.key; });
+
+	if ( ! runs.empty() && ! rows.empty() && ! spill_run(&rows, &runs) )
+		{
+		cleanup();
+		return false;
+		}
+
+	gzFile out = gzopen(merged.c_str(), compressed ? "wb" : "wT");
+
+	if ( ! out )
+		{
+		fprintf(stderr, "failed to open %s: %s\n", merged.c_str(), strerror(errno));
+		cleanup();
+		return false;
+		}
+
+	bool ok = true;
+
+	auto write_line = [&out, &ok](const std::string& line)
+		{
+		if ( gzwrite(out, line.data(), line.size()) != static_cast<int>(line.size()) ||
+		     gzputc(out, '\n') < 0 )
+			ok = false;
+		};
+
+	for ( const auto& h : header )
+		write_line(h);
+
+	if ( runs.empty() )
+		for ( const auto& r : rows )
+			write_line(r.line);
+
+	else
+		{
+		// Ties go to the earlier run, which keeps the merge stable.
+		auto later = [&runs](size_t a, size_t b)
+			{
+			return runs[b].head.key < runs[a].head.key ||
+				( ! (runs[a].head.key < runs[b].head.key) && b < a );
+			};
+
+		std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heads(later);
+
+		for ( size_t i = 0; i < runs.size(); ++i )
+			if ( read_run_row(&runs[i], format) )
+				heads.push(i);
+
+		while ( ! heads.empty() )
+			{
+			size_t i = heads.top();
+			heads.pop();
+			write_line(runs[i].head.line);
+
+			if ( read_run_row(&runs[i], format) )
+				heads.push(i);
+			}
+		}
+
+	if ( ! close_line.empty() )
+		write_line(close_line);
+
+	cleanup();
+
+	if ( gzclose(out) != Z_OK || ! ok )
+		{
+		fprintf(stderr, "failed to write %s\n", merged.c_str());
+		return false;
+		}
+
+	return true;
+	}
+
+void fork_flow_shards(Options* options)
+	{
+	int n = options->flow_shards;
+	const char* ext_env = getenv("ZEEK_LOG_SUFFIX");
+	std::string ext = ext_env ? ext_env : "log";
+
+	// Don't have buffered output written by every worker.
+	fflush(stdout);
+	fflush(stderr);
+
+	for ( int i = 0; i < n; ++i )
+		{
+		pid_t pid = fork();
+
+		if ( pid < 0 )
+			{
+			fprintf(stderr, "failed to fork flow shard worker: %s\n", strerror(errno));
+			forward_signal(SIGTERM);
+			exit(1);
+			}
+
+		if ( pid == 0 )
+			{
+			workers.clear();
+			options->flow_shards = 0;
+			options->script_options_to_set.emplace_back("flow_shard_count=" + std::to_string(n));
+			options->script_options_to_set.emplace_back("flow_shard_id=" + std::to_string(i));
+
+			// The ASCII writer names its files <path>.<ZEEK_LOG_SUFFIX>.
+			setenv("ZEEK_LOG_SUFFIX", (shard_marker(i).substr(1) + "." + ext).c_str(), 1);
+			return;
+			}
+
+		workers.push_back(pid);
+		}
+
+	// An interrupt from the terminal reaches the workers by itself, and
+	// they then shut down normally, so wait for them and merge what they
+	// wrote. Termination requests just get passed on.
+	signal(SIGINT, SIG_IGN);
+	signal(SIGTERM, forward_signal);
+
+	int failed = 0;
+
+	for ( pid_t pid : workers )
+		{
+		int status;
+
+		while ( waitpid(pid, &status, 0) < 0 )
+			if ( errno != EINTR )
+				{
+				status = -1;
+				break;
+				}
+
+		if ( ! WIFEXITED(status) || WEXITSTATUS(status) != 0 )
+			++failed;
+		}
+
+	// Find the shards of every log by their marker.
+	std::map<std::string, std::vector<std::string>> logs;
+	DIR* dir = opendir(".");
+
+	if ( ! dir )
+		{
+		fprintf(stderr, "failed to read current directory: %s\n", strerror(errno));
+		exit(1);
+		}
+
+	while ( dirent* e = readdir(dir) )
+		{
+		std::string name = e->d_name;
+
+		for ( int i = 0; i < n; ++i )
+			{
+			auto marker = shard_marker(i) + "." + ext;
+			auto pos = name.rfind(marker);
+
+			if ( pos == std::string::npos || pos == 0 )
+				continue;
+
+			auto merged = name.substr(0, pos) + name.substr(pos + shard_marker(i).size());
+			auto& shards = logs[merged];
+			shards.resize(n);
+			shards[i] = name;
+			break;
+			}
+		}
+
+	closedir(dir);
+
+	for ( const auto& [merged, shards] : logs )
+		{
+		if ( ! merge_log_shards(shards, merged, MERGE_MEM_LIMIT) )
+			{
+			++failed;
+			continue;
+			}
+
+		for ( const auto& s : shards )
+			if ( ! s.empty() )
+				unlink(s.c_str());
+		}
+
+	if ( failed )
+		fprintf(stderr, "%d flow shard worker(s) or log merge(s) failed\n", failed);
+
+	exit(failed ? 1 : 0);
+	}
+
+TEST_CASE("flow shards merge logs")
+	{
+	auto write = [](const char* name, const char* content)
+		{
+		FILE* f = fopen(name, "w");
+		fputs(content, f);
+		fclose(f);
+		};
+
+	auto read = [](const char* name)
+		{
+		std::string result;
+		FILE* f = fopen(name, "r");
+		char buf[256];
+
+		while ( f && fgets(buf, sizeof(buf), f) )
+			result += buf;
+
+		if ( f )
+			fclose(f);
+
+		return result;
+		};
+
+	write("test.shard-0.log",
+	      "#separator \\x09\n#path\ttest\n#open\t2021-01-01-00-00-01\n#fields\tuid\tts\n"
+	      "#types\tstring\ttime\nC1\t3.0\nC2\t1.0\nC3\t-\n#close\t2021-01-01-00-00-05\n");
+	write("test.shard-1.log",
+	      "#separator \\x09\n#path\ttest\n#open\t2021-01-01-00-00-02\n#fields\tuid\tts\n"
+	      "#types\tstring\ttime\nC4\t2.0\nC5\t1.0\n#close\t2021-01-01-00-00-07\n");
+
+	std::string expect =
+		"#separator \\x09\n#path\ttest\n#open\t2021-01-01-00-00-01\n#fields\tuid\tts\n"
+		"#types\tstring\ttime\nC2\t1.0\nC5\t1.0\nC4\t2.0\nC1\t3.0\nC3\t-\n"
+		"#close\t2021-01-01-00-00-07\n";
+
+	std::vector<std::string> shards = {"test.shard-0.log", "test.shard-1.log", "test.shard-2.log"};
+
+	// Sorted in memory, and in runs of about one row each.
+	CHECK(merge_log_shards(shards, "test.log", MERGE_MEM_LIMIT));
+	CHECK(read("test.log") == expect);
+
+	CHECK(merge_log_shards(shards, "test.log", 1));
+	CHECK(read("test.log") == expect);
+
+	write("test.shard-0.log", "{\"ts\":5.0,\"uid\":\"C1\"}\n{\"uid\":\"C2\"}\n{\"ts\":4.5,\"uid\":\"C3\"}\n");
+	write("test.shard-1.log", "{\"ts\":4.0,\"uid\":\"C4\"}\n");
+
+	CHECK(merge_log_shards(shards, "test.log", MERGE_MEM_LIMIT));
+	CHECK(read("test.log") ==
+	      "{\"ts\":4.0,\"uid\":\"C4\"}\n{\"ts\":4.5,\"uid\":\"C3\"}\n"
+	      "{\"ts\":5.0,\"uid\":\"C1\"}\n{\"uid\":\"C2\"}\n");
+
+	// Compressed shards make for a compressed merged log.
+	gzFile gz = gzopen("test.shard-0.log", "wb");
+	gzputs(gz, "{\"ts\":3.0,\"uid\":\"C5\"}\n");
+	gzclose(gz);
+
+	CHECK(merge_log_shards(shards, "test.log", MERGE_MEM_LIMIT));
+	CHECK(read("test.log").compare(0, 2, "\x1f\x8b") == 0);
+
+	std::string line;
+	LineReader merged("test.log");
+	CHECK((merged.Next(&line) && line == "{\"ts\":3.0,\"uid\":\"C5\"}"));
+	CHECK((merged.Next(&line) && line == "{\"ts\":4.0,\"uid\":\"C4\"}"));
+	CHECK(! merged.Next(&line));
+
+	unlink("test.shard-0.log");
+	unlink("test.shard-1.log");
+	unlink("test.log");
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,44 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace zeek {
+
+struct Options;
+
+namespace detail {
+
+/**
+ * Splits the analysis of a trace across worker processes by flow, for
+ * --flow-shards.  Forks one worker per shard, each of which analyzes only
+ * the connections that fall into its shard (see flow_shard_count) and
+ * writes its ASCII logs under a shard-specific name.  This returns in the
+ * workers, with their options adjusted accordingly, and only after all
+ * workers are running, so it must be called before any threads get
+ * started.  The parent waits for the workers, merges each log's shards
+ * into one file in timestamp order, and exits.
+ *
+ * @param options  the command-line options; updated for the worker
+ */
+void fork_flow_shards(Options* options);
+
+/**
+ * Merges the shards of an ASCII log, as written by the workers of
+ * fork_flow_shards(), into one file whose rows are ordered by their
+ * "ts" field.  Rows without one keep their order and go after the others.
+ *
+ * @param shards  the shards' file names, in shard order; missing files
+ * are skipped
+ * @param merged  the name of the file to write
+ * @param mem_limit  the number of bytes of rows to sort in memory at a
+ * time; more get sorted in runs that are spilled to temporary files
+ * @return false if an error occurred, which has been reported to stderr
+ */
+bool merge_log_shards(const std::vector<std::string>& shards, const std::string& merged,
+                      size_t mem_limit);
+
+} // namespace detail
+} // namespace zeek
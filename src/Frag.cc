@@ -15,18 +15,14 @@ constexpr uint32_t MAX_ACCEPTABLE_FRAG_SIZE = 64000;
 
 namespace zeek::detail {
 
-FragTimer::~FragTimer()
+size_t FragReassemblerKeyHash::operator()(const FragReassemblerKey& k) const
 	{
-	if ( f )
-		f->ClearTimer();
-	}
+	uint32_t bytes[9];
+	std::get<0>(k).CopyIPv6(&bytes[0]);
+	std::get<1>(k).CopyIPv6(&bytes[4]);
+	bytes[8] = std::get<2>(k);
 
-void FragTimer::Dispatch(double t, bool /* is_expire */)
-	{
-	if ( f )
-		f->Expire(t);
-	else
-		reporter->InternalWarning("fragment timer dispatched w/o reassembler");
+	return HashKey::HashBytes(bytes, sizeof(bytes));
 	}
 
 FragReassembler::FragReassembler(NetSessions* arg_s,
@@ -55,21 +51,13 @@ FragReassembler::FragReassembler(NetSessions* arg_s,
 	reassembled_pkt = nullptr;
 	frag_size = 0;	// flag meaning "not known"
 	next_proto = ip->NextProto();
-
-	if ( frag_timeout != 0.0 )
-		{
-		expire_timer = new FragTimer(this, t + frag_timeout);
-		timer_mgr->Add(expire_timer);
-		}
-	else
-		expire_timer = nullptr;
+	start_time = t;
 
 	AddFragment(t, ip, pkt);
 	}
 
 FragReassembler::~FragReassembler()
 	{
-	DeleteTimer();
 	delete [] proto_hdr;
 	}
 
@@ -278,9 +266,11 @@ void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
 		if ( b.upper > n )
 			{
 			reporter->InternalWarning("bad fragment reassembly");
-			DeleteTimer();
-			Expire(run_state::network_time);
+			// Give up on the datagram.  The FragmentManager
+			// removes us once the fragment's been added.
+			ClearBlocks();
 			delete [] pkt_start;
+			failed = true;
 			return;
 			}
 
@@ -297,7 +287,6 @@ void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
 		reassem4->ip_len = htons(frag_size + proto_hdr_len);
 		reassembled_pkt = std::make_unique<IP_Hdr>(reassem4, true);
 		reassembled_pkt->reassembled = true;
-		DeleteTimer();
 		}
 
 	else if ( version == 6 )
@@ -307,7 +296,6 @@ void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
 		const IPv6_Hdr_Chain* chain = new IPv6_Hdr_Chain(reassem6, next_proto, n);
 		reassembled_pkt = std::make_unique<IP_Hdr>(reassem6, true, n, chain);
 		reassembled_pkt->reassembled = true;
-		DeleteTimer();
 		}
 
 	else
@@ -318,25 +306,14 @@ void FragReassembler::BlockInserted(DataBlockMap::const_iterator /* it */)
 		}
 	}
 
-void FragReassembler::Expire(double t)
+void FragReassembler::ShedBuffers()
 	{
+	Weird("fragment_memory_shed");
 	block_list.Clear();
-	expire_timer->ClearReassembler();
-	expire_timer = nullptr;	// timer manager will delete it
 
 	fragment_mgr->Remove(this);
 	}
 
-void FragReassembler::DeleteTimer()
-	{
-	if ( expire_timer )
-		{
-		expire_timer->ClearReassembler();
-		timer_mgr->Cancel(expire_timer);
-		expire_timer = nullptr;	// timer manager will delete it
-		}
-	}
-
 FragmentManager::~FragmentManager()
 	{
 	Clear();
@@ -345,6 +322,8 @@ FragmentManager::~FragmentManager()
 FragReassembler* FragmentManager::NextFragment(double t, const std::unique_ptr<IP_Hdr>& ip,
                                                const u_char* pkt)
 	{
+	Expire(t);
+
 	uint32_t frag_id = ip->ID();
 	FragReassemblerKey key = std::make_tuple(ip->SrcAddr(), ip->DstAddr(), frag_id);
 
@@ -353,25 +332,97 @@ FragReassembler* FragmentManager::NextFragment(double t, const std::unique_ptr<I
 	if ( it != fragments.end() )
 		f = it->second;
 
-	if ( ! f )
+	if ( f )
+		f->AddFragment(t, ip, pkt);
+
+	else
 		{
+		if ( frag_max_reassemblers > 0 )
+			{
+			if ( fragments.empty() )
+				// Size the table for the worst case up front, so
+				// that a fragment storm doesn't keep rehashing it.
+				fragments.reserve(frag_max_reassemblers);
+
+			while ( oldest && fragments.size() >= frag_max_reassemblers )
+				{
+				++evictions;
+				Remove(oldest);
+				}
+			}
+
 		f = new FragReassembler(sessions, ip, pkt, key, t);
 		fragments[key] = f;
+		Age(f);
+
 		if ( fragments.size() > max_fragments )
 			max_fragments = fragments.size();
-		return f;
 		}
 
-	f->AddFragment(t, ip, pkt);
+	if ( f->failed )
+		{
+		// Don't let later fragments feed a datagram we gave up on.
+		Remove(f);
+		return nullptr;
+		}
+
+	if ( f->reassembled_pkt )
+		// Done, and in use until the packet's processing finishes, so
+		// a nested fragment mustn't expire or evict it.
+		StopAging(f);
+
 	return f;
 	}
 
+void FragmentManager::Expire(double t)
+	{
+	if ( frag_timeout == 0.0 )
+		return;
+
+	while ( oldest && oldest->start_time + frag_timeout <= t )
+		Remove(oldest);
+	}
+
+void FragmentManager::Age(FragReassembler* f)
+	{
+	f->aging = true;
+	f->older = newest;
+	f->newer = nullptr;
+
+	if ( newest )
+		newest->newer = f;
+	else
+		oldest = f;
+
+	newest = f;
+	}
+
+void FragmentManager::StopAging(FragReassembler* f)
+	{
+	if ( ! f->aging )
+		return;
+
+	if ( f->older )
+		f->older->newer = f->newer;
+	else
+		oldest = f->newer;
+
+	if ( f->newer )
+		f->newer->older = f->older;
+	else
+		newest = f->older;
+
+	f->older = f->newer = nullptr;
+	f->aging = false;
+	}
+
 void FragmentManager::Clear()
 	{
 	for ( const auto& entry : fragments )
 		Unref(entry.second);
 
 	fragments.clear();
+	oldest = newest = nullptr;
 	}
 
 void FragmentManager::Remove(detail::FragReassembler* f)
@@ -382,6 +433,7 @@ void FragmentManager::Remove(detail::FragReassembler* f)
 	if ( fragments.erase(f->Key()) == 0 )
 		reporter->InternalWarning("fragment reassembler not in dict");
 
+	StopAging(f);
 	Unref(f);
 	}
 
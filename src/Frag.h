@@ -4,11 +4,11 @@
 
 #include <sys/types.h> // for u_char
 #include <tuple>
+#include <unordered_map>
 
 #include "zeek/util.h" // for bro_uint_t
 #include "zeek/IPAddr.h"
 #include "zeek/Reassem.h"
-#include "zeek/Timer.h"
 
 namespace zeek {
 
@@ -18,10 +18,14 @@ class IP_Hdr;
 namespace detail {
 
 class FragReassembler;
-class FragTimer;
+class FragmentManager;
 
 using FragReassemblerKey = std::tuple<IPAddr, IPAddr, bro_uint_t>;
 
+struct FragReassemblerKeyHash {
+	size_t operator()(const FragReassemblerKey& k) const;
+};
+
 class FragReassembler : public Reassembler {
 public:
 	FragReassembler(NetSessions* s, const std::unique_ptr<IP_Hdr>& ip, const u_char* pkt,
@@ -30,14 +34,16 @@ public:
 
 	void AddFragment(double t, const std::unique_ptr<IP_Hdr>& ip, const u_char* pkt);
 
-	void Expire(double t);
-	void DeleteTimer();
-	void ClearTimer()	{ expire_timer = nullptr; }
-
 	std::unique_ptr<IP_Hdr> ReassembledPkt()	{ return std::move(reassembled_pkt); }
 	const FragReassemblerKey& Key() const	{ return key; }
 
+	// Time at which the first fragment arrived.
+	double StartTime() const	{ return start_time; }
+
 protected:
+	friend class FragmentManager;
+
+	void ShedBuffers() override;
 	void BlockInserted(DataBlockMap::const_iterator it) override;
 	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
 	void Weird(const char* name) const;
@@ -49,24 +55,13 @@ protected:
 	FragReassemblerKey key;
 	uint16_t next_proto; // first IPv6 fragment header's next proto field
 	uint16_t proto_hdr_len;
+	double start_time;
+	bool failed = false;	// reassembly went wrong, ignore the datagram
 
-	FragTimer* expire_timer;
-};
-
-class FragTimer final : public Timer {
-public:
-	FragTimer(FragReassembler* arg_f, double arg_t)
-		: Timer(arg_t, TIMER_FRAG)
-			{ f = arg_f; }
-	~FragTimer() override;
-
-	void Dispatch(double t, bool is_expire) override;
-
-	// Break the association between this timer and its creator.
-	void ClearReassembler()	{ f = nullptr; }
-
-protected:
-	FragReassembler* f;
+	// Neighbors on the FragmentManager's age list.
+	FragReassembler* older = nullptr;
+	FragReassembler* newer = nullptr;
+	bool aging = false;
 };
 
 class FragmentManager {
@@ -75,6 +70,8 @@ public:
 	FragmentManager() = default;
 	~FragmentManager();
 
+	// Adds a fragment to its datagram's reassembler and returns that,
+	// or nullptr if the datagram can't be reassembled.
 	FragReassembler* NextFragment(double t, const std::unique_ptr<IP_Hdr>& ip,
 	                              const u_char* pkt);
 	void Clear();
@@ -84,11 +81,28 @@ public:
 	size_t MaxFragments() const 	{ return max_fragments; }
 	uint32_t MemoryAllocation() const;
 
+	// Number of reassemblers dropped to stay within frag_max_reassemblers.
+	uint64_t Evictions() const	{ return evictions; }
+
 private:
+	// Drops reassemblers whose first fragment arrived more than
+	// frag_timeout before t.
+	void Expire(double t);
 
-	using FragmentMap = std::map<detail::FragReassemblerKey, detail::FragReassembler*>;
+	void Age(FragReassembler* f);
+	void StopAging(FragReassembler* f);
+
+	using FragmentMap = std::unordered_map<detail::FragReassemblerKey, detail::FragReassembler*,
+	                                       detail::FragReassemblerKeyHash>;
 	FragmentMap fragments;
 	size_t max_fragments = 0;
+	uint64_t evictions = 0;
+
+	// Incomplete datagrams' reassemblers, from oldest to newest.  This
+	// stands in for per-reassembler timers: the ones up for expiration
+	// or eviction are always at the front.
+	FragReassembler* oldest = nullptr;
+	FragReassembler* newest = nullptr;
 };
 
 extern FragmentManager* fragment_mgr;
@@ -15,10 +15,93 @@ std::vector<zeek::detail::Frame*> g_frame_stack;
 
 namespace zeek::detail {
 
+// Frames larger than this don't get pooled.
+static constexpr int MAX_POOLED_FRAME_SIZE = 128;
+
+namespace {
+
+// Released frames available for reuse, by size.
+struct FramePool {
+	~FramePool()
+		{
+		for ( const auto& free_list : free_lists )
+			for ( auto f : free_list )
+				delete f;
+		}
+
+	std::vector<Frame*> free_lists[MAX_POOLED_FRAME_SIZE + 1];
+
+	// Bounds the number of frames kept per size, which deep recursion
+	// could otherwise drive up.
+	int limit = 32;
+};
+
+FramePool frame_pool;
+
+} // namespace
+
 Frame::Frame(int arg_size, const ScriptFunc* func, const zeek::Args* fn_args)
 	{
 	size = arg_size;
 	frame = std::make_unique<Element[]>(size);
+
+	Init(func, fn_args);
+	}
+
+FramePtr Frame::Acquire(int size, const ScriptFunc* func, const zeek::Args* fn_args)
+	{
+	if ( size <= MAX_POOLED_FRAME_SIZE )
+		{
+		auto& free_list = frame_pool.free_lists[size];
+
+		if ( ! free_list.empty() )
+			{
+			Frame* f = free_list.back();
+			free_list.pop_back();
+			f->Init(func, fn_args);
+			return {AdoptRef{}, f};
+			}
+		}
+
+	return make_intrusive<Frame>(size, func, fn_args);
+	}
+
+void Frame::Release(FramePtr f)
+	{
+	// Anything referring to the frame, or that its destructor would need
+	// to take care of, rules out reusing it.  Dropping our reference then
+	// deletes it as usual.
+	if ( f->RefCnt() > 1 || f->size > MAX_POOLED_FRAME_SIZE ||
+	     f->closure || f->outer_ids.length() > 0 || f->offset_map ||
+	     f->functions_with_closure_frame_reference )
+		return;
+
+	auto& free_list = frame_pool.free_lists[f->size];
+
+	if ( int(free_list.size()) >= frame_pool.limit )
+		return;
+
+	for ( int i = 0; i < f->size; ++i )
+		f->ClearElement(i);
+
+	f->trigger = nullptr;
+	free_list.push_back(f.release());
+	}
+
+void Frame::SetPoolLimit(int limit)
+	{
+	frame_pool.limit = limit;
+
+	for ( auto& free_list : frame_pool.free_lists )
+		while ( int(free_list.size()) > limit )
+			{
+			delete free_list.back();
+			free_list.pop_back();
+			}
+	}
+
+void Frame::Init(const ScriptFunc* func, const zeek::Args* fn_args)
+	{
 	function = func;
 	func_args = fn_args;
 
@@ -30,6 +113,7 @@ Frame::Frame(int arg_size, const ScriptFunc* func, const zeek::Args* fn_args)
 	delayed = false;
 
 	closure = nullptr;
+	weak_closure_ref = false;
 
 	// We could Ref()/Unref() the captures frame, but there's really
 	// no need because by definition this current frame exists to
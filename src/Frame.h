@@ -56,6 +56,29 @@ public:
 	 */
 	virtual ~Frame() override;
 
+	/**
+	 * Returns a frame for an invocation of *func*, reusing one that an
+	 * earlier invocation handed back through Release() if there's one of
+	 * the right size. Arguments are as for the constructor.
+	 */
+	static FramePtr Acquire(int size, const ScriptFunc* func,
+	                        const zeek::Args* fn_args);
+
+	/**
+	 * Hands back a frame obtained from Acquire() once its invocation is
+	 * done. The frame only gets reused if nothing else holds on to it,
+	 * such as a trigger, or a lambda that uses it as its closure;
+	 * otherwise it lives on until those let go of it, just as without
+	 * pooling.
+	 */
+	static void Release(FramePtr f);
+
+	/**
+	 * Sets the number of released frames kept for reuse per frame size.
+	 * Zero turns off reuse.
+	 */
+	static void SetPoolLimit(int limit);
+
 	/**
 	 * @param n the index to get.
 	 * @return the value at index *n* of the underlying array.
@@ -279,6 +302,11 @@ private:
 
 	using OffsetMap = std::unordered_map<std::string, int>;
 
+	/**
+	 * (Re-)initializes the per-invocation state of the frame.
+	 */
+	void Init(const ScriptFunc* func, const zeek::Args* fn_args);
+
 	struct Element {
 		ValPtr val;
 		// Weak reference is used to prevent circular reference memory leaks
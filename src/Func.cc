@@ -48,6 +48,7 @@
 #include "zeek/Sessions.h"
 #include "zeek/RE.h"
 #include "zeek/Event.h"
+#include "zeek/EventRegistry.h"
 #include "zeek/Traverse.h"
 #include "zeek/Reporter.h"
 #include "zeek/plugin/Manager.h"
@@ -351,7 +352,7 @@ ValPtr ScriptFunc::Invoke(zeek::Args* args, Frame* parent) const
 		return Flavor() == FUNC_FLAVOR_HOOK ? val_mgr->True() : nullptr;
 		}
 
-	auto f = make_intrusive<Frame>(frame_size, this, args);
+	auto f = Frame::Acquire(frame_size, this, args);
 
 	if ( closure )
 		f->CaptureClosure(closure, outer_ids);
@@ -465,6 +466,7 @@ ValPtr ScriptFunc::Invoke(zeek::Args* args, Frame* parent) const
 		}
 
 	g_frame_stack.pop_back();
+	Frame::Release(std::move(f));
 
 	return result;
 	}
@@ -548,6 +550,13 @@ void ScriptFunc::AddBody(StmtPtr new_body,
 
 	bodies.push_back(b);
 	sort(bodies.begin(), bodies.end());
+
+	if ( Flavor() == FUNC_FLAVOR_EVENT && event_registry )
+		{
+		// The event's handler caches whether it has any bodies.
+		if ( auto h = event_registry->Lookup(Name()) )
+			h->UpdateLiveness();
+		}
 	}
 
 void ScriptFunc::ReplaceBody(const StmtPtr& old_body, StmtPtr new_body)
@@ -1004,6 +1013,8 @@ void init_primary_bifs()
 	GapStats = id::find_type<RecordType>("GapStats");
 	EventStats = id::find_type<RecordType>("EventStats");
 	TimerStats = id::find_type<RecordType>("TimerStats");
+	TableExpireStats = id::find_type<RecordType>("TableExpireStats");
+	StringInternStats = id::find_type<RecordType>("StringInternStats");
 	FileAnalysisStats = id::find_type<RecordType>("FileAnalysisStats");
 	ThreadStats = id::find_type<RecordType>("ThreadStats");
 	BrokerStats = id::find_type<RecordType>("BrokerStats");
@@ -117,6 +117,11 @@ int tcp_SYN_ack_ok;
 int tcp_match_undelivered;
 
 double frag_timeout;
+bro_uint_t frag_max_reassemblers;
+
+bro_uint_t reassembly_memory_high_water;
+bro_uint_t reassembly_memory_low_water;
+int reassembly_shed_largest_first;
 
 double tcp_SYN_timeout;
 double tcp_session_timer;
@@ -163,6 +168,10 @@ double stp_idle_min;
 double table_expire_interval;
 double table_expire_delay;
 int table_incremental_step;
+double table_expire_budget;
+
+int string_intern_max_entries;
+int string_intern_max_len;
 
 double connection_status_update_interval;
 
@@ -180,6 +189,7 @@ int load_sample_freq;
 int packet_filter_default;
 
 int sig_max_group_size;
+int sig_prefilter;
 
 int dpd_reassemble_first_packets;
 int dpd_buffer_size;
@@ -238,8 +248,12 @@ void init_general_global_var()
 	table_expire_interval = id::find_val("table_expire_interval")->AsInterval();
 	table_expire_delay = id::find_val("table_expire_delay")->AsInterval();
 	table_incremental_step = id::find_val("table_incremental_step")->AsCount();
+	table_expire_budget = id::find_val("table_expire_budget")->AsInterval();
+	string_intern_max_entries = id::find_val("string_intern_max_entries")->AsCount();
+	string_intern_max_len = id::find_val("string_intern_max_len")->AsCount();
 	packet_filter_default = id::find_val("packet_filter_default")->AsBool();
 	sig_max_group_size = id::find_val("sig_max_group_size")->AsCount();
+	sig_prefilter = id::find_val("sig_prefilter")->AsBool();
 	check_for_unused_event_handlers = id::find_val("check_for_unused_event_handlers")->AsBool();
 	record_all_packets = id::find_val("record_all_packets")->AsBool();
 	bits_per_uid = id::find_val("bits_per_uid")->AsCount();
@@ -261,6 +275,11 @@ void init_net_var()
 	tcp_match_undelivered = id::find_val("tcp_match_undelivered")->AsBool();
 
 	frag_timeout = id::find_val("frag_timeout")->AsInterval();
+	frag_max_reassemblers = id::find_val("frag_max_reassemblers")->AsCount();
+
+	reassembly_memory_high_water = id::find_val("reassembly_memory_high_water")->AsCount();
+	reassembly_memory_low_water = id::find_val("reassembly_memory_low_water")->AsCount();
+	reassembly_shed_largest_first = id::find_val("reassembly_shed_largest_first")->AsBool();
 
 	tcp_SYN_timeout = id::find_val("tcp_SYN_timeout")->AsInterval();
 	tcp_session_timer = id::find_val("tcp_session_timer")->AsInterval();
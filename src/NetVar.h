@@ -18,6 +18,11 @@ extern int tcp_SYN_ack_ok;
 extern int tcp_match_undelivered;
 
 extern double frag_timeout;
+extern bro_uint_t frag_max_reassemblers;
+
+extern bro_uint_t reassembly_memory_high_water;
+extern bro_uint_t reassembly_memory_low_water;
+extern int reassembly_shed_largest_first;
 
 extern double tcp_SYN_timeout;
 extern double tcp_session_timer;
@@ -64,6 +69,10 @@ extern double stp_idle_min;
 extern double table_expire_interval;
 extern double table_expire_delay;
 extern int table_incremental_step;
+extern double table_expire_budget;
+
+extern int string_intern_max_entries;
+extern int string_intern_max_len;
 
 extern int orig_addr_anonymization, resp_addr_anonymization;
 extern int other_addr_anonymization;
@@ -81,6 +90,7 @@ extern int load_sample_freq;
 extern int packet_filter_default;
 
 extern int sig_max_group_size;
+extern int sig_prefilter;
 
 extern int dpd_reassemble_first_packets;
 extern int dpd_buffer_size;
@@ -40,6 +40,7 @@ void Options::filter_supervised_node_options()
 	ignore_checksums = og.ignore_checksums;
 	use_watchdog = og.use_watchdog;
 	pseudo_realtime = og.pseudo_realtime;
+	use_timer_wheel = og.use_timer_wheel;
 	dns_mode = og.dns_mode;
 
 	bare_mode = og.bare_mode;
@@ -121,6 +122,8 @@ void usage(const char* prog, int code)
 	fprintf(stderr, "    -M|--mem-profile               | record heap [perftools]\n");
 #endif
 	fprintf(stderr, "    --pseudo-realtime[=<speedup>]  | enable pseudo-realtime for performance evaluation (default 1)\n");
+	fprintf(stderr, "    --timer-wheel                  | manage timers with a hierarchical timing wheel instead of a priority queue\n");
+	fprintf(stderr, "    --flow-shards <n>              | analyze the trace given with -r in n processes split by flow, then merge their logs\n");
 	fprintf(stderr, "    -j|--jobs                      | enable supervisor mode\n");
 
 #ifdef USE_IDMEF
@@ -157,6 +160,7 @@ static void set_analysis_option(const char* opt, Options& opts)
 	if ( util::streq(opt, "help") )
 		{
 		fprintf(stderr, "--optimize options:\n");
+		fprintf(stderr, "    bytecode	compile scripts to bytecode; implies xform\n");
 		fprintf(stderr, "    dump-uds	dump use-defs to stdout; implies xform\n");
 		fprintf(stderr, "    dump-xform	dump transformed scripts to stdout; implies xform\n");
 		fprintf(stderr, "    help	print this list\n");
@@ -168,7 +172,9 @@ static void set_analysis_option(const char* opt, Options& opts)
 
 	auto& a_o = opts.analysis_options;
 
-	if ( util::streq(opt, "dump-uds") )
+	if ( util::streq(opt, "bytecode") )
+		a_o.activate = a_o.gen_bytecode = true;
+	else if ( util::streq(opt, "dump-uds") )
 		a_o.activate = a_o.dump_uds = true;
 	else if ( util::streq(opt, "dump-xform") )
 		a_o.activate = a_o.dump_xform = true;
@@ -320,6 +326,8 @@ Options parse_cmdline(int argc, char** argv)
 #endif
 
 		{"pseudo-realtime",	optional_argument, nullptr,	'E'},
+		{"timer-wheel",	no_argument,		nullptr,	'K'},
+		{"flow-shards",	required_argument,	nullptr,	'L'},
 		{"jobs",	optional_argument, nullptr,	'j'},
 		{"test",		no_argument,		nullptr,	'#'},
 
@@ -449,6 +457,18 @@ Options parse_cmdline(int argc, char** argv)
 		case 'I':
 			rval.identifier_to_print = optarg;
 			break;
+		case 'K':
+			rval.use_timer_wheel = true;
+			break;
+		case 'L':
+			rval.flow_shards = atoi(optarg);
+
+			if ( rval.flow_shards < 1 )
+				{
+				fprintf(stderr, "ERROR: --flow-shards needs a positive number of shards.\n");
+				exit(1);
+				}
+			break;
 		case 'N':
 			++rval.print_plugins;
 			break;
@@ -526,6 +546,21 @@ Options parse_cmdline(int argc, char** argv)
 			rval.scripts_to_load.emplace_back(zargs[optind++]);
 		}
 
+	if ( rval.flow_shards > 1 )
+		{
+		if ( ! rval.pcap_file || *rval.pcap_file == "-" )
+			{
+			fprintf(stderr, "ERROR: --flow-shards requires a trace file given with -r.\n");
+			exit(1);
+			}
+
+		if ( rval.supervisor_mode )
+			{
+			fprintf(stderr, "ERROR: --flow-shards can't be used in supervisor mode.\n");
+			exit(1);
+			}
+		}
+
 	auto canonify_script_path = [](std::string* path)
 		{
 		if ( path->empty() )
@@ -46,6 +46,8 @@ struct Options {
 	bool ignore_checksums = false;
 	bool use_watchdog = false;
 	double pseudo_realtime = 0;
+	bool use_timer_wheel = false;
+	int flow_shards = 0;
 	detail::DNS_MgrMode dns_mode = detail::DNS_DEFAULT;
 
 	bool supervisor_mode = false;
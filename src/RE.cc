@@ -7,6 +7,7 @@
 #include <utility>
 
 #include "zeek/DFA.h"
+#include "zeek/DFATable.h"
 #include "zeek/CCL.h"
 #include "zeek/EquivClass.h"
 #include "zeek/Reporter.h"
@@ -24,6 +25,11 @@ extern void RE_done_with_scan();
 namespace zeek {
 namespace detail {
 
+Specific_RE_Matcher* Specific_RE_Matcher::all_matchers = nullptr;
+int Specific_RE_Matcher::precompile_max_states = 0;
+std::string Specific_RE_Matcher::precompile_cache_dir;
+Specific_RE_Matcher::PrecompileStats Specific_RE_Matcher::precompile_stats = { 0, 0, 0 };
+
 Specific_RE_Matcher::Specific_RE_Matcher(match_type arg_mt, int arg_multiline)
 : equiv_class(NUM_SYM)
 	{
@@ -32,16 +38,34 @@ Specific_RE_Matcher::Specific_RE_Matcher(match_type arg_mt, int arg_multiline)
 	any_ccl = nullptr;
 	pattern_text = nullptr;
 	dfa = nullptr;
+	table = nullptr;
 	ecs = nullptr;
 	accepted = new AcceptingSet();
+
+	prev_matcher = nullptr;
+	next_matcher = all_matchers;
+
+	if ( all_matchers )
+		all_matchers->prev_matcher = this;
+
+	all_matchers = this;
 	}
 
 Specific_RE_Matcher::~Specific_RE_Matcher()
 	{
+	if ( prev_matcher )
+		prev_matcher->next_matcher = next_matcher;
+	else
+		all_matchers = next_matcher;
+
+	if ( next_matcher )
+		next_matcher->prev_matcher = prev_matcher;
+
 	for ( int i = 0; i < ccl_list.length(); ++i )
 		delete ccl_list[i];
 
 	Unref(dfa);
+	delete table;
 	delete [] pattern_text;
 	delete accepted;
 	}
@@ -123,6 +147,8 @@ bool Specific_RE_Matcher::Compile(bool lazy)
 	if ( ! pattern_text )
 		return false;
 
+	cache_key = std::to_string(mt) + ":" + std::to_string(multiline) + ":" + pattern_text;
+
 	rem = this;
 	RE_set_input(pattern_text);
 
@@ -150,11 +176,23 @@ bool Specific_RE_Matcher::Compile(bool lazy)
 	return true;
 	}
 
-bool Specific_RE_Matcher::CompileSet(const string_list& set, const int_list& idx)
+bool Specific_RE_Matcher::CompileSet(const string_list& set, const int_list& idx,
+                                     bool precompile)
 	{
 	if ( (size_t)set.length() != idx.size() )
 		reporter->InternalError("compileset: lengths of sets differ");
 
+	cache_key = "set:" + std::to_string(mt) + ":" + std::to_string(multiline);
+
+	loop_over_list(set, j)
+		{
+		cache_key += ":" + std::to_string(idx[j]) + ":" + set[j];
+		cache_key.push_back('\0');
+		}
+
+	if ( precompile && precompile_max_states && LoadPrecompiled() )
+		return true;
+
 	rem = this;
 
 	NFA_Machine* set_nfa = nullptr;
@@ -194,9 +232,84 @@ bool Specific_RE_Matcher::CompileSet(const string_list& set, const int_list& idx
 	dfa = new DFA_Machine(nfa, EC());
 	ecs = EC()->EquivClasses();
 
+	if ( precompile && precompile_max_states )
+		Precompile();
+
 	return true;
 	}
 
+bool Specific_RE_Matcher::Precompile()
+	{
+	if ( table )
+		return true;
+
+	if ( ! dfa || ! precompile_max_states )
+		return false;
+
+	if ( ! LoadPrecompiled() )
+		{
+		table = DFA_Table::Build(dfa, EC(), precompile_max_states);
+
+		if ( ! table )
+			{
+			++precompile_stats.over_budget;
+			return false;
+			}
+
+		table->Minimize();
+		++precompile_stats.precompiled;
+
+		if ( ! precompile_cache_dir.empty() &&
+		     ! table->Save(precompile_cache_dir, cache_key) )
+			{
+			static bool warned = false;
+
+			if ( ! warned )
+				{
+				reporter->Warning("can't write DFA cache files to %s",
+				                  precompile_cache_dir.c_str());
+				warned = true;
+				}
+			}
+		}
+
+	// The table replaces the DFA, and what it has computed so far.
+	Unref(dfa);
+	dfa = nullptr;
+	ecs = table->EquivClasses();
+
+	return true;
+	}
+
+bool Specific_RE_Matcher::LoadPrecompiled()
+	{
+	if ( precompile_cache_dir.empty() || cache_key.empty() )
+		return false;
+
+	table = DFA_Table::Load(precompile_cache_dir, cache_key);
+
+	if ( ! table )
+		return false;
+
+	ecs = table->EquivClasses();
+	++precompile_stats.precompiled;
+	++precompile_stats.loaded;
+
+	return true;
+	}
+
+void Specific_RE_Matcher::EnablePrecompilation(int max_states, const std::string& cache_dir)
+	{
+	precompile_max_states = max_states;
+	precompile_cache_dir = cache_dir;
+
+	if ( ! max_states )
+		return;
+
+	for ( auto m = all_matchers; m; m = m->next_matcher )
+		m->Precompile();
+	}
+
 std::string Specific_RE_Matcher::LookupDef(const std::string& def)
 	{
 	const auto& iter = defs.find(def);
@@ -239,6 +352,19 @@ int Specific_RE_Matcher::LongestMatch(const String* s)
 
 bool Specific_RE_Matcher::MatchAll(const u_char* bv, int n)
 	{
+	if ( table )
+		{
+		int s = table->Xtion(table->StartState(), ecs[SYM_BOL]);
+
+		while ( s != DFA_Table::JAM && --n >= 0 )
+			s = table->Xtion(s, ecs[*(bv++)]);
+
+		if ( s != DFA_Table::JAM )
+			s = table->Xtion(s, ecs[SYM_EOL]);
+
+		return s != DFA_Table::JAM && table->Accepts(s);
+		}
+
 	if ( ! dfa )
 		// An empty pattern matches "all" iff what's being
 		// matched is empty.
@@ -265,6 +391,32 @@ bool Specific_RE_Matcher::MatchAll(const u_char* bv, int n)
 
 int Specific_RE_Matcher::Match(const u_char* bv, int n)
 	{
+	if ( table )
+		{
+		int s = table->Xtion(table->StartState(), ecs[SYM_BOL]);
+
+		if ( s == DFA_Table::JAM )
+			return 0;
+
+		for ( int i = 0; i < n; ++i )
+			{
+			s = table->Xtion(s, ecs[bv[i]]);
+
+			if ( s == DFA_Table::JAM )
+				return 0;
+
+			if ( table->Accepts(s) )
+				return i + 1;
+			}
+
+		s = table->Xtion(s, ecs[SYM_EOL]);
+
+		if ( s != DFA_Table::JAM && table->Accepts(s) )
+			return n > 0 ? n : 1;
+
+		return 0;
+		}
+
 	if ( ! dfa )
 		// An empty pattern matches anything.
 		return 1;
@@ -298,7 +450,8 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n)
 
 void Specific_RE_Matcher::Dump(FILE* f)
 	{
-	dfa->Dump(f);
+	if ( dfa )
+		dfa->Dump(f);
 	}
 
 inline void RE_Match_State::AddMatches(const AcceptingSet& as,
@@ -310,9 +463,19 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as,
 		accepted_matches.insert(am_idx(*it, position));
 	}
 
+inline void RE_Match_State::AddMatches(const int32_t* begin, const int32_t* end,
+                                       MatchPos position)
+	{
+	for ( ; begin != end; ++begin )
+		accepted_matches.insert(std::make_pair(*begin, position));
+	}
+
 bool RE_Match_State::Match(const u_char* bv, int n,
 				bool bol, bool eol, bool clear)
 	{
+	if ( table )
+		return MatchTable(bv, n, bol, eol, clear);
+
 	if ( current_pos == -1 )
 		{
 		// First call to Match().
@@ -373,14 +536,93 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 	return accepted_matches.size() != old_matches;
 	}
 
+bool RE_Match_State::MatchTable(const u_char* bv, int n,
+				bool bol, bool eol, bool clear)
+	{
+	if ( current_pos == -1 || clear )
+		{
+		current_xstate = table->StartState();
+
+		if ( current_pos == -1 && table->Accepts(current_xstate) )
+			AddMatches(table->AcceptBegin(current_xstate),
+			           table->AcceptEnd(current_xstate), 0);
+		}
+
+	if ( current_xstate == DFA_Table::JAM )
+		return false;
+
+	current_pos = 0;
+
+	size_t old_matches = accepted_matches.size();
+
+	int ec;
+	int m = bol ? n + 1 : n;
+	int e = eol ? -1 : 0;
+	int s = current_xstate;
+
+	while ( --m >= e )
+		{
+		if ( m == n )
+			ec = ecs[SYM_BOL];
+		else if ( m == -1 )
+			ec = ecs[SYM_EOL];
+		else
+			ec = ecs[*(bv++)];
+
+		s = table->Xtion(s, ec);
+
+		if ( s == DFA_Table::JAM )
+			break;
+
+		if ( table->Accepts(s) )
+			AddMatches(table->AcceptBegin(s), table->AcceptEnd(s), current_pos);
+
+		++current_pos;
+		}
+
+	current_xstate = s;
+
+	return accepted_matches.size() != old_matches;
+	}
+
 int Specific_RE_Matcher::LongestMatch(const u_char* bv, int n)
 	{
+	// Use -1 to indicate no match.
+	int last_accept = -1;
+
+	if ( table )
+		{
+		int s = table->Xtion(table->StartState(), ecs[SYM_BOL]);
+
+		if ( s == DFA_Table::JAM )
+			return -1;
+
+		if ( table->Accepts(s) )
+			last_accept = 0;
+
+		for ( int i = 0; i < n; ++i )
+			{
+			s = table->Xtion(s, ecs[bv[i]]);
+
+			if ( s == DFA_Table::JAM )
+				return last_accept;
+
+			if ( table->Accepts(s) )
+				last_accept = i + 1;
+			}
+
+		s = table->Xtion(s, ecs[SYM_EOL]);
+
+		if ( s != DFA_Table::JAM && table->Accepts(s) )
+			return n;
+
+		return last_accept;
+		}
+
 	if ( ! dfa )
 		// An empty pattern matches anything.
 		return 0;
 
-	// Use -1 to indicate no match.
-	int last_accept = -1;
 	DFA_State* d = dfa->StartState();
 
 	d = d->Xtion(ecs[SYM_BOL], dfa);
@@ -437,6 +679,7 @@ unsigned int Specific_RE_Matcher::MemoryAllocation() const
 		+ ccl_list.MemoryAllocation() - padded_sizeof(ccl_list)
 		+ equiv_class.Size() - padded_sizeof(EquivClass)
 		+ (dfa ? dfa->MemoryAllocation() : 0) // this is ref counted; consider the bytes here?
+		+ (table ? table->MemoryAllocation() : 0)
 		+ padded_sizeof(*any_ccl)
 		+ padded_sizeof(*accepted) // NOLINT(bugprone-sizeof-container)
 		+ accepted->size() * padded_sizeof(AcceptingSet::key_type);
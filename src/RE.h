@@ -11,6 +11,7 @@
 #include "zeek/List.h"
 #include "zeek/CCL.h"
 #include "zeek/EquivClass.h"
+#include "zeek/DFATable.h"
 
 typedef int (*cce_func)(int);
 
@@ -94,7 +95,8 @@ public:
 	// 'idx' contains indizes associated with the expressions.
 	// On matching, the set of indizes is returned which correspond
 	// to the matching expressions.  (idx must not contain zeros).
-	bool CompileSet(const string_list& set, const int_list& idx);
+	// With precompile, the set's DFA gets precompiled if that's enabled.
+	bool CompileSet(const string_list& set, const int_list& idx, bool precompile = false);
 
 	// Returns the position in s just beyond where the first match
 	// occurs, or 0 if there is no such position in s.  Note that
@@ -109,9 +111,43 @@ public:
 
 	EquivClass* EC()		{ return &equiv_class; }
 
+	// Maps input symbols to equivalence classes.  Unlike EC(), this
+	// also works for matchers loaded from a precompilation cache.
+	const int* ECs() const		{ return ecs; }
+
 	const char* PatternText() const	{ return pattern_text; }
 
+	// Exactly one of these is set once the matcher has been compiled,
+	// unless it's empty: the DFA computes its states on demand, the
+	// table has them all precomputed.
 	DFA_Machine* DFA() const		{ return dfa; }
+	const DFA_Table* Table() const		{ return table; }
+
+	/**
+	 * Computes the complete DFA up front, if it doesn't exceed the state
+	 * budget set with EnablePrecompilation().  Loads it from, or saves
+	 * it to, the cache directory if there is one.
+	 * @return true if the matcher now uses a precomputed table
+	 */
+	bool Precompile();
+
+	/**
+	 * Precompiles all existing matchers.  Of those compiled later, only
+	 * sets that ask for it get precompiled, so that patterns built at
+	 * run-time don't stall processing or fill up the cache.
+	 * @param max_states  the state budget for each matcher's DFA
+	 * @param cache_dir  directory for caching precompiled DFAs across
+	 * runs, or empty for none
+	 */
+	static void EnablePrecompilation(int max_states, const std::string& cache_dir);
+
+	struct PrecompileStats {
+		unsigned int precompiled;	// # of matchers now using a table
+		unsigned int loaded;	// # of those loaded from the cache
+		unsigned int over_budget;	// # left computing states on demand
+	};
+
+	static const PrecompileStats& GetPrecompileStats()	{ return precompile_stats; }
 
 	void Dump(FILE* f);
 
@@ -129,6 +165,9 @@ protected:
 	bool MatchAll(const u_char* bv, int n);
 	int Match(const u_char* bv, int n);
 
+	// Uses a cached table for the current cache_key, if any.
+	bool LoadPrecompiled();
+
 	match_type mt;
 	int multiline;
 	char* pattern_text;
@@ -137,10 +176,23 @@ protected:
 	std::map<std::string, CCL*> ccl_dict;
 	PList<CCL> ccl_list;
 	EquivClass equiv_class;
-	int* ecs;
+	const int* ecs;
 	DFA_Machine* dfa;
+	DFA_Table* table;
 	CCL* any_ccl;
 	AcceptingSet* accepted;
+
+	// Identifies the compiled expressions in the precompilation cache.
+	std::string cache_key;
+
+	// All matchers, for precompiling those that exist already.
+	Specific_RE_Matcher* prev_matcher;
+	Specific_RE_Matcher* next_matcher;
+	static Specific_RE_Matcher* all_matchers;
+
+	static int precompile_max_states;	// 0 if disabled
+	static std::string precompile_cache_dir;
+	static PrecompileStats precompile_stats;
 };
 
 class RE_Match_State {
@@ -148,9 +200,11 @@ public:
 	explicit RE_Match_State(Specific_RE_Matcher* matcher)
 		{
 		dfa = matcher->DFA() ? matcher->DFA() : nullptr;
-		ecs = matcher->EC()->EquivClasses();
+		table = matcher->Table();
+		ecs = matcher->ECs();
 		current_pos = -1;
 		current_state = nullptr;
+		current_xstate = DFA_Table::JAM;
 		}
 
 	const AcceptingMatchSet& AcceptedMatches() const
@@ -167,17 +221,24 @@ public:
 		{
 		current_pos = -1;
 		current_state = nullptr;
+		current_xstate = DFA_Table::JAM;
 		accepted_matches.clear();
 		}
 
 	void AddMatches(const AcceptingSet& as, MatchPos position);
+	void AddMatches(const int32_t* begin, const int32_t* end, MatchPos position);
 
 protected:
+	// Match() for precompiled tables.
+	bool MatchTable(const u_char* bv, int n, bool bol, bool eol, bool clear);
+
 	DFA_Machine* dfa;
-	int* ecs;
+	const DFA_Table* table;
+	const int* ecs;
 
 	AcceptingMatchSet accepted_matches;
 	DFA_State* current_state;
+	int current_xstate;	// current state when using the table
 	int current_pos;
 };
 
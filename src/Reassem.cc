@@ -6,6 +6,7 @@
 #include <algorithm>
 
 #include "zeek/Desc.h"
+#include "zeek/NetVar.h"
 
 using std::min;
 
@@ -13,12 +14,76 @@ namespace zeek {
 
 uint64_t Reassembler::total_size = 0;
 uint64_t Reassembler::sizes[REASSEM_NUM];
+Reassembler* Reassembler::active_head = nullptr;
+Reassembler* Reassembler::active_tail = nullptr;
+size_t Reassembler::num_active = 0;
+std::vector<Reassembler*>* Reassembler::shed_victims = nullptr;
+uint64_t Reassembler::num_shed = 0;
+uint64_t Reassembler::bytes_shed = 0;
+
+namespace detail {
+
+ReassemblyBufferPool::FreeBuffer*
+ReassemblyBufferPool::free_lists[MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1];
+uint64_t ReassemblyBufferPool::cached_bytes = 0;
+
+int ReassemblyBufferPool::SizeClass(uint64_t size)
+	{
+	int shift = MIN_CLASS_SHIFT;
+
+	while ( (uint64_t(1) << shift) < size )
+		++shift;
+
+	return shift - MIN_CLASS_SHIFT;
+	}
+
+u_char* ReassemblyBufferPool::Allocate(uint64_t size)
+	{
+	if ( size > (uint64_t(1) << MAX_CLASS_SHIFT) )
+		return new u_char[size];
+
+	int c = SizeClass(size);
+
+	if ( auto fb = free_lists[c] )
+		{
+		free_lists[c] = fb->next;
+		cached_bytes -= uint64_t(1) << (c + MIN_CLASS_SHIFT);
+		return reinterpret_cast<u_char*>(fb);
+		}
+
+	return new u_char[uint64_t(1) << (c + MIN_CLASS_SHIFT)];
+	}
+
+void ReassemblyBufferPool::Release(u_char* buf, uint64_t size)
+	{
+	if ( size > (uint64_t(1) << MAX_CLASS_SHIFT) )
+		{
+		delete [] buf;
+		return;
+		}
+
+	int c = SizeClass(size);
+	uint64_t class_size = uint64_t(1) << (c + MIN_CLASS_SHIFT);
+
+	if ( cached_bytes + class_size > MAX_CACHED_BYTES )
+		{
+		delete [] buf;
+		return;
+		}
+
+	auto fb = reinterpret_cast<FreeBuffer*>(buf);
+	fb->next = free_lists[c];
+	free_lists[c] = fb;
+	cached_bytes += class_size;
+	}
+
+} // namespace detail
 
 DataBlock::DataBlock(const u_char* data, uint64_t size, uint64_t arg_seq)
 	{
 	seq = arg_seq;
 	upper = seq + size;
-	block = new u_char[size];
+	block = detail::ReassemblyBufferPool::Allocate(size);
 	memcpy(block, data, size);
 	}
 
@@ -124,8 +189,9 @@ DataBlockList::Insert(uint64_t seq, uint64_t upper, const u_char* data,
 
 	const auto& last = block_map.rbegin()->second;
 
-	// Special check for the common case of appending to the end.
-	if ( seq == last.upper )
+	// Special check for the common case of appending to the end,
+	// directly or past a hole.
+	if ( seq >= last.upper )
 		return Insert(seq, upper, data, block_map.end());
 
 	// Find the first block that doesn't come completely before the new data.
@@ -282,8 +348,9 @@ void Reassembler::CheckOverlap(const DataBlockList& list,
 
 	const auto& last = list.LastBlock();
 
-	if ( seq == last.upper )
-		// Special case check for common case of appending to the end.
+	if ( seq >= last.upper )
+		// Special case check for common case of appending to the end
+		// (or past a hole), which can't overlap anything.
 		return;
 
 	uint64_t upper = (seq + len);
@@ -347,7 +414,15 @@ void Reassembler::NewBlock(double t, uint64_t seq, uint64_t len, const u_char* d
 		len -= amount_old;
 		}
 
-	auto it = block_list.Insert(seq, upper_seq, data);;
+	// In-order data with no hole in front of it may not need buffering.
+	if ( seq == last_reassem_seq && block_list.Empty() &&
+	     DeliverUnbuffered(seq, len, data) )
+		return;
+
+	if ( detail::reassembly_memory_high_water )
+		Activate();
+
+	auto it = block_list.Insert(seq, upper_seq, data);
 	BlockInserted(it);
 	}
 
@@ -371,6 +446,149 @@ uint64_t Reassembler::TotalSize() const
 	return block_list.DataSize() + old_block_list.DataSize();
 	}
 
+void Reassembler::CheckMemoryBudget()
+	{
+	uint64_t high = detail::reassembly_memory_high_water;
+
+	if ( ! high || total_size <= high )
+		return;
+
+	uint64_t low = detail::reassembly_memory_low_water;
+
+	if ( ! low || low > high )
+		low = high - high / 4;
+
+	// Delivering what a victim skips ahead to can make others buffer
+	// more, so don't go on beyond what was on the list to begin with.
+	if ( ! detail::reassembly_shed_largest_first )
+		{
+		for ( size_t n = num_active; n > 0 && total_size > low && active_head; --n )
+			active_head->Shed();
+
+		return;
+		}
+
+	// Order the victims by size once, rather than searching for the
+	// largest one each time.  Shedding may delete reassemblers other
+	// than the victim, so they clear their slot when leaving the list.
+	std::vector<std::pair<uint64_t, Reassembler*>> by_size;
+	by_size.reserve(num_active);
+
+	for ( auto r = active_head; r; r = r->next_active )
+		by_size.emplace_back(r->TotalSize(), r);
+
+	std::stable_sort(by_size.begin(), by_size.end(),
+	                 [](const auto& a, const auto& b) { return a.first > b.first; });
+
+	std::vector<Reassembler*> victims;
+	victims.reserve(by_size.size());
+
+	for ( const auto& v : by_size )
+		{
+		v.second->shed_slot = victims.size();
+		victims.push_back(v.second);
+		}
+
+	shed_victims = &victims;
+
+	for ( auto& victim : victims )
+		{
+		if ( total_size <= low )
+			break;
+
+		if ( victim )
+			victim->Shed();
+		}
+
+	for ( auto victim : victims )
+		if ( victim )
+			victim->shed_slot = -1;
+
+	shed_victims = nullptr;
+	}
+
+void Reassembler::Shed()
+	{
+	// Shedding may delete us, so we leave the list first.
+	Deactivate();
+
+	if ( TotalSize() == 0 )
+		// Everything got delivered since we last buffered data.
+		return;
+
+	uint64_t before = total_size;
+
+	++num_shed;
+	ShedBuffers();
+
+	if ( total_size < before )
+		bytes_shed += before - total_size;
+	}
+
+void Reassembler::ShedBuffers()
+	{
+	ClearBlocks();
+	ClearOldBlocks();
+	}
+
+void Reassembler::Activate()
+	{
+	if ( active )
+		{
+		if ( ! next_active )
+			return;
+
+		// Move to the end of the list.
+		next_active->prev_active = prev_active;
+
+		if ( prev_active )
+			prev_active->next_active = next_active;
+		else
+			active_head = next_active;
+		}
+	else
+		{
+		active = true;
+		++num_active;
+		}
+
+	prev_active = active_tail;
+	next_active = nullptr;
+
+	if ( active_tail )
+		active_tail->next_active = this;
+	else
+		active_head = this;
+
+	active_tail = this;
+	}
+
+void Reassembler::Deactivate()
+	{
+	if ( ! active )
+		return;
+
+	if ( prev_active )
+		prev_active->next_active = next_active;
+	else
+		active_head = next_active;
+
+	if ( next_active )
+		next_active->prev_active = prev_active;
+	else
+		active_tail = prev_active;
+
+	prev_active = next_active = nullptr;
+	active = false;
+	--num_active;
+
+	if ( shed_slot >= 0 )
+		{
+		(*shed_victims)[shed_slot] = nullptr;
+		shed_slot = -1;
+		}
+	}
+
 void Reassembler::Describe(ODesc* d) const
 	{
 	d->Add("reassembler");
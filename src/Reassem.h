@@ -7,6 +7,7 @@
 #include <sys/types.h> // for u_char
 #include <cstdint>
 #include <map>
+#include <vector>
 
 #include "zeek/Obj.h"
 
@@ -26,6 +27,43 @@ enum ReassemblerType {
 
 class Reassembler;
 
+namespace detail {
+
+/**
+ * Supplies the buffers holding reassembly data.  Buffers come in
+ * power-of-two size classes, and released ones go onto per-class free
+ * lists for reuse rather than back to malloc, as long as the pool holds
+ * less than MAX_CACHED_BYTES.  Blocks are mostly segment-sized and come
+ * and go at packet rate, which otherwise makes them an allocator hot spot.
+ */
+class ReassemblyBufferPool {
+public:
+	static u_char* Allocate(uint64_t size);
+	static void Release(u_char* buf, uint64_t size);
+
+	/**
+	 * @return the number of bytes held in the free lists.
+	 */
+	static uint64_t CachedBytes()
+		{ return cached_bytes; }
+
+	static constexpr int MIN_CLASS_SHIFT = 6;	// 64 bytes
+	static constexpr int MAX_CLASS_SHIFT = 16;	// 64 KB; larger ones use new[]
+	static constexpr uint64_t MAX_CACHED_BYTES = 4 * 1024 * 1024;
+
+private:
+	struct FreeBuffer {
+		FreeBuffer* next;
+	};
+
+	static int SizeClass(uint64_t size);
+
+	static FreeBuffer* free_lists[MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1];
+	static uint64_t cached_bytes;
+};
+
+} // namespace detail
+
 /**
  * A block/segment of data for use in the reassembly process.
  */
@@ -42,7 +80,7 @@ public:
 		seq = other.seq;
 		upper = other.upper;
 		auto size = other.Size();
-		block = new u_char[size];
+		block = detail::ReassemblyBufferPool::Allocate(size);
 		memcpy(block, other.block, size);
 		}
 
@@ -59,11 +97,11 @@ public:
 		if ( this == &other )
 			return *this;
 
+		ReleaseBlock();
 		seq = other.seq;
 		upper = other.upper;
 		auto size = other.Size();
-		delete [] block;
-		block = new u_char[size];
+		block = detail::ReassemblyBufferPool::Allocate(size);
 		memcpy(block, other.block, size);
 		return *this;
 		}
@@ -73,16 +111,16 @@ public:
 		if ( this == &other )
 			return *this;
 
+		ReleaseBlock();
 		seq = other.seq;
 		upper = other.upper;
-		delete [] block;
 		block = other.block;
 		other.block = nullptr;
 		return *this;
 		}
 
 	~DataBlock()
-		{ delete [] block; }
+		{ ReleaseBlock(); }
 
 	/**
 	 * @return length of the data block
@@ -93,6 +131,15 @@ public:
 	uint64_t seq;
 	uint64_t upper;
 	u_char* block;
+
+private:
+	// The pool needs the size a buffer was allocated with, so seq and
+	// upper must not change while the block holds a buffer.
+	void ReleaseBlock()
+		{
+		if ( block )
+			detail::ReassemblyBufferPool::Release(block, Size());
+		}
 };
 
 using DataBlockMap = std::map<uint64_t, DataBlock>;
@@ -254,7 +301,7 @@ private:
 class Reassembler : public Obj {
 public:
 	Reassembler(uint64_t init_seq, ReassemblerType reassem_type = REASSEM_UNKNOWN);
-	~Reassembler() override	{}
+	~Reassembler() override	{ Deactivate(); }
 
 	void NewBlock(double t, uint64_t seq, uint64_t len, const u_char* data);
 
@@ -289,12 +336,41 @@ public:
 
 	void SetMaxOldBlocks(uint32_t count)	{ max_old_blocks = count; }
 
+	// If all reassemblers together buffer more than
+	// reassembly_memory_high_water bytes, has them shed their data
+	// until they're down to reassembly_memory_low_water.  Call only
+	// where no reassembler is in the middle of processing data.
+	static void CheckMemoryBudget();
+
+	// Number of times a reassembler shed its data to stay within the
+	// memory budget, and the amount of data that released.
+	static uint64_t NumShed()	{ return num_shed; }
+	static uint64_t BytesShed()	{ return bytes_shed; }
+
 protected:
 
 	friend class DataBlockList;
 
 	virtual void Undelivered(uint64_t up_to_seq);
 
+	/**
+	 * Offered data that directly continues what's been delivered so far
+	 * while nothing is buffered.  A reassembler that would release such
+	 * data right after delivering it can deliver it straight from the
+	 * caller's buffer, skipping the copy into a block, and return true.
+	 * If it returns false, NewBlock() buffers the data as usual.
+	 */
+	virtual bool DeliverUnbuffered(uint64_t seq, uint64_t len, const u_char* data)
+		{ return false; }
+
+	/**
+	 * Gives up all buffered data because reassemblers together exceed
+	 * their memory budget.  The default discards it.  Reassemblers that
+	 * can should instead skip over any holes and deliver what's buffered
+	 * behind them.  May delete the reassembler.
+	 */
+	virtual void ShedBuffers();
+
 	virtual void BlockInserted(DataBlockMap::const_iterator it) = 0;
 	virtual void Overlap(const u_char* b1, const u_char* b2, uint64_t n) = 0;
 
@@ -312,6 +388,32 @@ protected:
 
 	static uint64_t total_size;
 	static uint64_t sizes[REASSEM_NUM];
+
+private:
+	// While a memory budget is set, reassemblers that received data
+	// to buffer are kept on a list from least to most recently active
+	// so that shedding can pick its victims without a search.
+	void Activate();
+	void Deactivate();
+
+	// Leaves the list and sheds the buffered data.  May delete the
+	// reassembler.
+	void Shed();
+
+	Reassembler* prev_active = nullptr;
+	Reassembler* next_active = nullptr;
+	bool active = false;
+
+	// While shedding largest first, our index in shed_victims.
+	int shed_slot = -1;
+
+	static Reassembler* active_head;
+	static Reassembler* active_tail;
+	static size_t num_active;
+	static std::vector<Reassembler*>* shed_victims;
+
+	static uint64_t num_shed;
+	static uint64_t bytes_shed;
 };
 
 } // namespace zeek
@@ -23,6 +23,7 @@
 #include "zeek/Var.h"
 #include "zeek/IPAddr.h"
 #include "zeek/RunState.h"
+#include "zeek/RulePrefilter.h"
 
 using namespace std;
 
@@ -227,6 +228,9 @@ RuleMatcher::RuleMatcher(int arg_RE_level)
 	RE_level = arg_RE_level;
 	parse_error = false;
 	has_non_file_magic_rule = false;
+
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		prefilters[i] = nullptr;
 	}
 
 RuleMatcher::~RuleMatcher()
@@ -238,6 +242,9 @@ RuleMatcher::~RuleMatcher()
 
 	for ( auto rule : rules )
 		delete rule;
+
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		delete prefilters[i];
 	}
 
 void RuleMatcher::Delete(RuleHdrTest* node)
@@ -285,6 +292,18 @@ bool RuleMatcher::ReadFiles(const std::vector<std::string>& files)
 	int_list ids[Rule::TYPES];
 	BuildRegEx(root, exprs, ids);
 
+	for ( int i = 0; i < Rule::TYPES; ++i )
+		{
+		if ( ! prefilters[i] )
+			continue;
+
+		prefilters[i]->Compile();
+
+		DBG_LOG(DBG_RULES, "%s prefilter: %d groups, %d states",
+		        Rule::TypeToString((Rule::PatternType) i),
+		        prefilters[i]->NumGroups(), prefilters[i]->NumStates());
+		}
+
 	return ! parse_error;
 	}
 
@@ -401,7 +420,8 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 		{
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			if ( exprs[i].length() )
-				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i],
+				                 (Rule::PatternType) i);
 		}
 
 	// Get the patterns on all of our children.
@@ -428,21 +448,70 @@ void RuleMatcher::BuildRegEx(RuleHdrTest* hdr_test, string_list* exprs,
 		{
 		for ( int i = 0; i < Rule::TYPES; ++i )
 			if ( exprs[i].length() )
-				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i]);
+				BuildPatternSets(&hdr_test->psets[i], exprs[i], ids[i],
+				                 (Rule::PatternType) i);
 		}
 
 	// If we're below the RE_level, the regexprs remains empty.
 	}
 
 void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
-                                   const string_list& exprs, const int_list& ids)
+                                   const string_list& exprs, const int_list& ids,
+                                   Rule::PatternType type)
 	{
 	assert(static_cast<size_t>(exprs.length()) == ids.size());
 
+	if ( ! sig_prefilter || type == Rule::FILE_MAGIC )
+		{
+		BuildPatternGroups(dst, exprs, ids, type, nullptr);
+		return;
+		}
+
+	// Keep patterns that can wait for a literal apart from the others,
+	// so that their groups can be prefiltered.
+	string_list filtered_exprs, other_exprs;
+	int_list filtered_ids, other_ids;
+	std::vector<std::vector<std::string>> literals;
+
+	loop_over_list(exprs, i)
+		{
+		std::vector<std::string> l;
+
+		if ( Prefilterable(exprs[i], ids[i], &l) )
+			{
+			filtered_exprs.push_back(exprs[i]);
+			filtered_ids.push_back(ids[i]);
+			literals.push_back(std::move(l));
+			}
+		else
+			{
+			other_exprs.push_back(exprs[i]);
+			other_ids.push_back(ids[i]);
+			}
+		}
+
+	if ( other_exprs.length() )
+		BuildPatternGroups(dst, other_exprs, other_ids, type, nullptr);
+
+	if ( filtered_exprs.length() )
+		{
+		if ( ! prefilters[type] )
+			prefilters[type] = new RulePrefilter();
+
+		BuildPatternGroups(dst, filtered_exprs, filtered_ids, type, &literals);
+		}
+	}
+
+void RuleMatcher::BuildPatternGroups(RuleHdrTest::pattern_set_list* dst,
+                                     const string_list& exprs, const int_list& ids,
+                                     Rule::PatternType type,
+                                     const std::vector<std::vector<std::string>>* literals)
+	{
 	// We build groups of at most sig_max_group_size regexps.
 
 	string_list group_exprs;
 	int_list group_ids;
+	std::vector<std::string> group_literals;
 
 	for ( int i = 0; i < exprs.length() + 1 /* sic! */; i++ )
 		{
@@ -450,6 +519,11 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
 			{
 			group_exprs.push_back(exprs[i]);
 			group_ids.push_back(ids[i]);
+
+			if ( literals )
+				group_literals.insert(group_literals.end(),
+				                      (*literals)[i].begin(),
+				                      (*literals)[i].end());
 			}
 
 		if ( group_exprs.length() > sig_max_group_size ||
@@ -458,13 +532,18 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
 			RuleHdrTest::PatternSet* set =
 				new RuleHdrTest::PatternSet;
 			set->re = new Specific_RE_Matcher(MATCH_EXACTLY, 1);
-			set->re->CompileSet(group_exprs, group_ids);
+			set->re->CompileSet(group_exprs, group_ids, true);
 			set->patterns = group_exprs;
 			set->ids = group_ids;
+
+			if ( literals )
+				set->prefilter_group = prefilters[type]->AddGroup(group_literals);
+
 			dst->push_back(set);
 
 			group_exprs.clear();
 			group_ids.clear();
+			group_literals.clear();
 			}
 		}
 	}
@@ -635,6 +714,18 @@ RuleFileMagicState* RuleMatcher::InitFileMagic() const
 	return state;
 	}
 
+bool RuleMatcher::Prefilterable(const char* expr, int id,
+                                std::vector<std::string>* literals)
+	{
+	// Depth limits are checked against positions that wouldn't
+	// count data skipped by the prefilter.
+	for ( const auto& p : Rule::rule_table[id - 1]->patterns )
+		if ( p->id == id && (p->offset != 0 || p->depth != INT_MAX) )
+			return false;
+
+	return RulePrefilter::ExtractLiterals(expr, literals);
+	}
+
 bool RuleMatcher::AllRulePatternsMatched(const Rule* r, MatchPos matchpos,
                                          const AcceptingMatchSet& ams)
 	{
@@ -782,7 +873,12 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer,
 					auto* m = new RuleEndpointState::Matcher;
 					m->state = new RE_Match_State(set->re);
 					m->type = (Rule::PatternType) i;
+					m->prefilter_group = set->prefilter_group;
+					m->dormant = set->prefilter_group >= 0;
 					state->matchers.push_back(m);
+
+					if ( m->dormant )
+						++state->prefilter_states[i].dormant;
 					}
 				}
 			}
@@ -891,15 +987,70 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type,
 			state->payload_size = 0;
 		}
 
+	RulePrefilter* prefilter = prefilters[type];
+	auto& ps = state->prefilter_states[type];
+
+	if ( prefilter && clear )
+		{
+		// The matchers start over, so they can wait for their
+		// literals again.
+		ps.stream.Clear();
+		ps.dormant = 0;
+
+		for ( const auto& m : state->matchers )
+			if ( m->type == type && m->prefilter_group >= 0 )
+				{
+				m->dormant = true;
+				++ps.dormant;
+				}
+		}
+
+	if ( prefilter && ps.dormant )
+		prefilter->Scan(&ps.stream, data, data_len);
+
 	// Feed data into all relevant matchers.
 	for ( const auto& m : state->matchers )
 		{
-		if ( m->type == type &&
-		     m->state->Match((const u_char*) data, data_len,
+		if ( m->type != type )
+			continue;
+
+		if ( m->dormant )
+			{
+			if ( ! prefilter->Hit(m->prefilter_group) )
+				continue;
+
+			// Start matching with the bytes the literal may have
+			// begun in.  Anything before doesn't matter as the
+			// patterns begin with ".*".
+			m->dormant = false;
+			--ps.dormant;
+
+			bool restart = true;
+
+			if ( ps.stream.tail_len )
+				{
+				if ( m->state->Match(ps.stream.tail, ps.stream.tail_len,
+				                     false, false, true) )
+					newmatch = true;
+
+				restart = false;
+				}
+
+			if ( m->state->Match((const u_char*) data, data_len,
+			                     bol, eol, restart) )
+				newmatch = true;
+
+			continue;
+			}
+
+		if ( m->state->Match((const u_char*) data, data_len,
 					bol, eol, clear) )
 			newmatch = true;
 		}
 
+	if ( prefilter && ps.dormant )
+		RulePrefilter::UpdateTail(&ps.stream, data, data_len);
+
 	// If no new match found, we're already done.
 	if ( ! newmatch )
 		return;
@@ -1126,8 +1277,22 @@ void RuleMatcher::ClearEndpointState(RuleEndpointState* state)
 
 	state->payload_size = -1;
 
+	for ( auto& ps : state->prefilter_states )
+		{
+		ps.stream.Clear();
+		ps.dormant = 0;
+		}
+
 	for ( const auto& matcher : state->matchers )
+		{
 		matcher->state->Clear();
+
+		if ( matcher->prefilter_group >= 0 )
+			{
+			matcher->dormant = true;
+			++state->prefilter_states[matcher->type].dormant;
+			}
+		}
 	}
 
 void RuleMatcher::ClearFileMagicState(RuleFileMagicState* state) const
@@ -1214,6 +1379,19 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test)
 			assert(set->re);
 
 			++stats->matchers;
+
+			if ( const DFA_Table* t = set->re->Table() )
+				{
+				// Precompiled, so everything's computed.
+				stats->dfa_states += t->NumStates();
+				stats->computed += t->NumStates() * t->NumClasses();
+				stats->mem += t->MemoryAllocation();
+				continue;
+				}
+
+			if ( ! set->re->DFA() )
+				continue;
+
 			set->re->DFA()->Cache()->GetStats(&cstats);
 
 			stats->dfa_states += cstats.dfa_states;
@@ -1256,9 +1434,15 @@ void RuleMatcher::DumpStateStats(File* f, RuleHdrTest* hdr_test)
 			RuleHdrTest::PatternSet* set = hdr_test->psets[i][j];
 			assert(set->re);
 
+			int num_states = 0;
+
+			if ( set->re->Table() )
+				num_states = set->re->Table()->NumStates();
+			else if ( set->re->DFA() )
+				num_states = set->re->DFA()->NumStates();
+
 			f->Write(util::fmt("%.6f %d DFA states in %s group %d from sigs ",
-			                   run_state::network_time,
-			                   set->re->DFA()->NumStates(),
+			                   run_state::network_time, num_states,
 			                   Rule::TypeToString((Rule::PatternType)i), j));
 
 			for ( const auto& id : set->ids )
@@ -12,6 +12,7 @@
 #include "zeek/Rule.h"
 #include "zeek/RE.h"
 #include "zeek/CCL.h"
+#include "zeek/RulePrefilter.h"
 
 //#define MATCHER_PRINT_STATS
 
@@ -107,7 +108,7 @@ private:
 	friend class RuleMatcher;
 
 	struct PatternSet {
-		PatternSet() : re() {}
+		PatternSet() : re(), prefilter_group(-1) {}
 
 		// If we're above the 'RE_level' (see RuleMatcher), this
 		// expr contains all patterns on this node. If we're on
@@ -118,6 +119,10 @@ private:
 		// All the patterns and their rule indices.
 		string_list patterns;
 		int_list ids;	// (only needed for debugging)
+
+		// The set's group in its type's RulePrefilter, or -1 if
+		// the set needs to see all data.
+		int prefilter_group;
 	};
 
 	using pattern_set_list = PList<PatternSet>;
@@ -167,10 +172,17 @@ private:
 	struct Matcher {
 		RE_Match_State* state;
 		Rule::PatternType type;
+		int prefilter_group;
+		bool dormant;	// waiting for one of its group's literals
 	};
 
 	using matcher_list = PList<Matcher>;
 
+	struct PrefilterState {
+		RulePrefilter::StreamState stream;
+		int dormant = 0;	// # of dormant matchers of the type
+	};
+
 	analyzer::Analyzer* analyzer;
 	RuleEndpointState* opposite;
 	analyzer::pia::PIA* pia;
@@ -184,6 +196,8 @@ private:
 	rule_list matched_by_patterns;
 	bstr_list matched_text;
 
+	PrefilterState prefilter_states[Rule::TYPES];
+
 	int payload_size;
 	bool is_orig;
 
@@ -329,7 +343,16 @@ private:
 
 	// Build groups of regular epxressions.
 	void BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
-				const string_list& exprs, const int_list& ids);
+				const string_list& exprs, const int_list& ids,
+				Rule::PatternType type);
+
+	// Helper for BuildPatternSets().  If literals is given, it holds
+	// those of each expression, and the groups go into the type's
+	// prefilter.
+	void BuildPatternGroups(RuleHdrTest::pattern_set_list* dst,
+				const string_list& exprs, const int_list& ids,
+				Rule::PatternType type,
+				const std::vector<std::vector<std::string>>* literals);
 
 	// Check an arbitrary rule if it's satisfied right now.
 	// eos signals end of stream
@@ -356,6 +379,11 @@ private:
 
 	void DumpStateStats(File* f, RuleHdrTest* hdr_test);
 
+	// Returns true if a pattern can wait for one of its literals
+	// before matching; if so, fills in the literals.
+	static bool Prefilterable(const char* expr, int id,
+	                          std::vector<std::string>* literals);
+
 	static bool AllRulePatternsMatched(const Rule* r, MatchPos matchpos,
 	                                   const AcceptingMatchSet& ams);
 
@@ -365,6 +393,9 @@ private:
 	RuleHdrTest* root;
 	rule_list rules;
 	rule_dict rules_by_id;
+
+	// Literal prefilters, if enabled by sig_prefilter.
+	RulePrefilter* prefilters[Rule::TYPES];
 };
 
 // Keeps bi-directional matching-state.
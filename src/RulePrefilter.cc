@@ -0,0 +1,594 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+#include "zeek/RulePrefilter.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+namespace zeek::detail {
+
+namespace {
+
+// Bounds the number of literals a single pattern may expand into
+// through alternations.
+constexpr size_t MAX_ALTERNATIVES = 32;
+
+struct Prefix {
+	std::string text;
+	bool open;	// whether the pattern may still extend it
+};
+
+using Prefixes = std::vector<Prefix>;
+
+// Collects the literals that a regular expression must start with.
+// Anything beyond plain characters, escapes, quoted strings, classes of
+// a letter in both cases, and groups of these ends a literal; anything
+// the parser can't make sense of disqualifies the pattern.
+class LiteralParser {
+public:
+	explicit LiteralParser(const char* arg_p) : p(arg_p)	{ }
+
+	const char* Pos() const	{ return p; }
+
+	// Parses alternatives up to an unmatched ')' or the end.  At the
+	// top level, alternatives don't share the pattern's leading ".*",
+	// so they disqualify it.
+	bool Alternatives(Prefixes* result, bool top_level)
+		{
+		for ( ; ; )
+			{
+			if ( ! Sequence(result) )
+				return false;
+
+			if ( *p != '|' )
+				break;
+
+			if ( top_level )
+				return false;
+
+			++p;
+			}
+
+		return result->size() <= MAX_ALTERNATIVES;
+		}
+
+private:
+	bool Sequence(Prefixes* result)
+		{
+		Prefixes prefixes{{"", true}};
+
+		while ( *p && *p != '|' && *p != ')' )
+			{
+			if ( ! AnyOpen(prefixes) )
+				{
+				if ( ! SkipBranch() )
+					return false;
+
+				break;
+				}
+
+			Prefixes atom;
+			bool literal = true;
+
+			switch ( *p ) {
+			case '(':
+				++p;
+
+				if ( *p == '?' )
+					{
+					if ( strncmp(p, "?i:", 3) != 0 )
+						return false;
+
+					p += 3;
+					}
+
+				if ( ! Alternatives(&atom, false) || *p != ')' )
+					return false;
+
+				++p;
+				break;
+
+			case '[':
+				{
+				int c = CaseClass();
+
+				if ( c >= 0 )
+					atom.push_back({std::string(1, c), true});
+
+				else if ( SkipClass() )
+					literal = false;
+
+				else
+					return false;
+				}
+				break;
+
+			case '"':
+				{
+				std::string s;
+
+				for ( ++p; *p && *p != '"'; ++p )
+					s += tolower(static_cast<u_char>(*p));
+
+				if ( ! *p )
+					return false;
+
+				++p;
+				atom.push_back({s, true});
+				}
+				break;
+
+			case '\\':
+				++p;
+				atom.push_back({std::string(1, tolower(Escape())), true});
+				break;
+
+			case '{':
+				{
+				// A named definition.
+				const char* end = strchr(p, '}');
+
+				if ( ! end )
+					return false;
+
+				p = end + 1;
+				literal = false;
+				}
+				break;
+
+			case '.':
+			case '^':
+			case '$':
+				++p;
+				literal = false;
+				break;
+
+			case '*':
+			case '+':
+			case '?':
+				return false;
+
+			default:
+				atom.push_back({std::string(1, tolower(static_cast<u_char>(*p))), true});
+				++p;
+				break;
+			}
+
+			// Whatever may occur zero times ends the literals, and
+			// so does whatever may repeat, after its first time.
+			bool optional = false;
+			bool repeats = false;
+
+			switch ( *p ) {
+			case '*':
+			case '?':
+				optional = true;
+				++p;
+				break;
+
+			case '+':
+				repeats = true;
+				++p;
+				break;
+
+			case '{':
+				if ( isdigit(static_cast<u_char>(p[1])) )
+					{
+					optional = atoi(p + 1) == 0;
+					repeats = true;
+
+					const char* end = strchr(p, '}');
+
+					if ( ! end )
+						return false;
+
+					p = end + 1;
+					}
+				break;
+			}
+
+			if ( ! literal || optional )
+				{
+				Close(&prefixes);
+				continue;
+				}
+
+			if ( ! Append(&prefixes, atom) )
+				return false;
+
+			if ( repeats )
+				Close(&prefixes);
+			}
+
+		result->insert(result->end(), prefixes.begin(), prefixes.end());
+		return true;
+		}
+
+	static bool AnyOpen(const Prefixes& prefixes)
+		{
+		for ( const auto& pf : prefixes )
+			if ( pf.open )
+				return true;
+
+		return false;
+		}
+
+	static void Close(Prefixes* prefixes)
+		{
+		for ( auto& pf : *prefixes )
+			pf.open = false;
+		}
+
+	static bool Append(Prefixes* prefixes, const Prefixes& atom)
+		{
+		Prefixes result;
+
+		for ( const auto& pf : *prefixes )
+			{
+			if ( ! pf.open )
+				{
+				result.push_back(pf);
+				continue;
+				}
+
+			for ( const auto& a : atom )
+				{
+				Prefix np{pf.text + a.text, a.open};
+
+				if ( np.text.size() >= RulePrefilter::MAX_LITERAL_LEN )
+					{
+					np.text.resize(RulePrefilter::MAX_LITERAL_LEN);
+					np.open = false;
+					}
+
+				result.push_back(std::move(np));
+				}
+			}
+
+		if ( result.size() > MAX_ALTERNATIVES )
+			return false;
+
+		*prefixes = std::move(result);
+		return true;
+		}
+
+	// Decodes the escape sequence following a backslash.
+	int Escape()
+		{
+		char c = *p++;
+
+		switch ( c ) {
+		case 'a': return '\a';
+		case 'b': return '\b';
+		case 'f': return '\f';
+		case 'n': return '\n';
+		case 'r': return '\r';
+		case 't': return '\t';
+		case 'v': return '\v';
+
+		case 'x':
+			{
+			int v = 0;
+
+			for ( int i = 0; i < 2 && isxdigit(static_cast<u_char>(*p)); ++i, ++p )
+				v = v * 16 + (isdigit(static_cast<u_char>(*p)) ? *p - '0' : tolower(*p) - 'a' + 10);
+
+			return v;
+			}
+
+		case '0': case '1': case '2': case '3':
+		case '4': case '5': case '6': case '7':
+			{
+			int v = c - '0';
+
+			for ( int i = 0; i < 2 && *p >= '0' && *p <= '7'; ++i, ++p )
+				v = v * 8 + (*p - '0');
+
+			return v & 0xff;
+			}
+
+		default:
+			return static_cast<u_char>(c);
+		}
+		}
+
+	// Returns the (lower-case) character that a class such as "[uU]"
+	// or "[x]" stands for, or -1 for any other class.
+	int CaseClass()
+		{
+		auto special = [](char c)
+			{ return c == '\0' || c == '\\' || c == '[' || c == ']' || c == '^' || c == '-'; };
+
+		if ( special(p[1]) )
+			return -1;
+
+		if ( p[2] == ']' )
+			{
+			int c = tolower(static_cast<u_char>(p[1]));
+			p += 3;
+			return c;
+			}
+
+		if ( ! special(p[2]) && p[3] == ']' &&
+		     tolower(static_cast<u_char>(p[1])) == tolower(static_cast<u_char>(p[2])) )
+			{
+			int c = tolower(static_cast<u_char>(p[1]));
+			p += 4;
+			return c;
+			}
+
+		return -1;
+		}
+
+	bool SkipClass()
+		{
+		++p;	// '['
+
+		if ( *p == '^' )
+			++p;
+
+		// The first character may be a ']'.
+		bool first = true;
+
+		while ( *p && (first || *p != ']') )
+			{
+			first = false;
+
+			if ( *p == '\\' && p[1] )
+				p += 2;
+
+			else if ( p[0] == '[' && p[1] == ':' )
+				{
+				const char* end = strstr(p + 2, ":]");
+
+				if ( ! end )
+					return false;
+
+				p = end + 2;
+				}
+
+			else
+				++p;
+			}
+
+		if ( ! *p )
+			return false;
+
+		++p;
+		return true;
+		}
+
+	// Skips to the end of the current alternative.
+	bool SkipBranch()
+		{
+		int depth = 0;
+
+		while ( *p )
+			{
+			switch ( *p ) {
+			case '\\':
+				if ( ! p[1] )
+					return false;
+
+				p += 2;
+				continue;
+
+			case '[':
+				if ( ! SkipClass() )
+					return false;
+
+				continue;
+
+			case '"':
+				p = strchr(p + 1, '"');
+
+				if ( ! p )
+					return false;
+
+				break;
+
+			case '(':
+				++depth;
+				break;
+
+			case ')':
+				if ( depth == 0 )
+					return true;
+
+				--depth;
+				break;
+
+			case '|':
+				if ( depth == 0 )
+					return true;
+
+				break;
+			}
+
+			++p;
+			}
+
+		return true;
+		}
+
+	const char* p;
+};
+
+} // namespace
+
+bool RulePrefilter::ExtractLiterals(const char* pattern, std::vector<std::string>* result)
+	{
+	std::string pat = pattern;
+
+	// Case-insensitive signature patterns come wrapped like this.
+	if ( pat.compare(0, 4, "(?i:") == 0 && pat.back() == ')' )
+		pat = pat.substr(4, pat.size() - 5);
+
+	if ( pat.compare(0, 2, ".*") != 0 )
+		return false;
+
+	const char* p = pat.c_str() + 2;
+
+	while ( strncmp(p, ".*", 2) == 0 )
+		p += 2;
+
+	LiteralParser parser(p);
+	Prefixes prefixes;
+
+	if ( ! parser.Alternatives(&prefixes, true) || *parser.Pos() )
+		return false;
+
+	std::vector<std::string> lits;
+
+	for ( const auto& pf : prefixes )
+		{
+		if ( pf.text.size() < MIN_LITERAL_LEN )
+			return false;
+
+		if ( std::find(lits.begin(), lits.end(), pf.text) == lits.end() )
+			lits.push_back(pf.text);
+		}
+
+	result->insert(result->end(), lits.begin(), lits.end());
+	return true;
+	}
+
+int RulePrefilter::AddGroup(const std::vector<std::string>& group_literals)
+	{
+	int group = num_groups++;
+
+	for ( const auto& l : group_literals )
+		literals.push_back({l, group});
+
+	return group;
+	}
+
+void RulePrefilter::Compile()
+	{
+	// Literals are in lower case; upper-case input maps to the same
+	// classes.
+	for ( const auto& l : literals )
+		for ( u_char c : l.text )
+			if ( ! classes[c] )
+				classes[c] = num_classes++;
+
+	for ( int c = 0; c < 256; ++c )
+		if ( isupper(c) )
+			classes[c] = classes[tolower(c)];
+
+	const int k = num_classes;
+
+	// Build the trie.
+	num_states = 1;
+	delta.assign(k, -1);
+	outputs.resize(1);
+
+	for ( const auto& l : literals )
+		{
+		int s = 0;
+
+		for ( u_char c : l.text )
+			{
+			int idx = s * k + classes[c];
+
+			if ( delta[idx] < 0 )
+				{
+				delta[idx] = num_states++;
+				delta.resize(num_states * k, -1);
+				outputs.emplace_back();
+				}
+
+			s = delta[idx];
+			}
+
+		if ( std::find(outputs[s].begin(), outputs[s].end(), l.group) == outputs[s].end() )
+			outputs[s].push_back(l.group);
+		}
+
+	// Turn it into a DFA by following failure links, breadth-first so
+	// that a state's failure state is always complete by the time we
+	// get to it.
+	std::vector<int> fail(num_states, 0);
+	std::vector<int> queue;
+
+	for ( int c = 0; c < k; ++c )
+		{
+		if ( delta[c] < 0 )
+			delta[c] = 0;
+		else
+			queue.push_back(delta[c]);
+		}
+
+	for ( size_t i = 0; i < queue.size(); ++i )
+		{
+		int s = queue[i];
+
+		for ( int g : outputs[fail[s]] )
+			if ( std::find(outputs[s].begin(), outputs[s].end(), g) == outputs[s].end() )
+				outputs[s].push_back(g);
+
+		for ( int c = 0; c < k; ++c )
+			{
+			int& t = delta[s * k + c];
+			int ft = delta[fail[s] * k + c];
+
+			if ( t < 0 )
+				t = ft;
+			else
+				{
+				fail[t] = ft;
+				queue.push_back(t);
+				}
+			}
+		}
+
+	has_output.resize(num_states);
+
+	for ( int s = 0; s < num_states; ++s )
+		has_output[s] = ! outputs[s].empty();
+
+	hit_scan.assign(num_groups, 0);
+	literals.clear();
+	}
+
+void RulePrefilter::Scan(StreamState* s, const u_char* data, int len)
+	{
+	++scan_id;
+
+	const int k = num_classes;
+	const int* d = delta.data();
+	int state = s->ac_state;
+
+	for ( int i = 0; i < len; ++i )
+		{
+		state = d[state * k + classes[data[i]]];
+
+		if ( has_output[state] )
+			for ( int g : outputs[state] )
+				hit_scan[g] = scan_id;
+		}
+
+	s->ac_state = state;
+	}
+
+void RulePrefilter::UpdateTail(StreamState* s, const u_char* data, int len)
+	{
+	constexpr int max_tail = MAX_LITERAL_LEN - 1;
+
+	if ( len >= max_tail )
+		{
+		memcpy(s->tail, data + len - max_tail, max_tail);
+		s->tail_len = max_tail;
+		return;
+		}
+
+	int keep = std::min(s->tail_len, max_tail - len);
+	memmove(s->tail, s->tail + s->tail_len - keep, keep);
+	memcpy(s->tail + keep, data, len);
+	s->tail_len = keep + len;
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,118 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * Literal prefilter for groups of signature patterns.  A group qualifies
+ * if all of its patterns float, i.e. start with ".*", and continue with
+ * one of a few literals.  Until one of these literals shows up in a
+ * stream, the group can't match, so its DFA doesn't need to see the
+ * data.  Once one does, the DFA starts over from the last few bytes
+ * before the current chunk, which, since ".*" absorbs anything before
+ * the literal, yields the same matches as having run all along.
+ *
+ * All qualifying groups of a pattern type share one Aho-Corasick
+ * automaton, so a chunk gets scanned once no matter how many groups
+ * are waiting for their literals.  The automaton ignores case: it may
+ * then report a literal that the pattern doesn't actually accept, but
+ * never misses one.
+ */
+class RulePrefilter {
+public:
+	// Literals are cut to this length, which also bounds how far back a
+	// group's DFA needs to start once a literal straddles two chunks.
+	static constexpr int MAX_LITERAL_LEN = 8;
+
+	// Shorter literals would show up too often to save much.
+	static constexpr int MIN_LITERAL_LEN = 3;
+
+	/**
+	 * Per-stream scanning state.
+	 */
+	struct StreamState {
+		void Clear()	{ ac_state = 0; tail_len = 0; }
+
+		int ac_state = 0;
+
+		// The last bytes scanned, for restarting a DFA.
+		u_char tail[MAX_LITERAL_LEN - 1];
+		int tail_len = 0;
+	};
+
+	/**
+	 * Determines the literals that any match of a signature pattern
+	 * must start with, if it's a floating one.
+	 * @param pattern  the pattern's regular expression
+	 * @param literals  receives the literals, case-folded
+	 * @return false if the pattern isn't suitable for prefiltering
+	 */
+	static bool ExtractLiterals(const char* pattern, std::vector<std::string>* literals);
+
+	/**
+	 * Adds a group of patterns that qualifies for prefiltering.  Must be
+	 * called before Compile().
+	 * @param literals  the union of its patterns' literals
+	 * @return the group's index
+	 */
+	int AddGroup(const std::vector<std::string>& literals);
+
+	/**
+	 * Builds the automaton once all groups have been added.
+	 */
+	void Compile();
+
+	int NumGroups() const	{ return num_groups; }
+	int NumStates() const	{ return num_states; }
+
+	/**
+	 * Scans the next chunk of a stream for literals.  Afterwards,
+	 * Hit() tells which groups' literals occurred, including ones
+	 * that began in earlier chunks.
+	 */
+	void Scan(StreamState* s, const u_char* data, int len);
+
+	/**
+	 * @return true if the most recent Scan() found a literal of the
+	 * given group.
+	 */
+	bool Hit(int group) const	{ return hit_scan[group] == scan_id; }
+
+	/**
+	 * Remembers the end of a chunk that's been scanned, for feeding
+	 * into a DFA that starts in the next.
+	 */
+	static void UpdateTail(StreamState* s, const u_char* data, int len);
+
+private:
+	struct Literal {
+		std::string text;
+		int group;
+	};
+
+	std::vector<Literal> literals;
+	int num_groups = 0;
+
+	// Byte to input class; class 0 stands for bytes in no literal.
+	int classes[256] = { 0 };
+	int num_classes = 1;
+
+	// Transitions, num_classes per state.
+	std::vector<int> delta;
+	int num_states = 0;
+
+	// Groups whose literals end in each state.
+	std::vector<std::vector<int>> outputs;
+	std::vector<uint8_t> has_output;
+
+	std::vector<uint64_t> hit_scan;
+	uint64_t scan_id = 0;
+};
+
+} // namespace zeek::detail
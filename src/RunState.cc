@@ -25,6 +25,7 @@ extern "C" {
 
 #include "zeek/NetVar.h"
 #include "zeek/Sessions.h"
+#include "zeek/Reassem.h"
 #include "zeek/Event.h"
 #include "zeek/Timer.h"
 #include "zeek/ID.h"
@@ -255,6 +256,7 @@ void dispatch_packet(Packet* pkt, iosource::PktSrc* pkt_src)
 		}
 
 	packet_mgr->ProcessPacket(pkt);
+	Reassembler::CheckMemoryBudget();
 	event_mgr.Drain();
 
 	if ( sp )
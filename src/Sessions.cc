@@ -53,6 +53,11 @@ NetSessions::NetSessions()
 	packet_filter = nullptr;
 
 	memset(&stats, 0, sizeof(SessionStats));
+
+	if ( BifConst::flow_shard_count > 1 &&
+	     BifConst::flow_shard_id >= BifConst::flow_shard_count )
+		reporter->FatalError("flow_shard_id %" PRIu64 " out of range for flow_shard_count %" PRIu64,
+		                     BifConst::flow_shard_id, BifConst::flow_shard_count);
 	}
 
 NetSessions::~NetSessions()
@@ -60,12 +65,12 @@ NetSessions::~NetSessions()
 	delete packet_filter;
 	delete stp_manager;
 
-	for ( const auto& entry : tcp_conns )
-		Unref(entry.second);
-	for ( const auto& entry : udp_conns )
-		Unref(entry.second);
-	for ( const auto& entry : icmp_conns )
-		Unref(entry.second);
+	for ( Connection* c : tcp_conns )
+		Unref(c);
+	for ( Connection* c : udp_conns )
+		Unref(c);
+	for ( Connection* c : icmp_conns )
+		Unref(c);
 
 	detail::fragment_mgr->Clear();
 	}
@@ -161,19 +166,21 @@ void NetSessions::ProcessTransportLayer(double t, const Packet* pkt, size_t rema
 	}
 
 	detail::ConnIDKey key = detail::BuildConnIDKey(id);
-	Connection* conn = nullptr;
+
+	if ( BifConst::flow_shard_count > 1 && ! InFlowShard(key, pkt) )
+		return;
+
+	auto key_hash = ConnectionMap::Hash(key);
 
 	// FIXME: The following is getting pretty complex. Need to split up
 	// into separate functions.
-	auto it = d->find(key);
-	if ( it != d->end() )
-		conn = it->second;
+	Connection* conn = d->Lookup(key, key_hash);
 
 	if ( ! conn )
 		{
 		conn = NewConn(key, t, &id, data, proto, ip_hdr->FlowLabel(), pkt);
 		if ( conn )
-			InsertConnection(d, key, conn);
+			InsertConnection(d, key, key_hash, conn);
 		}
 	else
 		{
@@ -185,7 +192,7 @@ void NetSessions::ProcessTransportLayer(double t, const Packet* pkt, size_t rema
 			Remove(conn);
 			conn = NewConn(key, t, &id, data, proto, ip_hdr->FlowLabel(), pkt);
 			if ( conn )
-				InsertConnection(d, key, conn);
+				InsertConnection(d, key, key_hash, conn);
 			}
 		else
 			{
@@ -235,6 +242,38 @@ void NetSessions::ProcessTransportLayer(double t, const Packet* pkt, size_t rema
 		}
 	}
 
+bool NetSessions::InFlowShard(const detail::ConnIDKey& key, const Packet* pkt) const
+	{
+	// Packets inside a transport-layer tunnel only get here in the
+	// shard analyzing the tunnel's connection, so they stay with that.
+	// IP and GRE tunnels have no connection of their own and every
+	// shard decapsulates them, so their inner flows get split up
+	// normally.
+	if ( pkt->encap && pkt->encap->Depth() > 0 &&
+	     pkt->encap->LastType() != BifEnum::Tunnel::IP &&
+	     pkt->encap->LastType() != BifEnum::Tunnel::GRE )
+		return true;
+
+	// The key orders the endpoints, so this is the same for both
+	// directions. FNV-1a over the key's fields.
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	auto mix = [&h](const void* p, size_t n)
+		{
+		auto b = static_cast<const u_char*>(p);
+
+		for ( size_t i = 0; i < n; ++i )
+			h = (h ^ b[i]) * 0x100000001b3ULL;
+		};
+
+	mix(&key.ip1, sizeof(key.ip1));
+	mix(&key.ip2, sizeof(key.ip2));
+	mix(&key.port1, sizeof(key.port1));
+	mix(&key.port2, sizeof(key.port2));
+
+	return h % BifConst::flow_shard_count == BifConst::flow_shard_id;
+	}
+
 int NetSessions::ParseIPPacket(int caplen, const u_char* const pkt, int proto,
                                IP_Hdr*& inner)
 	{
@@ -374,12 +413,7 @@ Connection* NetSessions::FindConnection(Val* v)
 		return nullptr;
 		}
 
-	Connection* conn = nullptr;
-	auto it = d->find(key);
-	if ( it != d->end() )
-		conn = it->second;
-
-	return conn;
+	return d->Lookup(key);
 	}
 
 void NetSessions::Remove(Connection* c)
@@ -409,17 +443,17 @@ void NetSessions::Remove(Connection* c)
 
 		switch ( c->ConnTransport() ) {
 		case TRANSPORT_TCP:
-			if ( tcp_conns.erase(key) == 0 )
+			if ( ! tcp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
 		case TRANSPORT_UDP:
-			if ( udp_conns.erase(key) == 0 )
+			if ( ! udp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
 		case TRANSPORT_ICMP:
-			if ( icmp_conns.erase(key) == 0 )
+			if ( ! icmp_conns.Remove(key) )
 				reporter->InternalWarning("connection missing");
 			break;
 
@@ -443,20 +477,17 @@ void NetSessions::Insert(Connection* c)
 	// already existing connections.
 
 	case TRANSPORT_TCP:
-		old = LookupConn(tcp_conns, c->Key());
-		tcp_conns.erase(c->Key());
+		old = tcp_conns.Remove(c->Key());
 		InsertConnection(&tcp_conns, c->Key(), c);
 		break;
 
 	case TRANSPORT_UDP:
-		old = LookupConn(udp_conns, c->Key());
-		udp_conns.erase(c->Key());
+		old = udp_conns.Remove(c->Key());
 		InsertConnection(&udp_conns, c->Key(), c);
 		break;
 
 	case TRANSPORT_ICMP:
-		old = LookupConn(icmp_conns, c->Key());
-		icmp_conns.erase(c->Key());
+		old = icmp_conns.Remove(c->Key());
 		InsertConnection(&icmp_conns, c->Key(), c);
 		break;
 
@@ -478,23 +509,20 @@ void NetSessions::Insert(Connection* c)
 
 void NetSessions::Drain()
 	{
-	for ( const auto& entry : tcp_conns )
+	for ( Connection* tc : tcp_conns )
 		{
-		Connection* tc = entry.second;
 		tc->Done();
 		tc->RemovalEvent();
 		}
 
-	for ( const auto& entry : udp_conns )
+	for ( Connection* uc : udp_conns )
 		{
-		Connection* uc = entry.second;
 		uc->Done();
 		uc->RemovalEvent();
 		}
 
-	for ( const auto& entry : icmp_conns )
+	for ( Connection* ic : icmp_conns )
 		{
-		Connection* ic = entry.second;
 		ic->Done();
 		ic->RemovalEvent();
 		}
@@ -502,27 +530,27 @@ void NetSessions::Drain()
 
 void NetSessions::Clear()
 	{
-	for ( const auto& entry : tcp_conns )
-		Unref(entry.second);
-	for ( const auto& entry : udp_conns )
-		Unref(entry.second);
-	for ( const auto& entry : icmp_conns )
-		Unref(entry.second);
+	for ( Connection* c : tcp_conns )
+		Unref(c);
+	for ( Connection* c : udp_conns )
+		Unref(c);
+	for ( Connection* c : icmp_conns )
+		Unref(c);
 
-	tcp_conns.clear();
-	udp_conns.clear();
-	icmp_conns.clear();
+	tcp_conns.Clear();
+	udp_conns.Clear();
+	icmp_conns.Clear();
 
 	detail::fragment_mgr->Clear();
 	}
 
 void NetSessions::GetStats(SessionStats& s) const
 	{
-	s.num_TCP_conns = tcp_conns.size();
+	s.num_TCP_conns = tcp_conns.Size();
 	s.cumulative_TCP_conns = stats.cumulative_TCP_conns;
-	s.num_UDP_conns = udp_conns.size();
+	s.num_UDP_conns = udp_conns.Size();
 	s.cumulative_UDP_conns = stats.cumulative_UDP_conns;
-	s.num_ICMP_conns = icmp_conns.size();
+	s.num_ICMP_conns = icmp_conns.Size();
 	s.cumulative_ICMP_conns = stats.cumulative_ICMP_conns;
 	s.num_fragments = detail::fragment_mgr->Size();
 	s.num_packets = packet_mgr->PacketsProcessed();
@@ -531,6 +559,7 @@ void NetSessions::GetStats(SessionStats& s) const
 	s.max_UDP_conns = stats.max_UDP_conns;
 	s.max_ICMP_conns = stats.max_ICMP_conns;
 	s.max_fragments = detail::fragment_mgr->MaxFragments();
+	s.evicted_fragments = detail::fragment_mgr->Evictions();
 	}
 
 Connection* NetSessions::NewConn(const detail::ConnIDKey& k, double t, const ConnID* id,
@@ -593,15 +622,6 @@ Connection* NetSessions::NewConn(const detail::ConnIDKey& k, double t, const Con
 	return conn;
 	}
 
-Connection* NetSessions::LookupConn(const ConnectionMap& conns, const detail::ConnIDKey& key)
-	{
-	auto it = conns.find(key);
-	if ( it != conns.end() )
-		return it->second;
-
-	return nullptr;
-	}
-
 bool NetSessions::IsLikelyServerPort(uint32_t port, TransportProto proto) const
 	{
 	// We keep a cached in-core version of the table to speed up the lookup.
@@ -710,34 +730,51 @@ unsigned int NetSessions::ConnectionMemoryUsage()
 		// Connections have been flushed already.
 		return 0;
 
-	for ( const auto& entry : tcp_conns )
-		mem += entry.second->MemoryAllocation();
+	for ( Connection* c : tcp_conns )
+		mem += c->MemoryAllocation();
 
-	for ( const auto& entry : udp_conns )
-		mem += entry.second->MemoryAllocation();
+	for ( Connection* c : udp_conns )
+		mem += c->MemoryAllocation();
 
-	for ( const auto& entry : icmp_conns )
-		mem += entry.second->MemoryAllocation();
+	for ( Connection* c : icmp_conns )
+		mem += c->MemoryAllocation();
 
 	return mem;
 	}
 
-unsigned int NetSessions::ConnectionMemoryUsageConnVals()
+unsigned int NetSessions::ConnectionMemoryUsageConnVals(unsigned int* num_conn_vals)
 	{
 	unsigned int mem = 0;
+	unsigned int num = 0;
+
+	if ( num_conn_vals )
+		*num_conn_vals = 0;
 
 	if ( run_state::terminating )
 		// Connections have been flushed already.
 		return 0;
 
-	for ( const auto& entry : tcp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+	auto add = [&](Connection* c)
+		{
+		unsigned int m = c->MemoryAllocationConnVal();
+
+		if ( m > 0 )
+			++num;
+
+		mem += m;
+		};
+
+	for ( Connection* c : tcp_conns )
+		add(c);
 
-	for ( const auto& entry : udp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+	for ( Connection* c : udp_conns )
+		add(c);
 
-	for ( const auto& entry : icmp_conns )
-		mem += entry.second->MemoryAllocationConnVal();
+	for ( Connection* c : icmp_conns )
+		add(c);
+
+	if ( num_conn_vals )
+		*num_conn_vals = num;
 
 	return mem;
 	}
@@ -750,9 +787,9 @@ unsigned int NetSessions::MemoryAllocation()
 
 	return ConnectionMemoryUsage()
 		+ padded_sizeof(*this)
-		+ (tcp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
-		+ (udp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
-		+ (icmp_conns.size() * (sizeof(ConnectionMap::key_type) + sizeof(ConnectionMap::value_type)))
+		+ tcp_conns.MemoryAllocation()
+		+ udp_conns.MemoryAllocation()
+		+ icmp_conns.MemoryAllocation()
 		+ detail::fragment_mgr->MemoryAllocation();
 		// FIXME: MemoryAllocation() not implemented for rest.
 		;
@@ -760,24 +797,30 @@ unsigned int NetSessions::MemoryAllocation()
 
 void NetSessions::InsertConnection(ConnectionMap* m, const detail::ConnIDKey& key, Connection* conn)
 	{
-	(*m)[key] = conn;
+	InsertConnection(m, key, ConnectionMap::Hash(key), conn);
+	}
+
+void NetSessions::InsertConnection(ConnectionMap* m, const detail::ConnIDKey& key,
+                                   ConnectionMap::hash_t hash, Connection* conn)
+	{
+	m->Insert(key, hash, conn);
 
 	switch ( conn->ConnTransport() )
 		{
 		case TRANSPORT_TCP:
 			stats.cumulative_TCP_conns++;
-			if ( m->size() > stats.max_TCP_conns )
-				stats.max_TCP_conns = m->size();
+			if ( m->Size() > stats.max_TCP_conns )
+				stats.max_TCP_conns = m->Size();
 			break;
 		case TRANSPORT_UDP:
 			stats.cumulative_UDP_conns++;
-			if ( m->size() > stats.max_UDP_conns )
-				stats.max_UDP_conns = m->size();
+			if ( m->Size() > stats.max_UDP_conns )
+				stats.max_UDP_conns = m->Size();
 			break;
 		case TRANSPORT_ICMP:
 			stats.cumulative_ICMP_conns++;
-			if ( m->size() > stats.max_ICMP_conns )
-				stats.max_ICMP_conns = m->size();
+			if ( m->Size() > stats.max_ICMP_conns )
+				stats.max_ICMP_conns = m->Size();
 			break;
 		default: break;
 		}
@@ -6,6 +6,7 @@
 #include <map>
 #include <utility>
 
+#include "zeek/ConnTable.h"
 #include "zeek/Frag.h"
 #include "zeek/PacketFilter.h"
 #include "zeek/NetVar.h"
@@ -37,6 +38,7 @@ struct SessionStats {
 
 	size_t num_fragments;
 	size_t max_fragments;
+	uint64_t evicted_fragments;
 	uint64_t num_packets;
 };
 
@@ -80,7 +82,7 @@ public:
 
 	unsigned int CurrentConnections()
 		{
-		return tcp_conns.size() + udp_conns.size() + icmp_conns.size();
+		return tcp_conns.Size() + udp_conns.Size() + icmp_conns.Size();
 		}
 
 	/**
@@ -121,20 +123,23 @@ public:
 	                  IP_Hdr*& inner);
 
 	unsigned int ConnectionMemoryUsage();
-	unsigned int ConnectionMemoryUsageConnVals();
+	// Returns the memory used by connection records.  If num_conn_vals
+	// is given, sets it to the number of connections that have one.
+	unsigned int ConnectionMemoryUsageConnVals(unsigned int* num_conn_vals = nullptr);
 	unsigned int MemoryAllocation();
 	analyzer::tcp::TCPStateStats tcp_stats;	// keeps statistics on TCP states
 
 protected:
 	friend class ConnCompressor;
 
-	using ConnectionMap = std::map<detail::ConnIDKey, Connection*>;
+	using ConnectionMap = detail::ConnectionTable;
 
 	Connection* NewConn(const detail::ConnIDKey& k, double t, const ConnID* id,
 	                    const u_char* data, int proto, uint32_t flow_label,
 	                    const Packet* pkt);
 
-	Connection* LookupConn(const ConnectionMap& conns, const detail::ConnIDKey& key);
+	Connection* LookupConn(const ConnectionMap& conns, const detail::ConnIDKey& key)
+		{ return conns.Lookup(key); }
 
 	// Returns true if the port corresonds to an application
 	// for which there's a Bro analyzer (even if it might not
@@ -158,12 +163,21 @@ protected:
 	// than that protocol's minimum header size.
 	bool CheckHeaderTrunc(int proto, uint32_t len, uint32_t caplen, const Packet *pkt);
 
+	// Returns true if the connection with the given key falls into the
+	// flow shard this process analyzes (see flow_shard_count). The hash
+	// doesn't depend on any per-process seed, so that all processes
+	// agree on the split.
+	bool InFlowShard(const detail::ConnIDKey& key, const Packet* pkt) const;
+
 	// Inserts a new connection into the sessions map. If a connection with
 	// the same key already exists in the map, it will be overwritten by
 	// the new one.  Connection count stats get updated either way (so most
 	// cases should likely check that the key is not already in the map to
-	// avoid unnecessary incrementing of connecting counts).
+	// avoid unnecessary incrementing of connecting counts).  The hash
+	// is the key's ConnectionTable::Hash(), if the caller has it already.
 	void InsertConnection(ConnectionMap* m, const detail::ConnIDKey& key, Connection* conn);
+	void InsertConnection(ConnectionMap* m, const detail::ConnIDKey& key,
+	                      ConnectionMap::hash_t hash, Connection* conn);
 
 	ConnectionMap tcp_conns;
 	ConnectionMap udp_conns;
@@ -132,7 +132,14 @@ void ProfileLogger::Log()
 	if ( expensive && sessions->CurrentConnections() != 0 )
 		avg_conn_mem_use = conn_mem_use / static_cast<double>(sessions->CurrentConnections());
 
-	file->Write(util::fmt("%.06f Conns: total=%" PRIu64 " current=%" PRIu64 "/%" PRIi32 " mem=%" PRIi32 "K avg=%.1f table=%" PRIu32 "K connvals=%" PRIu32 "K\n",
+	unsigned int num_conn_vals = 0;
+	unsigned int conn_val_mem_use = expensive ? sessions->ConnectionMemoryUsageConnVals(&num_conn_vals) : 0;
+	double avg_conn_val_mem_use = 0;
+
+	if ( num_conn_vals != 0 )
+		avg_conn_val_mem_use = conn_val_mem_use / static_cast<double>(num_conn_vals);
+
+	file->Write(util::fmt("%.06f Conns: total=%" PRIu64 " current=%" PRIu64 "/%" PRIi32 " mem=%" PRIi32 "K avg=%.1f table=%" PRIu32 "K connvals=%" PRIu32 "K/%" PRIu32 " avg=%.1f\n",
 		run_state::network_time,
 		Connection::TotalConnections(),
 		Connection::CurrentConnections(),
@@ -140,7 +147,9 @@ void ProfileLogger::Log()
 		conn_mem_use,
 		avg_conn_mem_use,
 		expensive ? sessions->MemoryAllocation() / 1024 : 0,
-		expensive ? sessions->ConnectionMemoryUsageConnVals() / 1024 : 0
+		conn_val_mem_use / 1024,
+		num_conn_vals,
+		avg_conn_val_mem_use
 		));
 
 	SessionStats s;
@@ -175,8 +184,11 @@ void ProfileLogger::Log()
 	file->Write(util::fmt("%.06f Connections expired due to inactivity: %" PRIu64 "\n",
 	                      run_state::network_time, killed_by_inactivity));
 
-	file->Write(util::fmt("%.06f Total reassembler data: %" PRIu64 "K\n", run_state::network_time,
-	                      Reassembler::TotalMemoryAllocation() / 1024));
+	file->Write(util::fmt("%.06f Total reassembler data: %" PRIu64 "K pooled=%" PRIu64 "K shed=%" PRIu64 " (%" PRIu64 "K)\n",
+	                      run_state::network_time,
+	                      Reassembler::TotalMemoryAllocation() / 1024,
+	                      zeek::detail::ReassemblyBufferPool::CachedBytes() / 1024,
+	                      Reassembler::NumShed(), Reassembler::BytesShed() / 1024));
 
 	// Signature engine.
 	if ( expensive && rule_matcher )
@@ -189,6 +201,13 @@ void ProfileLogger::Log()
 		                      stats.nfa_states, stats.dfa_states, stats.computed, stats.mem / 1024));
 		}
 
+	const auto& pstats = Specific_RE_Matcher::GetPrecompileStats();
+
+	if ( pstats.precompiled || pstats.over_budget )
+		file->Write(util::fmt("%.06f Precompiled DFAs: %u (%u from cache) over-budget=%u\n",
+		                      run_state::network_time, pstats.precompiled, pstats.loaded,
+		                      pstats.over_budget));
+
 	file->Write(util::fmt("%.06f Timers: current=%d max=%d lag=%.2fs\n",
 	                      run_state::network_time,
 	                      timer_mgr->Size(), timer_mgr->PeakSize(),
@@ -207,6 +226,13 @@ void ProfileLogger::Log()
 
 	file->Write(util::fmt("%.06f Triggers: total=%lu pending=%lu\n", run_state::network_time, tstats.total, tstats.pending));
 
+	const auto& istats = val_mgr->GetInternStats();
+
+	file->Write(util::fmt("%.06f Interned strings: current=%" PRIu64 " lookups=%" PRIu64
+	                      " hits=%" PRIu64 " saved=%" PRIu64 "K evicted=%" PRIu64 "\n",
+	                      run_state::network_time, istats.entries, istats.lookups,
+	                      istats.hits, istats.bytes_saved / 1024, istats.evictions));
+
 	unsigned int* current_timers = TimerMgr::CurrentTimers();
 	for ( int i = 0; i < NUM_TIMER_TYPES; ++i )
 		{
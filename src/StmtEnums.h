@@ -20,6 +20,7 @@ enum StmtTag {
 	STMT_WHILE,
 	STMT_CATCH_RETURN,	// for reduced InlineExpr's
 	STMT_CHECK_ANY_LEN,	// internal reduced statement
+	STMT_BYTECODE,		// function body compiled to bytecode
 	STMT_NULL
 #define NUM_STMTS (int(STMT_NULL) + 1)
 };
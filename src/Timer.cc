@@ -3,6 +3,8 @@
 #include "zeek/zeek-config.h"
 #include "zeek/Timer.h"
 
+#include <limits>
+
 #include "zeek/util.h"
 #include "zeek/Desc.h"
 #include "zeek/RunState.h"
@@ -192,4 +194,298 @@ double PQ_TimerMgr::GetNextTimeout()
 	return -1;
 	}
 
+TW_TimerMgr::TW_TimerMgr() : TimerMgr()
+	{
+	due = new PriorityQueue;
+	}
+
+TW_TimerMgr::~TW_TimerMgr()
+	{
+	// The queue deletes the timers it holds, so move everything there.
+	MoveAllToDue();
+	delete due;
+	}
+
+uint64_t TW_TimerMgr::Tick(double t)
+	{
+	if ( ! (t > 0) )
+		return 0;
+
+	// Clamp absurdly distant times so they fit into the tick counter;
+	// they'll sit in the overflow bucket either way.
+	double ticks = t * TICKS_PER_SEC;
+	if ( ticks >= 9.0e18 )
+		return uint64_t(9.0e18);
+
+	return uint64_t(ticks);
+	}
+
+TW_TimerMgr::Bucket* TW_TimerMgr::BucketFor(uint64_t tick, int& level, int& slot)
+	{
+	if ( tick <= cur_tick )
+		return nullptr;
+
+	// The wheel is determined by the most significant SLOT_BITS-sized
+	// digit in which the expiration and current ticks differ.
+	level = (63 - __builtin_clzll(tick ^ cur_tick)) / SLOT_BITS;
+
+	if ( level >= NUM_LEVELS )
+		{
+		level = NUM_LEVELS;
+		slot = 0;
+		return &overflow;
+		}
+
+	slot = (tick >> (level * SLOT_BITS)) & (NUM_SLOTS - 1);
+	return &wheels[level][slot];
+	}
+
+void TW_TimerMgr::Schedule(Timer* timer)
+	{
+	int level, slot;
+	Bucket* b = BucketFor(Tick(timer->Time()), level, slot);
+
+	if ( ! b )
+		{
+		if ( ! due->Add(timer) )
+			reporter->InternalError("out of memory");
+
+		return;
+		}
+
+	if ( level < NUM_LEVELS )
+		pending[level] |= uint64_t(1) << slot;
+
+	timer->SetOffset(b->size());
+	b->push_back(timer);
+	}
+
+void TW_TimerMgr::Add(Timer* timer)
+	{
+	DBG_LOG(DBG_TM, "Adding timer %s (%p) at %.6f",
+	        timer_type_to_string(timer->Type()), timer, timer->Time());
+
+	// Like PQ_TimerMgr, add the timer even if it's already expired.
+	// It then goes straight into the due queue.
+	Schedule(timer);
+
+	++current_timers[timer->Type()];
+	++cumulative_num;
+
+	if ( ++num_timers > peak_timers )
+		peak_timers = num_timers;
+	}
+
+void TW_TimerMgr::Remove(Timer* timer)
+	{
+	int level, slot;
+	Bucket* b = BucketFor(Tick(timer->Time()), level, slot);
+
+	if ( ! b )
+		{
+		if ( ! due->Remove(timer) )
+			reporter->InternalError("asked to remove a missing timer");
+		}
+
+	else
+		{
+		size_t idx = timer->Offset();
+
+		if ( idx >= b->size() || (*b)[idx] != timer )
+			reporter->InternalError("asked to remove a missing timer");
+
+		// Buckets are unordered, so just fill the gap with the last
+		// element.
+		Timer* last = b->back();
+		(*b)[idx] = last;
+		last->SetOffset(idx);
+		b->pop_back();
+		timer->SetOffset(-1);
+
+		if ( b->empty() && level < NUM_LEVELS )
+			pending[level] &= ~(uint64_t(1) << slot);
+		}
+
+	--current_timers[timer->Type()];
+	--num_timers;
+	delete timer;
+	}
+
+void TW_TimerMgr::Reschedule(Bucket& b)
+	{
+	// Rescheduling never puts a timer back into the bucket it's coming
+	// from, but swap it out anyway so we don't iterate over a vector
+	// that may get modified.
+	scratch.swap(b);
+
+	for ( Timer* timer : scratch )
+		Schedule(timer);
+
+	scratch.clear();
+	}
+
+void TW_TimerMgr::Cascade(uint64_t new_tick)
+	{
+	uint64_t old_tick = cur_tick;
+
+	// Update first, so that rescheduled timers are placed relative to
+	// the new time.
+	cur_tick = new_tick;
+
+	for ( int level = 0; level < NUM_LEVELS; ++level )
+		{
+		int shift = level * SLOT_BITS;
+		uint64_t candidates;
+		bool wrapped = (old_tick >> (shift + SLOT_BITS)) != (new_tick >> (shift + SLOT_BITS));
+
+		if ( wrapped )
+			// We moved past the end of this wheel's range, so all of
+			// its timers have come due or need to move down.
+			candidates = ~uint64_t(0);
+		else
+			{
+			// Slots after the old position up to and including the
+			// new one.
+			int old_slot = (old_tick >> shift) & (NUM_SLOTS - 1);
+			int new_slot = (new_tick >> shift) & (NUM_SLOTS - 1);
+
+			if ( old_slot == new_slot )
+				// Higher wheels can't have moved either.
+				break;
+
+			uint64_t upto_new = new_slot == NUM_SLOTS - 1 ?
+				~uint64_t(0) : (uint64_t(1) << (new_slot + 1)) - 1;
+			uint64_t upto_old = (uint64_t(1) << (old_slot + 1)) - 1;
+			candidates = upto_new & ~upto_old;
+			}
+
+		uint64_t todo = candidates & pending[level];
+		pending[level] &= ~candidates;
+
+		while ( todo )
+			{
+			int slot = __builtin_ctzll(todo);
+			todo &= todo - 1;
+			Reschedule(wheels[level][slot]);
+			}
+
+		if ( ! wrapped )
+			break;
+		}
+
+	if ( (old_tick >> (NUM_LEVELS * SLOT_BITS)) != (new_tick >> (NUM_LEVELS * SLOT_BITS)) )
+		Reschedule(overflow);
+	}
+
+void TW_TimerMgr::MoveAllToDue()
+	{
+	for ( int level = 0; level < NUM_LEVELS; ++level )
+		{
+		while ( pending[level] )
+			{
+			int slot = __builtin_ctzll(pending[level]);
+			pending[level] &= pending[level] - 1;
+
+			for ( Timer* timer : wheels[level][slot] )
+				due->Add(timer);
+
+			wheels[level][slot].clear();
+			}
+		}
+
+	for ( Timer* timer : overflow )
+		due->Add(timer);
+
+	overflow.clear();
+
+	// Timers get located by their tick, so make every tick count as
+	// due: otherwise removing one that's still in the future would
+	// look for it in a wheel.
+	cur_tick = std::numeric_limits<uint64_t>::max();
+	}
+
+void TW_TimerMgr::Expire()
+	{
+	// Dispatch everything in time order, including timers that get added
+	// while we're at it.
+	for ( ; ; )
+		{
+		MoveAllToDue();
+
+		Timer* timer = (Timer*) due->Remove();
+		if ( ! timer )
+			break;
+
+		DBG_LOG(DBG_TM, "Dispatching timer %s (%p)",
+		        timer_type_to_string(timer->Type()), timer);
+		--current_timers[timer->Type()];
+		--num_timers;
+		timer->Dispatch(t, true);
+		delete timer;
+		}
+	}
+
+int TW_TimerMgr::DoAdvance(double new_t, int max_expire)
+	{
+	uint64_t new_tick = Tick(new_t);
+
+	if ( new_tick > cur_tick )
+		Cascade(new_tick);
+
+	Timer* timer = Top();
+	for ( num_expired = 0; (num_expired < max_expire || max_expire == 0) &&
+		     timer && timer->Time() <= new_t; ++num_expired )
+		{
+		last_timestamp = timer->Time();
+		--current_timers[timer->Type()];
+		--num_timers;
+
+		// Remove it before dispatching, since the dispatch
+		// can otherwise delete it, and then we won't know
+		// whether we should delete it too.
+		(void) due->Remove();
+
+		DBG_LOG(DBG_TM, "Dispatching timer %s (%p)",
+		        timer_type_to_string(timer->Type()), timer);
+		timer->Dispatch(new_t, false);
+		delete timer;
+
+		timer = Top();
+		}
+
+	return num_expired;
+	}
+
+double TW_TimerMgr::GetNextTimeout()
+	{
+	if ( Timer* top = Top() )
+		return std::max(0.0, top->Time() - run_state::network_time);
+
+	// Lower wheels always expire before higher ones, and within a wheel
+	// all pending slots lie ahead of the current position. The start of
+	// the first pending slot is a lower bound for the next expiration,
+	// which is good enough for deciding when to wake up next.
+	for ( int level = 0; level < NUM_LEVELS; ++level )
+		{
+		if ( ! pending[level] )
+			continue;
+
+		int shift = level * SLOT_BITS;
+		int slot = __builtin_ctzll(pending[level]);
+		uint64_t base = (cur_tick >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+		uint64_t start = base | (uint64_t(slot) << shift);
+
+		return std::max(0.0, start / TICKS_PER_SEC - run_state::network_time);
+		}
+
+	if ( ! overflow.empty() )
+		{
+		int shift = NUM_LEVELS * SLOT_BITS;
+		uint64_t start = ((cur_tick >> shift) + 1) << shift;
+		return std::max(0.0, start / TICKS_PER_SEC - run_state::network_time);
+		}
+
+	return -1;
+	}
+
 } // namespace zeek::detail
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <vector>
 
 #include "zeek/PriorityQueue.h"
 #include "zeek/iosource/IOSource.h"
@@ -171,6 +172,82 @@ protected:
 	PriorityQueue* q;
 };
 
+/**
+ * A timer manager based on a hierarchical timing wheel. Adding and
+ * canceling a timer are O(1); timers are bucketed by expiration time with
+ * a resolution of one millisecond on NUM_LEVELS wheels of NUM_SLOTS slots
+ * each, whose slot width grows by a factor of NUM_SLOTS per level. As time
+ * advances, buckets coming due cascade down to lower levels and eventually
+ * into a small priority queue of due timers, from which they're dispatched
+ * in the same order PQ_TimerMgr would use.
+ */
+class TW_TimerMgr : public TimerMgr {
+public:
+	TW_TimerMgr();
+	~TW_TimerMgr() override;
+
+	void Add(Timer* timer) override;
+	void Expire() override;
+
+	int Size() const override { return num_timers; }
+	int PeakSize() const override { return peak_timers; }
+	uint64_t CumulativeNum() const override { return cumulative_num; }
+	double GetNextTimeout() override;
+
+protected:
+	int DoAdvance(double t, int max_expire) override;
+	void Remove(Timer* timer) override;
+
+	Timer* Top()			{ return (Timer*) due->Top(); }
+
+private:
+	static constexpr int SLOT_BITS = 6;
+	static constexpr int NUM_SLOTS = 1 << SLOT_BITS;
+	static constexpr int NUM_LEVELS = 6;
+	static constexpr double TICKS_PER_SEC = 1000.0;
+
+	// Timers within a bucket are unordered; a timer's PQ_Element offset
+	// is its index in the bucket.
+	using Bucket = std::vector<Timer*>;
+
+	static uint64_t Tick(double t);
+
+	// Returns the bucket a timer expiring at the given tick belongs in,
+	// relative to the current tick, or nullptr if it's due already.
+	// Sets level to the bucket's wheel (NUM_LEVELS for the overflow
+	// bucket) and slot to its index on that wheel.
+	Bucket* BucketFor(uint64_t tick, int& level, int& slot);
+
+	// Puts a timer into the due queue or the wheel bucket matching its
+	// expiration time.
+	void Schedule(Timer* timer);
+
+	// Moves the wheel forward to the given tick, redistributing all
+	// buckets that the move passes over.
+	void Cascade(uint64_t new_tick);
+
+	// Reschedules all timers of the given bucket (which gets emptied).
+	void Reschedule(Bucket& b);
+
+	// Moves all timers from the wheels into the due queue, which is
+	// where all timers go from then on.
+	void MoveAllToDue();
+
+	PriorityQueue* due;
+	Bucket wheels[NUM_LEVELS][NUM_SLOTS];
+	Bucket overflow;	// timers beyond the range of the top wheel
+	Bucket scratch;
+
+	// Per-wheel bitmap of non-empty slots.
+	uint64_t pending[NUM_LEVELS] = {};
+
+	uint64_t cur_tick = 0;
+
+	int num_timers = 0;
+	int peak_timers = 0;
+	uint64_t cumulative_num = 0;
+};
+
 extern TimerMgr* timer_mgr;
 
 } // namespace zeek::detail
@@ -827,6 +827,45 @@ RecordType::RecordType(type_decl_list* arg_types) : Type(TYPE_RECORD)
 	{
 	types = arg_types;
 	num_fields = types ? types->length() : 0;
+	AddFieldLayouts();
+	}
+
+void RecordType::AddFieldLayouts()
+	{
+	for ( int i = field_kinds.size(); i < num_fields; ++i )
+		{
+		RecordFieldKind kind;
+
+		switch ( (*types)[i]->type->Tag() ) {
+		case TYPE_BOOL:
+		case TYPE_INT:
+		case TYPE_ENUM:
+			kind = FIELD_INT;
+			break;
+
+		case TYPE_COUNT:
+		case TYPE_PORT:
+			kind = FIELD_UINT;
+			break;
+
+		case TYPE_DOUBLE:
+		case TYPE_TIME:
+		case TYPE_INTERVAL:
+			kind = FIELD_DOUBLE;
+			break;
+
+		case TYPE_ADDR:
+			kind = FIELD_ADDR;
+			break;
+
+		default:
+			kind = FIELD_VAL;
+			break;
+		}
+
+		field_slots.push_back(NumSlots(i));
+		field_kinds.push_back(kind);
+		}
 	}
 
 // in this case the clone is actually not so shallow, since
@@ -1027,6 +1066,7 @@ const char* RecordType::AddFields(const type_decl_list& others,
 		}
 
 	num_fields = types->length();
+	AddFieldLayouts();
 	RecordVal::ResizeParseTimeRecords(this);
 	TableVal::RebuildParseTimeTables();
 	return nullptr;
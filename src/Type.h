@@ -8,6 +8,7 @@
 #include <map>
 #include <list>
 #include <optional>
+#include <vector>
 
 #include "zeek/Obj.h"
 #include "zeek/ID.h"
@@ -546,6 +547,17 @@ public:
 
 using type_decl_list = PList<TypeDecl>;
 
+// How RecordVal's store fields of a given type.  Fields of atomic types
+// hold their value directly rather than a reference to a separately
+// allocated Val.
+enum RecordFieldKind : uint8_t {
+	FIELD_INT,	// bool, int and enum
+	FIELD_UINT,	// count and port
+	FIELD_DOUBLE,	// double, time and interval
+	FIELD_ADDR,	// addr, taking two slots
+	FIELD_VAL,	// all other types, as a Val
+};
+
 class RecordType final : public Type {
 public:
 	explicit RecordType(type_decl_list* types);
@@ -602,6 +614,25 @@ public:
 
 	int NumFields() const			{ return num_fields; }
 
+	/**
+	 * Returns how RecordVal's of this type store the given field.
+	 */
+	RecordFieldKind FieldKind(int field) const
+		{ return field_kinds[field]; }
+
+	/**
+	 * Returns the position at which RecordVal's of this type store the
+	 * given field, in units of their 8-byte slots.
+	 */
+	int FieldSlot(int field) const	{ return field_slots[field]; }
+
+	/**
+	 * Returns the number of slots that storing the first *n* fields
+	 * takes.
+	 */
+	int NumSlots(int n) const
+		{ return n == 0 ? 0 : field_slots[n - 1] + (field_kinds[n - 1] == FIELD_ADDR ? 2 : 1); }
+
 	/**
 	 * Returns a "record_field_table" value for introspection purposes.
 	 * @param rv  an optional record value, if given the values of
@@ -635,8 +666,15 @@ public:
 protected:
 	RecordType() { types = nullptr; }
 
+	// Extends the storage layout to any fields added since the
+	// last call.
+	void AddFieldLayouts();
+
 	int num_fields;
 	type_decl_list* types;
+
+	std::vector<RecordFieldKind> field_kinds;
+	std::vector<int> field_slots;
 };
 
 class SubNetType final : public Type {
@@ -13,7 +13,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cmath>
+#include <optional>
 #include <set>
 
 #include "zeek/Attr.h"
@@ -1430,7 +1432,6 @@ void TableVal::Init(TableTypePtr t)
 	table_type = std::move(t);
 	expire_func = nullptr;
 	expire_time = nullptr;
-	expire_iterator = nullptr;
 	timer = nullptr;
 	def_val = nullptr;
 
@@ -1452,11 +1453,14 @@ TableVal::~TableVal()
 	delete table_hash;
 	delete table_val;
 	delete subnets;
-	delete expire_iterator;
+
+	ClearExpireQueue();
 	}
 
 void TableVal::RemoveAll()
 	{
+	ClearExpireQueue();
+
 	// Here we take the brute force approach.
 	delete table_val;
 	table_val = new PDict<TableEntryVal>;
@@ -1537,6 +1541,10 @@ void TableVal::CheckExpireAttr(detail::AttrTag at)
 		if ( timer )
 			detail::timer_mgr->Cancel(timer);
 
+		// Entries that came in before expiration got enabled
+		// aren't queued, so start over.
+		ClearExpireQueue();
+
 		// As network_time is not necessarily initialized yet,
 		// we set a timer which fires immediately.
 		timer = new TableValTimer(this, 1);
@@ -1547,6 +1555,21 @@ void TableVal::CheckExpireAttr(detail::AttrTag at)
 bool TableVal::Assign(ValPtr index, ValPtr new_val, bool broker_forward,
                       bool* iterators_invalidated)
 	{
+	if ( table_hash->HasAtomicKeys() )
+		{
+		detail::AtomicKey ak;
+
+		if ( ! table_hash->MakeAtomicKey(*index, &ak, true) )
+			{
+			index->Error("index type doesn't match table", table_type->GetIndices().get());
+			return false;
+			}
+
+		// The dictionary copies the key when taking it over.
+		detail::HashKey k(ak.Key(), ak.Size(), ak.Hash(), true);
+		return DoAssign(std::move(index), &k, std::move(new_val), broker_forward, iterators_invalidated);
+		}
+
 	auto k = MakeHashKey(*index);
 
 	if ( ! k )
@@ -1561,14 +1584,31 @@ bool TableVal::Assign(ValPtr index, ValPtr new_val, bool broker_forward,
 bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k,
                       ValPtr new_val, bool broker_forward, bool* iterators_invalidated)
 	{
+	return DoAssign(std::move(index), k.get(), std::move(new_val), broker_forward, iterators_invalidated);
+	}
+
+bool TableVal::DoAssign(ValPtr index, detail::HashKey* k, ValPtr new_val,
+                        bool broker_forward, bool* iterators_invalidated)
+	{
 	bool is_set = table_type->IsSet();
 
 	if ( (is_set && new_val) || (! is_set && ! new_val) )
 		InternalWarning("bad set/table in TableVal::Assign");
 
+	// Without an index, we may need to recover it from the key below.
+	std::unique_ptr<detail::HashKey> k_copy;
+
+	if ( ! index && (subnets || change_func || ! broker_store.empty()) )
+		k_copy = std::make_unique<detail::HashKey>(k->Key(), k->Size(), k->Hash());
+
+	// In case this adds a key, the expiration queue needs its own copy.
+	std::optional<ExpireQueueEntry> expire_qe;
+
+	if ( expire_queue_valid )
+		expire_qe.emplace(0, 0, k->Key(), k->Size(), k->Hash());
+
 	TableEntryVal* new_entry_val = new TableEntryVal(std::move(new_val));
-	detail::HashKey k_copy(k->Key(), k->Size(), k->Hash());
-	TableEntryVal* old_entry_val = table_val->Insert(k.get(), new_entry_val, iterators_invalidated);
+	TableEntryVal* old_entry_val = table_val->Insert(k, new_entry_val, iterators_invalidated);
 
 	// If the dictionary index already existed, the insert may free up the
 	// memory allocated to the key bytes, so have to assume k is invalid
@@ -1579,7 +1619,7 @@ bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k,
 		{
 		if ( ! index )
 			{
-			auto v = RecreateIndex(k_copy);
+			auto v = RecreateIndex(*k_copy);
 			subnets->Insert(v.get(), new_entry_val);
 			}
 		else
@@ -1590,12 +1630,29 @@ bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k,
 	if ( old_entry_val && attrs && attrs->Find(detail::ATTR_EXPIRE_CREATE) )
 		new_entry_val->SetExpireAccess(old_entry_val->ExpireAccessTime());
 
+	if ( old_entry_val )
+		// A replaced entry's queue entry carries over to its successor.
+		new_entry_val->expire_generation = old_entry_val->expire_generation;
+
+	else if ( expire_qe )
+		{
+		if ( expire_queue.size() + expire_backlog.size() > 2 * size_t(table_val->Length()) )
+			// More than half of the queue is stale.
+			BuildExpireQueue();
+		else
+			{
+			expire_qe->access_time = new_entry_val->expire_access_time;
+			expire_qe->generation = new_entry_val->expire_generation = NextExpireGeneration();
+			QueueForExpiration(std::move(*expire_qe));
+			}
+		}
+
 	Modified();
 
 	if ( change_func || ( broker_forward && ! broker_store.empty() ) )
 		{
 		auto change_index = index ? std::move(index)
-		                          : RecreateIndex(k_copy);
+		                          : RecreateIndex(*k_copy);
 
 		if ( broker_forward && ! broker_store.empty() )
 			SendToStore(change_index.get(), new_entry_val, old_entry_val ? ELEMENT_CHANGED : ELEMENT_NEW);
@@ -1924,28 +1981,40 @@ const ValPtr& TableVal::Find(const ValPtr& index)
 
 	if ( table_val->Length() > 0 )
 		{
-		auto k = MakeHashKey(*index);
+		TableEntryVal* v = FindEntry(*index);
 
-		if ( k )
+		if ( v )
 			{
-			TableEntryVal* v = table_val->Lookup(k.get());
-
-			if ( v )
-				{
-				if ( attrs && attrs->Find(detail::ATTR_EXPIRE_READ) )
-					v->SetExpireAccess(run_state::network_time);
+			if ( attrs && attrs->Find(detail::ATTR_EXPIRE_READ) )
+				v->SetExpireAccess(run_state::network_time);
 
-				if ( v->GetVal() )
-					return v->GetVal();
+			if ( v->GetVal() )
+				return v->GetVal();
 
-				return val_mgr->True();
-				}
+			return val_mgr->True();
 			}
 		}
 
 	return Val::nil;
 	}
 
+TableEntryVal* TableVal::FindEntry(const Val& index) const
+	{
+	if ( table_hash->HasAtomicKeys() )
+		{
+		detail::AtomicKey ak;
+
+		if ( ! table_hash->MakeAtomicKey(index, &ak, true) )
+			return nullptr;
+
+		detail::HashKey k(ak.Key(), ak.Size(), ak.Hash(), true);
+		return table_val->Lookup(&k);
+		}
+
+	auto k = MakeHashKey(index);
+	return k ? table_val->Lookup(k.get()) : nullptr;
+	}
+
 ValPtr TableVal::FindOrDefault(const ValPtr& index)
 	{
 	if ( auto rval = Find(index) )
@@ -2014,14 +2083,7 @@ bool TableVal::UpdateTimestamp(Val* index)
 	if ( subnets )
 		v = (TableEntryVal*) subnets->Lookup(index);
 	else
-		{
-		auto k = MakeHashKey(*index);
-
-		if ( ! k )
-			return false;
-
-		v = table_val->Lookup(k.get());
-		}
+		v = FindEntry(*index);
 
 	if ( ! v )
 		return false;
@@ -2472,6 +2534,106 @@ void TableVal::InitTimer(double delay)
 	detail::timer_mgr->Add(timer);
 	}
 
+TableVal::ExpireQueueEntry::ExpireQueueEntry(int arg_access_time, uint32_t arg_generation,
+                                             const void* arg_key, int arg_key_size,
+                                             detail::hash_t arg_hash)
+	: access_time(arg_access_time), generation(arg_generation),
+	  hash(arg_hash), key_size(arg_key_size)
+	{
+	if ( key_size > 8 )
+		key = new char[key_size];
+
+	memcpy(key_size > 8 ? key : key_here, arg_key, key_size);
+	}
+
+TableVal::ExpireQueueEntry& TableVal::ExpireQueueEntry::operator=(ExpireQueueEntry&& other) noexcept
+	{
+	if ( this == &other )
+		return *this;
+
+	if ( key_size > 8 )
+		delete [] key;
+
+	access_time = other.access_time;
+	position = other.position;
+	generation = other.generation;
+	hash = other.hash;
+	key_size = other.key_size;
+	memcpy(key_here, other.key_here, sizeof(key_here));
+
+	other.key_size = 0;
+	return *this;
+	}
+
+void TableVal::QueueForExpiration(ExpireQueueEntry qe)
+	{
+	expire_queue.emplace_back(std::move(qe));
+	std::push_heap(expire_queue.begin(), expire_queue.end(), ExpireQueueEntry::Later);
+	}
+
+uint32_t TableVal::NextExpireGeneration()
+	{
+	// 0 means "not queued".
+	if ( ++expire_generation == 0 )
+		++expire_generation;
+
+	return expire_generation;
+	}
+
+void TableVal::BuildExpireQueue()
+	{
+	ClearExpireQueue();
+	expire_queue.reserve(table_val->Length());
+
+	for ( const auto& tble : *table_val )
+		{
+		auto* v = tble.GetValue<TableEntryVal*>();
+		v->expire_generation = NextExpireGeneration();
+		expire_queue.emplace_back(v->expire_access_time, v->expire_generation,
+		                          tble.GetKey(), tble.key_size, tble.hash);
+		}
+
+	std::make_heap(expire_queue.begin(), expire_queue.end(), ExpireQueueEntry::Later);
+	expire_queue_valid = true;
+	}
+
+void TableVal::ClearExpireQueue()
+	{
+	expire_stats.backlog -= expire_backlog.size();
+	expire_queue.clear();
+	expire_queue.shrink_to_fit();
+	expire_backlog.clear();
+	expire_backlog.shrink_to_fit();
+	expire_queue_valid = false;
+	}
+
+void TableVal::CollectDueEntries(double t, double timeout)
+	{
+	// Access times only ever increase, so the queue's order may be
+	// stale only in entries coming out later than they could.
+	double base = run_state::zeek_start_network_time + timeout;
+	size_t num_due = expire_backlog.size();
+
+	while ( ! expire_queue.empty() && base + expire_queue.front().access_time < t )
+		{
+		std::pop_heap(expire_queue.begin(), expire_queue.end(), ExpireQueueEntry::Later);
+		auto qe = std::move(expire_queue.back());
+		expire_queue.pop_back();
+
+		auto k = qe.Key();
+		qe.position = table_val->Position(&k);
+
+		if ( qe.position >= 0 )
+			expire_backlog.emplace_back(std::move(qe));
+		}
+
+	std::sort(expire_backlog.begin(), expire_backlog.end(),
+	          [](const ExpireQueueEntry& a, const ExpireQueueEntry& b)
+		          { return a.position > b.position; });
+
+	expire_stats.backlog += expire_backlog.size() - num_due;
+	}
+
 void TableVal::DoExpire(double t)
 	{
 	if ( ! type )
@@ -2484,22 +2646,39 @@ void TableVal::DoExpire(double t)
 		// error, it has been reported already.
 		return;
 
-	if ( ! expire_iterator )
-		{
-		auto it = table_val->begin_robust();
-		expire_iterator = new RobustDictIterator(std::move(it));
-		}
+	double start_time = util::current_time(true);
+
+	if ( ! expire_queue_valid )
+		BuildExpireQueue();
+
+	if ( expire_backlog.empty() )
+		CollectDueEntries(t, timeout);
 
-	std::unique_ptr<detail::HashKey> k = nullptr;
 	TableEntryVal* v = nullptr;
 	TableEntryVal* v_saved = nullptr;
 	bool modified = false;
 
 	for ( int i = 0; i < zeek::detail::table_incremental_step &&
-		      *expire_iterator != table_val->end_robust(); ++i, ++(*expire_iterator) )
+		      ! expire_backlog.empty(); ++i )
 		{
-		k = (*expire_iterator)->GetHashKey();
-		v = (*expire_iterator)->GetValue<TableEntryVal*>();
+		if ( zeek::detail::table_expire_budget > 0 && i > 0 &&
+		     util::current_time(true) - start_time > zeek::detail::table_expire_budget )
+			{
+			++expire_stats.exhausted;
+			break;
+			}
+
+		auto qe = std::move(expire_backlog.back());
+		expire_backlog.pop_back();
+		--expire_stats.backlog;
+
+		auto k = qe.Key();
+		v = table_val->Lookup(&k);
+
+		if ( ! v || v->expire_generation != qe.generation )
+			// Removed in the meantime, and maybe added anew, in
+			// which case it's been queued itself.
+			continue;
 
 		if ( v->ExpireAccessTime() == 0 )
 			{
@@ -2508,6 +2687,7 @@ void TableVal::DoExpire(double t)
 			// also when bro_start_network_time hasn't been initialized
 			// (e.g. before first packet).  The expire_access_time is
 			// correct, so we just need to wait.
+			QueueForExpiration(std::move(qe));
 			}
 
 		else if ( v->ExpireAccessTime() + timeout < t )
@@ -2516,14 +2696,14 @@ void TableVal::DoExpire(double t)
 
 			if ( expire_func )
 				{
-				idx = RecreateIndex(*k);
+				idx = RecreateIndex(k);
 				double secs = CallExpireFunc(idx);
 
 				// It's possible that the user-provided
 				// function modified or deleted the table
 				// value, so look it up again.
 				v_saved = v;
-				v = table_val->Lookup(k.get());
+				v = table_val->Lookup(&k);
 
 				if ( ! v )
 					{ // user-provided function deleted it
@@ -2531,11 +2711,18 @@ void TableVal::DoExpire(double t)
 					continue;
 					}
 
+				if ( v->expire_generation != qe.generation )
+					// Added anew, or the queue got rebuilt.
+					continue;
+
 				if ( secs > 0 )
 					{
 					// User doesn't want us to expire
 					// this now.
 					v->SetExpireAccess(run_state::network_time - timeout + secs);
+
+					qe.access_time = v->expire_access_time;
+					QueueForExpiration(std::move(qe));
 					continue;
 					}
 
@@ -2544,34 +2731,40 @@ void TableVal::DoExpire(double t)
 			if ( subnets )
 				{
 				if ( ! idx )
-					idx = RecreateIndex(*k);
+					idx = RecreateIndex(k);
 				if ( ! subnets->Remove(idx.get()) )
 					reporter->InternalWarning("index not in prefix table");
 				}
 
-			table_val->RemoveEntry(k.get());
+			table_val->RemoveEntry(&k);
 			if ( change_func )
 				{
 				if ( ! idx )
-					idx = RecreateIndex(*k);
+					idx = RecreateIndex(k);
 
 				CallChangeFunc(idx, v->GetVal(), ELEMENT_EXPIRED);
 				}
 
 			delete v;
+			++expire_stats.expired;
 			modified = true;
 			}
+
+		else
+			{
+			// Accessed since it got queued.
+			qe.access_time = v->expire_access_time;
+			QueueForExpiration(std::move(qe));
+			}
 		}
 
+	expire_stats.time += util::current_time(true) - start_time;
+
 	if ( modified )
 		Modified();
 
-	if ( (*expire_iterator) == table_val->end_robust() )
-		{
-		delete expire_iterator;
-		expire_iterator = nullptr;
+	if ( expire_backlog.empty() )
 		InitTimer(zeek::detail::table_expire_interval);
-		}
 	else
 		InitTimer(zeek::detail::table_expire_delay);
 	}
@@ -2597,6 +2790,7 @@ double TableVal::GetExpireTime()
 		return interval;
 
 	expire_time = nullptr;
+	ClearExpireQueue();
 
 	if ( timer )
 		detail::timer_mgr->Cancel(timer);
@@ -2781,6 +2975,8 @@ void TableVal::RebuildTable(ParseTimeTableState ptts)
 
 TableVal::ParseTimeTableStates TableVal::parse_time_table_states;
 
+TableVal::ExpireStats TableVal::expire_stats;
+
 TableVal::TableRecordDependencies TableVal::parse_time_table_record_dependencies;
 
 RecordVal::RecordTypeValMap RecordVal::parse_time_records;
@@ -2790,8 +2986,7 @@ RecordVal::RecordVal(RecordTypePtr t, bool init_fields) : Val(std::move(t))
 	origin = nullptr;
 	auto rt = GetType()->AsRecordType();
 	int n = rt->NumFields();
-	auto vl = record_val = new std::vector<ValPtr>;
-	vl->reserve(n);
+	Reserve(n);
 
 	if ( run_state::is_parsing )
 		parse_time_records[rt].emplace_back(NewRef{}, this);
@@ -2817,7 +3012,9 @@ RecordVal::RecordVal(RecordTypePtr t, bool init_fields) : Val(std::move(t))
 				if ( run_state::is_parsing )
 					parse_time_records[rt].pop_back();
 
-				delete record_val;
+				for ( auto j = 0u; j < is_set.size(); ++j )
+					ClearField(j);
+
 				throw;
 				}
 
@@ -2848,13 +3045,14 @@ RecordVal::RecordVal(RecordTypePtr t, bool init_fields) : Val(std::move(t))
 				def = make_intrusive<VectorVal>(cast_intrusive<VectorType>(type));
 			}
 
-		vl->emplace_back(std::move(def));
+		AppendField(std::move(def));
 		}
 	}
 
 RecordVal::~RecordVal()
 	{
-	delete record_val;
+	for ( auto i = 0u; i < is_set.size(); ++i )
+		ClearField(i);
 	}
 
 ValPtr RecordVal::SizeVal() const
@@ -2864,16 +3062,189 @@ ValPtr RecordVal::SizeVal() const
 
 void RecordVal::Assign(int field, ValPtr new_val)
 	{
-	(*record_val)[field] = std::move(new_val);
+	if ( new_val )
+		SetField(field, std::move(new_val));
+	else
+		ClearField(field);
+
+	Modified();
+	}
+
+void RecordVal::AssignInt(int field, bro_int_t v)
+	{
+	ClearField(field);
+	record_val[RecType()->FieldSlot(field)].int_val = v;
+	is_set[field] = true;
+	Modified();
+	}
+
+void RecordVal::AssignCount(int field, bro_uint_t v)
+	{
+	ClearField(field);
+	record_val[RecType()->FieldSlot(field)].uint_val = v;
+	is_set[field] = true;
+	Modified();
+	}
+
+void RecordVal::AssignDouble(int field, double v)
+	{
+	ClearField(field);
+	record_val[RecType()->FieldSlot(field)].double_val = v;
+	is_set[field] = true;
 	Modified();
 	}
 
+void RecordVal::AssignAddr(int field, const IPAddr& v)
+	{
+	ClearField(field);
+	new (&record_val[RecType()->FieldSlot(field)]) IPAddr(v);
+	is_set[field] = true;
+	Modified();
+	}
+
+void RecordVal::SetField(int field, ValPtr v)
+	{
+	auto rt = RecType();
+	auto& slot = record_val[rt->FieldSlot(field)];
+
+	switch ( rt->FieldKind(field) ) {
+	case FIELD_INT:
+		slot.int_val = v->CoerceToInt();
+		break;
+
+	case FIELD_UINT:
+		slot.uint_val = v->CoerceToUnsigned();
+		break;
+
+	case FIELD_DOUBLE:
+		slot.double_val = v->CoerceToDouble();
+		break;
+
+	case FIELD_ADDR:
+		new (&slot) IPAddr(v->AsAddr());
+		break;
+
+	case FIELD_VAL:
+		if ( is_set[field] )
+			Unref(slot.val);
+
+		slot.val = v.release();
+		break;
+	}
+
+	is_set[field] = true;
+
+	if ( field < 64 )
+		deferred_fields &= ~(uint64_t(1) << field);
+	}
+
+void RecordVal::ClearField(int field)
+	{
+	if ( is_set[field] && RecType()->FieldKind(field) == FIELD_VAL )
+		Unref(record_val[RecType()->FieldSlot(field)].val);
+
+	is_set[field] = false;
+
+	if ( field < 64 )
+		deferred_fields &= ~(uint64_t(1) << field);
+	}
+
+void RecordVal::ResolveField(int field)
+	{
+	deferred_fields &= ~(uint64_t(1) << field);
+
+	// Not an Assign(): to anyone watching, the field has had this
+	// value all along.
+	if ( auto v = field_provider->ProvideField(this, field) )
+		SetField(field, std::move(v));
+	else
+		ClearField(field);
+	}
+
+void RecordVal::ResolveDeferredFields()
+	{
+	for ( int i = 0; deferred_fields && i < 64; ++i )
+		Resolve(i);
+
+	field_provider = nullptr;
+	}
+
+void RecordVal::AppendField(ValPtr v)
+	{
+	int field = is_set.size();
+
+	is_set.push_back(false);
+	record_val.resize(RecType()->NumSlots(field + 1));
+
+	if ( v )
+		SetField(field, std::move(v));
+	}
+
+void RecordVal::Reserve(unsigned int n)
+	{
+	is_set.reserve(n);
+	record_val.reserve(RecType()->NumSlots(n));
+	}
+
+ValPtr RecordVal::GetField(int field) const
+	{
+	Resolve(field);
+
+	if ( ! is_set[field] )
+		return nullptr;
+
+	auto rt = RecType();
+	const auto& slot = record_val[rt->FieldSlot(field)];
+
+	switch ( rt->FieldKind(field) ) {
+	case FIELD_VAL:
+		return {NewRef{}, slot.val};
+
+	case FIELD_ADDR:
+		return make_intrusive<AddrVal>(*reinterpret_cast<const IPAddr*>(&slot));
+
+	default:
+		break;
+	}
+
+	const auto& ft = rt->GetFieldType(field);
+
+	switch ( ft->Tag() ) {
+	case TYPE_BOOL:
+		return val_mgr->Bool(slot.int_val);
+
+	case TYPE_INT:
+		return val_mgr->Int(slot.int_val);
+
+	case TYPE_ENUM:
+		return ft->AsEnumType()->GetEnumVal(slot.int_val);
+
+	case TYPE_COUNT:
+		return val_mgr->Count(slot.uint_val);
+
+	case TYPE_PORT:
+		return val_mgr->Port(slot.uint_val);
+
+	case TYPE_DOUBLE:
+		return make_intrusive<DoubleVal>(slot.double_val);
+
+	case TYPE_TIME:
+		return make_intrusive<TimeVal>(slot.double_val);
+
+	case TYPE_INTERVAL:
+		return make_intrusive<IntervalVal>(slot.double_val);
+
+	default:
+		reporter->InternalError("bad record field kind");
+	}
+	}
+
 ValPtr RecordVal::GetFieldOrDefault(int field) const
 	{
-	const auto& val = (*record_val)[field];
+	Resolve(field);
 
-	if ( val )
-		return val;
+	if ( is_set[field] )
+		return GetField(field);
 
 	return GetType()->AsRecordType()->FieldDefault(field);
 	}
@@ -2907,7 +3278,7 @@ void RecordVal::DoneParsing()
 	parse_time_records.clear();
 	}
 
-const ValPtr& RecordVal::GetField(const char* field) const
+ValPtr RecordVal::GetField(const char* field) const
 	{
 	int idx = GetType()->AsRecordType()->FieldOffset(field);
 
@@ -3006,7 +3377,7 @@ TableValPtr RecordVal::GetRecordFieldsVal() const
 
 void RecordVal::Describe(ODesc* d) const
 	{
-	auto n = record_val->size();
+	auto n = is_set.size();
 	auto record_type = GetType()->AsRecordType();
 
 	if ( d->IsBinary() || d->IsPortable() )
@@ -3029,7 +3400,7 @@ void RecordVal::Describe(ODesc* d) const
 		if ( ! d->IsBinary() )
 			d->Add("=");
 
-		const auto& v = (*record_val)[i];
+		auto v = GetField(i);
 
 		if ( v )
 			v->Describe(d);
@@ -3043,7 +3414,7 @@ void RecordVal::Describe(ODesc* d) const
 
 void RecordVal::DescribeReST(ODesc* d) const
 	{
-	auto n = record_val->size();
+	auto n = is_set.size();
 	auto record_type = GetType()->AsRecordType();
 
 	d->Add("{");
@@ -3057,7 +3428,7 @@ void RecordVal::DescribeReST(ODesc* d) const
 		d->Add(record_type->FieldName(i));
 		d->Add("=");
 
-		const auto& v = (*record_val)[i];
+		auto v = GetField(i);
 
 		if ( v )
 			v->Describe(d);
@@ -3076,15 +3447,27 @@ ValPtr RecordVal::DoClone(CloneState* state)
 	// record. As we cannot guarantee that it will ber zeroed out at the
 	// approproate time (as it seems to be guaranteed for the original record)
 	// we don't touch it.
+	ResolveDeferredFields();
+
 	auto rv = make_intrusive<RecordVal>(GetType<RecordType>(), false);
 	rv->origin = nullptr;
 	state->NewClone(this, rv);
 
-	for ( const auto& vlv : *record_val)
-		{
-		auto v = vlv ? vlv->Clone(state) : nullptr;
-  		rv->AppendField(std::move(v));
-		}
+	auto rt = RecType();
+	rv->record_val = record_val;
+	rv->is_set = is_set;
+
+	// Atomic values get copied along with the slots, the rest need
+	// cloning.
+	for ( auto i = 0u; i < is_set.size(); ++i )
+		if ( is_set[i] && rt->FieldKind(i) == FIELD_VAL )
+			{
+			auto& slot = rv->record_val[rt->FieldSlot(i)];
+			slot.val = slot.val->Clone(state).release();
+
+			if ( ! slot.val )
+				rv->is_set[i] = false;
+			}
 
 	return rv;
 	}
@@ -3092,16 +3475,14 @@ ValPtr RecordVal::DoClone(CloneState* state)
 unsigned int RecordVal::MemoryAllocation() const
 	{
 	unsigned int size = 0;
-	const auto& vl = *record_val;
+	auto rt = RecType();
 
-	for ( const auto& v : vl )
-		{
-		if ( v )
-		    size += v->MemoryAllocation();
-		}
+	for ( auto i = 0u; i < is_set.size(); ++i )
+		if ( is_set[i] && rt->FieldKind(i) == FIELD_VAL )
+			size += record_val[rt->FieldSlot(i)].val->MemoryAllocation();
 
-	size += util::pad_size(vl.capacity() * sizeof(ValPtr));
-	size += padded_sizeof(vl);
+	size += util::pad_size(record_val.capacity() * sizeof(Slot));
+	size += util::pad_size((is_set.capacity() + 7) / 8);
 	return size + padded_sizeof(*this);
 	}
 
@@ -3647,4 +4028,49 @@ const PortValPtr& ValManager::Port(uint32_t port_num) const
 		return Port(port_num, TRANSPORT_UNKNOWN);
 	}
 
+StringValPtr ValManager::InternString(const char* s, int len)
+	{
+	++intern_stats.lookups;
+
+	if ( len == 0 )
+		{
+		++intern_stats.hits;
+		return empty_string;
+		}
+
+	auto max_entries = detail::string_intern_max_entries;
+
+	if ( max_entries <= 0 || len > detail::string_intern_max_len )
+		return make_intrusive<StringVal>(len, s);
+
+	auto it = intern_index.find(std::string_view(s, len));
+
+	if ( it != intern_index.end() )
+		{
+		++intern_stats.hits;
+		intern_stats.bytes_saved += len;
+		interned.splice(interned.begin(), interned, it->second);
+		return *it->second;
+		}
+
+	// The index's keys point into the strings themselves, so remove
+	// a string from the index before releasing it.
+	while ( intern_index.size() >= static_cast<size_t>(max_entries) )
+		{
+		const String* old = interned.back()->Get();
+		intern_index.erase(std::string_view((const char*) old->Bytes(), old->Len()));
+		interned.pop_back();
+		++intern_stats.evictions;
+		}
+
+	auto rval = make_intrusive<StringVal>(len, s);
+	const String* str = rval->Get();
+	interned.push_front(rval);
+	intern_index.emplace(std::string_view((const char*) str->Bytes(), str->Len()),
+	                     interned.begin());
+	intern_stats.entries = intern_index.size();
+
+	return rval;
+	}
+
 }
@@ -7,6 +7,7 @@
 #include <list>
 #include <array>
 #include <unordered_map>
+#include <string_view>
 
 #include "zeek/IntrusivePtr.h"
 #include "zeek/Type.h"
@@ -290,7 +291,34 @@ public:
 	// Host-order port number already masked with port space protocol mask.
 	const PortValPtr& Port(uint32_t port_num) const;
 
+	// Returns a string value holding the given bytes, sharing the one
+	// returned by an earlier call for the same bytes if the intern
+	// table still holds it. The table keeps the most recently used
+	// strings, up to string_intern_max_entries of them, and doesn't
+	// intern strings longer than string_intern_max_len.
+	//
+	// Interned values are shared, so the caller must never modify
+	// them (e.g., through StringVal::ToUpper()). This is meant for
+	// analyzers and BiFs producing strings that repeat a lot, like
+	// protocol keywords, MIME types, or host names.
+	StringValPtr InternString(const char* s, int len);
+
+	StringValPtr InternString(std::string_view s)
+		{ return InternString(s.data(), s.size()); }
+
+	struct InternStats {
+		uint64_t lookups = 0;		// calls to InternString()
+		uint64_t hits = 0;		// calls that returned a shared value
+		uint64_t bytes_saved = 0;	// string bytes not allocated due to hits
+		uint64_t evictions = 0;		// entries dropped to stay within bounds
+		uint64_t entries = 0;		// current number of interned strings
+	};
+
+	const InternStats& GetInternStats() const
+		{ return intern_stats; }
+
 private:
+	using InternList = std::list<StringValPtr>;
 
 	std::array<std::array<PortValPtr, 65536>, NUM_PORT_SPACES> ports;
 	std::array<ValPtr, PREALLOCATED_COUNTS> counts;
@@ -298,6 +326,12 @@ private:
 	StringValPtr empty_string;
 	ValPtr b_true;
 	ValPtr b_false;
+
+	// Interned strings, most recently used first, and an index into
+	// that list keyed by the strings' (immutable) bytes.
+	InternList interned;
+	std::unordered_map<std::string_view, InternList::iterator> intern_index;
+	InternStats intern_stats;
 };
 
 extern ValManager* val_mgr;
@@ -679,6 +713,11 @@ protected:
 	// to save a few bytes, as we do not need a high resolution for these
 	// anyway.
 	int expire_access_time;
+
+	// Tags the table's expiration queue entry for this one, or 0 if
+	// there's none.  A queue entry whose tag doesn't match the one of
+	// its key's current entry is stale.
+	uint32_t expire_generation = 0;
 };
 
 class TableValTimer final : public detail::Timer {
@@ -931,6 +970,16 @@ public:
 	 */
 	void EnableChangeNotifications() { in_change_func = false; }
 
+	// Statistics across all tables about the expiration of their entries.
+	struct ExpireStats {
+		uint64_t expired = 0;
+		uint64_t backlog = 0;
+		uint64_t exhausted = 0;
+		double time = 0.0;
+	};
+
+	static const ExpireStats& GetExpireStats()	{ return expire_stats; }
+
 protected:
 	void Init(TableTypePtr t);
 
@@ -949,9 +998,77 @@ protected:
 	// Calculates default value for index.  Returns nullptr if none.
 	ValPtr Default(const ValPtr& index);
 
+	// Looks up the entry for the given index, returning nullptr if
+	// there's none or the index doesn't type-check.  For tables indexed
+	// by a single atomic value, the key doesn't get built on the heap.
+	TableEntryVal* FindEntry(const Val& index) const;
+
+	// Does the work for the Assign() methods.  "k" gets handed over
+	// to the dictionary and is invalid afterwards.
+	bool DoAssign(ValPtr index, detail::HashKey* k, ValPtr new_val,
+	              bool broker_forward, bool* iterators_invalidated);
+
 	// Returns true if item expiration is enabled.
 	bool ExpirationEnabled()	{ return expire_time != nullptr; }
 
+	// An entry of the expiration queue.  "access_time" is the entry's
+	// expire_access_time at the point it got queued, which its current
+	// one never falls below.  "generation" tells whether the key's entry
+	// still is the one queued (see TableEntryVal::expire_generation).
+	// "position" is the key's place in the table once the entry is due.
+	// Like the dictionary's entries, this keeps short keys inline.
+	class ExpireQueueEntry {
+	public:
+		ExpireQueueEntry(int access_time, uint32_t generation,
+		                 const void* key, int key_size, detail::hash_t hash);
+		ExpireQueueEntry(ExpireQueueEntry&& other) noexcept
+			{ *this = std::move(other); }
+		~ExpireQueueEntry()
+			{
+			if ( key_size > 8 )
+				delete [] key;
+			}
+
+		ExpireQueueEntry& operator=(ExpireQueueEntry&& other) noexcept;
+
+		// Returns a key that refers to the entry's bytes, and so is
+		// only valid as long as the entry is.
+		detail::HashKey Key() const
+			{ return {key_size > 8 ? key : key_here, key_size, hash, true}; }
+
+		// Orders the queue as a min-heap.
+		static bool Later(const ExpireQueueEntry& a, const ExpireQueueEntry& b)
+			{ return a.access_time > b.access_time; }
+
+		int access_time;
+		int position = 0;
+		uint32_t generation;
+
+	private:
+		uint32_t hash = 0;
+		int key_size = 0;
+		union {
+			char key_here[8];
+			char* key;
+		};
+	};
+
+	// Adds an entry to the expiration queue.
+	void QueueForExpiration(ExpireQueueEntry qe);
+
+	// Returns the generation for the next entry to queue.
+	uint32_t NextExpireGeneration();
+
+	// Fills the expiration queue with all of the table's entries.
+	void BuildExpireQueue();
+
+	// Discards the expiration queue and backlog.
+	void ClearExpireQueue();
+
+	// Moves all entries that are due at time "t" from the queue
+	// to the backlog.
+	void CollectDueEntries(double t, double timeout);
+
 	// Returns the expiration time defined by %{create,read,write}_expire
 	// attribute, or -1 for unset/invalid values. In the invalid case, an
 	// error will have been reported.
@@ -978,7 +1095,6 @@ protected:
 	detail::ExprPtr expire_time;
 	detail::ExprPtr expire_func;
 	TableValTimer* timer;
-	RobustDictIterator* expire_iterator;
 	detail::PrefixTable* subnets;
 	ValPtr def_val;
 	detail::ExprPtr change_func;
@@ -986,6 +1102,21 @@ protected:
 	// prevent recursion of change functions
 	bool in_change_func = false;
 
+	// Once expiration is enabled, every entry of the table is in either
+	// expire_queue, a min-heap on the entries' access times, or in
+	// expire_backlog, which holds the entries found due in descending
+	// table order.  Expiration thus only visits entries that are due,
+	// in the order that iterating over the table would.  The queue only
+	// gets built when first needed.  Removing an entry leaves it to go
+	// stale in there; once those outnumber the live ones, the queue
+	// gets rebuilt.
+	std::vector<ExpireQueueEntry> expire_queue;
+	std::vector<ExpireQueueEntry> expire_backlog;
+	bool expire_queue_valid = false;
+	uint32_t expire_generation = 0;
+
+	static ExpireStats expire_stats;
+
 	static TableRecordDependencies parse_time_table_record_dependencies;
 	static ParseTimeTableStates parse_time_table_states;
 
@@ -993,6 +1124,21 @@ private:
 	PDict<TableEntryVal>* table_val;
 };
 
+namespace detail {
+
+// Supplies the values of record fields that the record's creator deferred
+// until they get accessed.  See RecordVal::DeferFields().
+class RecordFieldProvider {
+public:
+	virtual ~RecordFieldProvider() = default;
+
+	// Returns the value of the given field of the record, which is
+	// about to be accessed, or nullptr to leave it unset.
+	virtual ValPtr ProvideField(const RecordVal* rv, int field) = 0;
+};
+
+} // namespace detail
+
 class RecordVal final : public Val, public notifier::detail::Modifiable {
 public:
 	explicit RecordVal(RecordTypePtr t, bool init_fields = true);
@@ -1019,37 +1165,103 @@ public:
 	void Assign(int field, Ts&&... args)
 		{ Assign(field, make_intrusive<T>(std::forward<Ts>(args)...)); }
 
+	/**
+	 * Assigns a value to a field of type bool, int or enum, without
+	 * creating a Val for it.
+	 * @param field  The field index to assign.
+	 * @param v  The value to assign.
+	 */
+	void AssignInt(int field, bro_int_t v);
+
+	/**
+	 * Assigns a value to a field of type count or port, without creating
+	 * a Val for it.  For ports, the value includes the protocol mask.
+	 * @param field  The field index to assign.
+	 * @param v  The value to assign.
+	 */
+	void AssignCount(int field, bro_uint_t v);
+
+	/**
+	 * Assigns a value to a field of type double, time or interval,
+	 * without creating a Val for it.
+	 * @param field  The field index to assign.
+	 * @param v  The value to assign.
+	 */
+	void AssignDouble(int field, double v);
+
+	/**
+	 * Assigns a value to a field of type addr, without creating a Val
+	 * for it.
+	 * @param field  The field index to assign.
+	 * @param v  The value to assign.
+	 */
+	void AssignAddr(int field, const IPAddr& v);
+
 	/**
 	 * Appends a value to the record's fields.  The caller is responsible
 	 * for ensuring that fields are appended in the correct orer and
 	 * with the correct type.
 	 * @param v  The value to append.
 	 */
-	void AppendField(ValPtr v)
-		{ record_val->emplace_back(std::move(v)); }
+	void AppendField(ValPtr v);
 
 	/**
 	 * Ensures that the record has enough internal storage for the
 	 * given number of fields.
 	 * @param n  The number of fields.
 	 */
-	void Reserve(unsigned int n)
-		{ record_val->reserve(n); }
+	void Reserve(unsigned int n);
 
 	/**
 	 * Returns the number of fields in the record.
 	 * @return  The number of fields in the record.
 	 */
 	unsigned int NumFields()
-		{ return record_val->size(); }
+		{ return is_set.size(); }
+
+	/**
+	 * Returns whether a given field index has a value.
+	 * @param field  The field index to check.
+	 * @return  True if the field is set.
+	 */
+	bool HasField(int field) const
+		{
+		Resolve(field);
+		return is_set[field];
+		}
+
+	/**
+	 * Defers the given fields until they're first accessed, at which
+	 * point the provider supplies their values.  Fields that are set
+	 * already keep their value until then.  Assigning a deferred field
+	 * cancels its deferral.  Filling in a deferred field doesn't count
+	 * as modifying the record.
+	 * @param p  The provider of the fields' values.  It needs to stay
+	 * around until it has provided all of them, or until
+	 * ResolveDeferredFields() is called.
+	 * @param fields  A bitmask of the fields' indices, which need to be
+	 * below 64.
+	 */
+	void DeferFields(detail::RecordFieldProvider* p, uint64_t fields)
+		{
+		field_provider = p;
+		deferred_fields |= fields;
+		}
 
 	/**
-	 * Returns the value of a given field index.
+	 * Has the provider supply all deferred fields, and forgets about it.
+	 */
+	void ResolveDeferredFields();
+
+	/**
+	 * Returns the value of a given field index.  Fields of atomic types
+	 * (see RecordFieldKind) don't store their values as Val's, so for
+	 * those this creates one, unless it's a shared instance such as
+	 * small counts.  Prefer GetFieldAs() to access such fields.
 	 * @param field  The field index to retrieve.
-	 * @return  The value at the given field index.
+	 * @return  The value at the given field index, or nil if it's unset.
 	 */
-	const ValPtr& GetField(int field) const
-		{ return (*record_val)[field]; }
+	ValPtr GetField(int field) const;
 
 	/**
 	 * Returns the value of a given field index as cast to type @c T.
@@ -1076,7 +1288,7 @@ public:
 	 * @return  The value of the given field.  If no such field name exists,
 	 * a fatal error occurs.
 	 */
-	const ValPtr& GetField(const char* field) const;
+	ValPtr GetField(const char* field) const;
 
 	/**
 	 * Returns the value of a given field name as cast to type @c T.
@@ -1111,23 +1323,39 @@ public:
 		{ return cast_intrusive<T>(GetField(field)); }
 
 	// The following return the given field converted to a particular
-	// underlying value.  We provide these to enable efficient
-	// access to record fields (without requiring an intermediary Val)
-	// if we change the underlying representation of records.
+	// underlying value.  They access record fields efficiently, without
+	// requiring an intermediary Val.  The field must be set, and @c T
+	// must correspond to its type.
 	template <typename T>
     auto GetFieldAs(int field) const -> std::invoke_result_t<decltype(&T::Get), T>
 		{
-		auto& field_ptr = GetField(field);
-		auto field_val_ptr = static_cast<T*>(field_ptr.get());
-		return field_val_ptr->Get();
+		Resolve(field);
+
+		const auto& slot = record_val[RecType()->FieldSlot(field)];
+
+		if constexpr ( std::is_same_v<T, PortVal> )
+			return val_mgr->Port(slot.uint_val).get();
+		else if constexpr ( std::is_same_v<T, AddrVal> )
+			return *reinterpret_cast<const IPAddr*>(&slot);
+		else if constexpr ( std::is_base_of_v<detail::IntValImplementation, T> )
+			return slot.int_val;
+		else if constexpr ( std::is_base_of_v<detail::UnsignedValImplementation, T> )
+			return slot.uint_val;
+		else if constexpr ( std::is_base_of_v<detail::DoubleValImplementation, T> )
+			return slot.double_val;
+		else
+			return static_cast<T*>(slot.val)->Get();
 		}
 
 	template <typename T>
     auto GetFieldAs(const char* field) const -> std::invoke_result_t<decltype(&T::Get), T>
 		{
-		auto& field_ptr = GetField(field);
-		auto field_val_ptr = static_cast<T*>(field_ptr.get());
-		return field_val_ptr->Get();
+		int idx = RecType()->FieldOffset(field);
+
+		if ( idx < 0 )
+			reporter->InternalError("missing record field: %s", field);
+
+		return GetFieldAs<T>(idx);
 		}
 
 	void Describe(ODesc* d) const override;
@@ -1180,7 +1408,45 @@ protected:
 	static RecordTypeValMap parse_time_records;
 
 private:
-	std::vector<ValPtr>* record_val;
+	const RecordType* RecType() const
+		{ return static_cast<const RecordType*>(type.get()); }
+
+	// Stores the value into the field's slots, taking over its reference
+	// if it's kept as a Val.  Doesn't flag the record as modified.
+	void SetField(int field, ValPtr v);
+
+	// Releases any Val the field holds and marks it as unset.
+	void ClearField(int field);
+
+	// Has the provider supply the field first if it's deferred.
+	void Resolve(int field) const
+		{
+		if ( deferred_fields && field < 64 && ((deferred_fields >> field) & 1) )
+			const_cast<RecordVal*>(this)->ResolveField(field);
+		}
+
+	void ResolveField(int field);
+
+	// The storage for a field's value, or half of it for addresses.
+	// Which member is valid follows from the field's RecordFieldKind.
+	union Slot {
+		bro_int_t int_val;
+		bro_uint_t uint_val;
+		double double_val;
+		Val* val;	// we hold a reference
+		uint64_t bits;
+	};
+
+	// The field values, laid out as given by the record type's
+	// FieldSlot().
+	std::vector<Slot> record_val;
+
+	// Which fields have a value.
+	std::vector<bool> is_set;
+
+	// Fields whose value is up to the provider, by bit.
+	detail::RecordFieldProvider* field_provider = nullptr;
+	uint64_t deferred_fields = 0;
 };
 
 class EnumVal final : public detail::IntValImplementation {
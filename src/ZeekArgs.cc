@@ -6,6 +6,14 @@
 
 namespace zeek {
 
+// Bounds on the argument lists kept for reuse, and on their sizes.
+static constexpr size_t MAX_SPARE_ARGS = 1024;
+static constexpr size_t MAX_SPARE_ARGS_CAPACITY = 32;
+
+// Argument lists released for reuse.  Never destroyed, as lists may get
+// released during the destruction of other static objects.
+static std::vector<Args>* spare_args = new std::vector<Args>;
+
 Args val_list_to_args(const ValPList& vl)
 	{
 	Args rval;
@@ -17,6 +25,31 @@ Args val_list_to_args(const ValPList& vl)
 	return rval;
 	}
 
+Args acquire_args(size_t n)
+	{
+	Args rval;
+
+	if ( ! spare_args->empty() )
+		{
+		rval = std::move(spare_args->back());
+		spare_args->pop_back();
+		}
+
+	rval.reserve(n);
+	return rval;
+	}
+
+void release_args(Args&& args)
+	{
+	args.clear();
+
+	if ( args.capacity() == 0 || args.capacity() > MAX_SPARE_ARGS_CAPACITY ||
+	     spare_args->size() >= MAX_SPARE_ARGS )
+		return;
+
+	spare_args->emplace_back(std::move(args));
+	}
+
 VectorValPtr MakeCallArgumentVector(const Args& vals,
                                     const RecordTypePtr& types)
     {
@@ -27,6 +27,22 @@ using Args = std::vector<ValPtr>;
  */
 Args val_list_to_args(const ValPList& vl);
 
+/**
+ * Returns an empty argument list with room for at least the given number
+ * of arguments.  Its storage comes from a list previously handed back
+ * through release_args() if there is one, avoiding a heap allocation.
+ * @param n  the number of arguments to reserve room for
+ * @return  the empty argument list
+ */
+Args acquire_args(size_t n);
+
+/**
+ * Clears an argument list and keeps its storage around for reuse by
+ * acquire_args(), within limits.
+ * @param args  the argument list to release
+ */
+void release_args(Args&& args);
+
 /**
  * Creates a vector of "call_argument" meta data describing the arguments to
  * function/event invocation.
@@ -578,7 +578,11 @@ public:
 		std::is_convertible_v<
 			std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	EnqueueConnEvent(EventHandlerPtr h, Args&&... args)
-		{ return EnqueueConnEvent(h, zeek::Args{std::forward<Args>(args)...}); }
+		{
+		auto vl = acquire_args(sizeof...(args));
+		(vl.push_back(std::forward<Args>(args)), ...);
+		return EnqueueConnEvent(h, std::move(vl));
+		}
 
 	/**
 	 * Convenience function that forwards directly to the corresponding
@@ -174,9 +174,10 @@ void ConnSize_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	RecordVal* orig_endp = conn_val->GetField("orig")->AsRecordVal();
 	RecordVal* resp_endp = conn_val->GetField("resp")->AsRecordVal();
 
-	// endpoint is the RecordType from NetVar.h
-	int pktidx = id::endpoint->FieldOffset("num_pkts");
-	int bytesidx = id::endpoint->FieldOffset("num_bytes_ip");
+	// endpoint is the RecordType from NetVar.h.  This runs for every
+	// ConnVal(), so look up the fields just once.
+	static int pktidx = id::endpoint->FieldOffset("num_pkts");
+	static int bytesidx = id::endpoint->FieldOffset("num_bytes_ip");
 
 	if ( pktidx < 0 )
 		reporter->InternalError("'endpoint' record missing 'num_pkts' field");
@@ -184,10 +185,10 @@ void ConnSize_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	if ( bytesidx < 0 )
 		reporter->InternalError("'endpoint' record missing 'num_bytes_ip' field");
 
-	orig_endp->Assign(pktidx, val_mgr->Count(orig_pkts));
-	orig_endp->Assign(bytesidx, val_mgr->Count(orig_bytes));
-	resp_endp->Assign(pktidx, val_mgr->Count(resp_pkts));
-	resp_endp->Assign(bytesidx, val_mgr->Count(resp_bytes));
+	orig_endp->AssignCount(pktidx, orig_pkts);
+	orig_endp->AssignCount(bytesidx, orig_bytes);
+	resp_endp->AssignCount(pktidx, resp_pkts);
+	resp_endp->AssignCount(bytesidx, resp_bytes);
 
 	Analyzer::UpdateConnVal(conn_val);
 	}
@@ -1253,7 +1253,7 @@ int HTTP_Analyzer::HTTP_RequestLine(const char* line, const char* end_of_line)
 		return -1;
 		}
 
-	request_method = make_intrusive<StringVal>(end_of_method - line, line);
+	request_method = val_mgr->InternString(line, end_of_method - line);
 
 	Conn()->Match(zeek::detail::Rule::HTTP_REQUEST,
 			(const u_char*) unescaped_URI->AsString()->Bytes(),
@@ -1409,7 +1409,7 @@ void HTTP_Analyzer::HTTP_Request()
 			request_method,
 			TruncateURI(request_URI),
 			TruncateURI(unescaped_URI),
-			make_intrusive<StringVal>(util::fmt("%.1f", request_version.ToDouble()))
+			val_mgr->InternString(util::fmt("%.1f", request_version.ToDouble()))
 		);
 	}
 
@@ -1646,14 +1646,11 @@ void HTTP_Analyzer::HTTP_Header(bool is_orig, analyzer::mime::MIME_Header* h)
 		if ( DEBUG_http )
 			DEBUG_MSG("%.6f http_header\n", run_state::network_time);
 
-		auto upper_hn = analyzer::mime::to_string_val(h->get_name());
-		upper_hn->ToUpper();
-
 		EnqueueConnEvent(http_header,
 			ConnVal(),
 			val_mgr->Bool(is_orig),
-			analyzer::mime::to_string_val(h->get_name()),
-			std::move(upper_hn),
+			analyzer::mime::to_interned_string_val(h->get_name()),
+			analyzer::mime::to_interned_string_val(h->get_name(), true),
 			analyzer::mime::to_string_val(h->get_value())
 		);
 		}
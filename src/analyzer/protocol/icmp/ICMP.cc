@@ -472,14 +472,14 @@ void ICMP_Analyzer::UpdateEndpointVal(const ValPtr& endp_arg, bool is_orig)
 
 	if ( size < 0 )
 		{
-		endp->Assign(0, val_mgr->Count(0));
-		endp->Assign(1, val_mgr->Count(int(ICMP_INACTIVE)));
+		endp->AssignCount(0, 0);
+		endp->AssignCount(1, int(ICMP_INACTIVE));
 		}
 
 	else
 		{
-		endp->Assign(0, val_mgr->Count(size));
-		endp->Assign(1, val_mgr->Count(int(ICMP_ACTIVE)));
+		endp->AssignCount(0, size);
+		endp->AssignCount(1, int(ICMP_ACTIVE));
 		}
 	}
 
@@ -271,6 +271,10 @@ extern bool is_null_data_chunk(data_chunk_t b);
 extern StringValPtr to_string_val(int length, const char* data);
 extern StringValPtr to_string_val(const char* data, const char* end_of_data);
 extern StringValPtr to_string_val(const data_chunk_t buf);
+// Like to_string_val(), but returns a value shared through the intern
+// table (see ValManager::InternString()), optionally upper-cased first.
+// Callers must not modify the result.
+extern StringValPtr to_interned_string_val(const data_chunk_t buf, bool upper = false);
 extern int fputs(data_chunk_t b, FILE* fp);
 extern bool istrequal(data_chunk_t s, const char* t);
 extern bool is_lws(char ch);
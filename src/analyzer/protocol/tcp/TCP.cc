@@ -1285,10 +1285,10 @@ void TCP_Analyzer::UpdateConnVal(RecordVal *conn_val)
 	RecordVal* orig_endp_val = conn_val->GetField("orig")->AsRecordVal();
 	RecordVal* resp_endp_val = conn_val->GetField("resp")->AsRecordVal();
 
-	orig_endp_val->Assign(0, val_mgr->Count(orig->Size()));
-	orig_endp_val->Assign(1, val_mgr->Count(int(orig->state)));
-	resp_endp_val->Assign(0, val_mgr->Count(resp->Size()));
-	resp_endp_val->Assign(1, val_mgr->Count(int(resp->state)));
+	orig_endp_val->AssignCount(0, orig->Size());
+	orig_endp_val->AssignCount(1, int(orig->state));
+	resp_endp_val->AssignCount(0, resp->Size());
+	resp_endp_val->AssignCount(1, int(resp->state));
 
 	// Call children's UpdateConnVal
 	Analyzer::UpdateConnVal(conn_val);
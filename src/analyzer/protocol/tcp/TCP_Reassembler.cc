@@ -379,6 +379,32 @@ void TCP_Reassembler::RecordGap(uint64_t start_seq, uint64_t upper_seq, const Fi
 		);
 	}
 
+bool TCP_Reassembler::DeliverUnbuffered(uint64_t seq, uint64_t len, const u_char* data)
+	{
+	// Delivered data stays buffered while the peer processes acks, for
+	// checking retransmissions against it; BlockInserted() only drops it
+	// right away if the peer doesn't.  Old blocks and contents files
+	// need the data in a block, too.
+	if ( endp->peer->HasContents() || max_old_blocks || record_contents_file )
+		return false;
+
+	last_reassem_seq += len;
+	DeliverBlock(seq, len, data);
+	TrimToSeq(last_reassem_seq);
+	return true;
+	}
+
+void TCP_Reassembler::ShedBuffers()
+	{
+	tcp_analyzer->Weird("tcp_reassembly_memory_shed");
+
+	// Skip over any holes and deliver what's buffered behind them.
+	if ( HasBlocks() )
+		TrimToSeq(block_list.LastBlock().upper);
+
+	ClearOldBlocks();
+	}
+
 void TCP_Reassembler::BlockInserted(DataBlockMap::const_iterator it)
 	{
 	const auto& start_block = it->second;
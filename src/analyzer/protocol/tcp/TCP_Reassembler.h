@@ -95,6 +95,8 @@ private:
 	void RecordBlock(const DataBlock& b, const FilePtr& f);
 	void RecordGap(uint64_t start_seq, uint64_t upper_seq, const FilePtr& f);
 
+	bool DeliverUnbuffered(uint64_t seq, uint64_t len, const u_char* data) override;
+	void ShedBuffers() override;
 	void BlockInserted(DataBlockMap::const_iterator it) override;
 	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
 
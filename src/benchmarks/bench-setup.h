@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "zeek/zeek-setup.h"
+#include "zeek/Options.h"
+
+namespace zeek::detail {
+
+/**
+ * Initializes Zeek far enough for benchmarks to use its internal classes:
+ * bare-mode scripts, deterministic hashing and no log output. If given,
+ * *script_code* gets loaded in addition, as with ``zeek -e``. Aborts on
+ * failure.
+ */
+inline void bench_setup(int argc, char** argv, const char* script_code = nullptr)
+	{
+	zeek::Options options;
+	options.bare_mode = true;
+	options.deterministic_mode = true;
+	options.ignore_checksums = true;
+	options.script_options_to_set.emplace_back("Log::default_writer=Log::WRITER_NONE");
+
+	if ( script_code )
+		options.script_code_to_exec = script_code;
+
+	if ( setup(argc, argv, &options).code )
+		abort();
+	}
+
+/**
+ * Wall-clock stopwatch for timing a benchmark loop.
+ */
+class BenchTimer {
+public:
+	BenchTimer()	{ Restart(); }
+
+	void Restart()	{ start = std::chrono::steady_clock::now(); }
+
+	double Elapsed() const
+		{
+		std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+		return d.count();
+		}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * Prints one result line in the common benchmark output format.
+ */
+inline void bench_report(const char* name, uint64_t ops, double secs)
+	{
+	printf("%-48s %12.0f ops/s %10.2f ns/op\n", name,
+	       secs > 0 ? ops / secs : 0.0, ops ? secs * 1e9 / ops : 0.0);
+	fflush(stdout);
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,106 @@
+// Measures the rate of script function, hook and event handler invocations
+// for small bodies, where setting up and tearing down the Frame is a large
+// part of the cost. Each runs once with frames reused through Frame's pool
+// and once with the pool disabled, which allocates a new frame per call as
+// Zeek used to.
+//
+// Usage: zeek-call-bench [calls]   (default: 5M)
+
+#include "bench-setup.h"
+
+#include "zeek/Event.h"
+#include "zeek/EventRegistry.h"
+#include "zeek/Frame.h"
+#include "zeek/Func.h"
+#include "zeek/ID.h"
+#include "zeek/Val.h"
+
+using namespace zeek::detail;
+
+static const char* bench_script = R"(
+global bench_total = 0;
+
+function bench_func(a: count, b: count): count
+	{
+	local sum = a + b;
+	return sum * 2;
+	}
+
+hook bench_hook(c: count)
+	{
+	if ( c == 0 )
+		break;
+	}
+
+event bench_event(c: count)
+	{
+	bench_total += c;
+	}
+)";
+
+static void bench_invoke(const char* what, const zeek::FuncPtr& func, size_t n)
+	{
+	zeek::Args args{zeek::val_mgr->Count(1), zeek::val_mgr->Count(2)};
+	args.resize(func->GetType()->Params()->NumFields());
+
+	BenchTimer t;
+
+	for ( size_t i = 0; i < n; ++i )
+		func->Invoke(&args);
+
+	bench_report(what, n, t.Elapsed());
+	}
+
+static void bench_events(const char* what, size_t n)
+	{
+	zeek::EventHandlerPtr h = zeek::event_registry->Lookup("bench_event");
+
+	// Queue events in chunks, as packet processing would between drains.
+	const size_t chunk = 1000;
+
+	BenchTimer t;
+
+	for ( size_t i = 0; i < n; i += chunk )
+		{
+		for ( size_t j = 0; j < chunk; ++j )
+			zeek::event_mgr.Enqueue(h, zeek::val_mgr->Count(1));
+
+		zeek::event_mgr.Drain();
+		}
+
+	bench_report(what, n, t.Elapsed());
+	}
+
+int main(int argc, char** argv)
+	{
+	size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+
+	bench_setup(1, argv, bench_script);
+
+	auto func = zeek::id::find_func("bench_func");
+	auto hook = zeek::id::find_func("bench_hook");
+
+	if ( ! func || ! hook || ! zeek::event_registry->Lookup("bench_event") )
+		{
+		fprintf(stderr, "benchmark script failed to load\n");
+		return 1;
+		}
+
+	for ( bool pooled : {false, true} )
+		{
+		Frame::SetPoolLimit(pooled ? 32 : 0);
+		const char* suffix = pooled ? "pooled frames" : "new frames";
+		char name[64];
+
+		snprintf(name, sizeof(name), "function calls, %s", suffix);
+		bench_invoke(name, func, n);
+
+		snprintf(name, sizeof(name), "hook calls, %s", suffix);
+		bench_invoke(name, hook, n);
+
+		snprintf(name, sizeof(name), "event dispatch, %s", suffix);
+		bench_events(name, n);
+		}
+
+	return 0;
+	}
@@ -0,0 +1,145 @@
+// Compares the flat ConnectionTable used by NetSessions against the
+// std::map it replaced, for insert, lookup (hit and miss), and removal.
+//
+// Usage: zeek-conn-table-bench [num_flows ...]   (default: 1M and 10M)
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "bench-setup.h"
+
+#include "zeek/ConnTable.h"
+
+using namespace zeek::detail;
+
+static std::vector<ConnIDKey> make_keys(size_t n, uint32_t seed)
+	{
+	std::vector<ConnIDKey> keys(n);
+	std::mt19937 rng(seed);
+
+	for ( auto& k : keys )
+		{
+		// IPv4-mapped IPv6 addresses, like BuildConnIDKey() produces.
+		k.ip1.s6_addr[10] = k.ip1.s6_addr[11] = 0xff;
+		k.ip2.s6_addr[10] = k.ip2.s6_addr[11] = 0xff;
+		uint32_t a1 = rng(), a2 = rng();
+		memcpy(&k.ip1.s6_addr[12], &a1, 4);
+		memcpy(&k.ip2.s6_addr[12], &a2, 4);
+		k.port1 = static_cast<uint16_t>(rng());
+		k.port2 = static_cast<uint16_t>(rng());
+		}
+
+	return keys;
+	}
+
+static zeek::Connection* fake_conn(size_t i)
+	{
+	return reinterpret_cast<zeek::Connection*>((i + 1) * 8);
+	}
+
+static void bench_map(const std::vector<ConnIDKey>& keys,
+                      const std::vector<ConnIDKey>& lookups,
+                      const std::vector<ConnIDKey>& misses)
+	{
+	std::map<ConnIDKey, zeek::Connection*> m;
+	char name[64];
+	uint64_t found = 0;
+
+	BenchTimer t;
+	for ( size_t i = 0; i < keys.size(); ++i )
+		m[keys[i]] = fake_conn(i);
+	snprintf(name, sizeof(name), "std::map insert (%zu)", keys.size());
+	bench_report(name, keys.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : lookups )
+		{
+		auto it = m.find(k);
+		found += it != m.end() ? 1 : 0;
+		}
+	snprintf(name, sizeof(name), "std::map lookup hit (%zu)", keys.size());
+	bench_report(name, lookups.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : misses )
+		found += m.find(k) != m.end() ? 1 : 0;
+	snprintf(name, sizeof(name), "std::map lookup miss (%zu)", keys.size());
+	bench_report(name, misses.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : lookups )
+		m.erase(k);
+	snprintf(name, sizeof(name), "std::map remove (%zu)", keys.size());
+	bench_report(name, lookups.size(), t.Elapsed());
+
+	if ( found != lookups.size() )
+		fprintf(stderr, "std::map: unexpected lookup results\n");
+	}
+
+static void bench_table(const std::vector<ConnIDKey>& keys,
+                        const std::vector<ConnIDKey>& lookups,
+                        const std::vector<ConnIDKey>& misses)
+	{
+	ConnectionTable ct;
+	char name[64];
+	uint64_t found = 0;
+
+	// Hashing is part of the per-packet cost, so it's included in each
+	// measurement just like NetSessions::ProcessTransportLayer() does it.
+	BenchTimer t;
+	for ( size_t i = 0; i < keys.size(); ++i )
+		ct.Insert(keys[i], ConnectionTable::Hash(keys[i]), fake_conn(i));
+	snprintf(name, sizeof(name), "ConnectionTable insert (%zu)", keys.size());
+	bench_report(name, keys.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : lookups )
+		found += ct.Lookup(k, ConnectionTable::Hash(k)) ? 1 : 0;
+	snprintf(name, sizeof(name), "ConnectionTable lookup hit (%zu)", keys.size());
+	bench_report(name, lookups.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : misses )
+		found += ct.Lookup(k, ConnectionTable::Hash(k)) ? 1 : 0;
+	snprintf(name, sizeof(name), "ConnectionTable lookup miss (%zu)", keys.size());
+	bench_report(name, misses.size(), t.Elapsed());
+
+	printf("%-48s %12zu bytes\n", "ConnectionTable memory", ct.MemoryAllocation());
+
+	t.Restart();
+	for ( const auto& k : lookups )
+		ct.Remove(k, ConnectionTable::Hash(k));
+	snprintf(name, sizeof(name), "ConnectionTable remove (%zu)", keys.size());
+	bench_report(name, lookups.size(), t.Elapsed());
+
+	if ( found != lookups.size() )
+		fprintf(stderr, "ConnectionTable: unexpected lookup results\n");
+	}
+
+int main(int argc, char** argv)
+	{
+	std::vector<size_t> sizes;
+
+	for ( int i = 1; i < argc; ++i )
+		sizes.push_back(strtoull(argv[i], nullptr, 10));
+
+	if ( sizes.empty() )
+		sizes = {1000000, 10000000};
+
+	bench_setup(1, argv);
+
+	for ( auto n : sizes )
+		{
+		auto keys = make_keys(n, 1);
+		auto misses = make_keys(n, 2);
+		auto lookups = keys;
+		std::shuffle(lookups.begin(), lookups.end(), std::mt19937(3));
+
+		bench_map(keys, lookups, misses);
+		bench_table(keys, lookups, misses);
+		}
+
+	return 0;
+	}
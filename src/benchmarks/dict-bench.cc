@@ -0,0 +1,176 @@
+// Measures zeek::Dictionary throughput for insertion, lookup (hit and miss),
+// iteration, and removal, with keys shaped like those of common script
+// tables: 8-byte counts, 16-byte addresses, and 48-byte composite keys
+// such as a conn_id's. std::unordered_map over the same keys and hashes
+// serves as a point of reference.
+//
+// Usage: zeek-dict-bench [num_entries ...]   (default: 10K, 100K and 1M)
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench-setup.h"
+
+#include "zeek/Dict.h"
+#include "zeek/Hash.h"
+
+using namespace zeek::detail;
+
+namespace {
+
+struct Key {
+	std::string bytes;
+	hash_t hash;
+};
+
+struct KeyHash {
+	size_t operator()(const Key& k) const	{ return k.hash; }
+};
+
+struct KeyEqual {
+	bool operator()(const Key& a, const Key& b) const	{ return a.bytes == b.bytes; }
+};
+
+std::vector<Key> make_keys(size_t n, size_t key_size, uint32_t seed)
+	{
+	std::vector<Key> keys(n);
+	std::mt19937_64 rng(seed);
+
+	for ( auto& k : keys )
+		{
+		k.bytes.resize(key_size);
+
+		for ( size_t i = 0; i < key_size; i += sizeof(uint64_t) )
+			{
+			uint64_t r = rng();
+			memcpy(&k.bytes[i], &r, std::min(sizeof(r), key_size - i));
+			}
+
+		k.hash = HashKey::HashBytes(k.bytes.data(), k.bytes.size());
+		}
+
+	return keys;
+	}
+
+void* fake_val(size_t i)
+	{
+	return reinterpret_cast<void*>((i + 1) * 8);
+	}
+
+void report(const char* impl, const char* op, size_t key_size, size_t n,
+            uint64_t ops, double secs)
+	{
+	char name[64];
+	snprintf(name, sizeof(name), "%s %s (%zuB keys, %zu)", impl, op, key_size, n);
+	bench_report(name, ops, secs);
+	}
+
+void bench_dict(const std::vector<Key>& keys, const std::vector<Key>& lookups,
+                const std::vector<Key>& misses, size_t key_size)
+	{
+	zeek::Dictionary d;
+	uint64_t found = 0;
+
+	BenchTimer t;
+	for ( size_t i = 0; i < keys.size(); ++i )
+		d.Insert((void*) keys[i].bytes.data(), key_size, keys[i].hash, fake_val(i), true);
+	report("Dictionary", "insert", key_size, keys.size(), keys.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : lookups )
+		found += d.Lookup(k.bytes.data(), key_size, k.hash) ? 1 : 0;
+	report("Dictionary", "lookup hit", key_size, keys.size(), lookups.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : misses )
+		found += d.Lookup(k.bytes.data(), key_size, k.hash) ? 1 : 0;
+	report("Dictionary", "lookup miss", key_size, keys.size(), misses.size(), t.Elapsed());
+
+	t.Restart();
+	uintptr_t sum = 0;
+	for ( const auto& e : d )
+		sum += reinterpret_cast<uintptr_t>(e.value);
+	report("Dictionary", "iterate", key_size, keys.size(), d.Length(), t.Elapsed());
+
+	char name[64];
+	snprintf(name, sizeof(name), "Dictionary memory (%zuB keys, %zu)", key_size, keys.size());
+	printf("%-48s %12zu bytes\n", name, d.MemoryAllocation());
+
+	t.Restart();
+	for ( const auto& k : lookups )
+		d.Remove(k.bytes.data(), key_size, k.hash);
+	report("Dictionary", "remove", key_size, keys.size(), lookups.size(), t.Elapsed());
+
+	if ( found != lookups.size() || sum == 0 )
+		fprintf(stderr, "Dictionary: unexpected lookup results\n");
+	}
+
+void bench_unordered_map(const std::vector<Key>& keys, const std::vector<Key>& lookups,
+                         const std::vector<Key>& misses, size_t key_size)
+	{
+	std::unordered_map<Key, void*, KeyHash, KeyEqual> m;
+	uint64_t found = 0;
+
+	BenchTimer t;
+	for ( size_t i = 0; i < keys.size(); ++i )
+		m[keys[i]] = fake_val(i);
+	report("unordered_map", "insert", key_size, keys.size(), keys.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : lookups )
+		found += m.find(k) != m.end() ? 1 : 0;
+	report("unordered_map", "lookup hit", key_size, keys.size(), lookups.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : misses )
+		found += m.find(k) != m.end() ? 1 : 0;
+	report("unordered_map", "lookup miss", key_size, keys.size(), misses.size(), t.Elapsed());
+
+	t.Restart();
+	uintptr_t sum = 0;
+	for ( const auto& e : m )
+		sum += reinterpret_cast<uintptr_t>(e.second);
+	report("unordered_map", "iterate", key_size, keys.size(), m.size(), t.Elapsed());
+
+	t.Restart();
+	for ( const auto& k : lookups )
+		m.erase(k);
+	report("unordered_map", "remove", key_size, keys.size(), lookups.size(), t.Elapsed());
+
+	if ( found != lookups.size() || sum == 0 )
+		fprintf(stderr, "unordered_map: unexpected lookup results\n");
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+	{
+	std::vector<size_t> sizes;
+
+	for ( int i = 1; i < argc; ++i )
+		sizes.push_back(strtoull(argv[i], nullptr, 10));
+
+	if ( sizes.empty() )
+		sizes = {10000, 100000, 1000000};
+
+	bench_setup(1, argv);
+
+	for ( auto n : sizes )
+		{
+		for ( size_t key_size : {8, 16, 48} )
+			{
+			auto keys = make_keys(n, key_size, 1);
+			auto misses = make_keys(n, key_size, 2);
+			auto lookups = keys;
+			std::shuffle(lookups.begin(), lookups.end(), std::mt19937(3));
+
+			bench_dict(keys, lookups, misses, key_size);
+			bench_unordered_map(keys, lookups, misses, key_size);
+			}
+		}
+
+	return 0;
+	}
@@ -0,0 +1,246 @@
+// Measures records per second rendered by the ASCII and JSON log formatters,
+// set up the way the ASCII writer uses them, for two kinds of records: one
+// like conn.log's, dominated by numbers and addresses, and one like
+// http.log's, dominated by strings such as URIs and user agents, some of
+// which need escaping.
+//
+// Usage: zeek-log-format-bench [records]   (default: 1M)
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench-setup.h"
+
+#include "zeek/Desc.h"
+#include "zeek/threading/SerialTypes.h"
+#include "zeek/threading/formatters/Ascii.h"
+#include "zeek/threading/formatters/JSON.h"
+
+using namespace zeek::detail;
+using zeek::threading::Field;
+using zeek::threading::Value;
+
+namespace {
+
+struct RecordSet {
+	const char* name;
+	std::vector<Field*> fields;
+	std::vector<Value**> records;
+
+	~RecordSet()
+		{
+		for ( auto r : records )
+			Value::delete_value_ptr_array(r, fields.size());
+
+		for ( auto f : fields )
+			delete f;
+		}
+};
+
+Value* count_val(uint64_t c)
+	{
+	auto v = new Value(zeek::TYPE_COUNT);
+	v->val.uint_val = c;
+	return v;
+	}
+
+Value* double_val(zeek::TypeTag t, double d)
+	{
+	auto v = new Value(t);
+	v->val.double_val = d;
+	return v;
+	}
+
+Value* string_val(zeek::TypeTag t, const std::string& s)
+	{
+	auto v = new Value(t);
+	v->val.string_val.data = zeek::util::copy_string(s.c_str());
+	v->val.string_val.length = s.size();
+	return v;
+	}
+
+Value* addr_val(uint32_t a)
+	{
+	auto v = new Value(zeek::TYPE_ADDR);
+	v->val.addr_val.family = IPv4;
+	v->val.addr_val.in.in4.s_addr = htonl(a);
+	return v;
+	}
+
+Value* port_val(uint16_t p)
+	{
+	auto v = new Value(zeek::TYPE_PORT);
+	v->val.port_val.port = p;
+	v->val.port_val.proto = TRANSPORT_TCP;
+	return v;
+	}
+
+Value* unset_val(zeek::TypeTag t)
+	{
+	return new Value(t, false);
+	}
+
+std::string random_token(std::mt19937& rng, size_t len)
+	{
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+	std::string s;
+
+	for ( size_t i = 0; i < len; ++i )
+		s += chars[rng() % (sizeof(chars) - 1)];
+
+	return s;
+	}
+
+void make_conn_records(RecordSet* rs, size_t n)
+	{
+	rs->name = "conn";
+
+	const std::pair<const char*, zeek::TypeTag> fields[] = {
+		{"ts", zeek::TYPE_TIME}, {"uid", zeek::TYPE_STRING},
+		{"id.orig_h", zeek::TYPE_ADDR}, {"id.orig_p", zeek::TYPE_PORT},
+		{"id.resp_h", zeek::TYPE_ADDR}, {"id.resp_p", zeek::TYPE_PORT},
+		{"proto", zeek::TYPE_ENUM}, {"service", zeek::TYPE_STRING},
+		{"duration", zeek::TYPE_INTERVAL}, {"orig_bytes", zeek::TYPE_COUNT},
+		{"resp_bytes", zeek::TYPE_COUNT}, {"conn_state", zeek::TYPE_STRING},
+		{"missed_bytes", zeek::TYPE_COUNT}, {"history", zeek::TYPE_STRING},
+		{"orig_pkts", zeek::TYPE_COUNT}, {"resp_pkts", zeek::TYPE_COUNT},
+	};
+
+	for ( const auto& f : fields )
+		rs->fields.push_back(new Field(f.first, nullptr, f.second, zeek::TYPE_VOID, false));
+
+	std::mt19937 rng(1);
+	double ts = 1600000000.0;
+
+	for ( size_t i = 0; i < n; ++i )
+		{
+		ts += (rng() % 1000) / 1e4;
+
+		auto vals = new Value*[rs->fields.size()];
+		int j = 0;
+		vals[j++] = double_val(zeek::TYPE_TIME, ts);
+		vals[j++] = string_val(zeek::TYPE_STRING, "C" + random_token(rng, 17));
+		vals[j++] = addr_val(0x0a000000 | (rng() & 0xffff));
+		vals[j++] = port_val(1024 + rng() % 60000);
+		vals[j++] = addr_val(rng());
+		vals[j++] = port_val(rng() % 2 ? 443 : 80);
+		vals[j++] = string_val(zeek::TYPE_ENUM, "tcp");
+		vals[j++] = rng() % 4 ? string_val(zeek::TYPE_STRING, "ssl") : unset_val(zeek::TYPE_STRING);
+		vals[j++] = double_val(zeek::TYPE_INTERVAL, (rng() % 100000000) / 1e6);
+		vals[j++] = count_val(rng() % 100000);
+		vals[j++] = count_val(rng() % 10000000);
+		vals[j++] = string_val(zeek::TYPE_STRING, "SF");
+		vals[j++] = count_val(0);
+		vals[j++] = string_val(zeek::TYPE_STRING, "ShADadFf");
+		vals[j++] = count_val(rng() % 1000);
+		vals[j++] = count_val(rng() % 10000);
+		rs->records.push_back(vals);
+		}
+	}
+
+void make_http_records(RecordSet* rs, size_t n)
+	{
+	rs->name = "http";
+
+	const std::pair<const char*, zeek::TypeTag> fields[] = {
+		{"ts", zeek::TYPE_TIME}, {"uid", zeek::TYPE_STRING},
+		{"method", zeek::TYPE_STRING}, {"host", zeek::TYPE_STRING},
+		{"uri", zeek::TYPE_STRING}, {"referrer", zeek::TYPE_STRING},
+		{"user_agent", zeek::TYPE_STRING}, {"status_code", zeek::TYPE_COUNT},
+		{"status_msg", zeek::TYPE_STRING}, {"resp_mime_type", zeek::TYPE_STRING},
+	};
+
+	for ( const auto& f : fields )
+		rs->fields.push_back(new Field(f.first, nullptr, f.second, zeek::TYPE_VOID, false));
+
+	std::mt19937 rng(2);
+	double ts = 1600000000.0;
+
+	for ( size_t i = 0; i < n; ++i )
+		{
+		ts += (rng() % 1000) / 1e4;
+
+		std::string host = "www." + random_token(rng, 8) + ".com";
+		std::string uri = "/" + random_token(rng, 10) + "/" + random_token(rng, 20) +
+			"?q=" + random_token(rng, 30) + "&session=" + random_token(rng, 24);
+
+		// Some URIs carry bytes that need escaping.
+		if ( rng() % 20 == 0 )
+			uri += "\x01\xff%00\\\"";
+
+		std::string ua = rng() % 10 ?
+			"Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/86.0.4240.75 Safari/537.36" :
+			"Mozilla/5.0 (compatible; \xc3\xa9t\xc3\xa9 crawler)";
+
+		auto vals = new Value*[rs->fields.size()];
+		int j = 0;
+		vals[j++] = double_val(zeek::TYPE_TIME, ts);
+		vals[j++] = string_val(zeek::TYPE_STRING, "C" + random_token(rng, 17));
+		vals[j++] = string_val(zeek::TYPE_STRING, "GET");
+		vals[j++] = string_val(zeek::TYPE_STRING, host);
+		vals[j++] = string_val(zeek::TYPE_STRING, uri);
+		vals[j++] = string_val(zeek::TYPE_STRING, "https://" + host + "/");
+		vals[j++] = string_val(zeek::TYPE_STRING, ua);
+		vals[j++] = count_val(200);
+		vals[j++] = string_val(zeek::TYPE_STRING, "OK");
+		vals[j++] = string_val(zeek::TYPE_STRING, "text/html");
+		rs->records.push_back(vals);
+		}
+	}
+
+void bench_formatter(const char* fmt_name, zeek::threading::Formatter* formatter,
+                     zeek::ODesc* desc, const RecordSet& rs)
+	{
+	uint64_t bytes = 0;
+
+	BenchTimer t;
+
+	for ( auto vals : rs.records )
+		{
+		desc->Clear();
+		formatter->Describe(desc, rs.fields.size(), rs.fields.data(), vals);
+		bytes += desc->Len();
+		}
+
+	double secs = t.Elapsed();
+
+	char name[64];
+	snprintf(name, sizeof(name), "%s %s records (%.0f MB/s)", fmt_name, rs.name,
+	         secs > 0 ? bytes / secs / 1e6 : 0.0);
+	bench_report(name, rs.records.size(), secs);
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+	{
+	size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+	bench_setup(1, argv);
+
+	RecordSet conn;
+	RecordSet http;
+	make_conn_records(&conn, n);
+	make_http_records(&http, n);
+
+	// Configured as the ASCII writer does by default.
+	zeek::ODesc ascii_desc;
+	ascii_desc.EnableEscaping();
+	ascii_desc.AddEscapeSequence("\t");
+	zeek::threading::formatter::Ascii::SeparatorInfo sep_info("\t", ",", "-", "(empty)");
+	zeek::threading::formatter::Ascii ascii(nullptr, sep_info);
+
+	zeek::ODesc json_desc;
+	zeek::threading::formatter::JSON json(nullptr, zeek::threading::formatter::JSON::TS_EPOCH);
+	zeek::threading::formatter::JSON json_iso(nullptr, zeek::threading::formatter::JSON::TS_ISO8601);
+
+	for ( const RecordSet* rs : {&conn, &http} )
+		{
+		bench_formatter("ascii", &ascii, &ascii_desc, *rs);
+		bench_formatter("json", &json, &json_desc, *rs);
+		bench_formatter("json-iso8601", &json_iso, &json_desc, *rs);
+		}
+
+	return 0;
+	}
@@ -0,0 +1,187 @@
+// Measures Reassembler::NewBlock() throughput for a stream of fixed-size
+// segments arriving in order, with neighbors swapped, with retransmissions,
+// and with holes that get filled in later. Each scenario runs once copying
+// all data into blocks before delivering it, and once letting the
+// reassembler deliver in-order data straight from the segment when nothing
+// is buffered.
+//
+// Usage: zeek-reassem-bench [segments]   (default: 1M)
+
+#include <algorithm>
+#include <cinttypes>
+#include <random>
+#include <vector>
+
+#include "bench-setup.h"
+
+#include "zeek/Reassem.h"
+
+using namespace zeek::detail;
+
+namespace {
+
+constexpr uint64_t SEGMENT_SIZE = 1460;
+
+struct Segment {
+	uint64_t seq;
+	uint64_t len;
+};
+
+class BenchReassembler final : public zeek::Reassembler {
+public:
+	explicit BenchReassembler(bool arg_unbuffered)
+		: zeek::Reassembler(0), unbuffered(arg_unbuffered)
+		{ }
+
+	uint64_t delivered = 0;
+
+protected:
+	bool DeliverUnbuffered(uint64_t seq, uint64_t len, const u_char* data) override
+		{
+		if ( ! unbuffered )
+			return false;
+
+		last_reassem_seq += len;
+		delivered += len;
+		TrimToSeq(last_reassem_seq);
+		return true;
+		}
+
+	void BlockInserted(zeek::DataBlockMap::const_iterator it) override
+		{
+		if ( it->second.seq > last_reassem_seq || it->second.upper <= last_reassem_seq )
+			return;
+
+		for ( ; it != block_list.End() && it->second.seq <= last_reassem_seq; ++it )
+			{
+			if ( it->second.seq == last_reassem_seq )
+				{
+				delivered += it->second.Size();
+				last_reassem_seq += it->second.Size();
+				}
+			}
+
+		TrimToSeq(last_reassem_seq);
+		}
+
+	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override
+		{ }
+
+private:
+	bool unbuffered;
+};
+
+std::vector<Segment> in_order(size_t n)
+	{
+	std::vector<Segment> segs(n);
+
+	for ( size_t i = 0; i < n; ++i )
+		segs[i] = {i * SEGMENT_SIZE, SEGMENT_SIZE};
+
+	return segs;
+	}
+
+// Swaps about one in ten neighboring segments.
+std::vector<Segment> reordered(size_t n)
+	{
+	auto segs = in_order(n);
+	std::mt19937 rng(1);
+
+	for ( size_t i = 0; i + 1 < n; ++i )
+		if ( rng() % 10 == 0 )
+			std::swap(segs[i], segs[i + 1]);
+
+	return segs;
+	}
+
+// Sends about one in ten segments a second time, shortly after.
+std::vector<Segment> duplicated(size_t n)
+	{
+	auto base = in_order(n);
+	std::vector<Segment> segs;
+	std::mt19937 rng(2);
+
+	for ( size_t i = 0; i < n; ++i )
+		{
+		segs.push_back(base[i]);
+
+		if ( i > 2 && rng() % 10 == 0 )
+			segs.push_back(base[i - 2]);
+		}
+
+	return segs;
+	}
+
+// Holds back one in fifty segments until 32 segments later, leaving a
+// hole with data piling up behind it.
+std::vector<Segment> holes(size_t n)
+	{
+	auto base = in_order(n);
+	std::vector<Segment> segs;
+	std::vector<std::pair<size_t, Segment>> held;
+	std::mt19937 rng(3);
+
+	for ( size_t i = 0; i < n; ++i )
+		{
+		if ( rng() % 50 == 0 )
+			held.emplace_back(i + 32, base[i]);
+		else
+			segs.push_back(base[i]);
+
+		while ( ! held.empty() && held.front().first <= i )
+			{
+			segs.push_back(held.front().second);
+			held.erase(held.begin());
+			}
+		}
+
+	for ( const auto& h : held )
+		segs.push_back(h.second);
+
+	return segs;
+	}
+
+void run(const char* scenario, const std::vector<Segment>& segs, uint64_t total,
+         const std::vector<u_char>& payload)
+	{
+	for ( bool unbuffered : {false, true} )
+		{
+		BenchReassembler r(unbuffered);
+
+		BenchTimer t;
+		for ( const auto& s : segs )
+			r.NewBlock(0.0, s.seq, s.len, payload.data());
+		double secs = t.Elapsed();
+
+		char name[64];
+		snprintf(name, sizeof(name), "NewBlock %s (%s)", scenario,
+		         unbuffered ? "unbuffered" : "buffered");
+		bench_report(name, segs.size(), secs);
+
+		if ( r.delivered != total )
+			fprintf(stderr, "%s: delivered %" PRIu64 " of %" PRIu64 " bytes\n",
+			        name, r.delivered, total);
+		}
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+	{
+	size_t n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+	bench_setup(1, argv);
+
+	std::vector<u_char> payload(SEGMENT_SIZE, 'x');
+	uint64_t total = n * SEGMENT_SIZE;
+
+	run("in-order", in_order(n), total, payload);
+	run("reordered", reordered(n), total, payload);
+	run("duplicated", duplicated(n), total, payload);
+	run("holes", holes(n), total, payload);
+
+	printf("%-48s %12" PRIu64 " bytes\n", "Pooled reassembly buffers",
+	       ReassemblyBufferPool::CachedBytes());
+
+	return 0;
+	}
@@ -0,0 +1,204 @@
+// Measures signature matching throughput for the payload and HTTP reply
+// body patterns of Zeek's shipped signature files, fed with HTTP and SMTP
+// traffic in which none of them match. Runs once with every pattern group
+// seeing all data and once with sig_prefilter holding back groups until
+// one of their literals shows up.
+//
+// Usage: zeek-sig-bench [megabytes [sig-file ...]]   (default: 100)
+
+#include <cinttypes>
+#include <fstream>
+#include <regex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "bench-setup.h"
+
+#include "zeek/RuleMatcher.h"
+#include "zeek/NetVar.h"
+#include "zeek/util.h"
+
+using namespace zeek::detail;
+
+namespace {
+
+const char* default_sig_files[] = {
+	"base/protocols/dce-rpc/dpd.sig",
+	"base/protocols/dhcp/dpd.sig",
+	"base/protocols/dnp3/dpd.sig",
+	"base/protocols/ftp/dpd.sig",
+	"base/protocols/http/dpd.sig",
+	"base/protocols/irc/dpd.sig",
+	"base/protocols/krb/dpd.sig",
+	"base/protocols/pop3/dpd.sig",
+	"base/protocols/rdp/dpd.sig",
+	"base/protocols/rfb/dpd.sig",
+	"base/protocols/sip/dpd.sig",
+	"base/protocols/smb/dpd.sig",
+	"base/protocols/smtp/dpd.sig",
+	"base/protocols/socks/dpd.sig",
+	"base/protocols/ssh/dpd.sig",
+	"base/protocols/ssl/dpd.sig",
+	"base/protocols/tunnels/dpd.sig",
+	"base/protocols/xmpp/dpd.sig",
+	"policy/frameworks/signatures/detect-windows-shells.sig",
+	"policy/protocols/http/detect-webapps.sig",
+	"policy/protocols/mqtt/dpd.sig",
+};
+
+// Copies the patterns of the given files into signatures of their own,
+// without header tests or conditions, which would need a connection.
+std::string write_bench_sigs(const std::vector<std::string>& files)
+	{
+	static const std::regex pattern_line(R"(^\s*(payload|http-reply-body)\s+(/.*/i?)\s*$)");
+
+	std::string path = "zeek-sig-bench.sig";
+	std::ofstream out(path);
+	int n = 0;
+
+	for ( const auto& f : files )
+		{
+		std::ifstream in(zeek::util::find_file(f, zeek::util::zeek_path(), ".sig"));
+
+		if ( ! in )
+			{
+			fprintf(stderr, "can't open %s\n", f.c_str());
+			exit(1);
+			}
+
+		std::string line;
+		std::smatch m;
+
+		while ( std::getline(in, line) )
+			if ( std::regex_match(line, m, pattern_line) )
+				out << "signature bench-" << ++n << " {\n\t" << m[1] << " " << m[2]
+				    << "\n\tevent \"bench\"\n}\n\n";
+		}
+
+	printf("%d patterns\n", n);
+	return path;
+	}
+
+struct Chunk {
+	Rule::PatternType type;
+	std::string data;
+};
+
+// One round of traffic: an HTTP request, its reply body in 1460-byte
+// chunks, and an SMTP session.
+std::vector<Chunk> make_traffic()
+	{
+	std::vector<Chunk> chunks;
+
+	chunks.push_back({Rule::PAYLOAD,
+	                  "GET /index.html HTTP/1.1\r\nHost: www.example.com\r\n"
+	                  "User-Agent: Mozilla/5.0 (X11; Linux x86_64)\r\n"
+	                  "Accept: text/html\r\nConnection: keep-alive\r\n\r\n"});
+
+	std::string body = "<!DOCTYPE html>\n<html>\n<head>\n<title>Example</title>\n"
+	                   "<meta charset=\"utf-8\">\n</head>\n<body>\n";
+
+	for ( int i = 0; body.size() < 64 * 1024; ++i )
+		body += "<div class=\"item\"><p>Paragraph " + std::to_string(i) +
+		        " of some text that looks like a web page, with a "
+		        "<b>few</b> tags and <i>markup</i> in it.</p></div>\n";
+
+	body += "</body>\n</html>\n";
+
+	for ( size_t i = 0; i < body.size(); i += 1460 )
+		chunks.push_back({Rule::HTTP_REPLY_BODY, body.substr(i, 1460)});
+
+	std::string smtp = "EHLO mail.example.com\r\nMAIL FROM:<alice@example.com>\r\n"
+	                   "RCPT TO:<bob@example.org>\r\nDATA\r\n"
+	                   "Subject: Quarterly numbers\r\n\r\n";
+
+	while ( smtp.size() < 32 * 1024 )
+		smtp += "Here are the numbers we talked about during the meeting "
+		        "last week, let me know if anything looks off.\r\n";
+
+	smtp += ".\r\nQUIT\r\n";
+
+	for ( size_t i = 0; i < smtp.size(); i += 1460 )
+		chunks.push_back({Rule::PAYLOAD, smtp.substr(i, 1460)});
+
+	return chunks;
+	}
+
+void run(const char* name, const std::string& sig_file, bool prefilter, uint64_t total)
+	{
+	sig_prefilter = prefilter;
+
+	// The signature parser adds rules to the global matcher.
+	auto* saved_matcher = rule_matcher;
+	auto* matcher = new RuleMatcher();
+	rule_matcher = matcher;
+
+	if ( ! matcher->ReadFiles({sig_file}) )
+		{
+		fprintf(stderr, "can't load %s\n", sig_file.c_str());
+		exit(1);
+		}
+
+	auto traffic = make_traffic();
+	uint64_t round_bytes = 0;
+
+	for ( const auto& c : traffic )
+		round_bytes += c.data.size();
+
+	uint64_t bytes = 0;
+
+	BenchTimer t;
+	while ( bytes < total )
+		{
+		RuleEndpointState* state =
+			matcher->InitEndpoint(nullptr, nullptr, 0, nullptr, true, nullptr);
+
+		bool seen[Rule::TYPES] = { };
+
+		for ( const auto& c : traffic )
+			{
+			matcher->Match(state, c.type,
+			               reinterpret_cast<const u_char*>(c.data.data()),
+			               c.data.size(), ! seen[c.type], false, false);
+			seen[c.type] = true;
+			}
+
+		matcher->FinishEndpoint(state);
+		delete state;
+		bytes += round_bytes;
+		}
+	double secs = t.Elapsed();
+
+	bench_report(name, bytes, secs);
+
+	rule_matcher = saved_matcher;
+	delete matcher;
+	}
+
+} // namespace
+
+int main(int argc, char** argv)
+	{
+	uint64_t megabytes = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100;
+
+	std::vector<std::string> files;
+
+	for ( int i = 2; i < argc; ++i )
+		files.emplace_back(argv[i]);
+
+	if ( files.empty() )
+		files.assign(std::begin(default_sig_files), std::end(default_sig_files));
+
+	bench_setup(1, argv);
+
+	auto sig_file = write_bench_sigs(files);
+	uint64_t total = megabytes * 1024 * 1024;
+
+	run("Match bytes (all groups)", sig_file, false, total);
+	run("Match bytes (sig_prefilter)", sig_file, true, total);
+
+	unlink(sig_file.c_str());
+
+	return 0;
+	}
@@ -17,6 +17,10 @@ using ZeekVal = zeek::Val*;
 using ZeekPortVal = zeek::PortVal*;
 using ZeekStringVal = zeek::StringVal*;
 
+// Returns a string value holding a copy of the given bytes. The copy can't
+// be avoided since scripts may keep the value beyond the packet's lifetime,
+// so analyzers should only call this for an event's arguments after testing
+// the event's handler, e.g. ``if ( my_event )``, which is a single load.
 inline zeek::StringValPtr to_stringval(const_bytestring const& str)
     {
 	return zeek::make_intrusive<zeek::StringVal>(str.length(), (const char*) str.begin());
@@ -1,6 +1,7 @@
 // See the file "COPYING" in the main distribution directory for copyright.
 
 #include "zeek/file_analysis/FileReassembler.h"
+#include "zeek/Reporter.h"
 #include "zeek/file_analysis/File.h"
 
 namespace zeek::file_analysis {
@@ -41,6 +42,21 @@ uint64_t FileReassembler::FlushTo(uint64_t sequence)
 	return rval;
 	}
 
+bool FileReassembler::DeliverUnbuffered(uint64_t seq, uint64_t len, const u_char* data)
+	{
+	// BlockInserted() would throw the data out right after delivery.
+	last_reassem_seq += len;
+	the_file->DeliverStream(data, len);
+	TrimToSeq(last_reassem_seq);
+	return true;
+	}
+
+void FileReassembler::ShedBuffers()
+	{
+	reporter->Weird(the_file, "file_reassembly_memory_shed");
+	Flush();
+	}
+
 void FileReassembler::BlockInserted(DataBlockMap::const_iterator it)
 	{
 	const auto& start_block = it->second;
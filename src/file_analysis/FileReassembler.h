@@ -52,6 +52,8 @@ public:
 protected:
 
 	void Undelivered(uint64_t up_to_seq) override;
+	bool DeliverUnbuffered(uint64_t seq, uint64_t len, const u_char* data) override;
+	void ShedBuffers() override;
 	void BlockInserted(DataBlockMap::const_iterator it) override;
 	void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
 
@@ -4,6 +4,7 @@
 #include "zeek/iosource/PktSrc.h"
 
 #include <sys/stat.h>
+#include <signal.h>
 
 #include "zeek/util.h"
 #include "zeek/Hash.h"
@@ -16,6 +17,8 @@
 
 #include "zeek/iosource/pcap/pcap.bif.h"
 
+extern int signal_val;
+
 namespace zeek::iosource {
 
 PktSrc::Properties::Properties()
@@ -28,7 +31,7 @@ PktSrc::Properties::Properties()
 
 PktSrc::PktSrc()
 	{
-	have_packet = false;
+	batch_pos = batch_len = 0;
 	errbuf = "";
 	SetClosed(true);
 	}
@@ -152,10 +155,31 @@ void PktSrc::Process()
 	if ( ! ExtractNextPacketInternal() )
 		return;
 
-	run_state::detail::dispatch_packet(&current_packet, this);
+	// Work through the batch without returning to the main loop, unless
+	// something comes up that the main loop needs to act on first. The
+	// current packet is always processed.
+	do
+		{
+		Packet* pkt = &batch[batch_pos];
+
+		if ( pkt->time < 0 )
+			Weird("negative_packet_timestamp", pkt);
+		else
+			run_state::detail::dispatch_packet(pkt, this);
 
-	have_packet = false;
-	DoneWithPacket();
+		++batch_pos;
+		}
+	while ( HavePacket() && IsOpen() &&
+	        ! run_state::is_processing_suspended() &&
+	        ::signal_val != SIGTERM && ::signal_val != SIGINT );
+
+	// If the source got closed, any remaining packets may refer to data
+	// that's gone now.
+	if ( HavePacket() && IsOpen() )
+		return;
+
+	batch_pos = batch_len = 0;
+	DoneWithPackets();
 	}
 
 const char* PktSrc::Tag()
@@ -165,31 +189,39 @@ const char* PktSrc::Tag()
 
 bool PktSrc::ExtractNextPacketInternal()
 	{
-	if ( have_packet )
-		return true;
-
-	have_packet = false;
-
 	// Don't return any packets if processing is suspended (except for the
 	// very first packet which we need to set up times).
 	if ( run_state::is_processing_suspended() && run_state::detail::first_timestamp )
 		return false;
 
+	if ( HavePacket() )
+		return true;
+
 	if ( run_state::pseudo_realtime )
 		run_state::detail::current_wallclock = util::current_time(true);
 
-	if ( ExtractNextPacket(&current_packet) )
+	if ( batch.empty() )
 		{
-		if ( current_packet.time < 0 )
-			{
-			Weird("negative_packet_timestamp", &current_packet);
-			return false;
-			}
+		// In pseudo-realtime mode each packet needs to wait for its own
+		// time to come, so there's no point in batching.
+		size_t n = run_state::pseudo_realtime ? 1 : BifConst::Pcap::batch_size;
+		batch = std::vector<Packet>(std::max(n, size_t(1)));
+		}
+
+	if ( (batch_len = ExtractNextPackets(&batch)) )
+		{
+		batch_pos = 0;
 
 		if ( ! run_state::detail::first_timestamp )
-			run_state::detail::first_timestamp = current_packet.time;
+			{
+			for ( size_t i = 0; i < batch_len; ++i )
+				if ( batch[i].time >= 0 )
+					{
+					run_state::detail::first_timestamp = batch[i].time;
+					break;
+					}
+			}
 
-		have_packet = true;
 		return true;
 		}
 
@@ -202,6 +234,16 @@ bool PktSrc::ExtractNextPacketInternal()
 	return false;
 	}
 
+size_t PktSrc::ExtractNextPackets(std::vector<Packet>* pkts)
+	{
+	return ExtractNextPacket(&(*pkts)[0]) ? 1 : 0;
+	}
+
+void PktSrc::DoneWithPackets()
+	{
+	DoneWithPacket();
+	}
+
 bool PktSrc::PrecompileBPFFilter(int index, const std::string& filter)
 	{
 	if ( index < 0 )
@@ -264,10 +306,10 @@ bool PktSrc::ApplyBPFFilter(int index, const struct pcap_pkthdr *hdr, const u_ch
 
 bool PktSrc::GetCurrentPacket(const Packet** pkt)
 	{
-	if ( ! have_packet )
+	if ( ! HavePacket() )
 		return false;
 
-	*pkt = &current_packet;
+	*pkt = &batch[batch_pos];
 	return true;
 	}
 
@@ -281,6 +323,12 @@ double PktSrc::GetNextTimeout()
 	if ( props.selectable_fd == -1 )
 		return 0.00002;
 
+	// If we had to break off processing a batch, the rest of it is
+	// ready right away.
+	if ( HavePacket() && ! run_state::pseudo_realtime &&
+	     ! run_state::is_processing_suspended() )
+		return 0;
+
 	// If we're live we want poll to do what it has to with the file descriptor. If we're not live
 	// but we're not in pseudo-realtime mode, let the loop just spin as fast as it can. If we're
 	// in pseudo-realtime mode, find the next time that a packet is ready and have poll block until
@@ -290,11 +338,11 @@ double PktSrc::GetNextTimeout()
 	else if ( ! run_state::pseudo_realtime )
 		return 0;
 
-	if ( ! have_packet )
-		ExtractNextPacketInternal();
+	if ( ! ExtractNextPacketInternal() )
+		return -1;
 
 	// This duplicates the calculation used in run_state::check_pseudo_time().
-	double pseudo_time = current_packet.time - run_state::detail::first_timestamp;
+	double pseudo_time = batch[batch_pos].time - run_state::detail::first_timestamp;
 	double ct = (util::current_time(true) - run_state::detail::first_wallclock) * run_state::pseudo_realtime;
 	return std::max(0.0, pseudo_time - ct);
 	}
@@ -329,11 +329,44 @@ protected:
 	 */
 	virtual void DoneWithPacket() = 0;
 
+	/**
+	 * Provides a batch of packets from the source. The base class
+	 * processes all packets of a batch in a row, without returning to
+	 * the main loop in between, which saves the per-packet cost of
+	 * polling and dispatching I/O sources.
+	 *
+	 * Derived classes may override this if they can hand out multiple
+	 * packets at once. The default implementation extracts a single
+	 * packet through \a ExtractNextPacket().
+	 *
+	 * @param pkts The packet structures to fill in, in order. The
+	 * callee fills in at most \a pkts->size() of them and must not
+	 * resize the vector. It keeps ownership of the packets' data but
+	 * must guarantee that it stays available at least until \a
+	 * DoneWithPackets() is called. It is guaranteed that no two calls to
+	 * this method will happen without \a DoneWithPackets() in between.
+	 *
+	 * @return The number of packets filled in, zero if no packet is
+	 * available or an error occured (which must be flagged via Error()).
+	 */
+	virtual size_t ExtractNextPackets(std::vector<Packet>* pkts);
+
+	/**
+	 * Signals that the data of all packets previously extracted via \a
+	 * ExtractNextPackets() will no longer be needed. The default
+	 * implementation calls \a DoneWithPacket().
+	 */
+	virtual void DoneWithPackets();
+
 private:
 
-	// Internal helper for ExtractNextPacket().
+	// Internal helper for ExtractNextPacket(). Returns true if there's a
+	// packet ready for dispatching, refilling the batch if necessary.
 	bool ExtractNextPacketInternal();
 
+	// Returns true if a batch still has packets left to dispatch.
+	bool HavePacket() const	{ return batch_pos < batch_len; }
+
 	// IOSource interface implementation.
 	void InitSource() override;
 	void Done() override;
@@ -342,8 +375,12 @@ private:
 
 	Properties props;
 
-	bool have_packet;
-	Packet current_packet;
+	// The current batch of extracted packets. Packets before batch_pos
+	// have been dispatched already; the one at batch_pos is the current
+	// packet.
+	std::vector<Packet> batch;
+	size_t batch_pos;
+	size_t batch_len;
 
 	// For BPF filtering support.
 	std::vector<detail::BPF_Program *> filters;
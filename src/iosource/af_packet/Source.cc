@@ -0,0 +1,492 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+#include "zeek/iosource/af_packet/Source.h"
+
+#include <algorithm>
+
+#ifdef HAVE_LINUX
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#endif
+
+extern "C" {
+#include <pcap.h>
+}
+
+#include "zeek/util.h"
+#include "zeek/iosource/Packet.h"
+#include "zeek/iosource/BPF_Program.h"
+
+#include "zeek/iosource/af_packet/af_packet.bif.h"
+
+namespace zeek::iosource::af_packet {
+
+AF_PacketSource::AF_PacketSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	}
+
+AF_PacketSource::~AF_PacketSource()
+	{
+	Close();
+	}
+
+iosource::PktSrc* AF_PacketSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new AF_PacketSource(path, is_live);
+	}
+
+bool AF_PacketSource::PrecompileFilter(int index, const std::string& filter)
+	{
+	return PktSrc::PrecompileBPFFilter(index, filter);
+	}
+
+#ifdef HAVE_LINUX
+
+void AF_PacketSource::Open()
+	{
+	fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+	if ( fd < 0 )
+		{
+		SocketError("socket");
+		return;
+		}
+
+	struct ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, props.path.c_str(), sizeof(ifr.ifr_name) - 1);
+
+	if ( ioctl(fd, SIOCGIFINDEX, &ifr) < 0 )
+		{
+		SocketError("SIOCGIFINDEX");
+		return;
+		}
+
+	int ifindex = ifr.ifr_ifindex;
+
+	if ( ioctl(fd, SIOCGIFHWADDR, &ifr) < 0 )
+		{
+		SocketError("SIOCGIFHWADDR");
+		return;
+		}
+
+	switch ( ifr.ifr_hwaddr.sa_family ) {
+	case ARPHRD_ETHER:
+		props.link_type = DLT_EN10MB;
+		break;
+
+	case ARPHRD_LOOPBACK:
+		// Linux presents loopback traffic with Ethernet framing.
+		props.link_type = DLT_EN10MB;
+		skip_outgoing = true;
+		break;
+
+	default:
+		Error(util::fmt("unsupported link type %d on %s",
+		                ifr.ifr_hwaddr.sa_family, props.path.c_str()));
+		Close();
+		return;
+	}
+
+	// The netmask is only needed for BPF filters referring to broadcast
+	// addresses, so it's ok if the interface has none.
+	props.netmask = NETMASK_UNKNOWN;
+
+	if ( ioctl(fd, SIOCGIFNETMASK, &ifr) == 0 )
+		props.netmask = reinterpret_cast<sockaddr_in*>(&ifr.ifr_netmask)->sin_addr.s_addr;
+
+	if ( ! SetupRing() || ! BindToInterface(ifindex) )
+		return;
+
+	struct packet_mreq mreq;
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.mr_ifindex = ifindex;
+	mreq.mr_type = PACKET_MR_PROMISC;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 )
+		{
+		SocketError("PACKET_ADD_MEMBERSHIP");
+		return;
+		}
+
+	if ( BifConst::AF_Packet::enable_fanout && ! JoinFanoutGroup() )
+		return;
+
+	props.selectable_fd = fd;
+	props.is_live = true;
+
+	Opened(props);
+	}
+
+bool AF_PacketSource::SetupRing()
+	{
+	int version = TPACKET_V3;
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 )
+		{
+		SocketError("PACKET_VERSION");
+		return false;
+		}
+
+	long page_size = sysconf(_SC_PAGESIZE);
+	block_size = BifConst::AF_Packet::block_size;
+	num_blocks = block_size ? BifConst::AF_Packet::buffer_size / block_size : 0;
+
+	if ( block_size == 0 || block_size % page_size != 0 )
+		{
+		Error(util::fmt("AF_Packet::block_size must be a multiple of the page size (%ld)",
+		                page_size));
+		Close();
+		return false;
+		}
+
+	if ( num_blocks == 0 )
+		{
+		Error("AF_Packet::buffer_size must be at least AF_Packet::block_size");
+		Close();
+		return false;
+		}
+
+	struct tpacket_req3 req;
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = block_size;
+	req.tp_block_nr = num_blocks;
+
+	// With TPACKET_V3, packets are packed into blocks back to back, so
+	// the frame size only needs to satisfy the kernel's sanity checks.
+	req.tp_frame_size = TPACKET_ALIGNMENT << 7;
+	req.tp_frame_nr = block_size / req.tp_frame_size * num_blocks;
+
+	// In milliseconds; zero would make the kernel pick a timeout.
+	req.tp_retire_blk_tov = std::max(1u,
+		static_cast<unsigned int>(BifConst::AF_Packet::block_timeout * 1000));
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0 )
+		{
+		SocketError("PACKET_RX_RING");
+		return false;
+		}
+
+	ring_size = block_size * num_blocks;
+	void* m = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE,
+	               MAP_SHARED | MAP_POPULATE, fd, 0);
+
+	if ( m == MAP_FAILED )
+		{
+		SocketError("mmap");
+		return false;
+		}
+
+	ring = static_cast<u_char*>(m);
+	block = nullptr;
+	block_in_use = false;
+	block_idx = 0;
+	pkts_left = 0;
+
+	return true;
+	}
+
+bool AF_PacketSource::BindToInterface(int ifindex)
+	{
+	struct sockaddr_ll sll;
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_ALL);
+	sll.sll_ifindex = ifindex;
+
+	if ( bind(fd, reinterpret_cast<sockaddr*>(&sll), sizeof(sll)) < 0 )
+		{
+		SocketError("bind");
+		return false;
+		}
+
+	return true;
+	}
+
+bool AF_PacketSource::JoinFanoutGroup()
+	{
+	uint32_t mode;
+
+	switch ( BifConst::AF_Packet::fanout_mode->AsEnum() ) {
+	case BifEnum::AF_Packet::FANOUT_HASH:
+		mode = PACKET_FANOUT_HASH;
+		break;
+
+	case BifEnum::AF_Packet::FANOUT_CPU:
+		mode = PACKET_FANOUT_CPU;
+		break;
+
+	case BifEnum::AF_Packet::FANOUT_QM:
+		mode = PACKET_FANOUT_QM;
+		break;
+
+	default:
+		Error("unsupported AF_Packet::fanout_mode");
+		Close();
+		return false;
+	}
+
+	if ( BifConst::AF_Packet::enable_defrag )
+		mode |= PACKET_FANOUT_FLAG_DEFRAG;
+
+	uint32_t arg = (BifConst::AF_Packet::fanout_id & 0xffff) | (mode << 16);
+
+	if ( setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0 )
+		{
+		SocketError("PACKET_FANOUT");
+		return false;
+		}
+
+	return true;
+	}
+
+void AF_PacketSource::Close()
+	{
+	if ( fd < 0 )
+		return;
+
+	if ( ring )
+		{
+		munmap(ring, ring_size);
+		ring = nullptr;
+		}
+
+	close(fd);
+	fd = -1;
+
+	block = nullptr;
+	block_in_use = false;
+	pkts_left = 0;
+
+	Closed();
+	}
+
+void AF_PacketSource::SocketError(const char* where)
+	{
+	Error(util::fmt("AF_PACKET error on %s (%s): %s",
+	                props.path.c_str(), where, strerror(errno)));
+	Close();
+	}
+
+bool AF_PacketSource::NextPacket(Packet* pkt)
+	{
+	while ( true )
+		{
+		if ( ! block )
+			{
+			auto b = reinterpret_cast<tpacket_block_desc*>(ring + block_idx * block_size);
+
+			// Pairs with the kernel's barrier before it flips the status.
+			if ( ! (__atomic_load_n(&b->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) )
+				return false;
+
+			block = b;
+			next_pkt = reinterpret_cast<u_char*>(b) + b->hdr.bh1.offset_to_first_pkt;
+			pkts_left = b->hdr.bh1.num_pkts;
+			}
+
+		while ( pkts_left > 0 )
+			{
+			auto hdr = reinterpret_cast<tpacket3_hdr*>(next_pkt);
+			auto sll = reinterpret_cast<const sockaddr_ll*>(next_pkt + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+			u_char* data = next_pkt + hdr->tp_mac;
+
+			next_pkt += hdr->tp_next_offset;
+			--pkts_left;
+
+			// On loopback we'd see each packet twice otherwise.
+			if ( skip_outgoing && sll->sll_pkttype == PACKET_OUTGOING )
+				continue;
+
+			FillPacket(pkt, hdr, data);
+			block_in_use = true;
+			return true;
+			}
+
+		if ( block_in_use )
+			// The block's packets are all handed out but may still be
+			// in use. It gets released once they're done.
+			return false;
+
+		// Nothing left that we'd hand out; move on to the next block.
+		ReleaseBlockIfDone();
+		}
+	}
+
+void AF_PacketSource::FillPacket(Packet* pkt, const tpacket3_hdr* hdr, u_char* data)
+	{
+	uint32_t caplen = hdr->tp_snaplen;
+	uint32_t len = hdr->tp_len;
+
+	if ( (hdr->tp_status & TP_STATUS_VLAN_VALID) && caplen >= 2 * ETH_ALEN )
+		{
+		// The kernel strips the outermost VLAN tag and reports it in the
+		// header instead. Put it back in place in front of the frame's
+		// ethertype. There's always room: the frame starts behind the
+		// header plus a sockaddr_ll that we've looked at already.
+		uint16_t tpid = (hdr->tp_status & TP_STATUS_VLAN_TPID_VALID) ?
+			hdr->hv1.tp_vlan_tpid : ETH_P_8021Q;
+		uint16_t tag[2] = { htons(tpid), htons(hdr->hv1.tp_vlan_tci) };
+
+		data -= sizeof(tag);
+		memmove(data, data + sizeof(tag), 2 * ETH_ALEN);
+		memcpy(data + 2 * ETH_ALEN, tag, sizeof(tag));
+		caplen += sizeof(tag);
+		len += sizeof(tag);
+		}
+
+	pkt_timeval ts = { static_cast<time_t>(hdr->tp_sec),
+	                   static_cast<suseconds_t>(hdr->tp_nsec / 1000) };
+	pkt->Init(props.link_type, &ts, caplen, len, data);
+
+	++stats.received;
+	stats.bytes_received += len;
+	}
+
+void AF_PacketSource::ReleaseBlockIfDone()
+	{
+	if ( ! block || pkts_left > 0 )
+		return;
+
+	__atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+	block = nullptr;
+	block_in_use = false;
+	block_idx = (block_idx + 1) % num_blocks;
+	}
+
+bool AF_PacketSource::ExtractNextPacket(Packet* pkt)
+	{
+	return fd >= 0 && NextPacket(pkt);
+	}
+
+void AF_PacketSource::DoneWithPacket()
+	{
+	ReleaseBlockIfDone();
+	}
+
+size_t AF_PacketSource::ExtractNextPackets(std::vector<Packet>* pkts)
+	{
+	if ( fd < 0 )
+		return 0;
+
+	// A batch never reaches beyond the current block, so that all of
+	// its packets can be released together.
+	size_t n = 0;
+
+	while ( n < pkts->size() && NextPacket(&(*pkts)[n]) )
+		++n;
+
+	return n;
+	}
+
+void AF_PacketSource::DoneWithPackets()
+	{
+	ReleaseBlockIfDone();
+	}
+
+bool AF_PacketSource::SetFilter(int index)
+	{
+	if ( fd < 0 )
+		return true; // Prevent error message
+
+	iosource::detail::BPF_Program* code = GetBPFFilter(index);
+
+	if ( ! code )
+		{
+		Error(util::fmt("No precompiled filter for index %d", index));
+		return false;
+		}
+
+	// We install the filter even if it matches everything, as it also
+	// truncates packets to the snap length.
+	bpf_program* prog = code->GetProgram();
+
+	struct sock_fprog fprog;
+	fprog.len = prog->bf_len;
+	fprog.filter = reinterpret_cast<sock_filter*>(prog->bf_insns);
+
+	if ( setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0 )
+		{
+		SocketError("SO_ATTACH_FILTER");
+		return false;
+		}
+
+	return true;
+	}
+
+void AF_PacketSource::Statistics(Stats* s)
+	{
+	if ( fd >= 0 )
+		{
+		struct tpacket_stats_v3 kstats;
+		socklen_t len = sizeof(kstats);
+
+		// The kernel resets its counters with each query, so we
+		// accumulate them. Its packet count includes drops.
+		if ( getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &kstats, &len) == 0 )
+			{
+			stats.link += kstats.tp_packets;
+			stats.dropped += kstats.tp_drops;
+			}
+		}
+
+	*s = stats;
+	}
+
+#else
+
+void AF_PacketSource::Open()
+	{
+	Error("AF_PACKET packet sources are only supported on Linux");
+	}
+
+void AF_PacketSource::Close()
+	{
+	}
+
+bool AF_PacketSource::ExtractNextPacket(Packet* pkt)
+	{
+	return false;
+	}
+
+void AF_PacketSource::DoneWithPacket()
+	{
+	}
+
+size_t AF_PacketSource::ExtractNextPackets(std::vector<Packet>* pkts)
+	{
+	return 0;
+	}
+
+void AF_PacketSource::DoneWithPackets()
+	{
+	}
+
+bool AF_PacketSource::SetFilter(int index)
+	{
+	return false;
+	}
+
+void AF_PacketSource::Statistics(Stats* s)
+	{
+	*s = stats;
+	}
+
+#endif
+
+} // namespace zeek::iosource::af_packet
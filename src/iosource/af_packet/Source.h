@@ -0,0 +1,92 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+
+#include "zeek/iosource/PktSrc.h"
+
+struct tpacket_block_desc;
+struct tpacket3_hdr;
+
+namespace zeek::iosource::af_packet {
+
+/**
+ * A live packet source reading from a Linux AF_PACKET socket through a
+ * TPACKET_V3 memory-mapped receive ring.
+ *
+ * The kernel fills the ring block by block, and packets are handed out as
+ * views directly into the current block without copying them. A block is
+ * returned to the kernel once all of its packets have been processed.
+ *
+ * Optionally, the socket joins a fanout group so that several Zeek
+ * processes can share the traffic of one interface, each receiving
+ * complete flows.
+ */
+class AF_PacketSource : public PktSrc {
+public:
+	AF_PacketSource(const std::string& path, bool is_live);
+	~AF_PacketSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	size_t ExtractNextPackets(std::vector<Packet>* pkts) override;
+	void DoneWithPackets() override;
+	bool PrecompileFilter(int index, const std::string& filter) override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	// Helpers for Open(). Each returns false after flagging an error.
+	bool SetupRing();
+	bool BindToInterface(int ifindex);
+	bool JoinFanoutGroup();
+
+	// Flags an error including the current errno and closes the source.
+	void SocketError(const char* where);
+
+	// Fills in the next packet of the current block, moving on to the
+	// next block first if there's nothing left in the current one.
+	// Returns false if there's no packet available right now.
+	bool NextPacket(Packet* pkt);
+
+	// Initializes a packet from its ring header and frame data.
+	void FillPacket(Packet* pkt, const tpacket3_hdr* hdr, u_char* data);
+
+	// Returns the current block to the kernel once all of its packets
+	// have been handed out.
+	void ReleaseBlockIfDone();
+
+	Properties props;
+	Stats stats;
+
+	int fd = -1;
+
+	// The mmap'ed ring and its geometry.
+	u_char* ring = nullptr;
+	size_t ring_size = 0;
+	size_t block_size = 0;
+	size_t num_blocks = 0;
+
+	// The block we're currently reading from, or null if the next one
+	// hasn't been filled yet, plus position and number of the packets
+	// left to hand out from it. block_in_use is set once one of its
+	// packets has been handed out.
+	tpacket_block_desc* block = nullptr;
+	size_t block_idx = 0;
+	u_char* next_pkt = nullptr;
+	uint32_t pkts_left = 0;
+	bool block_in_use = false;
+
+	// Set for loopback interfaces, where the kernel passes each packet
+	// to us both as outgoing and as incoming.
+	bool skip_outgoing = false;
+};
+
+} // namespace zeek::iosource::af_packet
@@ -0,0 +1,560 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+#include "zeek/iosource/pcap/MappedTrace.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "zeek/util.h"
+
+namespace zeek::iosource::pcap {
+
+// Same limit that libpcap enforces for the capture length of a packet.
+static constexpr uint32_t MAX_CAPLEN = 262144;
+
+// How far behind the current position we keep pages of the mapping
+// resident before dropping them.
+static constexpr size_t RESIDENT_WINDOW = 64 * 1024 * 1024;
+
+static constexpr uint32_t PCAP_MAGIC_USEC = 0xa1b2c3d4;
+static constexpr uint32_t PCAP_MAGIC_NSEC = 0xa1b23c4d;
+
+static constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+
+enum PcapngBlockType : uint32_t {
+	PCAPNG_IDB = 0x00000001, // interface description block
+	PCAPNG_PB = 0x00000002,  // obsolete packet block
+	PCAPNG_SPB = 0x00000003, // simple packet block
+	PCAPNG_EPB = 0x00000006, // enhanced packet block
+	PCAPNG_SHB = 0x0a0d0d0a, // section header block
+};
+
+enum PcapngOption : uint16_t {
+	PCAPNG_OPT_ENDOFOPT = 0,
+	PCAPNG_OPT_IF_TSRESOL = 9,
+	PCAPNG_OPT_IF_TSOFFSET = 14,
+};
+
+static uint32_t swap32(uint32_t v)
+	{
+	return ((v & 0xff) << 24) | ((v & 0xff00) << 8) |
+	       ((v >> 8) & 0xff00) | (v >> 24);
+	}
+
+// Maps the LINKTYPE_* value stored in a trace file to the corresponding
+// DLT_* value. We only handle the link types for which that's a known
+// one-to-one mapping on all platforms, and leave everything else to
+// libpcap. Returns -1 for link types we don't handle.
+static int linktype_to_dlt(uint32_t linktype)
+	{
+	switch ( linktype ) {
+	case 0: return DLT_NULL;
+	case 1: return DLT_EN10MB;
+	case 101: return DLT_RAW;
+	case 105: return DLT_IEEE802_11;
+	case 108: return DLT_LOOP;
+	case 113: return DLT_LINUX_SLL;
+	case 127: return DLT_IEEE802_11_RADIO;
+#ifdef DLT_NFLOG
+	case 239: return DLT_NFLOG;
+#endif
+#ifdef DLT_IPV4
+	case 228: return DLT_IPV4;
+#endif
+#ifdef DLT_IPV6
+	case 229: return DLT_IPV6;
+#endif
+	default: return -1;
+	}
+	}
+
+MappedTrace::~MappedTrace()
+	{
+	Close();
+	}
+
+bool MappedTrace::Open(const std::string& path)
+	{
+	Close();
+
+	fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if ( fd < 0 )
+		return false;
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || ! S_ISREG(st.st_mode) ||
+	     st.st_size < 24 ||
+	     static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max() )
+		{
+		Close();
+		return false;
+		}
+
+	void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if ( m == MAP_FAILED )
+		{
+		Close();
+		return false;
+		}
+
+	base = static_cast<const u_char*>(m);
+	size = st.st_size;
+
+	// We walk the file front to back exactly once.
+	madvise(m, size, MADV_SEQUENTIAL);
+
+	uint32_t magic;
+	memcpy(&magic, base, sizeof(magic));
+
+	bool ok = false;
+
+	if ( magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC ||
+	     swap32(magic) == PCAP_MAGIC_USEC || swap32(magic) == PCAP_MAGIC_NSEC )
+		ok = ParsePcapHeader();
+
+	else if ( magic == PCAPNG_SHB )
+		ok = ParsePcapngHeader();
+
+	if ( ! ok )
+		{
+		Close();
+		return false;
+		}
+
+	return true;
+	}
+
+void MappedTrace::Close()
+	{
+	if ( base )
+		munmap(const_cast<u_char*>(base), size);
+
+	if ( fd >= 0 )
+		close(fd);
+
+	fd = -1;
+	base = nullptr;
+	size = pos = dropped = 0;
+	is_pcapng = swapped = nsec = false;
+	link_type = -1;
+	snaplen = 0;
+	interfaces.clear();
+	}
+
+bool MappedTrace::ParsePcapHeader()
+	{
+	uint32_t magic;
+	memcpy(&magic, base, sizeof(magic));
+
+	swapped = (magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC);
+	nsec = (swapped ? swap32(magic) : magic) == PCAP_MAGIC_NSEC;
+
+	if ( Get16(base + 4) != 2 )
+		return false;
+
+	snaplen = Get32(base + 16);
+
+	if ( snaplen == 0 || snaplen > MAX_CAPLEN )
+		snaplen = MAX_CAPLEN;
+
+	// The upper bits of the link type may carry FCS information,
+	// which we leave to libpcap.
+	link_type = linktype_to_dlt(Get32(base + 20));
+
+	if ( link_type < 0 )
+		return false;
+
+	is_pcapng = false;
+	pos = 24;
+	return true;
+	}
+
+bool MappedTrace::ParsePcapngHeader()
+	{
+	is_pcapng = true;
+
+	// Skip anything up to the first interface description, so that
+	// the link type is known once we're open.
+	while ( true )
+		{
+		uint32_t type;
+		const u_char* body;
+		size_t len;
+
+		if ( ReadBlock(&type, &body, &len) <= 0 )
+			return false;
+
+		switch ( type ) {
+		case PCAPNG_SHB:
+			if ( ! ParseSectionHeader(body, len) )
+				return false;
+			break;
+
+		case PCAPNG_IDB:
+			return ParseInterface(body, len);
+
+		case PCAPNG_PB:
+		case PCAPNG_SPB:
+		case PCAPNG_EPB:
+			// Packets without an interface.
+			return false;
+
+		default:
+			break;
+		}
+		}
+	}
+
+bool MappedTrace::ParseSectionHeader(const u_char* body, size_t len)
+	{
+	// ReadBlock() has already determined the byte order.
+	if ( len < 16 || Get16(body + 4) != 1 )
+		{
+		error = "unsupported pcapng section header";
+		return false;
+		}
+
+	// Interface IDs are local to a section.
+	interfaces.clear();
+	return true;
+	}
+
+int MappedTrace::ReadBlock(uint32_t* type, const u_char** body, size_t* len)
+	{
+	size_t avail = size - pos;
+
+	if ( avail == 0 )
+		return 0;
+
+	if ( avail < 12 )
+		return Fail(util::fmt("truncated pcapng dump file; tried to read 12 bytes, only got %zu",
+		                      avail));
+
+	const u_char* p = base + pos;
+
+	// The section header's type reads the same in either byte order,
+	// and it's the block that defines the order for the rest of the
+	// section.
+	uint32_t raw_type;
+	memcpy(&raw_type, p, sizeof(raw_type));
+
+	if ( raw_type == PCAPNG_SHB )
+		{
+		uint32_t bom;
+		memcpy(&bom, p + 8, sizeof(bom));
+
+		if ( bom == PCAPNG_BYTE_ORDER_MAGIC )
+			swapped = false;
+		else if ( swap32(bom) == PCAPNG_BYTE_ORDER_MAGIC )
+			swapped = true;
+		else
+			return Fail("pcapng section header has an invalid byte order magic");
+		}
+
+	uint32_t total_len = Get32(p + 4);
+
+	if ( total_len < 12 || total_len % 4 != 0 )
+		return Fail(util::fmt("pcapng block has an invalid length %u", total_len));
+
+	if ( total_len > avail )
+		return Fail(util::fmt("truncated pcapng dump file; tried to read %u bytes, only got %zu",
+		                      total_len, avail));
+
+	if ( Get32(p + total_len - 4) != total_len )
+		return Fail("pcapng block's trailing length doesn't match its leading length");
+
+	*type = Get32(p);
+	*body = p + 8;
+	*len = total_len - 12;
+
+	pos += total_len;
+	DropConsumed();
+
+	return 1;
+	}
+
+bool MappedTrace::ParseInterface(const u_char* body, size_t len)
+	{
+	if ( len < 8 )
+		{
+		error = "pcapng interface description block is too short";
+		return false;
+		}
+
+	uint32_t linktype = Get16(body);
+	int dlt = linktype_to_dlt(linktype);
+
+	if ( dlt < 0 )
+		{
+		error = util::fmt("pcapng interface has unsupported link type %u", linktype);
+		return false;
+		}
+
+	if ( link_type >= 0 && dlt != link_type )
+		{
+		error = util::fmt("an interface has a type %u different from the type of the first interface",
+		                  linktype);
+		return false;
+		}
+
+	Interface iface{1000000, 0, Get32(body + 4)};
+
+	if ( iface.snaplen == 0 || iface.snaplen > MAX_CAPLEN )
+		iface.snaplen = MAX_CAPLEN;
+
+	const u_char* opt = body + 8;
+	size_t left = len - 8;
+
+	while ( left >= 4 )
+		{
+		uint16_t code = Get16(opt);
+		uint16_t olen = Get16(opt + 2);
+		size_t padded = (olen + 3u) & ~3u;
+
+		if ( code == PCAPNG_OPT_ENDOFOPT )
+			break;
+
+		if ( padded > left - 4 )
+			{
+			error = "pcapng interface option extends past the end of its block";
+			return false;
+			}
+
+		const u_char* val = opt + 4;
+
+		if ( code == PCAPNG_OPT_IF_TSRESOL && olen == 1 )
+			{
+			uint8_t v = val[0];
+
+			if ( v & 0x80 )
+				{
+				if ( (v & 0x7f) > 63 )
+					{
+					error = "pcapng interface has an invalid timestamp resolution";
+					return false;
+					}
+
+				iface.ts_units = uint64_t(1) << (v & 0x7f);
+				}
+			else
+				{
+				if ( v > 19 )
+					{
+					error = "pcapng interface has an invalid timestamp resolution";
+					return false;
+					}
+
+				iface.ts_units = 1;
+				for ( uint8_t i = 0; i < v; ++i )
+					iface.ts_units *= 10;
+				}
+			}
+
+		else if ( code == PCAPNG_OPT_IF_TSOFFSET && olen == 8 )
+			iface.ts_offset = static_cast<int64_t>(Get64(val));
+
+		opt += 4 + padded;
+		left -= 4 + padded;
+		}
+
+	link_type = dlt;
+	interfaces.push_back(iface);
+	return true;
+	}
+
+int MappedTrace::Next(pcap_pkthdr* hdr, const u_char** data)
+	{
+	if ( ! base )
+		return 0;
+
+	return is_pcapng ? NextPcapng(hdr, data) : NextPcap(hdr, data);
+	}
+
+int MappedTrace::NextPcap(pcap_pkthdr* hdr, const u_char** data)
+	{
+	size_t avail = size - pos;
+
+	if ( avail == 0 )
+		return 0;
+
+	if ( avail < 16 )
+		return Fail(util::fmt("truncated dump file; tried to read 16 header bytes, only got %zu",
+		                      avail));
+
+	const u_char* p = base + pos;
+	uint32_t caplen = Get32(p + 8);
+
+	if ( caplen > MAX_CAPLEN )
+		return Fail(util::fmt("invalid packet capture length %u, bigger than maximum of %u",
+		                      caplen, MAX_CAPLEN));
+
+	if ( caplen > avail - 16 )
+		return Fail(util::fmt("truncated dump file; tried to read %u captured bytes, only got %zu",
+		                      caplen, avail - 16));
+
+	hdr->ts.tv_sec = Get32(p);
+	hdr->ts.tv_usec = nsec ? Get32(p + 4) / 1000 : Get32(p + 4);
+	hdr->caplen = std::min(caplen, snaplen);
+	hdr->len = Get32(p + 12);
+	*data = p + 16;
+
+	pos += 16 + caplen;
+	DropConsumed();
+
+	return 1;
+	}
+
+int MappedTrace::NextPcapng(pcap_pkthdr* hdr, const u_char** data)
+	{
+	while ( true )
+		{
+		uint32_t type;
+		const u_char* body;
+		size_t len;
+
+		int res = ReadBlock(&type, &body, &len);
+
+		if ( res <= 0 )
+			return res;
+
+		switch ( type ) {
+		case PCAPNG_SHB:
+			if ( ! ParseSectionHeader(body, len) )
+				return -1;
+			break;
+
+		case PCAPNG_IDB:
+			if ( ! ParseInterface(body, len) )
+				return -1;
+			break;
+
+		case PCAPNG_EPB:
+		case PCAPNG_PB:
+			{
+			if ( len < 20 )
+				return Fail("pcapng packet block is too short");
+
+			uint32_t if_id = (type == PCAPNG_EPB) ? Get32(body) : Get16(body);
+			uint64_t ts = (uint64_t(Get32(body + 4)) << 32) | Get32(body + 8);
+			uint32_t caplen = Get32(body + 12);
+
+			if ( caplen > len - 20 )
+				return Fail(util::fmt("invalid packet capture length %u, bigger than its block",
+				                      caplen));
+
+			if ( ! FillHeader(hdr, if_id, ts, caplen, Get32(body + 16)) )
+				return -1;
+
+			*data = body + 20;
+			return 1;
+			}
+
+		case PCAPNG_SPB:
+			{
+			// Simple packets always belong to the first interface
+			// and don't have a timestamp.
+			if ( len < 4 )
+				return Fail("pcapng simple packet block is too short");
+
+			uint32_t orig_len = Get32(body);
+			uint32_t caplen = std::min(orig_len, static_cast<uint32_t>(len - 4));
+
+			if ( ! FillHeader(hdr, 0, 0, caplen, orig_len) )
+				return -1;
+
+			hdr->ts.tv_sec = hdr->ts.tv_usec = 0;
+			*data = body + 4;
+			return 1;
+			}
+
+		default:
+			// Statistics, name resolution, custom blocks, etc.
+			break;
+		}
+		}
+	}
+
+bool MappedTrace::FillHeader(pcap_pkthdr* hdr, uint32_t if_id, uint64_t ts,
+                             uint32_t caplen, uint32_t len)
+	{
+	if ( if_id >= interfaces.size() )
+		{
+		Fail(util::fmt("pcapng packet refers to unknown interface %u", if_id));
+		return false;
+		}
+
+	const Interface& iface = interfaces[if_id];
+	uint64_t frac = ts % iface.ts_units;
+	uint64_t usec;
+
+	if ( iface.ts_units == 1000000 )
+		usec = frac;
+	else if ( iface.ts_units <= std::numeric_limits<uint64_t>::max() / 1000000 )
+		usec = frac * 1000000 / iface.ts_units;
+	else
+		usec = static_cast<uint64_t>(static_cast<long double>(frac) * 1000000 / iface.ts_units);
+
+	hdr->ts.tv_sec = ts / iface.ts_units + iface.ts_offset;
+	hdr->ts.tv_usec = usec;
+	hdr->caplen = std::min(caplen, iface.snaplen);
+	hdr->len = len;
+	return true;
+	}
+
+void MappedTrace::DropConsumed()
+	{
+	if ( pos < dropped + 2 * RESIDENT_WINDOW )
+		return;
+
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+
+	// Packets handed out most recently stay resident. Dropping pages
+	// of a read-only file mapping doesn't invalidate them anyway, the
+	// kernel just reads them in again if they're accessed.
+	size_t end = (pos - RESIDENT_WINDOW) & ~(page_size - 1);
+
+	madvise(const_cast<u_char*>(base) + dropped, end - dropped, MADV_DONTNEED);
+	dropped = end;
+	}
+
+uint16_t MappedTrace::Get16(const u_char* p) const
+	{
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? (v >> 8) | (v << 8) : v;
+	}
+
+uint32_t MappedTrace::Get32(const u_char* p) const
+	{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? swap32(v) : v;
+	}
+
+uint64_t MappedTrace::Get64(const u_char* p) const
+	{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+
+	if ( swapped )
+		v = (uint64_t(swap32(v & 0xffffffff)) << 32) | swap32(v >> 32);
+
+	return v;
+	}
+
+int MappedTrace::Fail(std::string msg)
+	{
+	error = std::move(msg);
+	return -1;
+	}
+
+} // namespace zeek::iosource::pcap
@@ -0,0 +1,142 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <pcap.h>
+}
+
+namespace zeek::iosource::pcap {
+
+/**
+ * Reads an offline trace file by mapping it into memory in its entirety
+ * and walking its records in place, so that packets can be handed out
+ * as views into the mapping without copying them.
+ *
+ * Supports classic pcap files (either byte order, microsecond or
+ * nanosecond timestamps) and pcapng files with a single link type.
+ * Anything else is left to libpcap: Open() returns false for input that
+ * the class doesn't handle, without considering that an error.
+ */
+class MappedTrace {
+public:
+	MappedTrace() = default;
+	~MappedTrace();
+
+	MappedTrace(const MappedTrace&) = delete;
+	MappedTrace& operator=(const MappedTrace&) = delete;
+
+	/**
+	 * Maps a trace file and parses its file header.
+	 *
+	 * @param path The path of the file.
+	 *
+	 * @return True if the file is now ready for reading. False if it
+	 * can't be read this way, in which case the caller should fall back
+	 * to libpcap, which will also report any problems with the file.
+	 */
+	bool Open(const std::string& path);
+
+	/**
+	 * Unmaps the file. Previously returned packet data becomes invalid.
+	 */
+	void Close();
+
+	/**
+	 * Returns true if a file is currently mapped.
+	 */
+	bool IsOpen() const	{ return base != nullptr; }
+
+	/**
+	 * Returns the next packet of the trace.
+	 *
+	 * @param hdr Receives the packet's header.
+	 *
+	 * @param data Receives a pointer to the packet's data inside the
+	 * mapping, valid until the trace is closed.
+	 *
+	 * @return 1 if a packet was returned, 0 at the end of the file, or
+	 * -1 if the file is corrupt, with ErrorMsg() describing the problem.
+	 */
+	int Next(pcap_pkthdr* hdr, const u_char** data);
+
+	/**
+	 * Returns the DLT_* link type of the trace's packets.
+	 */
+	int LinkType() const	{ return link_type; }
+
+	/**
+	 * Returns the file descriptor of the mapped file.
+	 */
+	int Fd() const	{ return fd; }
+
+	/**
+	 * Returns a description of the last error.
+	 */
+	const std::string& ErrorMsg() const	{ return error; }
+
+private:
+	struct Interface {
+		uint64_t ts_units; // timestamp units per second
+		int64_t ts_offset; // seconds to add to timestamps
+		uint32_t snaplen;
+	};
+
+	bool ParsePcapHeader();
+	bool ParsePcapngHeader();
+	bool ParseSectionHeader(const u_char* body, size_t len);
+
+	// Reads the next pcapng block, returning its type and body. Returns
+	// 1 if a block was read, 0 at the end of the file, and -1 if the
+	// block is invalid.
+	int ReadBlock(uint32_t* type, const u_char** body, size_t* len);
+
+	int NextPcap(pcap_pkthdr* hdr, const u_char** data);
+	int NextPcapng(pcap_pkthdr* hdr, const u_char** data);
+
+	// Parses an interface description block's link type and
+	// timestamp options. Returns false if the block is invalid or
+	// inconsistent with earlier ones.
+	bool ParseInterface(const u_char* body, size_t len);
+
+	// Fills in a pcapng packet's header from its interface, 64-bit
+	// timestamp and lengths. Returns false if the interface is unknown.
+	bool FillHeader(pcap_pkthdr* hdr, uint32_t if_id, uint64_t ts,
+	                uint32_t caplen, uint32_t len);
+
+	// Releases pages well behind the current position, so that reading
+	// a large trace doesn't keep all of it resident.
+	void DropConsumed();
+
+	uint16_t Get16(const u_char* p) const;
+	uint32_t Get32(const u_char* p) const;
+	uint64_t Get64(const u_char* p) const;
+
+	int Fail(std::string msg);
+
+	int fd = -1;
+	const u_char* base = nullptr;
+	size_t size = 0;
+	size_t pos = 0;
+	size_t dropped = 0;
+
+	bool is_pcapng = false;
+	bool swapped = false;
+	int link_type = -1;
+	uint32_t snaplen = 0;
+
+	// Classic pcap: true for nanosecond timestamps.
+	bool nsec = false;
+
+	// pcapng: the interfaces of the current section.
+	std::vector<Interface> interfaces;
+
+	std::string error;
+};
+
+} // namespace zeek::iosource::pcap
@@ -37,11 +37,20 @@ void PcapSource::Open()
 
 void PcapSource::Close()
 	{
-	if ( ! pd )
-		return;
+	if ( trace.IsOpen() )
+		{
+		trace.Close();
+		filter_index = -1;
+		}
 
-	pcap_close(pd);
-	pd = nullptr;
+	else if ( pd )
+		{
+		pcap_close(pd);
+		pd = nullptr;
+		}
+
+	else
+		return;
 
 	Closed();
 
@@ -171,6 +180,20 @@ void PcapSource::OpenOffline()
 	{
 	char errbuf[PCAP_ERRBUF_SIZE];
 
+	// Standard input can't be mapped. For files, the mapped reader
+	// declines anything it doesn't support, and we go through libpcap,
+	// which also takes care of reporting errors.
+	if ( BifConst::Pcap::mmap_offline && props.path != "-" &&
+	     trace.Open(props.path) )
+		{
+		props.selectable_fd = trace.Fd();
+		props.link_type = trace.LinkType();
+		props.is_live = false;
+
+		Opened(props);
+		return;
+		}
+
 	pd = pcap_open_offline(props.path.c_str(), errbuf);
 
 	if ( ! pd )
@@ -192,52 +215,154 @@ void PcapSource::OpenOffline()
 
 bool PcapSource::ExtractNextPacket(Packet* pkt)
 	{
-	if ( ! pd )
+	if ( ! pd && ! trace.IsOpen() )
 		return false;
 
+	int res = ReadPacket(pkt);
+
+	if ( res < 0 )
+		Close();
+
+	return res > 0;
+	}
+
+size_t PcapSource::ExtractNextPackets(std::vector<Packet>* pkts)
+	{
+	if ( ! pd && ! trace.IsOpen() )
+		return 0;
+
+	size_t max = pkts->size();
+
+	// Packets from a mapped trace point into the mapping and remain
+	// valid while we read more, so they don't need copying.
+	bool need_copy = (pd != nullptr);
+
+	if ( need_copy && max > 1 && batch_slots < max - 1 )
+		{
+		batch_slots = max - 1;
+		batch_slot_size = std::max(pcap_snapshot(pd), 0);
+		batch_buf.reset(new u_char[batch_slots * batch_slot_size]);
+		}
+
+	size_t n = 0;
+
+	while ( n < max )
+		{
+		if ( need_copy && n > 0 )
+			{
+			Packet& prev = (*pkts)[n - 1];
+
+			// Shouldn't happen, but if libpcap hands us more than
+			// the snapshot length, end the batch here.
+			if ( prev.cap_len > batch_slot_size )
+				break;
+
+			u_char* buf = &batch_buf[(n - 1) * batch_slot_size];
+			memcpy(buf, prev.data, prev.cap_len);
+			prev.data = buf;
+			}
+
+		int res = ReadPacket(&(*pkts)[n]);
+
+		if ( res < 0 )
+			{
+			// Hand out what we have first; we'll see the end of
+			// the file again with the next call.
+			if ( n == 0 )
+				Close();
+
+			break;
+			}
+
+		if ( res == 0 )
+			break;
+
+		++n;
+		}
+
+	return n;
+	}
+
+int PcapSource::ReadPacket(Packet* pkt)
+	{
 	const u_char* data;
 	pcap_pkthdr* header;
+	pcap_pkthdr mapped_header;
 
-	int res = pcap_next_ex(pd, &header, &data);
+	if ( trace.IsOpen() )
+		{
+		int res = ReadMappedPacket(&mapped_header, &data);
 
-	switch ( res ) {
-	case PCAP_ERROR_BREAK: // -2
-		// Exhausted pcap file, no more packets to read.
-		assert(! props.is_live);
-		Close();
-		return false;
-	case PCAP_ERROR: // -1
-		// Error occurred while reading the packet.
-		if ( props.is_live )
-			reporter->Error("failed to read a packet from %s: %s",
-			                props.path.data(), pcap_geterr(pd));
-		else
-			reporter->FatalError("failed to read a packet from %s: %s",
-			                     props.path.data(), pcap_geterr(pd));
-		return false;
-	case 0:
-		// Read from live interface timed out (ok).
-		return false;
-	case 1:
-		// Read a packet without problem.
-		break;
-	default:
-		reporter->InternalError("unhandled pcap_next_ex return value: %d", res);
-		return false;
-	}
+		if ( res <= 0 )
+			return res;
+
+		header = &mapped_header;
+		}
+
+	else
+		{
+		int res = pcap_next_ex(pd, &header, &data);
+
+		switch ( res ) {
+		case PCAP_ERROR_BREAK: // -2
+			// Exhausted pcap file, no more packets to read.
+			assert(! props.is_live);
+			return -1;
+		case PCAP_ERROR: // -1
+			// Error occurred while reading the packet.
+			if ( props.is_live )
+				reporter->Error("failed to read a packet from %s: %s",
+				                props.path.data(), pcap_geterr(pd));
+			else
+				reporter->FatalError("failed to read a packet from %s: %s",
+				                     props.path.data(), pcap_geterr(pd));
+			return 0;
+		case 0:
+			// Read from live interface timed out (ok).
+			return 0;
+		case 1:
+			// Read a packet without problem.
+			break;
+		default:
+			reporter->InternalError("unhandled pcap_next_ex return value: %d", res);
+			return 0;
+		}
+		}
 
 	pkt->Init(props.link_type, &header->ts, header->caplen, header->len, data);
 
 	if ( header->len == 0 || header->caplen == 0 )
 		{
 		Weird("empty_pcap_header", pkt);
-		return false;
+		return 0;
 		}
 
 	++stats.received;
 	stats.bytes_received += header->len;
 
-	return true;
+	return 1;
+	}
+
+int PcapSource::ReadMappedPacket(pcap_pkthdr* hdr, const u_char** data)
+	{
+	while ( true )
+		{
+		int res = trace.Next(hdr, data);
+
+		if ( res == 0 )
+			return -1;
+
+		if ( res < 0 )
+			{
+			reporter->FatalError("failed to read a packet from %s: %s",
+			                     props.path.data(), trace.ErrorMsg().c_str());
+			return 0;
+			}
+
+		// Like libpcap, skip packets not matching the filter.
+		if ( filter_index < 0 || ApplyBPFFilter(filter_index, hdr, *data) )
+			return 1;
+		}
 	}
 
 void PcapSource::DoneWithPacket()
@@ -252,7 +377,7 @@ bool PcapSource::PrecompileFilter(int index, const std::string& filter)
 
 bool PcapSource::SetFilter(int index)
 	{
-	if ( ! pd )
+	if ( ! pd && ! trace.IsOpen() )
 		return true; // Prevent error message
 
 	char errbuf[PCAP_ERRBUF_SIZE];
@@ -275,6 +400,11 @@ bool PcapSource::SetFilter(int index)
 		// since the default scripts will always attempt to compile
 		// and install a default filter
 		}
+	else if ( trace.IsOpen() )
+		{
+		// Applied by ReadMappedPacket().
+		filter_index = index;
+		}
 	else
 		{
 		if ( pcap_setfilter(pd, code->GetProgram()) < 0 )
@@ -3,12 +3,14 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
+#include <memory>
 
 extern "C" {
 #include <pcap.h>
 }
 
 #include "zeek/iosource/PktSrc.h"
+#include "zeek/iosource/pcap/MappedTrace.h"
 
 namespace zeek::iosource::pcap {
 
@@ -24,6 +26,7 @@ protected:
 	void Open() override;
 	void Close() override;
 	bool ExtractNextPacket(Packet* pkt) override;
+	size_t ExtractNextPackets(std::vector<Packet>* pkts) override;
 	void DoneWithPacket() override;
 	bool PrecompileFilter(int index, const std::string& filter) override;
 	bool SetFilter(int index) override;
@@ -34,10 +37,32 @@ private:
 	void OpenOffline();
 	void PcapError(const char* where = nullptr);
 
+	// Reads the next packet from libpcap. Returns 1 if a packet was
+	// read, 0 if none is available, and -1 at the end of a trace file.
+	int ReadPacket(Packet* pkt);
+
+	// Reads the next packet passing the current filter from the mapped
+	// trace file. Same return values as ReadPacket().
+	int ReadMappedPacket(pcap_pkthdr* hdr, const u_char** data);
+
 	Properties props;
 	Stats stats;
 
 	pcap_t *pd;
+
+	// Used instead of pd when reading a trace file through a memory
+	// mapping. Since libpcap isn't involved then, we apply the BPF
+	// filter with the given index ourselves, if any.
+	MappedTrace trace;
+	int filter_index = -1;
+
+	// libpcap reuses its buffer for each packet it returns, so inside a
+	// batch we copy each packet here before reading the next one. Not
+	// needed for mapped trace files. Holds
+	// batch_slots slots of batch_slot_size bytes each.
+	std::unique_ptr<u_char[]> batch_buf;
+	size_t batch_slots = 0;
+	size_t batch_slot_size = 0;
 };
 
 } // namespace zeek::iosource::pcap
@@ -23,6 +23,7 @@
 
 #include "zeek/logging/WriterFrontend.h"
 #include "zeek/logging/WriterBackend.h"
+#include "zeek/logging/WriteBatch.h"
 #include "zeek/plugin/Plugin.h"
 #include "zeek/plugin/Manager.h"
 
@@ -897,7 +898,20 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 
 		// Alright, can do the write now.
 
-		threading::Value** vals = RecordToFilterVals(stream, filter, columns.get());
+		// This runs script code, which may itself write to the log,
+		// so it needs to happen before we grab the writer's batch.
+		auto ext_rec = FilterExtensions(filter);
+
+		// Build the record right inside the writer's current batch,
+		// unless a plugin hook may want to replace values, which
+		// requires them to be individually heap-allocated.
+		WriteBatch* batch = nullptr;
+
+		if ( ! plugin_mgr->HavePluginForHook(zeek::plugin::HOOK_LOG_WRITE) )
+			batch = writer->CurrentBatch();
+
+		threading::Value** vals = RecordToFilterVals(stream, filter, ext_rec.get(),
+		                                             columns.get(), batch);
 
 		if ( ! PLUGIN_HOOK_WITH_RESULT(HOOK_LOG_WRITE,
 		                               HookLogWrite(filter->writer->GetType()->AsEnumType()->Lookup(filter->writer->InternalInt()),
@@ -915,9 +929,13 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 			return true;
 			}
 
-		// Write takes ownership of vals.
+		// Write takes ownership of vals; in a batch, they belong to it already.
 		assert(writer);
-		writer->Write(filter->num_fields, vals);
+
+		if ( batch )
+			writer->WriteInBatch(filter->num_fields, vals);
+		else
+			writer->Write(filter->num_fields, vals);
 
 #ifdef DEBUG
 		DBG_LOG(DBG_LOGGING, "Wrote record to filter '%s' on stream '%s'",
@@ -928,15 +946,98 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 	return true;
 	}
 
-threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
+// Helpers for building log values either on the heap or, if a batch is
+// given, in the batch's arena.
+
+static threading::Value* new_log_val(WriteBatch* batch, TypeTag type, bool present = true)
+	{
+	if ( batch )
+		return batch->NewValue(type, present);
+
+	return new threading::Value(type, present);
+	}
+
+static threading::Value** new_log_val_array(WriteBatch* batch, size_t n)
+	{
+	if ( batch )
+		return batch->NewValueArray(n);
+
+	return new threading::Value*[n];
+	}
+
+static void set_log_string(WriteBatch* batch, threading::Value* lval, const char* data, size_t len)
+	{
+	char* buf;
+
+	if ( batch )
+		buf = batch->CopyString(data, len);
+	else
+		{
+		buf = new char[len + 1];
+		memcpy(buf, data, len);
+		buf[len] = '\0';
+		}
+
+	lval->val.string_val.data = buf;
+	lval->val.string_val.length = len;
+	}
+
+threading::Value* Manager::FieldToLogVal(RecordVal* rv, int field, WriteBatch* batch)
+	{
+	const auto& ft = rv->GetType()->AsRecordType()->GetFieldType(field);
+
+	if ( ! rv->HasField(field) )
+		return new_log_val(batch, ft->Tag(), false);
+
+	threading::Value* lval;
+
+	switch ( ft->Tag() ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+		lval = new_log_val(batch, ft->Tag());
+		lval->val.int_val = rv->GetFieldAs<IntVal>(field);
+		return lval;
+
+	case TYPE_COUNT:
+		lval = new_log_val(batch, ft->Tag());
+		lval->val.uint_val = rv->GetFieldAs<CountVal>(field);
+		return lval;
+
+	case TYPE_PORT:
+		{
+		auto p = rv->GetFieldAs<PortVal>(field);
+		lval = new_log_val(batch, ft->Tag());
+		lval->val.port_val.port = p->Port();
+		lval->val.port_val.proto = p->PortType();
+		return lval;
+		}
+
+	case TYPE_ADDR:
+		lval = new_log_val(batch, ft->Tag());
+		rv->GetFieldAs<AddrVal>(field).ConvertToThreadingValue(&lval->val.addr_val);
+		return lval;
+
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		lval = new_log_val(batch, ft->Tag());
+		lval->val.double_val = rv->GetFieldAs<DoubleVal>(field);
+		return lval;
+
+	default:
+		return ValToLogVal(rv->GetField(field).get(), nullptr, batch);
+	}
+	}
+
+threading::Value* Manager::ValToLogVal(Val* val, Type* ty, WriteBatch* batch)
 	{
 	if ( ! ty )
 		ty = val->GetType().get();
 
 	if ( ! val )
-		return new threading::Value(ty->Tag(), false);
+		return new_log_val(batch, ty->Tag(), false);
 
-	threading::Value* lval = new threading::Value(ty->Tag());
+	threading::Value* lval = new_log_val(batch, ty->Tag());
 
 	switch ( lval->type ) {
 	case TYPE_BOOL:
@@ -949,18 +1050,13 @@ threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
 		const char* s =
 			val->GetType()->AsEnumType()->Lookup(val->InternalInt());
 
-		if ( s )
-			{
-			lval->val.string_val.data = util::copy_string(s);
-			lval->val.string_val.length = strlen(s);
-			}
-
-		else
+		if ( ! s )
 			{
 			val->GetType()->Error("enum type does not contain value", val);
-			lval->val.string_val.data = util::copy_string("");
-			lval->val.string_val.length = 0;
+			s = "";
 			}
+
+		set_log_string(batch, lval, s, strlen(s));
 		break;
 		}
 
@@ -990,11 +1086,7 @@ threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
 	case TYPE_STRING:
 		{
 		const String* s = val->AsString();
-		char* buf = new char[s->Len()];
-		memcpy(buf, s->Bytes(), s->Len());
-
-		lval->val.string_val.data = buf;
-		lval->val.string_val.length = s->Len();
+		set_log_string(batch, lval, reinterpret_cast<const char*>(s->Bytes()), s->Len());
 		break;
 		}
 
@@ -1002,8 +1094,7 @@ threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
 		{
 		const File* f = val->AsFile();
 		string s = f->Name();
-		lval->val.string_val.data = util::copy_string(s.c_str());
-		lval->val.string_val.length = s.size();
+		set_log_string(batch, lval, s.data(), s.size());
 		break;
 		}
 
@@ -1013,8 +1104,7 @@ threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
 		const Func* f = val->AsFunc();
 		f->Describe(&d);
 		const char* s = d.Description();
-		lval->val.string_val.data = util::copy_string(s);
-		lval->val.string_val.length = strlen(s);
+		set_log_string(batch, lval, s, strlen(s));
 		break;
 		}
 
@@ -1027,10 +1117,10 @@ threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
 			set = make_intrusive<ListVal>(TYPE_INT);
 
 		lval->val.set_val.size = set->Length();
-		lval->val.set_val.vals = new threading::Value* [lval->val.set_val.size];
+		lval->val.set_val.vals = new_log_val_array(batch, lval->val.set_val.size);
 
 		for ( bro_int_t i = 0; i < lval->val.set_val.size; i++ )
-			lval->val.set_val.vals[i] = ValToLogVal(set->Idx(i).get());
+			lval->val.set_val.vals[i] = ValToLogVal(set->Idx(i).get(), nullptr, batch);
 
 		break;
 		}
@@ -1040,13 +1130,13 @@ threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
 		VectorVal* vec = val->AsVectorVal();
 		lval->val.vector_val.size = vec->Size();
 		lval->val.vector_val.vals =
-			new threading::Value* [lval->val.vector_val.size];
+			new_log_val_array(batch, lval->val.vector_val.size);
 
 		for ( bro_int_t i = 0; i < lval->val.vector_val.size; i++ )
 			{
 			lval->val.vector_val.vals[i] =
 				ValToLogVal(vec->At(i).get(),
-					    vec->GetType()->Yield().get());
+					    vec->GetType()->Yield().get(), batch);
 			}
 
 		break;
@@ -1059,20 +1149,24 @@ threading::Value* Manager::ValToLogVal(Val* val, Type* ty)
 	return lval;
 	}
 
-threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
-                                               RecordVal* columns)
+RecordValPtr Manager::FilterExtensions(Filter* filter)
 	{
-	RecordValPtr ext_rec;
+	if ( filter->num_ext_fields == 0 )
+		return nullptr;
 
-	if ( filter->num_ext_fields > 0 )
-		{
-		auto res = filter->ext_func->Invoke(IntrusivePtr{NewRef{}, filter->path_val});
+	auto res = filter->ext_func->Invoke(IntrusivePtr{NewRef{}, filter->path_val});
 
-		if ( res )
-			ext_rec = {AdoptRef{}, res.release()->AsRecordVal()};
-		}
+	if ( ! res )
+		return nullptr;
 
-	threading::Value** vals = new threading::Value*[filter->num_fields];
+	return {AdoptRef{}, res.release()->AsRecordVal()};
+	}
+
+threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
+                                               RecordVal* ext_rec, RecordVal* columns,
+                                               WriteBatch* batch)
+	{
+	threading::Value** vals = new_log_val_array(batch, filter->num_fields);
 
 	for ( int i = 0; i < filter->num_fields; ++i )
 		{
@@ -1082,33 +1176,34 @@ threading::Value** Manager::RecordToFilterVals(Stream* stream, Filter* filter,
 			if ( ! ext_rec )
 				{
 				// executing function did not return record. Send empty for all vals.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
+				vals[i] = new_log_val(batch, filter->fields[i]->type, false);
 				continue;
 				}
 
-			val = ext_rec.get();
+			val = ext_rec;
 			}
 		else
 			val = columns;
 
-		// For each field, first find the right value, which can
-		// potentially be nested inside other records.
+		// For each field, first find the record holding the right
+		// value, which can potentially be nested inside other records.
+		// The records along the way stay alive through their parents.
 		list<int>& indices = filter->indices[i];
+		auto last = std::prev(indices.end());
 
-		for ( list<int>::iterator j = indices.begin(); j != indices.end(); ++j )
+		for ( list<int>::iterator j = indices.begin(); j != last; ++j )
 			{
 			val = val->AsRecordVal()->GetField(*j).get();
 
 			if ( ! val )
-				{
-				// Value, or any of its parents, is not set.
-				vals[i] = new threading::Value(filter->fields[i]->type, false);
 				break;
-				}
 			}
 
 		if ( val )
-			vals[i] = ValToLogVal(val);
+			vals[i] = FieldToLogVal(val->AsRecordVal(), *last, batch);
+		else
+			// One of the parents is not set.
+			vals[i] = new_log_val(batch, filter->fields[i]->type, false);
 		}
 
 	return vals;
@@ -1243,7 +1338,7 @@ WriterFrontend* Manager::CreateWriter(EnumVal* id, EnumVal* writer, WriterBacken
 
 void Manager::DeleteVals(int num_fields, threading::Value** vals)
 	{
-	// Note this code is duplicated in WriterBackend::DeleteVals().
+	// Note this code is duplicated in WriterFrontend::DeleteVals().
 	for ( int i = 0; i < num_fields; i++ )
 		delete vals[i];
 
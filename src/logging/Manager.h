@@ -23,6 +23,7 @@ namespace detail { class SerializationFormat; }
 namespace logging {
 
 class WriterFrontend;
+class WriteBatch;
 class RotationFinishedMessage;
 class RotationTimer;
 
@@ -284,10 +285,20 @@ private:
 	                    TableVal* include, TableVal* exclude,
 	                    const std::string& path, const std::list<int>& indices);
 
+	// Returns the filter's extension record, or null if it has none.
+	RecordValPtr FilterExtensions(Filter* filter);
+
+	// Both build the values in the batch's arena if one is given, and on
+	// the heap otherwise. ext_rec is the result of FilterExtensions().
 	threading::Value** RecordToFilterVals(Stream* stream, Filter* filter,
-	                                      RecordVal* columns);
+	                                      RecordVal* ext_rec, RecordVal* columns,
+	                                      WriteBatch* batch = nullptr);
+
+	threading::Value* ValToLogVal(Val* val, Type* ty = nullptr, WriteBatch* batch = nullptr);
 
-	threading::Value* ValToLogVal(Val* val, Type* ty = nullptr);
+	// Like ValToLogVal() for a record field, but reading atomic values
+	// straight from the record.
+	threading::Value* FieldToLogVal(RecordVal* rv, int field, WriteBatch* batch);
 	Stream* FindStream(EnumVal* id);
 	void RemoveDisabledWriters(Stream* stream);
 	void InstallRotationTimer(WriterInfo* winfo);
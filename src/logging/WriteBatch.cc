@@ -0,0 +1,64 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/logging/WriteBatch.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace zeek::logging {
+
+// Smallest arena block we allocate.
+static constexpr size_t MIN_BLOCK_SIZE = 16 * 1024;
+
+WriteBatch::WriteBatch(int arg_num_fields, size_t size_hint)
+	{
+	num_fields = arg_num_fields;
+
+	if ( size_hint )
+		{
+		// Leave some room for the next batch being a bit larger.
+		block_size = std::max(size_hint + size_hint / 8, MIN_BLOCK_SIZE);
+		blocks.emplace_back(new char[block_size]);
+		cur_block = blocks.back().get();
+		}
+	}
+
+WriteBatch::~WriteBatch()
+	{
+	// Arena values don't own anything outside of the arena, so they
+	// just go away with their blocks.
+	for ( auto vals : owned_records )
+		threading::Value::delete_value_ptr_array(vals, num_fields);
+	}
+
+void* WriteBatch::AllocateSlow(size_t n, size_t align)
+	{
+	size_t size = std::max({n + align, block_size * 2, MIN_BLOCK_SIZE});
+
+	blocks.emplace_back(new char[size]);
+	cur_block = blocks.back().get();
+	block_size = size;
+	block_pos = 0;
+
+	return Allocate(n, align);
+	}
+
+char* WriteBatch::CopyString(const char* data, size_t len)
+	{
+	// Some consumers expect a terminating null even though there's a
+	// length.
+	char* s = static_cast<char*>(Allocate(len + 1, 1));
+	memcpy(s, data, len);
+	s[len] = '\0';
+	return s;
+	}
+
+void WriteBatch::Add(threading::Value** vals, bool owned)
+	{
+	records.push_back(vals);
+
+	if ( owned )
+		owned_records.push_back(vals);
+	}
+
+} // namespace zeek::logging
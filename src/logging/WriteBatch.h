@@ -0,0 +1,127 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "zeek/threading/SerialTypes.h"
+
+namespace zeek::logging {
+
+/**
+ * A batch of log records that a WriterFrontend hands over to its backend
+ * in a single message.
+ *
+ * Records are normally built directly inside the batch's arena: the
+ * threading::Value instances, the per-record value arrays, and all string
+ * data get carved out of a few large blocks instead of being allocated
+ * one by one. Writers see ordinary threading::Value pointers into the
+ * arena, and everything is released at once when the batch is destroyed.
+ *
+ * Values from the arena must never be deleted individually. The batch can
+ * also carry records allocated on the heap the traditional way, which it
+ * then deletes when it's destroyed.
+ */
+class WriteBatch {
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param num_fields The number of fields of each record.
+	 *
+	 * @param size_hint Initial arena size in bytes. Passing the arena
+	 * size of the previous batch usually makes the arena a single
+	 * allocation.
+	 */
+	explicit WriteBatch(int num_fields, size_t size_hint = 0);
+
+	~WriteBatch();
+
+	WriteBatch(const WriteBatch&) = delete;
+	WriteBatch& operator=(const WriteBatch&) = delete;
+
+	/**
+	 * Allocates a value in the arena.
+	 */
+	threading::Value* NewValue(TypeTag type, bool present = true)
+		{
+		return new (Allocate(sizeof(threading::Value), alignof(threading::Value)))
+			threading::Value(type, present);
+		}
+
+	/**
+	 * Allocates an uninitialized array of value pointers in the arena,
+	 * e.g. for a record or for the elements of a set or vector.
+	 */
+	threading::Value** NewValueArray(size_t n)
+		{
+		return static_cast<threading::Value**>(
+			Allocate(n * sizeof(threading::Value*), alignof(threading::Value*)));
+		}
+
+	/**
+	 * Copies string data into the arena.
+	 */
+	char* CopyString(const char* data, size_t len);
+
+	/**
+	 * Appends a record.
+	 *
+	 * @param vals The record's values, of size NumFields().
+	 *
+	 * @param owned True if \a vals and its values are heap-allocated,
+	 * passing their ownership to the batch. False if they come from the
+	 * arena.
+	 */
+	void Add(threading::Value** vals, bool owned);
+
+	/**
+	 * Returns the number of fields of each record.
+	 */
+	int NumFields() const	{ return num_fields; }
+
+	/**
+	 * Returns the number of records in the batch.
+	 */
+	int Size() const	{ return records.size(); }
+
+	/**
+	 * Returns the records in the order they were added.
+	 */
+	threading::Value** const* Records() const	{ return records.data(); }
+
+	/**
+	 * Returns the number of arena bytes in use.
+	 */
+	size_t ArenaSize() const	{ return arena_used; }
+
+private:
+	void* Allocate(size_t n, size_t align)
+		{
+		size_t pos = (block_pos + align - 1) & ~(align - 1);
+
+		if ( pos + n > block_size )
+			return AllocateSlow(n, align);
+
+		arena_used += pos + n - block_pos;
+		block_pos = pos + n;
+		return cur_block + pos;
+		}
+
+	void* AllocateSlow(size_t n, size_t align);
+
+	int num_fields;
+	std::vector<threading::Value**> records;
+	std::vector<threading::Value**> owned_records;
+
+	// Arena blocks; allocation happens from the last one.
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char* cur_block = nullptr;
+	size_t block_size = 0;
+	size_t block_pos = 0;
+	size_t arena_used = 0;
+};
+
+} // namespace zeek::logging
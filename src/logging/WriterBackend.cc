@@ -8,6 +8,7 @@
 #include "zeek/threading/SerialTypes.h"
 #include "zeek/logging/Manager.h"
 #include "zeek/logging/WriterFrontend.h"
+#include "zeek/logging/WriteBatch.h"
 
 // Messages sent from backend to frontend (i.e., "OutputMessages").
 
@@ -143,20 +144,6 @@ WriterBackend::~WriterBackend()
 	delete info;
 	}
 
-void WriterBackend::DeleteVals(int num_writes, Value*** vals)
-	{
-	for ( int j = 0; j < num_writes; ++j )
-		{
-		// Note this code is duplicated in Manager::DeleteVals().
-		for ( int i = 0; i < num_fields; i++ )
-			delete vals[j][i];
-
-		delete [] vals[j];
-		}
-
-	delete [] vals;
-	}
-
 bool WriterBackend::FinishedRotation(const char* new_name, const char* old_name,
 				     double open, double close, bool terminating)
 	{
@@ -195,24 +182,27 @@ bool WriterBackend::Init(int arg_num_fields, const Field* const* arg_fields)
 	return true;
 	}
 
-bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
+bool WriterBackend::Write(WriteBatch* batch)
 	{
 	// Double-check that the arguments match. If we get this from remote,
 	// something might be mixed up.
-	if ( num_fields != arg_num_fields )
+	if ( num_fields != batch->NumFields() )
 		{
 
 #ifdef DEBUG
 		const char* msg = Fmt("Number of fields don't match in WriterBackend::Write() (%d vs. %d)",
-				      arg_num_fields, num_fields);
+				      batch->NumFields(), num_fields);
 		Debug(DBG_LOGGING, msg);
 #endif
 
-		DeleteVals(num_writes, vals);
+		delete batch;
 		DisableFrontend();
 		return false;
 		}
 
+	int num_writes = batch->Size();
+	Value** const* vals = batch->Records();
+
 	// Double-check all the types match.
 	for ( int j = 0; j < num_writes; j++ )
 		{
@@ -226,7 +216,7 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 				Debug(DBG_LOGGING, msg);
 #endif
 				DisableFrontend();
-				DeleteVals(num_writes, vals);
+				delete batch;
 				return false;
 				}
 			}
@@ -245,7 +235,7 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals)
 			}
 		}
 
-	DeleteVals(num_writes, vals);
+	delete batch;
 
 	if ( ! success )
 		DisableFrontend();
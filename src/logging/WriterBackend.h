@@ -12,6 +12,7 @@ namespace broker { class data; }
 namespace zeek::logging {
 
 class WriterFrontend;
+class WriteBatch;
 
 /**
  * Base class for writer implementation. When the logging::Manager creates a
@@ -144,21 +145,18 @@ public:
 	bool Init(int num_fields, const threading::Field* const* fields);
 
 	/**
-	 * Writes one log entry.
+	 * Writes a batch of log entries.
 	 *
-	 * @param num_fields: The number of log fields for this stream. The
-	 * value must match what was passed to Init().
-	 *
-	 * @param An array of size \a num_fields with the log values. Their
-	 * types musst match with the field passed to Init(). The method
-	 * takes ownership of \a vals..
+	 * @param batch: The entries. Their number of fields and their types
+	 * must match what was passed to Init(). The method takes ownership of
+	 * \a batch.
 	 *
 	 * Returns false if an error occured, in which case the writer must
 	 * not be used any further.
 	 *
 	 * @return False if an error occured.
 	 */
-	bool Write(int num_fields, int num_writes, threading::Value*** vals);
+	bool Write(WriteBatch* batch);
 
 	/**
 	 * Sets the buffering status for the writer, assuming the writer
@@ -381,11 +379,6 @@ protected:
 	virtual bool DoHeartbeat(double network_time, double current_time) = 0;
 
 private:
-	/**
-	 * Deletes the values as passed into Write().
-	 */
-	void DeleteVals(int num_writes, threading::Value*** vals);
-
 	// Frontend that instantiated us. This object must not be access from
 	// this class, it's running in a different thread!
 	WriterFrontend* frontend;
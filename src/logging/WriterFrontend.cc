@@ -5,6 +5,7 @@
 #include "zeek/broker/Manager.h"
 #include "zeek/logging/Manager.h"
 #include "zeek/logging/WriterBackend.h"
+#include "zeek/logging/WriteBatch.h"
 
 using zeek::threading::Value;
 using zeek::threading::Field;
@@ -53,16 +54,14 @@ private:
 class WriteMessage final : public threading::InputMessage<WriterBackend>
 {
 public:
-	WriteMessage(WriterBackend* backend, int num_fields, int num_writes, Value*** vals)
+	WriteMessage(WriterBackend* backend, WriteBatch* batch)
 		: threading::InputMessage<WriterBackend>("Write", backend),
-		num_fields(num_fields), num_writes(num_writes), vals(vals)	{}
+		batch(batch)	{}
 
-	bool Process() override { return Object()->Write(num_fields, num_writes, vals); }
+	bool Process() override { return Object()->Write(batch); }
 
 private:
-	int num_fields;
-	int num_writes;
-	Value ***vals;
+	WriteBatch* batch;
 };
 
 class SetBufMessage final : public threading::InputMessage<WriterBackend>
@@ -104,8 +103,8 @@ WriterFrontend::WriterFrontend(const WriterBackend::WriterInfo& arg_info, EnumVa
 	buf = true;
 	local = arg_local;
 	remote = arg_remote;
-	write_buffer = nullptr;
-	write_buffer_pos = 0;
+	write_batch = nullptr;
+	last_batch_size = 0;
 	info = new WriterBackend::WriterInfo(arg_info);
 
 	num_fields = 0;
@@ -132,6 +131,7 @@ WriterFrontend::~WriterFrontend()
 		delete fields[i];
 
 	delete [] fields;
+	delete write_batch;
 
 	Unref(stream);
 	Unref(writer);
@@ -216,33 +216,72 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals)
 		return;
 		}
 
-	if ( ! write_buffer )
+	AddToBatch(vals, true);
+	}
+
+WriteBatch* WriterFrontend::CurrentBatch()
+	{
+	if ( disabled || ! initialized || ! backend )
+		return nullptr;
+
+	if ( ! write_batch )
+		// Size the arena after the previous batch, so that a steady
+		// stream of similar records needs a single allocation.
+		write_batch = new WriteBatch(num_fields, last_batch_size);
+
+	return write_batch;
+	}
+
+void WriterFrontend::WriteInBatch(int arg_num_fields, Value** vals)
+	{
+	// The values belong to the batch's arena, so there's nothing to
+	// clean up when skipping them.
+	if ( arg_num_fields != num_fields )
+		{
+		reporter->Warning("WriterFrontend %s expected %d fields in write, got %d. Skipping line.",
+		                  name, num_fields, arg_num_fields);
+		return;
+		}
+
+	if ( remote )
 		{
-		// Need new buffer.
-		write_buffer = new Value**[WRITER_BUFFER_SIZE];
-		write_buffer_pos = 0;
+		broker_mgr->PublishLogWrite(stream,
+				writer,
+				info->path,
+				num_fields,
+				vals);
 		}
 
-	write_buffer[write_buffer_pos++] = vals;
+	AddToBatch(vals, false);
+	}
+
+void WriterFrontend::AddToBatch(Value** vals, bool owned)
+	{
+	if ( ! write_batch )
+		write_batch = new WriteBatch(num_fields, last_batch_size);
+
+	write_batch->Add(vals, owned);
 
-	if ( write_buffer_pos >= WRITER_BUFFER_SIZE || ! buf || run_state::terminating )
+	if ( write_batch->Size() >= WRITER_BUFFER_SIZE || ! buf || run_state::terminating )
 		// Buffer full (or no bufferin desired or termiating).
 		FlushWriteBuffer();
-
 	}
 
 void WriterFrontend::FlushWriteBuffer()
 	{
-	if ( ! write_buffer_pos )
+	if ( ! write_batch || ! write_batch->Size() )
 		// Nothing to do.
 		return;
 
+	last_batch_size = write_batch->ArenaSize();
+
 	if ( backend )
-		backend->SendIn(new WriteMessage(backend, num_fields, write_buffer_pos, write_buffer));
+		// Passes ownership of the batch to the child thread.
+		backend->SendIn(new WriteMessage(backend, write_batch));
+	else
+		delete write_batch;
 
-	// Clear buffer (no delete, we pass ownership to child thread.)
-	write_buffer = nullptr;
-	write_buffer_pos = 0;
+	write_batch = nullptr;
 	}
 
 void WriterFrontend::SetBuf(bool enabled)
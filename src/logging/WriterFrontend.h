@@ -7,6 +7,7 @@
 namespace zeek::logging  {
 
 class Manager;
+class WriteBatch;
 
 /**
  * Bridge class between the logging::Manager and backend writer threads. The
@@ -93,6 +94,28 @@ public:
 	 */
 	void Write(int num_fields, threading::Value** vals);
 
+	/**
+	 * Returns the batch that the next write will go into, so that the
+	 * caller can build the record's values directly inside the batch's
+	 * arena and then pass them to WriteInBatch(). Returns null if the
+	 * frontend has nowhere to write locally, in which case the caller
+	 * should use Write() instead.
+	 *
+	 * The batch remains valid until the next write or flush.
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	WriteBatch* CurrentBatch();
+
+	/**
+	 * Write out a record whose values were allocated from the arena of
+	 * CurrentBatch(). Otherwise this is the same as Write(), except that
+	 * the batch retains ownership of \a vals.
+	 *
+	 * This method must only be called from the main thread.
+	 */
+	void WriteInBatch(int num_fields, threading::Value** vals);
+
 	/**
 	 * Sets the buffering state.
 	 *
@@ -203,10 +226,13 @@ protected:
 	int num_fields;	// The number of log fields.
 	const threading::Field* const*  fields;	// The log fields.
 
+	// Adds a record to the current batch and flushes it if needed.
+	void AddToBatch(threading::Value** vals, bool owned);
+
 	// Buffer for bulk writes.
 	static const int WRITER_BUFFER_SIZE = 1000;
-	int write_buffer_pos;	// Position of next write in buffer.
-	threading::Value*** write_buffer;	// Buffer of size WRITER_BUFFER_SIZE.
+	WriteBatch* write_batch;	// Batch being filled, if any.
+	size_t last_batch_size;	// Arena size of the previously sent batch.
 };
 
 } // namespace zeek::logging
@@ -203,6 +203,8 @@ Ascii::Ascii(WriterFrontend* frontend) : WriterBackend(frontend)
 	formatter = nullptr;
 	gzip_level = 0;
 	gzfile = nullptr;
+	zstd_level = 0;
+	compression_threads = 0;
 
 	InitConfigOptions();
 	init_options = InitFilterOptions();
@@ -215,6 +217,8 @@ void Ascii::InitConfigOptions()
 	use_json = BifConst::LogAscii::use_json;
 	enable_utf_8 = BifConst::LogAscii::enable_utf_8;
 	gzip_level = BifConst::LogAscii::gzip_level;
+	zstd_level = BifConst::LogAscii::zstd_level;
+	compression_threads = BifConst::LogAscii::compression_threads;
 
 	separator.assign(
 			(const char*) BifConst::LogAscii::separator->Bytes(),
@@ -252,6 +256,11 @@ void Ascii::InitConfigOptions()
 		(const char*) BifConst::LogAscii::gzip_file_extension->Bytes(),
 		BifConst::LogAscii::gzip_file_extension->Len()
 		);
+
+	zstd_file_extension.assign(
+		(const char*) BifConst::LogAscii::zstd_file_extension->Bytes(),
+		BifConst::LogAscii::zstd_file_extension->Len()
+		);
 	}
 
 bool Ascii::InitFilterOptions()
@@ -285,6 +294,10 @@ bool Ascii::InitFilterOptions()
 				return false;
 				}
 			}
+
+		else if ( strcmp(i->first, "zstd_level" ) == 0 )
+			zstd_level = atoi(i->second);
+
 		else if ( strcmp(i->first, "use_json") == 0 )
 			{
 			if ( strcmp(i->second, "T") == 0 )
@@ -344,6 +357,33 @@ bool Ascii::InitFilterOptions()
 
 		else if ( strcmp(i->first, "gzip_file_extension") == 0 )
 			gzip_file_extension.assign(i->second);
+
+		else if ( strcmp(i->first, "zstd_file_extension") == 0 )
+			zstd_file_extension.assign(i->second);
+		}
+
+	if ( gzip_level < 0 || gzip_level > 9 )
+		{
+		Error("invalid value for 'gzip_level', must be a number between 0 and 9.");
+		return false;
+		}
+
+	if ( zstd_level < 0 || zstd_level > 19 )
+		{
+		Error("invalid value for 'zstd_level', must be a number between 0 and 19.");
+		return false;
+		}
+
+	if ( zstd_level > 0 && gzip_level > 0 )
+		{
+		Error("'gzip_level' and 'zstd_level' cannot both be enabled");
+		return false;
+		}
+
+	if ( zstd_level > 0 && ! BlockCompressor::HaveFormat(BlockCompressor::ZSTD) )
+		{
+		Error("zstd compression is not supported by this build");
+		return false;
 		}
 
 	if ( ! InitFormatter() )
@@ -440,14 +480,7 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const threading::Fiel
 
 	if ( ! IsSpecial(fname) )
 		{
-		std::string ext = "." + LogExt();
-
-		if ( gzip_level > 0 )
-			{
-			ext += ".";
-			ext += gzip_file_extension.empty() ? "gz" : gzip_file_extension;
-			}
-
+		std::string ext = "." + LogExt() + CompressionExt();
 		fname += ext;
 
 		bool use_shadow = BifConst::LogAscii::enable_leftover_log_rotation && Info().rotation_interval > 0;
@@ -499,14 +532,16 @@ bool Ascii::DoInit(const WriterInfo& info, int num_fields, const threading::Fiel
 		return false;
 		}
 
-	if ( gzip_level > 0 )
-		{
-		if ( gzip_level < 0 || gzip_level > 9 )
-			{
-			Error("invalid value for 'gzip_level', must be a number between 0 and 9.");
-			return false;
-			}
+	if ( zstd_level > 0 )
+		compressor = std::make_unique<BlockCompressor>(fd, BlockCompressor::ZSTD, zstd_level,
+		                                               compression_threads);
+
+	else if ( gzip_level > 0 && compression_threads > 0 )
+		compressor = std::make_unique<BlockCompressor>(fd, BlockCompressor::GZIP, gzip_level,
+		                                               compression_threads);
 
+	else if ( gzip_level > 0 )
+		{
 		char mode[4];
 		snprintf(mode, sizeof(mode), "wb%d", gzip_level);
 		errno = 0; // errno will only be set under certain circumstances by gzdopen.
@@ -587,6 +622,12 @@ bool Ascii::WriteHeader(const string& path)
 
 bool Ascii::DoFlush(double network_time)
 	{
+	if ( compressor && ! compressor->Flush() )
+		{
+		Error(Fmt("error compressing %s: %s", fname.c_str(), compressor->ErrorMsg().c_str()));
+		return false;
+		}
+
 	fsync(fd);
 	return true;
 	}
@@ -661,13 +702,7 @@ bool Ascii::DoRotate(const char* rotated_path, double open, double close, bool t
 
 	CloseFile(close);
 
-	string nname = string(rotated_path) + "." + LogExt();
-
-	if ( gzip_level > 0 )
-		{
-		nname += ".";
-		nname += gzip_file_extension.empty() ? "gz" : gzip_file_extension;
-		}
+	string nname = string(rotated_path) + "." + LogExt() + CompressionExt();
 
 	if ( rename(fname.c_str(), nname.c_str()) != 0 )
 		{
@@ -882,8 +917,28 @@ string Ascii::Timestamp(double t)
 	return tmp;
 	}
 
+string Ascii::CompressionExt()
+	{
+	if ( zstd_level > 0 )
+		return "." + (zstd_file_extension.empty() ? "zst" : zstd_file_extension);
+
+	if ( gzip_level > 0 )
+		return "." + (gzip_file_extension.empty() ? "gz" : gzip_file_extension);
+
+	return "";
+	}
+
 bool Ascii::InternalWrite(int fd, const char* data, int len)
 	{
+	if ( compressor )
+		{
+		if ( compressor->Write(data, len) )
+			return true;
+
+		Error(Fmt("Ascii::InternalWrite error: %s\n", compressor->ErrorMsg().c_str()));
+		return false;
+		}
+
 	if ( ! gzfile )
 		return util::safe_write(fd, data, len);
 
@@ -907,6 +962,19 @@ bool Ascii::InternalWrite(int fd, const char* data, int len)
 
 bool Ascii::InternalClose(int fd)
 	{
+	if ( compressor )
+		{
+		// Writes out the remaining blocks.
+		bool ok = compressor->Finish();
+
+		if ( ! ok )
+			Error(Fmt("Ascii::InternalClose error: %s\n", compressor->ErrorMsg().c_str()));
+
+		compressor.reset();
+		util::safe_close(fd);
+		return ok;
+		}
+
 	if ( ! gzfile )
 		{
 		util::safe_close(fd);
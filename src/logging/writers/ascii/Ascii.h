@@ -5,8 +5,10 @@
 #pragma once
 
 #include <zlib.h>
+#include <memory>
 
 #include "zeek/logging/WriterBackend.h"
+#include "zeek/logging/writers/ascii/BlockCompressor.h"
 #include "zeek/threading/formatters/Ascii.h"
 #include "zeek/threading/formatters/JSON.h"
 #include "zeek/Desc.h"
@@ -50,11 +52,13 @@ private:
 	void InitConfigOptions();
 	bool InitFilterOptions();
 	bool InitFormatter();
+	std::string CompressionExt();
 	bool InternalWrite(int fd, const char* data, int len);
 	bool InternalClose(int fd);
 
 	int fd;
 	gzFile gzfile;
+	std::unique_ptr<BlockCompressor> compressor;
 	std::string fname;
 	ODesc desc;
 	bool ascii_done;
@@ -72,6 +76,9 @@ private:
 
 	int gzip_level; // level > 0 enables gzip compression
 	std::string gzip_file_extension;
+	int zstd_level; // level > 0 enables zstd compression
+	std::string zstd_file_extension;
+	int compression_threads; // > 0 compresses blocks in parallel
 	bool use_json;
 	bool enable_utf_8;
 	std::string json_timestamps;
@@ -0,0 +1,289 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+
+#include "zeek/logging/writers/ascii/BlockCompressor.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "zeek/util.h"
+
+namespace zeek::logging::writer::detail {
+
+// Amount of uncompressed data per block. Large enough to not noticeably
+// hurt the compression ratio, small enough to keep memory bounded.
+static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
+namespace {
+
+// Threads compressing blocks for all writers. They live until the process
+// exits.
+class CompressionPool {
+public:
+	static CompressionPool* Get(int threads)
+		{
+		// Leaked on purpose, as there's no good point to stop the
+		// threads before exit.
+		static CompressionPool* pool = new CompressionPool(threads);
+		return pool;
+		}
+
+	void Submit(std::function<void()> job)
+		{
+			{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+			}
+
+		cond.notify_one();
+		}
+
+private:
+	explicit CompressionPool(int threads)
+		{
+		// The threads inherit the signal mask of the writer thread
+		// creating them, which blocks everything, so that signals
+		// keep going to the main thread.
+		for ( int i = 0; i < threads; ++i )
+			std::thread(&CompressionPool::Run, this).detach();
+		}
+
+	void Run()
+		{
+		while ( true )
+			{
+			std::function<void()> job;
+
+				{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [this] { return ! jobs.empty(); });
+				job = std::move(jobs.front());
+				jobs.pop_front();
+				}
+
+			job();
+			}
+		}
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<std::function<void()>> jobs;
+};
+
+} // namespace
+
+bool BlockCompressor::HaveFormat(Format format)
+	{
+#ifdef USE_ZSTD
+	return true;
+#else
+	return format == GZIP;
+#endif
+	}
+
+BlockCompressor::BlockCompressor(int arg_fd, Format arg_format, int arg_level, int arg_threads)
+	{
+	fd = arg_fd;
+	format = arg_format;
+	level = arg_level;
+	threads = arg_threads;
+
+	buffer.reserve(BLOCK_SIZE);
+	}
+
+BlockCompressor::~BlockCompressor()
+	{
+	// Jobs refer to us, so wait for them.
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for ( const auto& b : pending )
+		cond.wait(lock, [&b] { return b->done; });
+	}
+
+bool BlockCompressor::Write(const char* data, size_t len)
+	{
+	while ( len > 0 )
+		{
+		size_t n = std::min(len, BLOCK_SIZE - buffer.size());
+		buffer.append(data, n);
+		data += n;
+		len -= n;
+
+		if ( buffer.size() >= BLOCK_SIZE && ! Submit() )
+			return false;
+		}
+
+	return true;
+	}
+
+bool BlockCompressor::Flush()
+	{
+	if ( ! buffer.empty() && ! Submit() )
+		return false;
+
+	return WriteFinished(0);
+	}
+
+bool BlockCompressor::Finish()
+	{
+	// Even without any data, the file must hold a valid, empty
+	// member or frame.
+	if ( ! wrote_any && buffer.empty() && pending.empty() )
+		{
+		Block block;
+		Compress(format, level, &block);
+
+		if ( ! WriteBlock(block) )
+			return false;
+		}
+
+	return Flush();
+	}
+
+bool BlockCompressor::Submit()
+	{
+	auto block = std::make_shared<Block>();
+	block->input.swap(buffer);
+	buffer.reserve(BLOCK_SIZE);
+
+	if ( threads == 0 )
+		{
+		Compress(format, level, block.get());
+		return WriteBlock(*block);
+		}
+
+	pending.push_back(block);
+
+	auto job = [this, block, format = format, level = level]()
+		{
+		Compress(format, level, block.get());
+
+		// Notify while holding the lock, so that the compressor can't
+		// go away before we're done with it.
+		std::lock_guard<std::mutex> lock(mutex);
+		block->done = true;
+		cond.notify_all();
+		};
+
+	CompressionPool::Get(threads)->Submit(std::move(job));
+
+	// Leave enough blocks in flight to keep the threads busy while the
+	// writer fills the next ones.
+	return WriteFinished(2 * threads);
+	}
+
+bool BlockCompressor::WriteFinished(size_t max_pending)
+	{
+	while ( ! pending.empty() )
+		{
+		auto block = pending.front();
+
+			{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			if ( pending.size() > max_pending )
+				cond.wait(lock, [&block] { return block->done; });
+
+			else if ( ! block->done )
+				return true;
+			}
+
+		pending.pop_front();
+
+		if ( ! WriteBlock(*block) )
+			return false;
+		}
+
+	return true;
+	}
+
+bool BlockCompressor::WriteBlock(const Block& block)
+	{
+	if ( ! block.error.empty() )
+		{
+		error = block.error;
+		return false;
+		}
+
+	if ( ! util::safe_write(fd, block.output.data(), block.output.size()) )
+		{
+		error = std::string("write failed: ") + strerror(errno);
+		return false;
+		}
+
+	wrote_any = true;
+	return true;
+	}
+
+void BlockCompressor::Compress(Format format, int level, Block* block)
+	{
+	const std::string& in = block->input;
+	std::string& out = block->output;
+
+	if ( format == GZIP )
+		{
+		z_stream zs;
+		zs.zalloc = Z_NULL;
+		zs.zfree = Z_NULL;
+		zs.opaque = Z_NULL;
+
+		// 16 added to the window bits selects a gzip wrapper.
+		if ( deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+			{
+			block->error = "cannot initialize gzip compression";
+			return;
+			}
+
+		out.resize(deflateBound(&zs, in.size()));
+		zs.next_in = (Bytef*)in.data();
+		zs.avail_in = in.size();
+		zs.next_out = (Bytef*)out.data();
+		zs.avail_out = out.size();
+
+		int rc = deflate(&zs, Z_FINISH);
+		out.resize(zs.total_out);
+		deflateEnd(&zs);
+
+		if ( rc != Z_STREAM_END )
+			block->error = "gzip compression failed: " + std::to_string(rc);
+		}
+
+	else
+		{
+#ifdef USE_ZSTD
+		// One context per thread saves reallocating its tables for
+		// every block.
+		static thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)>
+			ctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+
+		out.resize(ZSTD_compressBound(in.size()));
+		size_t n = ZSTD_compressCCtx(ctx.get(), out.data(), out.size(),
+		                             in.data(), in.size(), level);
+
+		if ( ZSTD_isError(n) )
+			{
+			block->error = std::string("zstd compression failed: ") + ZSTD_getErrorName(n);
+			return;
+			}
+
+		out.resize(n);
+#else
+		block->error = "zstd support not compiled in";
+#endif
+		}
+
+	// Don't hold on to the input while waiting to be written.
+	std::string().swap(block->input);
+	}
+
+} // namespace zeek::logging::writer::detail
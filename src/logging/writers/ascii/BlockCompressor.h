@@ -0,0 +1,127 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace zeek::logging::writer::detail {
+
+/**
+ * Compresses a log file's output in independent blocks.
+ *
+ * Data gets collected into blocks of a fixed size, each of which becomes
+ * a self-contained gzip member or zstd frame. Concatenations of these are
+ * valid gzip and zstd files, respectively, which the standard tools
+ * decompress as a whole.
+ *
+ * With threads enabled, blocks get compressed on a small pool of threads
+ * shared by all writers, while the writer keeps filling the next block.
+ * Finished blocks are still written to the file in order, and the number
+ * of blocks in flight is bounded so that a writer that produces data
+ * faster than it can be compressed eventually waits.
+ *
+ * All methods must be called from the writer's thread.
+ */
+class BlockCompressor {
+public:
+	enum Format { GZIP, ZSTD };
+
+	/**
+	 * Returns true if Zeek has been built with support for the given
+	 * format.
+	 */
+	static bool HaveFormat(Format format);
+
+	/**
+	 * Constructor.
+	 *
+	 * @param fd The file to write the compressed output to. The
+	 * compressor doesn't take ownership.
+	 *
+	 * @param format The compression format.
+	 *
+	 * @param level The compression level, in the format's own range.
+	 *
+	 * @param threads The size of the shared compression thread pool. The
+	 * first compressor to use threads determines the size. If 0, blocks
+	 * get compressed right away on the calling thread.
+	 */
+	BlockCompressor(int fd, Format format, int level, int threads);
+
+	/**
+	 * Destructor. Waits for any blocks in flight, but discards them;
+	 * call Finish() to write them out.
+	 */
+	~BlockCompressor();
+
+	BlockCompressor(const BlockCompressor&) = delete;
+	BlockCompressor& operator=(const BlockCompressor&) = delete;
+
+	/**
+	 * Adds data to the output.
+	 *
+	 * @return False if an error occurred; see ErrorMsg().
+	 */
+	bool Write(const char* data, size_t len);
+
+	/**
+	 * Compresses all data added so far and writes it to the file,
+	 * waiting for it to complete.
+	 *
+	 * @return False if an error occurred; see ErrorMsg().
+	 */
+	bool Flush();
+
+	/**
+	 * Flushes the output and completes the file. The compressor must
+	 * not be used afterwards.
+	 *
+	 * @return False if an error occurred; see ErrorMsg().
+	 */
+	bool Finish();
+
+	/**
+	 * Returns a description of the last error.
+	 */
+	const std::string& ErrorMsg() const	{ return error; }
+
+private:
+	struct Block {
+		std::string input;
+		std::string output;
+		std::string error;
+		bool done = false;
+	};
+
+	// Hands the current buffer off for compression.
+	bool Submit();
+
+	// Writes out finished blocks from the front of the queue, waiting
+	// for further ones while more than max_pending remain in flight.
+	bool WriteFinished(size_t max_pending);
+
+	bool WriteBlock(const Block& block);
+
+	static void Compress(Format format, int level, Block* block);
+
+	int fd;
+	Format format;
+	int level;
+	int threads;
+
+	std::string buffer;
+	bool wrote_any = false;
+	std::string error;
+
+	// Blocks in flight, in file order. The mutex protects the blocks'
+	// done flags.
+	std::deque<std::shared_ptr<Block>> pending;
+	std::mutex mutex;
+	std::condition_variable cond;
+};
+
+} // namespace zeek::logging::writer::detail
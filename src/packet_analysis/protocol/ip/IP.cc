@@ -157,6 +157,11 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 			{
 			f = detail::fragment_mgr->NextFragment(run_state::processing_start_time, packet->ip_hdr,
 			                                       packet->data + hdr_size);
+
+			if ( ! f )
+				// Reassembly failed, nothing to analyze.
+				return true;
+
 			std::unique_ptr<IP_Hdr> ih = f->ReassembledPkt();
 
 			if ( ! ih )
@@ -263,8 +268,5 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 		break;
 	}
 
-	if ( f )
-		f->DeleteTimer();
-
 	return return_val;
 	}
@@ -0,0 +1,1437 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/script_opt/ByteCode.h"
+
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "zeek/Desc.h"
+#include "zeek/Frame.h"
+#include "zeek/Func.h"
+#include "zeek/Reporter.h"
+#include "zeek/Traverse.h"
+#include "zeek/script_opt/ProfileFunc.h"
+
+
+namespace zeek::detail {
+
+
+const char* bc_op_name(BCOp op)
+	{
+	static const char* op_names[NUM_BC_OPS] = {
+		"add-i", "add-u", "add-d",
+		"sub-i", "sub-u", "sub-d",
+		"mul-i", "mul-u", "mul-d",
+		"div-i", "div-u", "div-d",
+		"mod-i", "mod-u",
+		"and-u", "or-u", "xor-u",
+		"lt-i", "lt-u", "lt-d",
+		"le-i", "le-u", "le-d",
+		"eq-i", "eq-u", "eq-d",
+		"ne-i", "ne-u", "ne-d",
+		"neg-i", "neg-d",
+		"not",
+		"move",
+		"i2u", "i2d", "u2i", "u2d", "d2i", "d2u",
+		"incr-i", "incr-u", "decr-i", "decr-u",
+		"load", "store", "store-nil",
+		"eval", "eval-to-reg", "eval-to-frame", "exec",
+		"jump", "jump-if-false", "eval-branch",
+		"return", "return-reg", "return-expr", "exit", "done",
+	};
+
+	return op_names[int(op)];
+	}
+
+// Placeholder for "no such opcode".
+static constexpr BCOp BC_NONE = BCOp(NUM_BC_OPS);
+
+static bool is_native_type(const Type* t)
+	{
+	switch ( t->Tag() ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+	case TYPE_COUNT:
+	case TYPE_DOUBLE:
+	case TYPE_TIME:
+	case TYPE_INTERVAL:
+		return true;
+
+	default:
+		return false;
+	}
+	}
+
+static void unbox(const Val* v, TypeTag t, BCValue& r)
+	{
+	switch ( t ) {
+	case TYPE_BOOL:
+	case TYPE_INT:
+		r.int_val = v->AsInt();
+		break;
+
+	case TYPE_COUNT:
+		r.uint_val = v->AsCount();
+		break;
+
+	default:
+		r.double_val = v->AsDouble();
+		break;
+	}
+	}
+
+static ValPtr box(const BCValue& r, TypeTag t)
+	{
+	switch ( t ) {
+	case TYPE_BOOL:		return val_mgr->Bool(r.int_val);
+	case TYPE_INT:		return val_mgr->Int(r.int_val);
+	case TYPE_COUNT:	return val_mgr->Count(r.uint_val);
+	case TYPE_DOUBLE:	return make_intrusive<DoubleVal>(r.double_val);
+	case TYPE_TIME:		return make_intrusive<TimeVal>(r.double_val);
+	case TYPE_INTERVAL:	return make_intrusive<IntervalVal>(r.double_val);
+
+	default:
+		reporter->InternalError("bad type in bytecode boxing");
+		return nullptr;
+	}
+	}
+
+// If the expression is a local whose values could live in a register,
+// returns its identifier.
+static const ID* native_local(const Expr* e)
+	{
+	if ( e->Tag() != EXPR_NAME )
+		return nullptr;
+
+	auto id = e->AsNameExpr()->Id();
+
+	if ( id->IsGlobal() || ! is_native_type(id->GetType().get()) )
+		return nullptr;
+
+	return id;
+	}
+
+static bool is_native_operand(const Expr* e)
+	{
+	if ( e->Tag() == EXPR_CONST )
+		return is_native_type(e->GetType().get());
+
+	return native_local(e) != nullptr;
+	}
+
+static BCOp select_op(InternalTypeTag it, BCOp i_op, BCOp u_op, BCOp d_op)
+	{
+	switch ( it ) {
+	case TYPE_INTERNAL_INT:		return i_op;
+	case TYPE_INTERNAL_UNSIGNED:	return u_op;
+	case TYPE_INTERNAL_DOUBLE:	return d_op;
+	default:			return BC_NONE;
+	}
+	}
+
+// Returns the opcode computing the given (reduced) expression from its
+// operands in registers, or BC_NONE if it can't be computed that way.
+// Sets "swap" if the operands need to go in reverse order.
+static BCOp native_op(const Expr* e, bool& swap)
+	{
+	swap = false;
+
+	if ( ! is_native_type(e->GetType().get()) )
+		return BC_NONE;
+
+	auto it = e->GetType()->InternalType();
+	auto tag = e->Tag();
+
+	if ( tag == EXPR_NOT || tag == EXPR_NEGATE || tag == EXPR_ARITH_COERCE )
+		{
+		auto op = e->GetOp1();
+
+		if ( ! is_native_operand(op.get()) )
+			return BC_NONE;
+
+		auto op_it = op->GetType()->InternalType();
+
+		if ( tag == EXPR_NOT )
+			return op->GetType()->Tag() == TYPE_BOOL ? BC_NOT : BC_NONE;
+
+		if ( tag == EXPR_NEGATE )
+			return op_it == it ? select_op(it, BC_NEG_I, BC_NONE, BC_NEG_D) : BC_NONE;
+
+		if ( op_it == it )
+			return BC_MOVE;
+
+		switch ( op_it ) {
+		case TYPE_INTERNAL_INT:
+			return select_op(it, BC_NONE, BC_I2U, BC_I2D);
+		case TYPE_INTERNAL_UNSIGNED:
+			return select_op(it, BC_U2I, BC_NONE, BC_U2D);
+		case TYPE_INTERNAL_DOUBLE:
+			return select_op(it, BC_D2I, BC_D2U, BC_NONE);
+		default:
+			return BC_NONE;
+		}
+		}
+
+	switch ( tag ) {
+	case EXPR_ADD:
+	case EXPR_SUB:
+	case EXPR_TIMES:
+	case EXPR_DIVIDE:
+	case EXPR_MOD:
+	case EXPR_AND:
+	case EXPR_OR:
+	case EXPR_XOR:
+	case EXPR_LT:
+	case EXPR_LE:
+	case EXPR_EQ:
+	case EXPR_NE:
+	case EXPR_GE:
+	case EXPR_GT:
+		break;
+
+	default:
+		return BC_NONE;
+	}
+
+	auto op1 = e->GetOp1();
+	auto op2 = e->GetOp2();
+
+	if ( ! is_native_operand(op1.get()) || ! is_native_operand(op2.get()) )
+		return BC_NONE;
+
+	auto op_it = op1->GetType()->InternalType();
+
+	if ( op2->GetType()->InternalType() != op_it )
+		return BC_NONE;
+
+	bool is_cmp = tag == EXPR_LT || tag == EXPR_LE || tag == EXPR_EQ ||
+	              tag == EXPR_NE || tag == EXPR_GE || tag == EXPR_GT;
+
+	if ( is_cmp ? e->GetType()->Tag() != TYPE_BOOL : op_it != it )
+		return BC_NONE;
+
+	switch ( tag ) {
+	case EXPR_ADD:		return select_op(op_it, BC_ADD_I, BC_ADD_U, BC_ADD_D);
+	case EXPR_SUB:		return select_op(op_it, BC_SUB_I, BC_SUB_U, BC_SUB_D);
+	case EXPR_TIMES:	return select_op(op_it, BC_MUL_I, BC_MUL_U, BC_MUL_D);
+	case EXPR_DIVIDE:	return select_op(op_it, BC_DIV_I, BC_DIV_U, BC_DIV_D);
+	case EXPR_MOD:		return select_op(op_it, BC_MOD_I, BC_MOD_U, BC_NONE);
+	case EXPR_AND:		return select_op(op_it, BC_NONE, BC_AND_U, BC_NONE);
+	case EXPR_OR:		return select_op(op_it, BC_NONE, BC_OR_U, BC_NONE);
+	case EXPR_XOR:		return select_op(op_it, BC_NONE, BC_XOR_U, BC_NONE);
+	case EXPR_LT:		return select_op(op_it, BC_LT_I, BC_LT_U, BC_LT_D);
+	case EXPR_LE:		return select_op(op_it, BC_LE_I, BC_LE_U, BC_LE_D);
+	case EXPR_EQ:		return select_op(op_it, BC_EQ_I, BC_EQ_U, BC_EQ_D);
+	case EXPR_NE:		return select_op(op_it, BC_NE_I, BC_NE_U, BC_NE_D);
+
+	case EXPR_GT:
+		swap = true;
+		return select_op(op_it, BC_LT_I, BC_LT_U, BC_LT_D);
+
+	case EXPR_GE:
+		swap = true;
+		return select_op(op_it, BC_LE_I, BC_LE_U, BC_LE_D);
+
+	default:
+		return BC_NONE;
+	}
+	}
+
+static bool is_native_expr(const Expr* e)
+	{
+	bool swap;
+	return is_native_operand(e) || native_op(e, swap) != BC_NONE;
+	}
+
+// True if the expression can be computed natively for assigning it to
+// the given local.
+static bool is_native_value_for(const Expr* e, const ID* target)
+	{
+	return is_native_expr(e) &&
+	       e->GetType()->InternalType() == target->GetType()->InternalType();
+	}
+
+// If the expression is an assignment to a local whose values could live
+// in a register, returns that local.
+static const ID* assign_target(const Expr* e)
+	{
+	if ( e->Tag() != EXPR_ASSIGN )
+		return nullptr;
+
+	auto lhs = e->GetOp1();
+
+	if ( lhs->Tag() == EXPR_REF )
+		lhs = lhs->GetOp1();
+
+	auto id = native_local(lhs.get());
+
+	// Make sure we can unbox the value if it's computed generically.
+	if ( id && e->GetOp2()->GetType()->InternalType() !=
+	           id->GetType()->InternalType() )
+		return nullptr;
+
+	return id;
+	}
+
+// The same for increments and decrements.
+static const ID* incr_target(const Expr* e)
+	{
+	if ( e->Tag() != EXPR_INCR && e->Tag() != EXPR_DECR )
+		return nullptr;
+
+	auto target = e->GetOp1();
+
+	if ( target->Tag() == EXPR_REF )
+		target = target->GetOp1();
+
+	auto id = native_local(target.get());
+
+	if ( id && ! IsIntegral(id->GetType()->Tag()) )
+		return nullptr;
+
+	return id;
+	}
+
+using IDSet = std::unordered_set<const ID*>;
+
+namespace {
+
+// Compiles a reduced function body in two passes over it.  The first
+// determines which locals can live in registers: those of suitable types
+// that generically executed code never refers to and that are assigned
+// on all paths before they're read.  The second then generates the code.
+// The two passes make the same decisions on how to compile each piece of
+// the body.
+class BCCompiler {
+public:
+	BCCompiler(const ScriptFunc* f, StmtPtr body);
+
+	StmtPtr Compile();
+
+private:
+	// First pass.
+	void Analyze(const Stmt* s, IDSet& assigned);
+	void AnalyzeValue(const Expr* e, const ID* target, const IDSet& assigned);
+	void NoteOperand(const Expr* e, const IDSet& assigned);
+	void NoteGeneric(const Stmt* s);
+	void NoteGeneric(const Expr* e);
+	void NoteCandidate(const ID* id);
+	void NoteConst(const Expr* e);
+
+	// Second pass.
+	void CompileStmt(const Stmt* s);
+	void CompileCond(const Expr* cond, int false_jump_list, int nil_jump_list);
+	void CompileReturn(const Expr* e);
+	void CompileAssign(const ID* target, const Expr* rhs, const Expr* assign);
+	void CompileNative(const Expr* e, int dest);
+	void EmitExec(const Stmt* s);
+
+	// Returns a register holding the value of the native expression,
+	// loading or computing it if needed.
+	int ValueReg(const Expr* e);
+
+	// Returns the register of the given local, or -1 if its value
+	// lives in the Frame.
+	int Reg(const ID* id) const
+		{
+		auto r = regs.find(id);
+		return r == regs.end() ? -1 : r->second;
+		}
+
+	int ConstReg(const Expr* e);
+	int NewScratch()	{ return num_regs++; }
+
+	bool IsParam(const ID* id) const
+		{ return id->Offset() < num_params; }
+
+	int Emit(BCInst inst);
+
+	// Jumps and other instructions pointing forward get collected in
+	// lists until the target becomes known.
+	struct Patch {
+		int inst;
+		int BCInst::* field;
+	};
+
+	int NewPatchList();
+	void AddPatch(int list, int inst, int BCInst::* field);
+	void PatchHere(int list);
+
+	// Context for "next" and "break" in a loop.
+	struct LoopInfo {
+		int top;
+		int breaks;	// patch list
+	};
+
+	// Context for "return" in an inlined block.
+	struct CatchInfo {
+		const ID* ret_id;
+		int exits;	// patch list
+	};
+
+	const ScriptFunc* func;
+	StmtPtr body;
+	int num_params;
+
+	// Results of the first pass.
+	std::vector<const ID*> candidates;
+	IDSet candidate_set;
+	IDSet generic_locals;
+	IDSet unset_reads;
+	std::vector<const ID*> catch_ret_ids;
+
+	std::vector<BCValue> consts;
+	std::map<std::pair<int, uint64_t>, int> const_regs;
+	std::unordered_map<const ID*, int> regs;
+	int num_regs = 0;
+
+	// State of the second pass.
+	std::vector<BCInst> insts;
+	std::vector<std::vector<Patch>> patch_lists;
+	std::vector<LoopInfo> loops;
+	std::vector<CatchInfo> catches;
+	int num_native = 0;
+};
+
+BCCompiler::BCCompiler(const ScriptFunc* f, StmtPtr arg_body)
+	: func(f), body(std::move(arg_body))
+	{
+	num_params = f->GetType()->Params()->NumFields();
+	}
+
+StmtPtr BCCompiler::Compile()
+	{
+	IDSet assigned;
+	Analyze(body.get(), assigned);
+
+	num_regs = consts.size();
+
+	for ( auto id : candidates )
+		if ( generic_locals.count(id) == 0 && unset_reads.count(id) == 0 )
+			regs[id] = num_regs++;
+
+	// Parameters living in registers start out with their arguments.
+	for ( auto id : candidates )
+		{
+		auto r = Reg(id);
+
+		if ( r >= 0 && IsParam(id) )
+			{
+			BCInst i{BC_LOAD};
+			i.a = r;
+			i.t = id->GetType()->Tag();
+			i.id = {NewRef{}, const_cast<ID*>(id)};
+			Emit(std::move(i));
+			}
+		}
+
+	CompileStmt(body.get());
+	Emit({BC_DONE});
+
+	if ( num_native == 0 )
+		return nullptr;
+
+	return make_intrusive<ByteCodeBody>(body, std::move(insts),
+	                                    std::move(consts), num_regs);
+	}
+
+void BCCompiler::Analyze(const Stmt* s, IDSet& assigned)
+	{
+	switch ( s->Tag() ) {
+	case STMT_LIST:
+		for ( auto stmt : s->AsStmtList()->Stmts() )
+			Analyze(stmt, assigned);
+		break;
+
+	case STMT_EXPR:
+		{
+		auto e = s->AsExprStmt()->StmtExpr();
+
+		if ( auto target = assign_target(e) )
+			{
+			AnalyzeValue(e->GetOp2().get(), target, assigned);
+			NoteCandidate(target);
+			assigned.insert(target);
+			}
+
+		else if ( auto target = incr_target(e) )
+			{
+			NoteCandidate(target);
+
+			if ( ! assigned.count(target) && ! IsParam(target) )
+				unset_reads.insert(target);
+			}
+
+		else
+			NoteGeneric(e);
+
+		break;
+		}
+
+	case STMT_IF:
+		{
+		auto i = s->AsIfStmt();
+		AnalyzeValue(i->StmtExpr(), nullptr, assigned);
+
+		IDSet true_assigned = assigned;
+		IDSet false_assigned = assigned;
+		Analyze(i->TrueBranch(), true_assigned);
+		Analyze(i->FalseBranch(), false_assigned);
+
+		// A branch that doesn't continue afterwards doesn't
+		// constrain what's assigned there.
+		if ( i->TrueBranch()->NoFlowAfter(false) )
+			assigned = std::move(false_assigned);
+
+		else if ( i->FalseBranch()->NoFlowAfter(false) )
+			assigned = std::move(true_assigned);
+
+		else
+			{
+			assigned.clear();
+
+			for ( auto id : true_assigned )
+				if ( false_assigned.count(id) )
+					assigned.insert(id);
+			}
+
+		break;
+		}
+
+	case STMT_WHILE:
+		{
+		auto w = s->AsWhileStmt();
+
+		// Locals declared inside the loop become unset again in
+		// every iteration.
+		ProfileFunc pf;
+		w->Body()->Traverse(&pf);
+
+		for ( auto id : pf.Inits() )
+			assigned.erase(id);
+
+		if ( w->CondPredStmt() )
+			Analyze(w->CondPredStmt().get(), assigned);
+
+		AnalyzeValue(w->Condition().get(), nullptr, assigned);
+
+		// The body might not execute at all.
+		IDSet body_assigned = assigned;
+		Analyze(w->Body().get(), body_assigned);
+		break;
+		}
+
+	case STMT_RETURN:
+		{
+		auto e = s->AsReturnStmt()->StmtExpr();
+
+		if ( ! e )
+			break;
+
+		if ( catch_ret_ids.empty() )
+			AnalyzeValue(e, nullptr, assigned);
+
+		else if ( auto ret_id = catch_ret_ids.back() )
+			AnalyzeValue(e, ret_id, assigned);
+
+		else
+			NoteGeneric(e);
+
+		break;
+		}
+
+	case STMT_CATCH_RETURN:
+		{
+		auto cr = s->AsCatchReturnStmt();
+		auto rv = cr->RetVar();
+		auto ret_id = rv ? native_local(rv) : nullptr;
+
+		if ( rv && ! ret_id )
+			{
+			// Compiled as a whole to generic execution.
+			NoteGeneric(s);
+			break;
+			}
+
+		if ( ret_id )
+			NoteCandidate(ret_id);
+
+		catch_ret_ids.push_back(ret_id);
+		IDSet block_assigned = assigned;
+		Analyze(cr->Block().get(), block_assigned);
+		catch_ret_ids.pop_back();
+
+		// If the block can complete without a "return", the
+		// return variable ends up unset.
+		if ( ret_id && cr->Block()->NoFlowAfter(false) )
+			assigned.insert(ret_id);
+
+		break;
+		}
+
+	case STMT_INIT:
+		for ( const auto& id : s->AsInitStmt()->Inits() )
+			assigned.erase(id.get());
+		break;
+
+	case STMT_NEXT:
+	case STMT_BREAK:
+	case STMT_NULL:
+		break;
+
+	default:
+		NoteGeneric(s);
+		break;
+	}
+	}
+
+void BCCompiler::AnalyzeValue(const Expr* e, const ID* target, const IDSet& assigned)
+	{
+	if ( target ? ! is_native_value_for(e, target) : ! is_native_expr(e) )
+		{
+		NoteGeneric(e);
+		return;
+		}
+
+	if ( is_native_operand(e) )
+		{
+		NoteOperand(e, assigned);
+		return;
+		}
+
+	NoteOperand(e->GetOp1().get(), assigned);
+
+	if ( auto op2 = e->GetOp2() )
+		NoteOperand(op2.get(), assigned);
+	}
+
+void BCCompiler::NoteOperand(const Expr* e, const IDSet& assigned)
+	{
+	if ( e->Tag() == EXPR_CONST )
+		{
+		NoteConst(e);
+		return;
+		}
+
+	auto id = native_local(e);
+	NoteCandidate(id);
+
+	if ( ! assigned.count(id) && ! IsParam(id) )
+		unset_reads.insert(id);
+	}
+
+void BCCompiler::NoteGeneric(const Stmt* s)
+	{
+	ProfileFunc pf;
+	s->Traverse(&pf);
+
+	generic_locals.insert(pf.Locals().begin(), pf.Locals().end());
+	generic_locals.insert(pf.Inits().begin(), pf.Inits().end());
+	}
+
+void BCCompiler::NoteGeneric(const Expr* e)
+	{
+	ProfileFunc pf;
+	e->Traverse(&pf);
+
+	generic_locals.insert(pf.Locals().begin(), pf.Locals().end());
+	}
+
+void BCCompiler::NoteCandidate(const ID* id)
+	{
+	if ( candidate_set.insert(id).second )
+		candidates.push_back(id);
+	}
+
+void BCCompiler::NoteConst(const Expr* e)
+	{
+	ConstReg(e);
+	}
+
+int BCCompiler::ConstReg(const Expr* e)
+	{
+	BCValue v;
+	unbox(e->AsConstExpr()->Value(), e->GetType()->Tag(), v);
+
+	uint64_t bits;
+	memcpy(&bits, &v, sizeof(bits));
+
+	auto key = std::make_pair(int(e->GetType()->InternalType()), bits);
+	auto c = const_regs.find(key);
+
+	if ( c != const_regs.end() )
+		return c->second;
+
+	// All constants get found by the first pass, so that they
+	// precede the other registers.
+	ASSERT(insts.empty());
+
+	int r = consts.size();
+	consts.push_back(v);
+	const_regs[key] = r;
+
+	return r;
+	}
+
+void BCCompiler::CompileStmt(const Stmt* s)
+	{
+	switch ( s->Tag() ) {
+	case STMT_LIST:
+		for ( auto stmt : s->AsStmtList()->Stmts() )
+			CompileStmt(stmt);
+		break;
+
+	case STMT_EXPR:
+		{
+		auto e = s->AsExprStmt()->StmtExpr();
+
+		if ( auto target = assign_target(e) )
+			CompileAssign(target, e->GetOp2().get(), e);
+
+		else if ( auto target = incr_target(e) )
+			{
+			auto r = Reg(target);
+
+			if ( r >= 0 )
+				{
+				bool is_int = target->GetType()->Tag() == TYPE_INT;
+				BCOp op;
+
+				if ( e->Tag() == EXPR_INCR )
+					op = is_int ? BC_INCR_I : BC_INCR_U;
+				else
+					op = is_int ? BC_DECR_I : BC_DECR_U;
+
+				BCInst i{op};
+				i.a = r;
+				i.e = e;
+				Emit(std::move(i));
+				}
+			else
+				{
+				BCInst i{BC_EVAL};
+				i.e = e;
+				Emit(std::move(i));
+				}
+			}
+
+		else
+			{
+			BCInst i{BC_EVAL};
+			i.e = e;
+			Emit(std::move(i));
+			}
+
+		break;
+		}
+
+	case STMT_IF:
+		{
+		auto is = s->AsIfStmt();
+		int false_jumps = NewPatchList();
+		int end_jumps = NewPatchList();
+
+		CompileCond(is->StmtExpr(), false_jumps, end_jumps);
+		CompileStmt(is->TrueBranch());
+
+		if ( is->FalseBranch()->Tag() != STMT_NULL )
+			{
+			BCInst skip{BC_JUMP};
+			AddPatch(end_jumps, Emit(std::move(skip)), &BCInst::target);
+
+			PatchHere(false_jumps);
+			CompileStmt(is->FalseBranch());
+			}
+		else
+			PatchHere(false_jumps);
+
+		PatchHere(end_jumps);
+		break;
+		}
+
+	case STMT_WHILE:
+		{
+		auto w = s->AsWhileStmt();
+		int top = insts.size();
+		int exits = NewPatchList();
+
+		if ( w->CondPredStmt() )
+			CompileStmt(w->CondPredStmt().get());
+
+		CompileCond(w->Condition().get(), exits, exits);
+
+		loops.push_back({top, exits});
+		CompileStmt(w->Body().get());
+		loops.pop_back();
+
+		BCInst back{BC_JUMP};
+		back.target = top;
+		Emit(std::move(back));
+
+		PatchHere(exits);
+		break;
+		}
+
+	case STMT_NEXT:
+	case STMT_BREAK:
+		{
+		bool is_next = s->Tag() == STMT_NEXT;
+
+		if ( loops.empty() )
+			{
+			BCInst i{BC_EXIT};
+			i.a = is_next ? FLOW_LOOP : FLOW_BREAK;
+			Emit(std::move(i));
+			}
+
+		else if ( is_next )
+			{
+			BCInst i{BC_JUMP};
+			i.target = loops.back().top;
+			Emit(std::move(i));
+			}
+
+		else
+			{
+			BCInst i{BC_JUMP};
+			AddPatch(loops.back().breaks, Emit(std::move(i)), &BCInst::target);
+			}
+
+		break;
+		}
+
+	case STMT_RETURN:
+		{
+		auto e = s->AsReturnStmt()->StmtExpr();
+
+		if ( catches.empty() )
+			{
+			CompileReturn(e);
+			break;
+			}
+
+		// Returning from an inlined block.
+		const auto& c = catches.back();
+
+		if ( e )
+			{
+			if ( c.ret_id )
+				CompileAssign(c.ret_id, e, nullptr);
+
+			else
+				{
+				BCInst i{BC_EVAL};
+				i.e = e;
+				Emit(std::move(i));
+				}
+			}
+
+		BCInst exit{BC_JUMP};
+		AddPatch(c.exits, Emit(std::move(exit)), &BCInst::target);
+		break;
+		}
+
+	case STMT_CATCH_RETURN:
+		{
+		auto cr = s->AsCatchReturnStmt();
+		auto rv = cr->RetVar();
+		auto ret_id = rv ? native_local(rv) : nullptr;
+
+		if ( rv && ! ret_id )
+			{
+			// The return value can't live in a register, so
+			// we leave the block to the AST.
+			EmitExec(s);
+			break;
+			}
+
+		catches.push_back({ret_id, NewPatchList()});
+		CompileStmt(cr->Block().get());
+		auto exits = catches.back().exits;
+		catches.pop_back();
+
+		if ( ret_id && Reg(ret_id) < 0 && ! cr->Block()->NoFlowAfter(false) )
+			{
+			BCInst i{BC_STORE_NIL};
+			i.id = {NewRef{}, const_cast<ID*>(ret_id)};
+			Emit(std::move(i));
+			}
+
+		PatchHere(exits);
+		break;
+		}
+
+	case STMT_INIT:
+		{
+		// Only locals living in the Frame need initializing.
+		for ( const auto& id : s->AsInitStmt()->Inits() )
+			if ( Reg(id.get()) < 0 )
+				{
+				EmitExec(s);
+				break;
+				}
+
+		break;
+		}
+
+	case STMT_NULL:
+		break;
+
+	default:
+		EmitExec(s);
+		break;
+	}
+	}
+
+void BCCompiler::CompileCond(const Expr* cond, int false_jumps, int nil_jumps)
+	{
+	if ( is_native_expr(cond) )
+		{
+		BCInst i{BC_JUMP_IF_FALSE};
+		i.b = ValueReg(cond);
+		AddPatch(false_jumps, Emit(std::move(i)), &BCInst::target);
+		}
+	else
+		{
+		BCInst i{BC_EVAL_BRANCH};
+		i.e = cond;
+		int n = Emit(std::move(i));
+		AddPatch(false_jumps, n, &BCInst::target);
+		AddPatch(nil_jumps, n, &BCInst::target2);
+		}
+	}
+
+void BCCompiler::CompileReturn(const Expr* e)
+	{
+	if ( ! e )
+		Emit({BC_RETURN});
+
+	else if ( is_native_expr(e) )
+		{
+		BCInst i{BC_RETURN_REG};
+		i.b = ValueReg(e);
+		i.t = e->GetType()->Tag();
+		Emit(std::move(i));
+		}
+
+	else
+		{
+		BCInst i{BC_RETURN_EXPR};
+		i.e = e;
+		Emit(std::move(i));
+		}
+	}
+
+void BCCompiler::CompileAssign(const ID* target, const Expr* rhs, const Expr* assign)
+	{
+	auto r = Reg(target);
+	IDPtr target_ptr{NewRef{}, const_cast<ID*>(target)};
+
+	if ( is_native_value_for(rhs, target) )
+		{
+		if ( r >= 0 )
+			CompileNative(rhs, r);
+
+		else
+			{
+			auto scratch = NewScratch();
+			CompileNative(rhs, scratch);
+
+			BCInst i{BC_STORE};
+			i.b = scratch;
+			i.t = target->GetType()->Tag();
+			i.id = std::move(target_ptr);
+			Emit(std::move(i));
+			}
+		}
+
+	else if ( r >= 0 )
+		{
+		BCInst i{BC_EVAL_TO_REG};
+		i.a = r;
+		i.t = target->GetType()->Tag();
+		i.e = rhs;
+		Emit(std::move(i));
+		}
+
+	else if ( assign )
+		{
+		BCInst i{BC_EVAL};
+		i.e = assign;
+		Emit(std::move(i));
+		}
+
+	else
+		{
+		BCInst i{BC_EVAL_TO_FRAME};
+		i.e = rhs;
+		i.id = std::move(target_ptr);
+		Emit(std::move(i));
+		}
+	}
+
+void BCCompiler::CompileNative(const Expr* e, int dest)
+	{
+	if ( e->Tag() == EXPR_NAME )
+		{
+		auto id = native_local(e);
+		auto r = Reg(id);
+
+		if ( r < 0 )
+			{
+			BCInst i{BC_LOAD};
+			i.a = dest;
+			i.t = id->GetType()->Tag();
+			i.e = e;
+			i.id = {NewRef{}, const_cast<ID*>(id)};
+			Emit(std::move(i));
+			}
+
+		else if ( r != dest )
+			{
+			BCInst i{BC_MOVE};
+			i.a = dest;
+			i.b = r;
+			Emit(std::move(i));
+			}
+
+		return;
+		}
+
+	if ( e->Tag() == EXPR_CONST )
+		{
+		BCInst i{BC_MOVE};
+		i.a = dest;
+		i.b = ConstReg(e);
+		Emit(std::move(i));
+		return;
+		}
+
+	bool swap;
+	BCInst i{native_op(e, swap)};
+	i.a = dest;
+	i.b = ValueReg(e->GetOp1().get());
+
+	if ( auto op2 = e->GetOp2() )
+		i.c = ValueReg(op2.get());
+
+	if ( swap )
+		std::swap(i.b, i.c);
+
+	i.e = e;
+	Emit(std::move(i));
+	}
+
+int BCCompiler::ValueReg(const Expr* e)
+	{
+	if ( e->Tag() == EXPR_CONST )
+		return ConstReg(e);
+
+	if ( e->Tag() == EXPR_NAME )
+		{
+		auto r = Reg(native_local(e));
+
+		if ( r >= 0 )
+			return r;
+		}
+
+	auto scratch = NewScratch();
+	CompileNative(e, scratch);
+
+	return scratch;
+	}
+
+void BCCompiler::EmitExec(const Stmt* s)
+	{
+	BCInst i{BC_EXEC};
+	i.s = const_cast<Stmt*>(s);
+
+	if ( ! loops.empty() )
+		i.target = loops.back().top;
+
+	int n = Emit(std::move(i));
+
+	if ( ! loops.empty() )
+		AddPatch(loops.back().breaks, n, &BCInst::target2);
+
+	if ( ! catches.empty() )
+		{
+		const auto& c = catches.back();
+		auto& inst = insts[n];
+
+		if ( c.ret_id )
+			{
+			inst.t = c.ret_id->GetType()->Tag();
+			inst.a = Reg(c.ret_id);
+
+			if ( inst.a < 0 )
+				inst.id = {NewRef{}, const_cast<ID*>(c.ret_id)};
+			}
+
+		AddPatch(c.exits, n, &BCInst::target3);
+		}
+	}
+
+int BCCompiler::Emit(BCInst inst)
+	{
+	if ( inst.op <= BC_DECR_U || inst.op == BC_JUMP_IF_FALSE )
+		++num_native;
+
+	insts.push_back(std::move(inst));
+	return insts.size() - 1;
+	}
+
+int BCCompiler::NewPatchList()
+	{
+	patch_lists.emplace_back();
+	return patch_lists.size() - 1;
+	}
+
+void BCCompiler::AddPatch(int list, int inst, int BCInst::* field)
+	{
+	patch_lists[list].push_back({inst, field});
+	}
+
+void BCCompiler::PatchHere(int list)
+	{
+	int here = insts.size();
+
+	for ( const auto& p : patch_lists[list] )
+		insts[p.inst].*p.field = here;
+
+	patch_lists[list].clear();
+	}
+
+} // namespace
+
+
+ByteCodeBody::ByteCodeBody(StmtPtr arg_body, std::vector<BCInst> arg_insts,
+                           std::vector<BCValue> arg_consts, int arg_num_regs)
+	: Stmt(STMT_BYTECODE), body(std::move(arg_body)),
+	  insts(std::move(arg_insts)), consts(std::move(arg_consts)),
+	  num_regs(arg_num_regs)
+	{
+	SetLocationInfo(body->GetLocationInfo());
+	}
+
+ValPtr ByteCodeBody::Exec(Frame* f, StmtFlowType& flow) const
+	{
+	RegisterAccess();
+	flow = FLOW_NEXT;
+
+	BCValue stack_regs[MAX_STACK_REGS];
+	std::unique_ptr<BCValue[]> heap_regs;
+	BCValue* r = stack_regs;
+
+	if ( num_regs > MAX_STACK_REGS )
+		{
+		heap_regs = std::make_unique<BCValue[]>(num_regs);
+		r = heap_regs.get();
+		}
+
+	if ( ! consts.empty() )
+		memcpy(r, consts.data(), consts.size() * sizeof(BCValue));
+
+	const BCInst* code = insts.data();
+	int pc = 0;
+
+	for ( ; ; )
+		{
+		const BCInst& i = code[pc++];
+
+		switch ( i.op ) {
+#define BC_ARITH(op, field, oper) \
+		case op: \
+			r[i.a].field = r[i.b].field oper r[i.c].field; \
+			break;
+
+#define BC_CMP(op, field, oper) \
+		case op: \
+			r[i.a].int_val = r[i.b].field oper r[i.c].field; \
+			break;
+
+#define BC_DIV(op, field, oper, msg) \
+		case op: \
+			if ( r[i.c].field == 0 ) \
+				reporter->ExprRuntimeError(i.e, msg); \
+			r[i.a].field = r[i.b].field oper r[i.c].field; \
+			break;
+
+#define BC_CONVERT(op, to_field, to_type, from_field) \
+		case op: \
+			r[i.a].to_field = static_cast<to_type>(r[i.b].from_field); \
+			break;
+
+		BC_ARITH(BC_ADD_I, int_val, +)
+		BC_ARITH(BC_ADD_U, uint_val, +)
+		BC_ARITH(BC_ADD_D, double_val, +)
+		BC_ARITH(BC_SUB_I, int_val, -)
+		BC_ARITH(BC_SUB_U, uint_val, -)
+		BC_ARITH(BC_SUB_D, double_val, -)
+		BC_ARITH(BC_MUL_I, int_val, *)
+		BC_ARITH(BC_MUL_U, uint_val, *)
+		BC_ARITH(BC_MUL_D, double_val, *)
+		BC_DIV(BC_DIV_I, int_val, /, "division by zero")
+		BC_DIV(BC_DIV_U, uint_val, /, "division by zero")
+		BC_DIV(BC_DIV_D, double_val, /, "division by zero")
+		BC_DIV(BC_MOD_I, int_val, %, "modulo by zero")
+		BC_DIV(BC_MOD_U, uint_val, %, "modulo by zero")
+		BC_ARITH(BC_AND_U, uint_val, &)
+		BC_ARITH(BC_OR_U, uint_val, |)
+		BC_ARITH(BC_XOR_U, uint_val, ^)
+
+		BC_CMP(BC_LT_I, int_val, <)
+		BC_CMP(BC_LT_U, uint_val, <)
+		BC_CMP(BC_LT_D, double_val, <)
+		BC_CMP(BC_LE_I, int_val, <=)
+		BC_CMP(BC_LE_U, uint_val, <=)
+		BC_CMP(BC_LE_D, double_val, <=)
+		BC_CMP(BC_EQ_I, int_val, ==)
+		BC_CMP(BC_EQ_U, uint_val, ==)
+		BC_CMP(BC_EQ_D, double_val, ==)
+		BC_CMP(BC_NE_I, int_val, !=)
+		BC_CMP(BC_NE_U, uint_val, !=)
+		BC_CMP(BC_NE_D, double_val, !=)
+
+		case BC_NEG_I:
+			r[i.a].int_val = - r[i.b].int_val;
+			break;
+
+		case BC_NEG_D:
+			r[i.a].double_val = - r[i.b].double_val;
+			break;
+
+		case BC_NOT:
+			r[i.a].int_val = ! r[i.b].int_val;
+			break;
+
+		case BC_MOVE:
+			r[i.a] = r[i.b];
+			break;
+
+		BC_CONVERT(BC_I2U, uint_val, bro_uint_t, int_val)
+		BC_CONVERT(BC_I2D, double_val, double, int_val)
+		BC_CONVERT(BC_U2I, int_val, bro_int_t, uint_val)
+		BC_CONVERT(BC_U2D, double_val, double, uint_val)
+		BC_CONVERT(BC_D2I, int_val, bro_int_t, double_val)
+		BC_CONVERT(BC_D2U, uint_val, bro_uint_t, double_val)
+
+		case BC_INCR_I:
+			++r[i.a].int_val;
+			break;
+
+		case BC_INCR_U:
+			++r[i.a].uint_val;
+			break;
+
+		case BC_DECR_I:
+			--r[i.a].int_val;
+			break;
+
+		case BC_DECR_U:
+			// Same test as the interpreter's, which goes
+			// through a signed value.
+			if ( static_cast<bro_int_t>(r[i.a].uint_val) <= 0 )
+				reporter->ExprRuntimeError(i.e, "count underflow");
+			--r[i.a].uint_val;
+			break;
+
+		case BC_LOAD:
+			{
+			const auto& v = f->GetElementByID(i.id);
+
+			if ( ! v )
+				reporter->ExprRuntimeError(i.e, "value used but not set");
+
+			unbox(v.get(), i.t, r[i.a]);
+			break;
+			}
+
+		case BC_STORE:
+			f->SetElement(i.id, box(r[i.b], i.t));
+			break;
+
+		case BC_STORE_NIL:
+			f->SetElement(i.id, nullptr);
+			break;
+
+		case BC_EVAL:
+			i.e->Eval(f);
+			break;
+
+		case BC_EVAL_TO_REG:
+			{
+			auto v = i.e->Eval(f);
+
+			// The interpreter would leave the local unset and
+			// complain once it's used, which we can't track.
+			if ( ! v )
+				reporter->ExprRuntimeError(i.e, "value used but not set");
+
+			unbox(v.get(), i.t, r[i.a]);
+			break;
+			}
+
+		case BC_EVAL_TO_FRAME:
+			f->SetElement(i.id, i.e->Eval(f));
+			break;
+
+		case BC_EXEC:
+			{
+			f->SetNextStmt(i.s);
+			auto v = i.s->Exec(f, flow);
+
+			if ( flow == FLOW_RETURN )
+				{
+				if ( i.target3 < 0 )
+					return v;
+
+				// Returning from an inlined block.
+				if ( i.a >= 0 )
+					{
+					if ( v )
+						unbox(v.get(), i.t, r[i.a]);
+					}
+
+				else if ( i.id )
+					f->SetElement(i.id, std::move(v));
+
+				pc = i.target3;
+				}
+
+			else if ( flow == FLOW_LOOP )
+				{
+				if ( i.target < 0 )
+					return nullptr;
+
+				pc = i.target;
+				}
+
+			else if ( flow == FLOW_BREAK )
+				{
+				if ( i.target2 < 0 )
+					return nullptr;
+
+				pc = i.target2;
+				}
+
+			flow = FLOW_NEXT;
+			break;
+			}
+
+		case BC_JUMP:
+			pc = i.target;
+			break;
+
+		case BC_JUMP_IF_FALSE:
+			if ( ! r[i.b].int_val )
+				pc = i.target;
+			break;
+
+		case BC_EVAL_BRANCH:
+			{
+			auto v = i.e->Eval(f);
+
+			if ( ! v )
+				pc = i.target2;
+
+			else if ( v->IsZero() )
+				pc = i.target;
+
+			break;
+			}
+
+		case BC_RETURN:
+			flow = FLOW_RETURN;
+			return nullptr;
+
+		case BC_RETURN_REG:
+			flow = FLOW_RETURN;
+			return box(r[i.b], i.t);
+
+		case BC_RETURN_EXPR:
+			flow = FLOW_RETURN;
+			return i.e->Eval(f);
+
+		case BC_EXIT:
+			flow = StmtFlowType(i.a);
+			return nullptr;
+
+		case BC_DONE:
+			return nullptr;
+
+#undef BC_ARITH
+#undef BC_CMP
+#undef BC_DIV
+#undef BC_CONVERT
+		}
+		}
+	}
+
+bool ByteCodeBody::IsPure() const
+	{
+	return body->IsPure();
+	}
+
+TraversalCode ByteCodeBody::Traverse(TraversalCallback* cb) const
+	{
+	TraversalCode tc = cb->PreStmt(this);
+	HANDLE_TC_STMT_PRE(tc);
+
+	tc = body->Traverse(cb);
+	HANDLE_TC_STMT_PRE(tc);
+
+	tc = cb->PostStmt(this);
+	HANDLE_TC_STMT_POST(tc);
+	}
+
+StmtPtr ByteCodeBody::Duplicate()
+	{
+	return body->Duplicate();
+	}
+
+void ByteCodeBody::Dump() const
+	{
+	printf("%zu constants, %d registers\n", consts.size(), num_regs);
+
+	for ( auto n = 0u; n < insts.size(); ++n )
+		{
+		const auto& i = insts[n];
+		printf("%u: %s", n, bc_op_name(i.op));
+
+		if ( i.a >= 0 )
+			printf(" a=%d", i.a);
+		if ( i.b >= 0 )
+			printf(" b=%d", i.b);
+		if ( i.c >= 0 )
+			printf(" c=%d", i.c);
+		if ( i.target >= 0 )
+			printf(" ->%d", i.target);
+		if ( i.target2 >= 0 )
+			printf(" ->%d", i.target2);
+		if ( i.target3 >= 0 )
+			printf(" ->%d", i.target3);
+		if ( i.id )
+			printf(" %s", i.id->Name());
+		if ( i.e && i.op >= BC_EVAL )
+			printf(" %s", obj_desc(i.e).c_str());
+		if ( i.s )
+			printf(" %s", obj_desc(i.s).c_str());
+
+		printf("\n");
+		}
+	}
+
+void ByteCodeBody::StmtDescribe(ODesc* d) const
+	{
+	body->Describe(d);
+	}
+
+StmtPtr compile_to_bytecode(const ScriptFunc* f, const StmtPtr& body)
+	{
+	return BCCompiler(f, body).Compile();
+	}
+
+} // namespace zeek::detail
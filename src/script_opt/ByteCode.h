@@ -0,0 +1,159 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Compilation of reduced function bodies into register-based bytecode,
+// along with the statement that interprets it.
+//
+// Locals of type bool, int, count, double, time and interval that are
+// only ever used by arithmetic, comparisons, assignments, and control flow
+// live unboxed in registers, and operations on them execute directly on
+// those, without creating Val's.  Everything else - calls, aggregates,
+// strings, globals, "for" and "switch" statements, and so on - executes as
+// before through the AST, with the operand values in the function's Frame.
+// The compiled code thus preserves the interpreter's semantics while only
+// speeding up the parts it understands.
+
+#pragma once
+
+#include <vector>
+
+#include "zeek/Stmt.h"
+#include "zeek/Expr.h"
+
+namespace zeek::detail {
+
+// The contents of a register.  Which member is valid follows from
+// the internal type of the value it holds.
+union BCValue {
+	bro_int_t int_val;	// int and bool
+	bro_uint_t uint_val;	// count
+	double double_val;	// double, time and interval
+};
+
+// Instruction opcodes.  Unless noted otherwise, "a" is the destination
+// register and "b" and "c" are the operand registers.  The _I, _U, and _D
+// suffixes denote variants for signed, unsigned and double operands.
+enum BCOp {
+	BC_ADD_I, BC_ADD_U, BC_ADD_D,
+	BC_SUB_I, BC_SUB_U, BC_SUB_D,
+	BC_MUL_I, BC_MUL_U, BC_MUL_D,
+	BC_DIV_I, BC_DIV_U, BC_DIV_D,
+	BC_MOD_I, BC_MOD_U,
+	BC_AND_U, BC_OR_U, BC_XOR_U,
+
+	// Comparisons, yielding a bool.  There are no "greater"
+	// variants; the compiler swaps the operands instead.
+	BC_LT_I, BC_LT_U, BC_LT_D,
+	BC_LE_I, BC_LE_U, BC_LE_D,
+	BC_EQ_I, BC_EQ_U, BC_EQ_D,
+	BC_NE_I, BC_NE_U, BC_NE_D,
+
+	BC_NEG_I, BC_NEG_D,
+	BC_NOT,
+	BC_MOVE,
+
+	// Arithmetic coercions, e.g. I2D converts an int to a double.
+	BC_I2U, BC_I2D, BC_U2I, BC_U2D, BC_D2I, BC_D2U,
+
+	// In-place increment/decrement of register "a".
+	BC_INCR_I, BC_INCR_U, BC_DECR_I, BC_DECR_U,
+
+	// Transfers between registers and the Frame: LOAD unboxes
+	// local "id" into "a", STORE boxes "b" into it as a value of
+	// type "t", and STORE_NIL unsets it.
+	BC_LOAD, BC_STORE, BC_STORE_NIL,
+
+	// Generic execution through the AST.  EVAL evaluates "e" for its
+	// side effects, EVAL_TO_REG unboxes its value into "a", and
+	// EVAL_TO_FRAME assigns it to local "id".  EXEC executes statement
+	// "s", with the jump targets of the instruction telling where any
+	// change in the flow of control leads.
+	BC_EVAL, BC_EVAL_TO_REG, BC_EVAL_TO_FRAME, BC_EXEC,
+
+	// Jumps go to instruction "target".  JUMP_IF_FALSE tests
+	// register "b".  EVAL_BRANCH evaluates condition "e", jumping to
+	// "target" if it's false and to "target2" if it yields no value.
+	BC_JUMP, BC_JUMP_IF_FALSE, BC_EVAL_BRANCH,
+
+	// Returning from the body: without a value, with the value of
+	// register "b" boxed as type "t", or with the value of "e".
+	// EXIT instead leaves the body with the flow given by "a", for
+	// "next" and "break" outside of loops, and DONE marks the end.
+	BC_RETURN, BC_RETURN_REG, BC_RETURN_EXPR, BC_EXIT, BC_DONE,
+
+#define NUM_BC_OPS (int(BC_DONE) + 1)
+};
+
+extern const char* bc_op_name(BCOp op);
+
+struct BCInst {
+	BCOp op;
+
+	int a = -1;
+	int b = -1;
+	int c = -1;
+
+	// Jump targets.  For EXEC, "target" is where to continue for
+	// "next", "target2" where for "break", and "target3" where for
+	// "return", with -1 meaning to leave the body instead.
+	int target = -1;
+	int target2 = -1;
+	int target3 = -1;
+
+	// Type of the value being boxed or unboxed.
+	TypeTag t = TYPE_VOID;
+
+	// Expression to evaluate generically, or to blame for run-time
+	// errors.
+	const Expr* e = nullptr;
+
+	// Statement to execute generically.
+	Stmt* s = nullptr;
+
+	// Local to transfer from or to the Frame.
+	IDPtr id;
+};
+
+// A function body compiled to bytecode.  Takes the place of the original
+// (reduced) body, which it keeps around for generic execution, for
+// traversals, and for describing it.
+class ByteCodeBody final : public Stmt {
+public:
+	ByteCodeBody(StmtPtr body, std::vector<BCInst> insts,
+	             std::vector<BCValue> consts, int num_regs);
+
+	ValPtr Exec(Frame* f, StmtFlowType& flow) const override;
+
+	bool IsPure() const override;
+
+	TraversalCode Traverse(TraversalCallback* cb) const override;
+
+	// Compiled bodies only come into existence after all other
+	// optimizations are done, so this just returns a duplicate of
+	// the original body.
+	StmtPtr Duplicate() override;
+
+	// Prints the instructions to stdout.
+	void Dump() const;
+
+protected:
+	void StmtDescribe(ODesc* d) const override;
+
+	// Number of registers up to which Exec() keeps them on the stack
+	// rather than on the heap.
+	static constexpr int MAX_STACK_REGS = 64;
+
+	StmtPtr body;
+	std::vector<BCInst> insts;
+
+	// Constants, which occupy the first registers.
+	std::vector<BCValue> consts;
+
+	int num_regs;
+};
+
+// Compiles the given reduced body of the given function.  Returns the
+// compiled body, or nil if compiling it wouldn't gain anything because
+// none of its code can run natively.
+extern StmtPtr compile_to_bytecode(const ScriptFunc* f, const StmtPtr& body);
+
+} // namespace zeek::detail
@@ -9,6 +9,7 @@
 #include "zeek/script_opt/Reduce.h"
 #include "zeek/script_opt/GenRDs.h"
 #include "zeek/script_opt/UseDefs.h"
+#include "zeek/script_opt/ByteCode.h"
 
 
 namespace zeek::detail {
@@ -102,6 +103,23 @@ void optimize_func(ScriptFunc* f, std::shared_ptr<ProfileFunc> pf,
 	if ( new_frame_size > f->FrameSize() )
 		f->SetFrameSize(new_frame_size);
 
+	if ( analysis_options.gen_bytecode )
+		{
+		auto bc = compile_to_bytecode(f, body);
+
+		if ( bc )
+			{
+			if ( analysis_options.only_func || analysis_options.dump_xform )
+				{
+				printf("Bytecode for %s:\n", f->Name());
+				static_cast<ByteCodeBody*>(bc.get())->Dump();
+				}
+
+			f->ReplaceBody(body, bc);
+			body = bc;
+			}
+		}
+
 	pop_scope();
 	}
 
@@ -134,6 +152,7 @@ void analyze_scripts()
 		check_env_opt("ZEEK_DUMP_UDS", analysis_options.dump_uds);
 		check_env_opt("ZEEK_INLINE", analysis_options.inliner);
 		check_env_opt("ZEEK_XFORM", analysis_options.activate);
+		check_env_opt("ZEEK_BYTECODE", analysis_options.gen_bytecode);
 
 		auto usage = getenv("ZEEK_USAGE_ISSUES");
 
@@ -148,7 +167,8 @@ void analyze_scripts()
 			}
 
 		if ( analysis_options.only_func ||
-		     analysis_options.usage_issues > 0 )
+		     analysis_options.usage_issues > 0 ||
+		     analysis_options.gen_bytecode )
 			analysis_options.activate = true;
 
 		did_init = true;
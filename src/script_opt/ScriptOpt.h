@@ -36,6 +36,10 @@ struct AnalyOpt {
 	// If true, do global inlining.
 	bool inliner = false;
 
+	// If true, compile optimized function bodies to bytecode that keeps
+	// suitable locals unboxed in registers.
+	bool gen_bytecode = false;
+
 	// If true, report which functions are directly and indirectly
 	// recursive, and exit.  Only germane if running the inliner.
 	bool report_recursive = false;
@@ -200,7 +200,8 @@ Message::~Message()
 	delete [] name;
 	}
 
-MsgThread::MsgThread() : BasicThread(), queue_in(this, nullptr), queue_out(nullptr, this)
+MsgThread::MsgThread() : BasicThread(), queue_in(this, nullptr, &flare_in),
+                         queue_out(nullptr, this, &flare)
 	{
 	cnt_sent_in = cnt_sent_out = 0;
 	main_finished = false;
@@ -384,8 +385,6 @@ void MsgThread::SendOut(BasicOutputMessage* msg, bool force)
 	queue_out.Put(msg);
 
 	++cnt_sent_out;
-
-	flare.Fire();
 	}
 
 void MsgThread::SendEvent(const char* name, const int num_vals, Value* *vals)
@@ -332,6 +332,11 @@ private:
 	 */
 	void Finished();
 
+	// Wake up the child when there's input for it, and the main thread's
+	// I/O loop when there's output, respectively. The queues fire them.
+	zeek::detail::Flare flare_in;
+	zeek::detail::Flare flare;
+
 	Queue<BasicInputMessage *> queue_in;
 	Queue<BasicOutputMessage *> queue_out;
 
@@ -342,8 +347,6 @@ private:
 	bool child_finished;	// Child thread is finished.
 	bool child_sent_finish; // Child thread asked to be finished.
 	bool failed;	// Set to true when a command failed.
-
-	zeek::detail::Flare flare;
 };
 
 /**
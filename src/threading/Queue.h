@@ -1,13 +1,14 @@
 #pragma once
 
-#include <mutex>
-#include <condition_variable>
-#include <queue>
+#include <atomic>
 #include <deque>
+#include <memory>
+#include <mutex>
 #include <stdint.h>
-#include <sys/time.h>
+#include <poll.h>
 
 #include "zeek/Reporter.h"
+#include "zeek/Flare.h"
 #include "zeek/threading/BasicThread.h"
 
 #undef Queue // Defined elsewhere unfortunately.
@@ -17,13 +18,17 @@ namespace zeek::threading {
 /**
  * A thread-safe single-reader single-writer queue.
  *
- * The implementation uses multiple queues and reads/writes in rotary fashion
- * in an attempt to limit contention.
+ * Elements pass through a bounded lock-free ring buffer. The reader and the
+ * writer each own one of the ring's indices, which live on separate cache
+ * lines so that the two threads don't contend for them. Should the ring fill
+ * up because the reader falls behind, further elements go to a mutex-guarded
+ * overflow list until the reader has caught up, so that Put() never blocks or
+ * drops anything.
  *
- * All Queue instances must be instantiated by Bro's main thread.
+ * The reader gets woken up through a flare, which the writer fires only when
+ * it finds the queue empty, so a burst of elements costs a single wakeup.
  *
- * TODO: Unclear how critical performance is for this qeueue. We could likely
- * optimize it further if helpful.
+ * All Queue instances must be instantiated by Bro's main thread.
  */
 template<typename T>
 class Queue
@@ -35,8 +40,16 @@ public:
 	 * reader, writer: The corresponding threads. This is for checking
 	 * whether they have terminated so that we can abort I/O opeations.
 	 * Can be left null for the main thread.
+	 *
+	 * flare: Fired whenever an element gets queued while the queue is
+	 * empty. If the reader is a thread, Get() waits on it for new input.
+	 * Can be left null if nobody needs waking up.
+	 *
+	 * capacity: Number of elements the ring can hold before spilling
+	 * into the overflow list. Rounded up to a power of two.
 	 */
-	Queue(BasicThread* arg_reader, BasicThread* arg_writer);
+	Queue(BasicThread* arg_reader, BasicThread* arg_writer,
+	      zeek::detail::Flare* arg_flare = nullptr, size_t capacity = 1024);
 
 	/**
 	 * Destructor.
@@ -44,9 +57,10 @@ public:
 	~Queue();
 
 	/**
-	 * Retrieves one element. This may block for a little while of no
-	 * input is available and eventually return with a null element if
-	 * nothing shows up.
+	 * Retrieves one element. If the reader is a thread, this may block for
+	 * a little while if no input is available and eventually return with a
+	 * null element if nothing shows up. On the main thread, it returns null
+	 * right away if the queue is empty.
 	 */
 	T Get();
 
@@ -63,13 +77,14 @@ public:
 	/**
 	 * Returns true if the next Get() operation might succeed. This
 	 * function may occasionally return a value not indicating the actual
-	 * state, but won't do so very often. Note that this means that it can
-	 * consistently return false even if there is something in the Queue.
-	 * You have to check real queue status from time to time to be sure that
-	 * it is empty. In other words, this method helps to avoid locking the queue
-	 * frequently, but doesn't allow you to forgo it completely.
+	 * state, but won't do so very often. Unlike Ready(), it may be called
+	 * from any thread.
 	 */
-	bool MaybeReady() { return (num_reads != num_writes); }
+	bool MaybeReady()
+		{
+		return num_reads.load(std::memory_order_relaxed) !=
+		       num_writes.load(std::memory_order_relaxed);
+		}
 
 	/**
 	 * Wake up the reader if it's currently blocked for input. This is
@@ -100,45 +115,60 @@ public:
 	void GetStats(Stats* stats);
 
 private:
-	static const int NUM_QUEUES = 8;
+	static constexpr size_t CACHE_LINE = 64;
+
+	// Pops the next element if there's one, without blocking.
+	bool TryGet(T* data);
+
+	// Ring storage; mask is the capacity minus one.
+	std::unique_ptr<T[]> ring;
+	size_t mask;
 
-	std::vector<std::unique_lock<std::mutex>> LocksForAllQueues();
+	// Index of the next slot to write, owned by the writer, and the
+	// writer's last view of the read index.
+	alignas(CACHE_LINE) std::atomic<uint64_t> write_idx;
+	uint64_t cached_read_idx;
 
-	std::mutex mutex[NUM_QUEUES];	// Mutex protected shared accesses.
-	std::condition_variable has_data[NUM_QUEUES];	// Signals when data becomes available
-	std::queue<T> messages[NUM_QUEUES];	// Actually holds the queued messages
+	// Index of the next slot to read, owned by the reader, and the
+	// reader's last view of the write index.
+	alignas(CACHE_LINE) std::atomic<uint64_t> read_idx;
+	uint64_t cached_write_idx;
 
-	int read_ptr;	// Where the next operation will read from
-	int write_ptr;	// Where the next operation will write to
+	// Elements that didn't fit into the ring. Once there's anything in
+	// here, the writer appends all further elements here as well until
+	// the reader has drained it, which keeps elements in order.
+	alignas(CACHE_LINE) std::mutex overflow_mutex;
+	std::deque<T> overflow;
+	std::atomic<size_t> overflow_size;
+
+	zeek::detail::Flare* flare;
 
 	BasicThread* reader;
 	BasicThread* writer;
 
-	// Statistics.
-	uint64_t num_reads;
-	uint64_t num_writes;
+	// Statistics, each updated only by one side.
+	std::atomic<uint64_t> num_reads;
+	std::atomic<uint64_t> num_writes;
 };
 
-inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m)
-	{
-	try
-		{
-		return std::unique_lock<std::mutex>(m);
-		}
-	catch ( const std::system_error& e )
-		{
-		reporter->FatalErrorWithCore("cannot lock mutex: %s", e.what());
-		// Never gets here.
-		throw std::exception();
-		}
-	}
-
 template<typename T>
-inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer)
+inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer,
+                       zeek::detail::Flare* arg_flare, size_t capacity)
 	{
-	read_ptr = 0;
-	write_ptr = 0;
+	size_t n = 1;
+
+	while ( n < capacity )
+		n <<= 1;
+
+	ring.reset(new T[n]);
+	mask = n - 1;
+
+	write_idx = read_idx = 0;
+	cached_read_idx = cached_write_idx = 0;
+	overflow_size = 0;
 	num_reads = num_writes = 0;
+
+	flare = arg_flare;
 	reader = arg_reader;
 	writer = arg_writer;
 	}
@@ -149,116 +179,143 @@ inline Queue<T>::~Queue()
 	}
 
 template<typename T>
-inline T Queue<T>::Get()
+inline bool Queue<T>::TryGet(T* data)
 	{
-	auto lock = acquire_lock(mutex[read_ptr]);
+	uint64_t r = read_idx.load(std::memory_order_relaxed);
 
-	int old_read_ptr = read_ptr;
+	if ( r == cached_write_idx )
+		cached_write_idx = write_idx.load();
 
-	if ( messages[read_ptr].empty() && ! ((reader && reader->Killed()) || (writer && writer->Killed())) )
+	if ( r != cached_write_idx )
 		{
-		if ( has_data[read_ptr].wait_for(lock, std::chrono::seconds(5)) == std::cv_status::timeout )
-			return nullptr;
+		*data = ring[r & mask];
+		read_idx.store(r + 1);
+		num_reads.store(num_reads.load(std::memory_order_relaxed) + 1,
+		                std::memory_order_relaxed);
+		return true;
 		}
 
-	if ( messages[read_ptr].empty() )
-		return nullptr;
-
-	T data = messages[read_ptr].front();
-	messages[read_ptr].pop();
+	// The writer only uses the overflow list while the ring's full or
+	// the list is non-empty, so anything in there comes after what we
+	// just found in the ring.
+	if ( overflow_size.load() == 0 )
+		return false;
 
-	read_ptr = (read_ptr + 1) % NUM_QUEUES;
-	++num_reads;
+	std::lock_guard<std::mutex> lock(overflow_mutex);
 
-	return data;
+	*data = overflow.front();
+	overflow.pop_front();
+	overflow_size.store(overflow.size());
+	num_reads.store(num_reads.load(std::memory_order_relaxed) + 1,
+	                std::memory_order_relaxed);
+	return true;
 	}
 
 template<typename T>
-inline void Queue<T>::Put(T data)
+inline T Queue<T>::Get()
 	{
-	auto lock = acquire_lock(mutex[write_ptr]);
-
-	int old_write_ptr = write_ptr;
+	T data;
 
-	bool need_signal = messages[write_ptr].empty();
+	if ( TryGet(&data) )
+		return data;
 
-	messages[write_ptr].push(data);
-
-	write_ptr = (write_ptr + 1) % NUM_QUEUES;
-	++num_writes;
+	// Only threads wait for input; the main thread polls its flare as
+	// part of the I/O loop instead.
+	if ( ! (reader && flare) )
+		return nullptr;
 
-	if ( need_signal )
-		{
-		lock.unlock();
-		has_data[old_write_ptr].notify_one();
-		}
-	}
+	if ( reader->Killed() || (writer && writer->Killed()) )
+		return nullptr;
 
+	// If anything got queued since we looked, the writer has fired the
+	// flare and this returns right away.
+	struct pollfd pfd = { flare->FD(), POLLIN, 0 };
 
-template<typename T>
-inline bool Queue<T>::Ready()
-	{
-	auto lock = acquire_lock(mutex[read_ptr]);
+	if ( poll(&pfd, 1, 5000) > 0 )
+		flare->Extinguish();
 
-	bool ret = (messages[read_ptr].size());
+	if ( TryGet(&data) )
+		return data;
 
-	return ret;
+	return nullptr;
 	}
 
 template<typename T>
-inline std::vector<std::unique_lock<std::mutex>> Queue<T>::LocksForAllQueues()
+inline void Queue<T>::Put(T data)
 	{
-	std::vector<std::unique_lock<std::mutex>> locks;
+	uint64_t w = write_idx.load(std::memory_order_relaxed);
+	bool queued = false;
+	bool was_empty = false;
 
-	try
+	if ( overflow_size.load() == 0 )
 		{
-		for ( int i = 0; i < NUM_QUEUES; i++ )
-			locks.emplace_back(std::unique_lock<std::mutex>(mutex[i]));
+		if ( w - cached_read_idx > mask )
+			cached_read_idx = read_idx.load();
+
+		if ( w - cached_read_idx <= mask )
+			{
+			ring[w & mask] = data;
+			write_idx.store(w + 1);
+			queued = true;
+
+			// Having published the element, check whether the
+			// reader had already consumed everything before it.
+			// Either we see that, or the reader sees our element
+			// before it goes to sleep.
+			cached_read_idx = read_idx.load();
+			was_empty = (cached_read_idx == w);
+			}
 		}
 
-	catch ( const std::system_error& e )
+	if ( ! queued )
 		{
-		reporter->FatalErrorWithCore("cannot lock all mutexes: %s", e.what());
-		// Never gets here.
-		throw std::exception();
+		// The ring is full, or still draining earlier overflow.
+		std::lock_guard<std::mutex> lock(overflow_mutex);
+		overflow.push_back(data);
+		overflow_size.store(overflow.size());
+
+		// The reader may have emptied the ring since we checked, so
+		// wake it up whenever the list starts filling.
+		was_empty = (overflow.size() == 1);
 		}
 
-	return locks;
+	num_writes.store(num_writes.load(std::memory_order_relaxed) + 1,
+	                 std::memory_order_relaxed);
+
+	if ( was_empty && flare )
+		flare->Fire();
 	}
 
 template<typename T>
-inline uint64_t Queue<T>::Size()
+inline bool Queue<T>::Ready()
 	{
-	// Need to lock all queues.
-	auto locks = LocksForAllQueues();
-
-	uint64_t size = 0;
+	return read_idx.load(std::memory_order_relaxed) != write_idx.load() ||
+	       overflow_size.load() > 0;
+	}
 
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		size += messages[i].size();
+template<typename T>
+inline uint64_t Queue<T>::Size()
+	{
+	// Take the read index first so that a concurrent Get() can't make
+	// the difference negative.
+	uint64_t r = read_idx.load();
+	uint64_t w = write_idx.load();
 
-	return size;
+	return (w - r) + overflow_size.load();
 	}
 
 template<typename T>
 inline void Queue<T>::GetStats(Stats* stats)
 	{
-	// To be safe, we look all queues. That's probably unneccessary, but
-	// doesn't really hurt.
-	auto locks = LocksForAllQueues();
-
-	stats->num_reads = num_reads;
-	stats->num_writes = num_writes;
+	stats->num_reads = num_reads.load(std::memory_order_relaxed);
+	stats->num_writes = num_writes.load(std::memory_order_relaxed);
 	}
 
 template<typename T>
 inline void Queue<T>::WakeUp()
 	{
-	for ( int i = 0; i < NUM_QUEUES; i++ )
-		{
-		auto lock = acquire_lock(mutex[i]);
-		has_data[i].notify_all();
-		}
+	if ( flare )
+		flare->Fire();
 	}
 
 } // namespace zeek::threading
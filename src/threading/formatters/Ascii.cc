@@ -7,6 +7,7 @@
 #include <sstream>
 
 #include "zeek/Desc.h"
+#include "zeek/modp_numtoa.h"
 #include "zeek/threading/MsgThread.h"
 
 using namespace std;
@@ -115,11 +116,16 @@ bool Ascii::Describe(ODesc* desc, Value* val, const string& name) const
 
 	case TYPE_INTERVAL:
 	case TYPE_TIME:
-		// Rendering via Render() keeps trailing 0s after the decimal
-		// point. The difference with DOUBLE is mainly to keep the
-		// log format consistent.
-		desc->Add(Render(val->val.double_val));
+		// Rendering like Render() does keeps trailing 0s after the
+		// decimal point. The difference with DOUBLE is mainly to keep
+		// the log format consistent. Formatting into a local buffer
+		// saves Render()'s string allocation.
+		{
+		char buf[256];
+		modp_dtoa(val->val.double_val, buf, 6);
+		desc->Add(buf);
 		break;
+		}
 
 	case TYPE_ENUM:
 	case TYPE_STRING:
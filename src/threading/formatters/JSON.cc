@@ -16,9 +16,136 @@
 
 #include "zeek/Desc.h"
 #include "zeek/threading/MsgThread.h"
+#include "zeek/ConvertUTF.h"
 
 namespace zeek::threading::formatter {
 
+// Appends the JSON string literal for a value, equivalent to what the
+// writer produces for util::json_escape_utf8()'s version of it, but in a
+// single pass that copies unproblematic spans in bulk.
+static void append_json_string(std::string* out, const char* data, size_t len)
+	{
+	auto udata = reinterpret_cast<const unsigned char*>(data);
+
+	out->push_back('"');
+
+	for ( size_t i = 0; i < len; )
+		{
+		size_t n = util::printable_prefix_len(data + i, len - i, "\"\\");
+
+		if ( n )
+			{
+			out->append(data + i, n);
+			i += n;
+			continue;
+			}
+
+		unsigned char c = udata[i];
+
+		switch ( c ) {
+		case '"':	out->append("\\\""); break;
+		case '\\':	out->append("\\\\"); break;
+		case '\b':	out->append("\\b"); break;
+		case '\f':	out->append("\\f"); break;
+		case '\n':	out->append("\\n"); break;
+		case '\r':	out->append("\\r"); break;
+		case '\t':	out->append("\\t"); break;
+		case 0x7f:	out->push_back(c); break;
+
+		default:
+			{
+			if ( c >= 0x80 )
+				{
+				unsigned int char_size = getNumBytesForUTF8(c);
+
+				if ( char_size > 1 && i + char_size <= len &&
+				     isLegalUTF8Sequence(udata + i, udata + i + char_size) )
+					{
+					out->append(data + i, char_size);
+					i += char_size;
+					continue;
+					}
+				}
+
+			// json_escape_utf8() turns the byte into \xYY, and the
+			// backslash then gets escaped once more.
+			char hex[5] = {'\\', '\\', 'x', '0', '0'};
+			util::bytetohex(c, hex + 3);
+			out->append(hex, 5);
+			break;
+			}
+		}
+
+		++i;
+		}
+
+	out->push_back('"');
+	}
+
+// Formats a timestamp like 2008-07-09T16:13:30.543210Z, which is what
+// strftime() and snprintf() would produce, without going through them.
+// Returns false for years that don't have four digits.
+static bool format_iso8601(double d, char* buf, size_t* len)
+	{
+	time_t the_time = time_t(floor(d));
+	struct tm t;
+
+	if ( ! gmtime_r(&the_time, &t) )
+		return false;
+
+	int year = t.tm_year + 1900;
+
+	if ( year < 1000 || year > 9999 )
+		return false;
+
+	double integ;
+	double frac = modf(d, &integ);
+
+	if ( frac < 0 )
+		frac += 1;
+
+	// Rounds like printf's %.0f does.
+	uint64_t usecs = uint64_t(nearbyint(fabs(frac) * 1000000));
+
+	auto put2 = [](char* p, int v) { p[0] = '0' + v / 10; p[1] = '0' + v % 10; };
+
+	put2(buf, year / 100);
+	put2(buf + 2, year % 100);
+	buf[4] = '-';
+	put2(buf + 5, t.tm_mon + 1);
+	buf[7] = '-';
+	put2(buf + 8, t.tm_mday);
+	buf[10] = 'T';
+	put2(buf + 11, t.tm_hour);
+	buf[13] = ':';
+	put2(buf + 14, t.tm_min);
+	buf[16] = ':';
+	put2(buf + 17, t.tm_sec);
+	buf[19] = '.';
+
+	// At least six digits, but rounding can make it seven.
+	char digits[20];
+	int n = 0;
+
+	do
+		{
+		digits[n++] = '0' + usecs % 10;
+		usecs /= 10;
+		} while ( usecs );
+
+	char* p = buf + 20;
+
+	for ( int i = n; i < 6; ++i )
+		*p++ = '0';
+
+	while ( n )
+		*p++ = digits[--n];
+
+	*p++ = 'Z';
+	*len = p - buf;
+	return true;
+	}
+
 bool JSON::NullDoubleWriter::Double(double d)
 	{
 	if ( rapidjson::internal::Double(d).IsNanOrInf() )
@@ -51,7 +178,7 @@ bool JSON::Describe(ODesc* desc, int num_fields, const Field* const * fields,
 		}
 
 	writer.EndObject();
-	desc->Add(buffer.GetString());
+	desc->AddN(buffer.GetString(), buffer.GetSize());
 
 	return true;
 	}
@@ -133,6 +260,14 @@ void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& na
 			if ( timestamps == TS_ISO8601 )
 				{
 				char buffer[40];
+				size_t len;
+
+				if ( format_iso8601(val->val.double_val, buffer, &len) )
+					{
+					writer.String(buffer, len);
+					break;
+					}
+
 				char buffer2[48];
 				time_t the_time = time_t(floor(val->val.double_val));
 				struct tm t;
@@ -175,8 +310,10 @@ void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& na
 		case TYPE_FILE:
 		case TYPE_FUNC:
 			{
-			writer.String(util::json_escape_utf8(
-				              std::string(val->val.string_val.data, val->val.string_val.length)));
+			std::string s;
+			s.reserve(val->val.string_val.length + 2);
+			append_json_string(&s, val->val.string_val.data, val->val.string_val.length);
+			writer.RawValue(s.data(), s.size(), rapidjson::kStringType);
 			break;
 			}
 
@@ -36,6 +36,10 @@
 #include <openssl/md5.h>
 #include <openssl/sha.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifdef HAVE_MALLINFO
 # include <malloc.h>
 #endif
@@ -1106,6 +1110,64 @@ std::string get_escaped_string(const char* str, size_t len, bool escape_all)
 	return get_escaped_string(&d, str, len, escape_all)->Description();
 	}
 
+size_t printable_prefix_len(const char* str, size_t len, std::string_view specials)
+	{
+	size_t i = 0;
+
+#ifdef __SSE2__
+	// Compared as signed, bytes >= 0x80 are negative, so a single
+	// comparison catches them along with the control characters.
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i del = _mm_set1_epi8(0x7f);
+
+	for ( ; i + 16 <= len; i += 16 )
+		{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+		__m128i stop = _mm_or_si128(_mm_cmplt_epi8(v, space), _mm_cmpeq_epi8(v, del));
+
+		for ( char c : specials )
+			stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+
+		if ( int mask = _mm_movemask_epi8(stop) )
+			return i + __builtin_ctz(mask);
+		}
+#endif
+
+	for ( ; i < len; ++i )
+		{
+		unsigned char c = str[i];
+
+		if ( c < 0x20 || c >= 0x7f || specials.find(c) != std::string_view::npos )
+			break;
+		}
+
+	return i;
+	}
+
+TEST_CASE("util printable_prefix_len")
+	{
+	CHECK(printable_prefix_len("", 0) == 0);
+	CHECK(printable_prefix_len("abc", 3) == 3);
+	CHECK(printable_prefix_len("ab\tc", 4) == 2);
+	CHECK(printable_prefix_len("ab\x7fc", 4) == 2);
+	CHECK(printable_prefix_len("ab\xc3\xb1", 4) == 2);
+	CHECK(printable_prefix_len("a,b", 3, ",") == 1);
+
+	// Longer than a vector, with the stop in different positions.
+	std::string s(100, 'x');
+
+	for ( size_t i = 0; i < s.size(); ++i )
+		{
+		std::string t = s;
+		t[i] = '\\';
+		CHECK(printable_prefix_len(t.data(), t.size(), "\\\"") == i);
+		t[i] = '\0';
+		CHECK(printable_prefix_len(t.data(), t.size()) == i);
+		}
+
+	CHECK(printable_prefix_len(s.data(), s.size(), ",") == s.size());
+	}
+
 char* copy_string(const char* s)
 	{
 	if ( ! s )
@@ -2417,8 +2479,12 @@ TEST_CASE("util json_escape_utf8")
 
 string json_escape_utf8(const string& val)
 	{
-	auto val_data = reinterpret_cast<const unsigned char*>(val.c_str());
-	auto val_size = val.length();
+	return json_escape_utf8(val.data(), val.size());
+	}
+
+string json_escape_utf8(const char* val, size_t val_size)
+	{
+	auto val_data = reinterpret_cast<const unsigned char*>(val);
 
 	// Reserve at least the size of the existing string to avoid resizing the string in the best-case
 	// scenario where we don't have any multi-byte characters.
@@ -2428,6 +2494,16 @@ string json_escape_utf8(const string& val)
 	size_t idx;
 	for ( idx = 0; idx < val_size; )
 		{
+		// Copy printable ASCII in bulk.
+		size_t n = printable_prefix_len(val + idx, val_size - idx);
+
+		if ( n )
+			{
+			result.append(val + idx, n);
+			idx += n;
+			continue;
+			}
+
 		const char ch = val[idx];
 
 		// Normal ASCII characters plus a few of the control characters can be inserted directly. The
@@ -2458,7 +2534,7 @@ string json_escape_utf8(const string& val)
 			continue;
 			}
 
-		result.append(val, idx, char_size);
+		result.append(val + idx, char_size);
 		idx += char_size;
 		}
 
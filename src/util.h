@@ -303,6 +303,19 @@ inline std::string get_escaped_string(const std::string& str, bool escape_all)
 	return get_escaped_string(str.data(), str.length(), escape_all);
 	}
 
+/**
+ * Returns the number of leading bytes of a string that are printable ASCII
+ * characters (0x20 to 0x7e) and not among a set of special ones. Escaping
+ * routines use this to find spans that they can copy in bulk. Where SSE2 is
+ * available, this checks 16 bytes at a time.
+ *
+ * @param str the string to scan
+ * @param len the length of \a str
+ * @param specials printable characters that end the span as well
+ * @return the length of the span
+ */
+size_t printable_prefix_len(const char* str, size_t len, std::string_view specials = {});
+
 std::vector<std::string>* tokenize_string(std::string_view input,
 					  std::string_view delim,
 					  std::vector<std::string>* rval = nullptr, int limit = 0);
@@ -490,6 +503,15 @@ inline void* safe_malloc(size_t size)
 	return ptr;
 	}
 
+inline void* safe_calloc(size_t nmemb, size_t size)
+	{
+	void* ptr = calloc(nmemb, size);
+	if ( nmemb && size && ! ptr )
+		out_of_memory("calloc");
+
+	return ptr;
+	}
+
 inline char* safe_strncpy(char* dest, const char* src, size_t n)
 	{
 	char* result = strncpy(dest, src, n-1);
@@ -541,5 +563,13 @@ char* zeekenv(const char* name);
  */
 std::string json_escape_utf8(const std::string& val);
 
+/**
+ * Escapes bytes in a string that are not valid UTF8 characters with \xYY format.
+ * @param val the input string to be escaped
+ * @param len the length of \a val
+ * @return the escaped string
+ */
+std::string json_escape_utf8(const char* val, size_t len);
+
 } // namespace util
 } // namespace zeek
@@ -53,6 +53,7 @@ extern "C" {
 #include "zeek/Func.h"
 #include "zeek/ScannedFile.h"
 #include "zeek/Frag.h"
+#include "zeek/FlowShards.h"
 
 #include "zeek/script_opt/ScriptOpt.h"
 
@@ -412,6 +413,10 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		exit(context.run());
 		}
 
+	// This needs to come before anything starts threads.
+	if ( options.flow_shards > 1 )
+		fork_flow_shards(&options);
+
 	auto stem = Supervisor::CreateStem(options.supervisor_mode);
 
 	if ( Supervisor::ThisNode() )
@@ -521,7 +526,10 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	createCurrentDoc("1.0");		// Set a global XML document
 #endif
 
-	timer_mgr = new PQ_TimerMgr();
+	if ( options.use_timer_wheel )
+		timer_mgr = new TW_TimerMgr();
+	else
+		timer_mgr = new PQ_TimerMgr();
 
 	auto zeekygen_cfg = options.zeekygen_config_file.value_or("");
 	zeekygen_mgr = new zeekygen::detail::Manager(zeekygen_cfg, zeek_argv[0]);
@@ -704,6 +712,12 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		id->SetVal(make_intrusive<StringVal>(*options.pcap_filter));
 		}
 
+	// Precompile the patterns parsed so far, and from now on also the
+	// signatures' pattern groups.
+	Specific_RE_Matcher::EnablePrecompilation(
+		std::min(id::find_val("pattern_precompile_max_states")->AsCount(), bro_uint_t(INT_MAX)),
+		id::find_val("pattern_precompile_cache_dir")->AsString()->CheckString());
+
 	auto all_signature_files = options.signature_files;
 
 	// Append signature files defined in "signature_files" script option